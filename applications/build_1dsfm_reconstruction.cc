@@ -298,8 +298,10 @@ InitializeReconstructionBuilderFrom1DSFM() {
       SetReconstructionBuilderOptions();
   std::unique_ptr<Reconstruction> reconstruction(new Reconstruction);
   std::unique_ptr<theia::ViewGraph> view_graph(new theia::ViewGraph);
-  CHECK(Read1DSFM(
-      FLAGS_1dsfm_dataset_directory, reconstruction.get(), view_graph.get()))
+  CHECK(Read1DSFM(FLAGS_1dsfm_dataset_directory,
+                  FLAGS_num_threads,
+                  reconstruction.get(),
+                  view_graph.get()))
       << "Could not read 1dsfm dataset from " << FLAGS_1dsfm_dataset_directory;
   LOG(INFO) << "Initializing reconstruction builder from 1dsfm.";
   return std::unique_ptr<ReconstructionBuilder>(new ReconstructionBuilder(
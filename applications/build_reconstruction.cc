@@ -55,6 +55,11 @@ DEFINE_string(
     "",
     "Filename to write reconstruction to. The filename will be appended with "
     "the reconstruction number if multiple reconstructions are created.");
+DEFINE_bool(write_compact_reconstruction,
+            false,
+            "Write the reconstruction in the compact columnar format, which is "
+            "much faster to write and read for large reconstructions. All "
+            "applications that read reconstructions accept this format.");
 
 // Multithreading.
 DEFINE_int32(num_threads,
@@ -71,6 +76,11 @@ DEFINE_string(feature_density,
               "NORMAL",
               "Set to SPARSE, NORMAL, or DENSE to extract fewer or more "
               "features from each image.");
+DEFINE_string(keypoint_selection,
+              "STRENGTH",
+              "Set to STRENGTH, GRID, or ANMS to choose how the features to "
+              "keep are selected when an image has too many features. GRID "
+              "and ANMS spread the features over the image.");
 DEFINE_string(matching_strategy,
               "CASCADE_HASHING",
               "Strategy used to match features. Must be BRUTE_FORCE "
@@ -79,6 +89,25 @@ DEFINE_string(matching_working_directory,
               "",
               "Directory used during matching to store features for "
               "out-of-core matching.");
+DEFINE_int32(matching_database_cache_size_mb,
+             512,
+             "Size of the block cache of the features and matches database.");
+DEFINE_int32(matching_database_write_buffer_size_mb,
+             1024,
+             "Memory used to buffer writes to the features and matches "
+             "database before they are flushed to disk.");
+DEFINE_int32(matching_database_background_jobs,
+             4,
+             "Number of threads that flush and compact the features and "
+             "matches database.");
+DEFINE_string(matching_database_compression,
+              "SNAPPY",
+              "Compression of the features and matches database. Must be one "
+              "of NONE, SNAPPY, LZ4 or ZSTD.");
+DEFINE_bool(resume_matching,
+            false,
+            "Only match the image pairs that have not been processed by a "
+            "previous run using the same matching_working_directory.");
 DEFINE_double(lowes_ratio, 0.8, "Lowes ratio used for feature matching.");
 DEFINE_double(max_sampson_error_for_verified_match,
               4.0,
@@ -94,6 +123,11 @@ DEFINE_int32(min_num_inliers_for_valid_match,
 DEFINE_bool(bundle_adjust_two_view_geometry,
             true,
             "Set to false to turn off 2-view BA.");
+DEFINE_bool(share_homography_hypotheses,
+            false,
+            "Count the homography inliers of calibrated image pairs from the "
+            "samples of the relative pose RANSAC instead of running a separate "
+            "homography RANSAC.");
 DEFINE_bool(keep_only_symmetric_matches,
             true,
             "Performs two-way matching and keeps symmetric matches.");
@@ -209,6 +243,11 @@ DEFINE_int32(partial_bundle_adjustment_num_views,
              20,
              "When full BA is not being run, partial BA is executed on a "
              "constant number of views specified by this parameter.");
+DEFINE_bool(reuse_bundle_adjustment_problem,
+            false,
+            "Keep the partial and full bundle adjustment problems of "
+            "incremental SfM alive between calls instead of rebuilding them "
+            "for every call.");
 
 // Triangulation options.
 DEFINE_double(min_triangulation_angle_degrees,
@@ -234,6 +273,30 @@ DEFINE_double(bundle_adjustment_robust_loss_width,
               "If the BA loss function is not NONE, then this value controls "
               "where the robust loss begins with respect to reprojection error "
               "in pixels.");
+DEFINE_int32(max_num_views_per_bundle_adjustment_partition,
+             0,
+             "Global SfM bundle adjustment of reconstructions with more views "
+             "than this is split into partitions of at most this many views "
+             "that are optimized separately. Set to 0 to disable.");
+DEFINE_int32(num_bundle_adjustment_partitions_in_parallel,
+             1,
+             "Number of bundle adjustment partitions that are optimized at "
+             "the same time. Only the problems of these partitions are held in "
+             "memory.");
+DEFINE_int32(max_num_partitioned_bundle_adjustment_iterations,
+             10,
+             "Maximum number of rounds in which all bundle adjustment "
+             "partitions are optimized once.");
+DEFINE_double(partitioned_bundle_adjustment_function_tolerance,
+              1e-3,
+              "Partitioned bundle adjustment stops when the relative decrease "
+              "of the reprojection cost of a round is below this value.");
+DEFINE_double(bundle_adjustment_partition_consensus_penalty,
+              1.0,
+              "Weight per observation of the term that ties together the "
+              "estimates of a track that is optimized in several bundle "
+              "adjustment partitions. The value is in squared pixels per "
+              "squared unit of the reconstruction.");
 
 // Track Subsampling parameters.
 DEFINE_bool(subsample_tracks_for_bundle_adjustment,
@@ -272,11 +335,15 @@ ReconstructionBuilderOptions SetReconstructionBuilderOptions() {
 
   options.descriptor_type = StringToDescriptorExtractorType(FLAGS_descriptor);
   options.feature_density = StringToFeatureDensity(FLAGS_feature_density);
+  options.keypoint_selection_type =
+      StringToKeypointSelectionType(FLAGS_keypoint_selection);
   options.features_and_matches_database_directory =
       FLAGS_matching_working_directory;
   options.matching_strategy =
       StringToMatchingStrategyType(FLAGS_matching_strategy);
   options.matching_options.lowes_ratio = FLAGS_lowes_ratio;
+  options.matching_options.match_only_pending_image_pairs =
+      FLAGS_resume_matching;
   options.matching_options.keep_only_symmetric_matches =
       FLAGS_keep_only_symmetric_matches;
   options.min_num_inlier_matches = FLAGS_min_num_inliers_for_valid_match;
@@ -286,6 +353,8 @@ ReconstructionBuilderOptions SetReconstructionBuilderOptions() {
       FLAGS_max_sampson_error_for_verified_match;
   options.matching_options.geometric_verification_options.bundle_adjustment =
       FLAGS_bundle_adjust_two_view_geometry;
+  options.matching_options.geometric_verification_options
+      .share_homography_hypotheses = FLAGS_share_homography_hypotheses;
   options.matching_options.geometric_verification_options
       .triangulation_max_reprojection_error =
       FLAGS_triangulation_reprojection_error_pixels;
@@ -355,6 +424,8 @@ ReconstructionBuilderOptions SetReconstructionBuilderOptions() {
       FLAGS_full_bundle_adjustment_growth_percent;
   reconstruction_estimator_options.partial_bundle_adjustment_num_views =
       FLAGS_partial_bundle_adjustment_num_views;
+  reconstruction_estimator_options.reuse_bundle_adjustment_problem =
+      FLAGS_reuse_bundle_adjustment_problem;
 
   // Triangulation options (used by all SfM pipelines).
   reconstruction_estimator_options.min_triangulation_angle_degrees =
@@ -370,6 +441,21 @@ ReconstructionBuilderOptions SetReconstructionBuilderOptions() {
       StringToLossFunction(FLAGS_bundle_adjustment_robust_loss_function);
   reconstruction_estimator_options.bundle_adjustment_robust_loss_width =
       FLAGS_bundle_adjustment_robust_loss_width;
+  reconstruction_estimator_options
+      .max_num_views_per_bundle_adjustment_partition =
+      FLAGS_max_num_views_per_bundle_adjustment_partition;
+  reconstruction_estimator_options
+      .num_bundle_adjustment_partitions_in_parallel =
+      FLAGS_num_bundle_adjustment_partitions_in_parallel;
+  reconstruction_estimator_options
+      .max_num_partitioned_bundle_adjustment_iterations =
+      FLAGS_max_num_partitioned_bundle_adjustment_iterations;
+  reconstruction_estimator_options
+      .partitioned_bundle_adjustment_function_tolerance =
+      FLAGS_partitioned_bundle_adjustment_function_tolerance;
+  reconstruction_estimator_options
+      .bundle_adjustment_partition_consensus_penalty =
+      FLAGS_bundle_adjustment_partition_consensus_penalty;
 
   // Track subsampling options.
   reconstruction_estimator_options.subsample_tracks_for_bundle_adjustment =
@@ -507,9 +593,17 @@ int main(int argc, char* argv[]) {
   CHECK_GT(FLAGS_output_reconstruction.size(), 0);
 
   // Initialize the features and matches database.
+  theia::RocksDbFeaturesAndMatchesDatabaseOptions database_options;
+  database_options.block_cache_size_mb = FLAGS_matching_database_cache_size_mb;
+  database_options.db_write_buffer_size_mb =
+      FLAGS_matching_database_write_buffer_size_mb;
+  database_options.max_background_jobs =
+      FLAGS_matching_database_background_jobs;
+  database_options.compression =
+      StringToRocksDbCompressionType(FLAGS_matching_database_compression);
   std::unique_ptr<FeaturesAndMatchesDatabase> features_and_matches_database(
       new theia::RocksDbFeaturesAndMatchesDatabase(
-          FLAGS_matching_working_directory));
+          FLAGS_matching_working_directory, database_options));
 
   // Create the reconstruction builder.
   const ReconstructionBuilderOptions options =
@@ -536,7 +630,12 @@ int main(int argc, char* argv[]) {
     const std::string output_file =
         theia::StringPrintf("%s-%d", FLAGS_output_reconstruction.c_str(), i);
     LOG(INFO) << "Writing reconstruction " << i << " to " << output_file;
-    CHECK(theia::WriteReconstruction(*reconstructions[i], output_file))
-        << "Could not write reconstruction to file.";
+    if (FLAGS_write_compact_reconstruction) {
+      CHECK(theia::WriteCompactReconstruction(*reconstructions[i], output_file))
+          << "Could not write reconstruction to file.";
+    } else {
+      CHECK(theia::WriteReconstruction(*reconstructions[i], output_file))
+          << "Could not write reconstruction to file.";
+    }
   }
 }
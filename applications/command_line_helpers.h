@@ -45,11 +45,13 @@
 using theia::DescriptorExtractorType;
 using theia::FeatureDensity;
 using theia::GlobalPositionEstimatorType;
+using theia::KeypointSelectionType;
 using theia::GlobalRotationEstimatorType;
 using theia::LossFunctionType;
 using theia::MatchingStrategy;
 using theia::OptimizeIntrinsicsType;
 using theia::ReconstructionEstimatorType;
+using theia::RocksDbCompressionType;
 
 inline DescriptorExtractorType StringToDescriptorExtractorType(
     const std::string& descriptor) {
@@ -78,6 +80,21 @@ inline FeatureDensity StringToFeatureDensity(
   }
 }
 
+inline KeypointSelectionType StringToKeypointSelectionType(
+    const std::string& keypoint_selection) {
+  if (keypoint_selection == "STRENGTH") {
+    return KeypointSelectionType::STRENGTH;
+  } else if (keypoint_selection == "GRID") {
+    return KeypointSelectionType::GRID;
+  } else if (keypoint_selection == "ANMS") {
+    return KeypointSelectionType::ANMS;
+  } else {
+    LOG(FATAL) << "Invalid keypoint selection requested. Please use STRENGTH, "
+                  "GRID, or ANMS.";
+    return KeypointSelectionType::STRENGTH;
+  }
+}
+
 inline MatchingStrategy StringToMatchingStrategyType(
     const std::string& matching_strategy) {
   if (matching_strategy == "BRUTE_FORCE") {
@@ -91,6 +108,23 @@ inline MatchingStrategy StringToMatchingStrategyType(
   }
 }
 
+inline RocksDbCompressionType StringToRocksDbCompressionType(
+    const std::string& compression) {
+  if (compression == "NONE") {
+    return RocksDbCompressionType::NONE;
+  } else if (compression == "SNAPPY") {
+    return RocksDbCompressionType::SNAPPY;
+  } else if (compression == "LZ4") {
+    return RocksDbCompressionType::LZ4;
+  } else if (compression == "ZSTD") {
+    return RocksDbCompressionType::ZSTD;
+  } else {
+    LOG(FATAL) << "Invalid database compression specified. Please use NONE, "
+                  "SNAPPY, LZ4, or ZSTD.";
+    return RocksDbCompressionType::SNAPPY;
+  }
+}
+
 inline ReconstructionEstimatorType StringToReconstructionEstimatorType(
     const std::string& reconstruction_estimator) {
   if (reconstruction_estimator == "GLOBAL") {
@@ -188,20 +188,47 @@ void ComputeTrackLengthHistogram(const Reconstruction& reconstruction) {
   LOG(INFO) << "Track lengths = \n" << hist_msg;
 }
 
+// Only the cameras are needed to compare the reconstructions, so the tracks are
+// not loaded from compact reconstruction files. The number of tracks in the
+// file is returned in num_tracks.
+bool ReadReconstructionCameras(const std::string& filename,
+                               Reconstruction* reconstruction,
+                               int* num_tracks) {
+  if (theia::IsCompactReconstructionFile(filename)) {
+    theia::MappedCompactReconstruction mapped_reconstruction;
+    if (!mapped_reconstruction.Open(filename)) {
+      return false;
+    }
+    mapped_reconstruction.ExtractReconstruction(false, reconstruction);
+    *num_tracks = mapped_reconstruction.NumTracks();
+    return true;
+  }
+
+  if (!theia::ReadReconstruction(filename, reconstruction)) {
+    return false;
+  }
+  *num_tracks = reconstruction->NumTracks();
+  return true;
+}
+
 int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
   THEIA_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
 
   std::unique_ptr<Reconstruction> reference_reconstruction(
       new Reconstruction());
-  CHECK(theia::ReadReconstruction(FLAGS_reference_reconstruction,
-                                  reference_reconstruction.get()))
+  int num_reference_tracks;
+  CHECK(ReadReconstructionCameras(FLAGS_reference_reconstruction,
+                                  reference_reconstruction.get(),
+                                  &num_reference_tracks))
       << "Could not read ground truth reconstruction file:"
       << FLAGS_reference_reconstruction;
 
   std::unique_ptr<Reconstruction> reconstruction_to_align(new Reconstruction());
-  CHECK(theia::ReadReconstruction(FLAGS_reconstruction_to_align,
-                                  reconstruction_to_align.get()))
+  int num_tracks_to_align;
+  CHECK(ReadReconstructionCameras(FLAGS_reconstruction_to_align,
+                                  reconstruction_to_align.get(),
+                                  &num_tracks_to_align))
       << "Could not read reconstruction file:" << FLAGS_reconstruction_to_align;
 
   const std::vector<std::string> common_view_names =
@@ -223,8 +250,8 @@ int main(int argc, char* argv[]) {
 
   // Compare number of 3d points.
   LOG(INFO) << "Number of 3d points:\n"
-            << "\tReconstruction 1: " << reference_reconstruction->NumTracks()
-            << "\n\tReconstruction 2: " << reconstruction_to_align->NumTracks();
+            << "\tReconstruction 1: " << num_reference_tracks
+            << "\n\tReconstruction 2: " << num_tracks_to_align;
 
   // Evaluate rotation independent of positions.
   EvaluateRotations(*reference_reconstruction,
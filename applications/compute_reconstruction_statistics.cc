@@ -49,6 +49,20 @@ int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
   THEIA_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
 
+  // Compact reconstruction files are memory-mapped and the statistics are
+  // computed directly from the file without building a Reconstruction.
+  if (theia::IsCompactReconstructionFile(FLAGS_reconstruction)) {
+    theia::MappedCompactReconstruction reconstruction;
+    CHECK(reconstruction.Open(FLAGS_reconstruction))
+        << "Could not read reconstruction file.";
+
+    LOG(INFO) << "\nNum views: " << reconstruction.NumViews()
+              << "\nNum 3D points: " << reconstruction.NumTracks();
+    PrintReprojectionErrors(reconstruction);
+    PrintTrackLengthHistogram(reconstruction);
+    return 0;
+  }
+
   // Load the SIFT descriptors into the cameras.
   std::unique_ptr<theia::Reconstruction> reconstruction(
       new theia::Reconstruction());
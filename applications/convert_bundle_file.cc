@@ -48,6 +48,7 @@ DEFINE_string(images_directory, "",
               "Directory of input images. This is used to extract the "
               "principal point and image dimensions since Bundler does not "
               "provide those.");
+DEFINE_int32(num_threads, 1, "Number of threads used to parse the points.");
 
 int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
@@ -57,6 +58,7 @@ int main(int argc, char* argv[]) {
   theia::Reconstruction reconstruction;
   CHECK(theia::ReadBundlerFiles(FLAGS_lists_file,
                                 FLAGS_bundle_file,
+                                FLAGS_num_threads,
                                 &reconstruction))
       << "Could not read Bundler files.";
   if (FLAGS_images_directory.size() > 0) {
@@ -41,6 +41,7 @@
 DEFINE_string(nvm_file, "", "Input bundle lists file.");
 DEFINE_string(output_reconstruction_file, "",
               "Output reconstruction file in binary format.");
+DEFINE_int32(num_threads, 1, "Number of threads used to parse the NVM file.");
 
 int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
@@ -48,7 +49,8 @@ int main(int argc, char* argv[]) {
 
   // Import the NVM file as a Reconstruction.
   theia::Reconstruction reconstruction;
-  CHECK(theia::ImportNVMFile(FLAGS_nvm_file, &reconstruction))
+  CHECK(theia::ImportNVMFile(
+      FLAGS_nvm_file, FLAGS_num_threads, &reconstruction))
       << "Could not read NVM files.";
 
   CHECK(WriteReconstruction(reconstruction, FLAGS_output_reconstruction_file))
@@ -33,23 +33,46 @@
 // Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
 
 /* This tool exports a Theia match file in the Vision Workbench binary 
-   match file format.
+   match file format. The matches are streamed from the RocksDB database in
+   batches so that memory use is bounded regardless of the number of pairs,
+   and the match files of each batch are written in parallel. Each file is
+   written to a temporary file and renamed once complete, so a partial run
+   may be resumed with --skip_existing.
 */
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
+#include <future>
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 #include <theia/theia.h>
 
 #include <string>
+#include <vector>
 
 DEFINE_string(theia_match_dir, "",
               "Input directory having Theia matches.");
 DEFINE_string(vw_output_prefix, "", "Output files will be written with this folder/prefix.");
 DEFINE_int32(min_num_matches, 30,
              "Don't generate files with fewer matches than this.");
+DEFINE_int32(num_threads, 1, "Number of threads used to write match files.");
+DEFINE_int32(batch_size, 1000,
+             "Number of image pair matches read from the database at a time.");
+DEFINE_bool(skip_existing, false,
+            "Don't rewrite match files that already exist. Use this to resume "
+            "an export that was interrupted.");
 
 namespace theia {
+
+// The outcome of exporting a single image pair match.
+enum class VwExportStatus {
+  WRITTEN,
+  SKIPPED_TOO_FEW_MATCHES,
+  SKIPPED_EXISTING,
+  FAILED
+};
+
 // Return the name minus the extension
 std::string strip_ext(const std::string &name) {
   size_t pos = name.rfind('.');
@@ -85,9 +108,15 @@ bool make_vw_filename(std::string const& out_prefix,
   return swap;
 }
 
+// Appends raw bytes of a value to the buffer.
+template <typename T>
+inline void append_bytes(const T& value, std::string* buffer) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
 // Only the location is actually filled in, the rest of the fields
 // get dummy values.
-inline void write_vw_ip_record(std::ofstream &f, const theia::Feature & ip) {
+inline void write_vw_ip_record(const theia::Feature & ip, std::string* buffer) {
   float        dummy_f      = 0.0;
   bool         dummy_bool   = false;
   unsigned int dummy_uint32 = 0;
@@ -95,79 +124,177 @@ inline void write_vw_ip_record(std::ofstream &f, const theia::Feature & ip) {
   float y  = ip.y();
   int   ix = static_cast<int>(x);
   int   iy = static_cast<int>(y);
-  f.write((char*)&x,  sizeof(float));
-  f.write((char*)&y,  sizeof(float));
-  f.write((char*)&ix, sizeof(int  ));
-  f.write((char*)&iy, sizeof(int  ));
-  f.write((char*)&(dummy_f), sizeof(float));
-  f.write((char*)&(dummy_f), sizeof(float));
-  f.write((char*)&(dummy_f), sizeof(float));
-  f.write((char*)&(dummy_bool), sizeof(bool));
-  f.write((char*)&(dummy_uint32), sizeof(unsigned int));
-  f.write((char*)&(dummy_uint32), sizeof(unsigned int));
+  append_bytes(x, buffer);
+  append_bytes(y, buffer);
+  append_bytes(ix, buffer);
+  append_bytes(iy, buffer);
+  append_bytes(dummy_f, buffer);
+  append_bytes(dummy_f, buffer);
+  append_bytes(dummy_f, buffer);
+  append_bytes(dummy_bool, buffer);
+  append_bytes(dummy_uint32, buffer);
+  append_bytes(dummy_uint32, buffer);
   unsigned long long size = 1;
-  f.write((char*)(&size), sizeof(unsigned long long));
+  append_bytes(size, buffer);
   for (size_t i = 0; i < size; ++i)
-    f.write((char*)&(dummy_f), sizeof(float));
+    append_bytes(dummy_f, buffer);
 }
 
-// Write a single VW compatible binary file
+// Write a single VW compatible binary file. The file is assembled in memory,
+// written to a temporary file with a single write, and then renamed so that
+// the output file only ever exists in its complete form.
 bool write_vw_binary_match_file(const std::string   & matches_file,
                                 const theia::ImagePairMatch& matches,
                                 const bool swap) {
-  // Return false if the file cannot be opened for writing.
-  std::ofstream matches_writer(matches_file, std::ios::out | std::ios::binary);
-  if (!matches_writer.is_open()) {
-    LOG(ERROR) << "Could not open the matches file: " << matches_file
-               << " for writing.";
-    return false;
-  }
+  const size_t num_matches = matches.correspondences.size();
+  const size_t kRecordSize = 3 * sizeof(float) + 2 * sizeof(int) +
+                             sizeof(bool) + 2 * sizeof(unsigned int) +
+                             sizeof(unsigned long long) + 2 * sizeof(float);
+  std::string buffer;
+  buffer.reserve(2 * sizeof(unsigned long long) +
+                 2 * num_matches * kRecordSize);
 
   // Write the IP sizes
-  const size_t num_matches = matches.correspondences.size();
-  std::cout << "Writing " << num_matches << " matches to " << matches_file << std::endl;
   unsigned long long sizeull = num_matches;
-  matches_writer.write((char*)&sizeull, sizeof(unsigned long long));
-  matches_writer.write((char*)&sizeull, sizeof(unsigned long long));
+  append_bytes(sizeull, &buffer);
+  append_bytes(sizeull, &buffer);
   
   // Write all IP's for the first image
   for (size_t i=0; i<num_matches; ++i) {
     if (swap)
-      write_vw_ip_record(matches_writer, matches.correspondences[i].feature2);
+      write_vw_ip_record(matches.correspondences[i].feature2, &buffer);
     else
-      write_vw_ip_record(matches_writer, matches.correspondences[i].feature1);
+      write_vw_ip_record(matches.correspondences[i].feature1, &buffer);
   }
   // Write all IP's for the second image
   for (size_t i=0; i<num_matches; ++i) {
     if (swap)
-      write_vw_ip_record(matches_writer, matches.correspondences[i].feature1);
+      write_vw_ip_record(matches.correspondences[i].feature1, &buffer);
     else
-      write_vw_ip_record(matches_writer, matches.correspondences[i].feature2);
+      write_vw_ip_record(matches.correspondences[i].feature2, &buffer);
   }
 
+  // Return false if the file cannot be opened for writing.
+  const std::string temp_file = matches_file + ".tmp";
+  std::ofstream matches_writer(temp_file, std::ios::out | std::ios::binary);
+  if (!matches_writer.is_open()) {
+    LOG(ERROR) << "Could not open the matches file: " << temp_file
+               << " for writing.";
+    return false;
+  }
+  matches_writer.write(buffer.data(), buffer.size());
   matches_writer.close();
+  if (!matches_writer) {
+    LOG(ERROR) << "Could not write the matches file: " << temp_file;
+    std::remove(temp_file.c_str());
+    return false;
+  }
+
+  if (std::rename(temp_file.c_str(), matches_file.c_str()) != 0) {
+    LOG(ERROR) << "Could not rename " << temp_file << " to " << matches_file;
+    std::remove(temp_file.c_str());
+    return false;
+  }
   return true;
 }
 
-// Convert all the image match information into multiple VW match files.
+// Export a single image pair match to its VW match file.
+VwExportStatus ExportVwMatchFile(const std::string& output_prefix,
+                                 const theia::ImagePairMatch& match,
+                                 const int min_num_matches,
+                                 const bool skip_existing) {
+  if (match.correspondences.size() < min_num_matches) {
+    return VwExportStatus::SKIPPED_TOO_FEW_MATCHES;
+  }
+
+  std::string this_file;
+  const bool swap =
+      make_vw_filename(output_prefix, match.image1, match.image2, this_file);
+  // Files are renamed into place only once complete, so an existing file is
+  // always a valid output of a previous run.
+  if (skip_existing && FileExists(this_file)) {
+    return VwExportStatus::SKIPPED_EXISTING;
+  }
+
+  VLOG(2) << "Writing " << match.correspondences.size() << " matches to "
+          << this_file;
+  if (!write_vw_binary_match_file(this_file, match, swap)) {
+    return VwExportStatus::FAILED;
+  }
+  return VwExportStatus::WRITTEN;
+}
+
+// Stream all image pair matches from the database and convert them into
+// multiple VW match files. Only two batches of matches are held in memory at
+// any time: the batch being written by the thread pool and the next batch,
+// which is read from the database while the current batch is written.
 bool WriteAllVwMatchFiles(
     const std::string& output_prefix,
-    const std::vector<std::string>& view_names,
-    const std::vector<theia::ImagePairMatch>& matches,
-    const int min_num_matches) {
+    const int min_num_matches,
+    const bool skip_existing,
+    const int batch_size,
+    const int num_threads,
+    theia::RocksDbFeaturesAndMatchesDatabase* database) {
+  ThreadPool pool(std::max(num_threads, 1));
 
-  // Write info for each pair to a seperate match file.
-  const size_t num_matches = matches.size();
-  for (size_t i=0; i<num_matches; ++i) {
-    const size_t num_matches = matches[i].correspondences.size();
-    if (num_matches < min_num_matches)
-      continue; // Skip pairs with too few IP
-    std::string this_file;
-    bool swap = make_vw_filename(output_prefix, matches[i].image1, matches[i].image2, this_file);
-    if (!write_vw_binary_match_file(this_file, matches[i], swap))
-      return false;
+  std::vector<theia::ImagePairMatch> matches, next_matches;
+  bool has_matches =
+      database->GetNextImagePairMatches("", "", batch_size, &matches);
+
+  int num_written = 0, num_too_few = 0, num_existing = 0, num_failed = 0;
+  while (has_matches) {
+    // Compactly stored matches only contain feature indices, so their
+    // correspondences are resolved against the keypoints of each image.
+    for (theia::ImagePairMatch& match : matches) {
+      if (match.correspondences.empty() && !match.feature_indices.empty() &&
+          !theia::ResolveCorrespondences(database->GetKeypoints(match.image1),
+                                         database->GetKeypoints(match.image2),
+                                         &match)) {
+        LOG(ERROR) << "Could not resolve the matches between " << match.image1
+                   << " and " << match.image2;
+      }
+    }
+
+    std::vector<std::future<VwExportStatus> > results;
+    results.reserve(matches.size());
+    for (const theia::ImagePairMatch& match : matches) {
+      results.emplace_back(pool.Add(ExportVwMatchFile,
+                                    std::cref(output_prefix),
+                                    std::cref(match),
+                                    min_num_matches,
+                                    skip_existing));
+    }
+
+    // Read the next batch while the current one is being written.
+    has_matches = database->GetNextImagePairMatches(matches.back().image1,
+                                                    matches.back().image2,
+                                                    batch_size,
+                                                    &next_matches);
+
+    for (auto& result : results) {
+      switch (result.get()) {
+        case VwExportStatus::WRITTEN:
+          ++num_written;
+          break;
+        case VwExportStatus::SKIPPED_TOO_FEW_MATCHES:
+          ++num_too_few;
+          break;
+        case VwExportStatus::SKIPPED_EXISTING:
+          ++num_existing;
+          break;
+        case VwExportStatus::FAILED:
+          ++num_failed;
+          break;
+      }
+    }
+    std::swap(matches, next_matches);
+
+    LOG(INFO) << "Exported " << num_written << " match files (" << num_too_few
+              << " pairs with too few matches, " << num_existing
+              << " existing files skipped, " << num_failed << " failures).";
   }
-  return true;
+
+  return num_failed == 0;
 }
 
 } // end namespace theia
@@ -175,30 +302,20 @@ bool WriteAllVwMatchFiles(
 int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
   THEIA_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_batch_size, 0);
 
   // Initialize the features and matches database.
-  std::unique_ptr<theia::FeaturesAndMatchesDatabase> features_and_matches_database
-    (new theia::RocksDbFeaturesAndMatchesDatabase(FLAGS_theia_match_dir));
-
-  // Add the matches
-  const auto match_keys = features_and_matches_database->ImageNamesOfMatches();
-  std::cout << "Loaded " << match_keys.size() << " pairs of matches.\n";
-  for (const auto& match_key: match_keys) {
-    const theia::ImagePairMatch& match =
-        features_and_matches_database->GetImagePairMatch(match_key.first,
-                                                         match_key.second);
-
-    const size_t num_matches = match.correspondences.size();
-    if (num_matches < FLAGS_min_num_matches) {
-      std::cout << "Too few matches loaded, will not save them.\n";
-      continue; // Skip pairs with too few IP
-    }
-    
-    std::string this_file;
-    bool swap = theia::make_vw_filename(FLAGS_vw_output_prefix,
-                                        match_key.first, match_key.second, this_file);
-    if (!write_vw_binary_match_file(this_file, match, swap))
-      std::cout << "Failed to write match file: " << this_file << std::endl;
+  theia::RocksDbFeaturesAndMatchesDatabase features_and_matches_database(
+      FLAGS_theia_match_dir);
+
+  if (!theia::WriteAllVwMatchFiles(FLAGS_vw_output_prefix,
+                                   FLAGS_min_num_matches,
+                                   FLAGS_skip_existing,
+                                   FLAGS_batch_size,
+                                   FLAGS_num_threads,
+                                   &features_and_matches_database)) {
+    LOG(ERROR) << "Failed to write some of the match files.";
+    return 1;
   }
 
   return 0;
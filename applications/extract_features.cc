@@ -56,6 +56,10 @@ DEFINE_string(
 DEFINE_string(feature_density, "NORMAL",
               "Set to SPARSE, NORMAL, or DENSE to extract fewer or more "
               "features from each image.");
+DEFINE_string(keypoint_selection, "STRENGTH",
+              "Set to STRENGTH, GRID, or ANMS to choose how the features to "
+              "keep are selected when an image has too many features. GRID "
+              "and ANMS spread the features over the image.");
 
 int main(int argc, char *argv[]) {
   THEIA_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
@@ -72,6 +76,8 @@ int main(int argc, char *argv[]) {
   options.descriptor_extractor_type =
       StringToDescriptorExtractorType(FLAGS_descriptor);
   options.feature_density = StringToFeatureDensity(FLAGS_feature_density);
+  options.keypoint_selection_type =
+      StringToKeypointSelectionType(FLAGS_keypoint_selection);
   options.num_threads = FLAGS_num_threads;
   options.output_directory = FLAGS_features_output_directory;
 
@@ -40,88 +40,146 @@
 #include <theia/theia.h>
 
 #include <algorithm>
+#include <numeric>
 #include <string>
 #include <vector>
 
-inline void PrintReprojectionErrors(
-    const theia::Reconstruction& reconstruction) {
-  std::vector<double> reprojection_errors;
-  int num_projections_behind_camera = 0;
-  for (const theia::TrackId track_id : reconstruction.TrackIds()) {
-    const theia::Track* track = CHECK_NOTNULL(reconstruction.Track(track_id));
-    for (const theia::ViewId view_id : track->ViewIds()) {
-      const theia::Feature* feature =
-        reconstruction.View(view_id)->GetFeature(track_id);
-
-      // Reproject the observations.
-      Eigen::Vector2d projection;
-      if (reconstruction.View(view_id)
-              ->Camera().ProjectPoint(track->Point(), &projection) < 0) {
-        ++num_projections_behind_camera;
-      }
-
-      // Compute reprojection error.
-      const double reprojection_error = (*feature - projection).norm();
-      reprojection_errors.emplace_back(reprojection_error);
-    }
+// Reprojects the point into the camera and adds the reprojection error of the
+// observed feature.
+inline void AddReprojectionError(const theia::Camera& camera,
+                                 const Eigen::Vector4d& point,
+                                 const Eigen::Vector2d& feature,
+                                 std::vector<double>* reprojection_errors,
+                                 int* num_projections_behind_camera) {
+  // Reproject the observations.
+  Eigen::Vector2d projection;
+  if (camera.ProjectPoint(point, &projection) < 0) {
+    ++(*num_projections_behind_camera);
   }
 
-  if (reprojection_errors.size() == 0) {
+  // Compute reprojection error.
+  const double reprojection_error = (feature - projection).norm();
+  reprojection_errors->emplace_back(reprojection_error);
+}
+
+inline void PrintReprojectionErrorStatistics(
+    const int num_projections_behind_camera,
+    std::vector<double>* reprojection_errors) {
+  if (reprojection_errors->size() == 0) {
     LOG(INFO) << "No estimated 3d points were found. Cannot compute "
                  "reprojection error statistics.";
     return;
   }
 
-  std::sort(reprojection_errors.begin(), reprojection_errors.end());
+  std::sort(reprojection_errors->begin(), reprojection_errors->end());
   const double mean_reprojection_error =
-      std::accumulate(reprojection_errors.begin(),
-                      reprojection_errors.end(),
-                      0.0) / static_cast<double>(reprojection_errors.size());
+      std::accumulate(reprojection_errors->begin(),
+                      reprojection_errors->end(),
+                      0.0) / static_cast<double>(reprojection_errors->size());
   const double median_reprojection_error =
-      reprojection_errors[reprojection_errors.size() / 2];
+      (*reprojection_errors)[reprojection_errors->size() / 2];
 
-  LOG(INFO) << "\nNum observations: " << reprojection_errors.size()
+  LOG(INFO) << "\nNum observations: " << reprojection_errors->size()
             << "\nNum reprojections behind camera: "
             << num_projections_behind_camera
             << "\nMean reprojection error = " << mean_reprojection_error
             << "\nMedian reprojection_error = " << median_reprojection_error;
 }
 
-inline void PrintTrackLengthHistogram(
-    const theia::Reconstruction& reconstruction) {
-  std::vector<int> histogram_bins = {2, 3,  4,  5,  6,  7, 8,
-                                     9, 10, 15, 20, 25, 50};
-  theia::Histogram<int> histogram(histogram_bins);
-  std::vector<int> track_lengths;
-  for (const theia::TrackId track_id : reconstruction.TrackIds()) {
-    const theia::Track* track = reconstruction.Track(track_id);
-    track_lengths.emplace_back(track->NumViews());
-    histogram.Add(track->NumViews());
-  }
-
+inline void PrintTrackLengthStatistics(std::vector<int>* track_lengths) {
   // Exit if there were no tracks found.
-  if (track_lengths.size() == 0) {
+  if (track_lengths->size() == 0) {
     LOG(INFO) << "No valid tracks were present in the reconstruction.";
     return;
   }
 
+  std::vector<int> histogram_bins = {2, 3,  4,  5,  6,  7, 8,
+                                     9, 10, 15, 20, 25, 50};
+  theia::Histogram<int> histogram(histogram_bins);
+  for (const int track_length : *track_lengths) {
+    histogram.Add(track_length);
+  }
+
   // Compute the mean and median track lengths.
   const float mean_track_length =
-      std::accumulate(track_lengths.begin(), track_lengths.end(), 0) /
-      static_cast<float>(track_lengths.size());
+      std::accumulate(track_lengths->begin(), track_lengths->end(), 0.0) /
+      static_cast<float>(track_lengths->size());
   LOG(INFO) << "Mean track length: " << mean_track_length;
 
   // Sort the median track length.
-  std::nth_element(track_lengths.begin(),
-                   track_lengths.begin() + track_lengths.size() / 2,
-                   track_lengths.end());
-  const int median_track_length = track_lengths[track_lengths.size() / 2];
+  std::nth_element(track_lengths->begin(),
+                   track_lengths->begin() + track_lengths->size() / 2,
+                   track_lengths->end());
+  const int median_track_length = (*track_lengths)[track_lengths->size() / 2];
   LOG(INFO) << "Median track length: " << median_track_length;
 
   // Display the track length histogram.
   const std::string hist_msg = histogram.PrintString();
   LOG(INFO) << "Track length histogram = \n" << hist_msg;
+}
+
+inline void PrintReprojectionErrors(
+    const theia::Reconstruction& reconstruction) {
+  std::vector<double> reprojection_errors;
+  int num_projections_behind_camera = 0;
+  for (const theia::TrackId track_id : reconstruction.TrackIds()) {
+    const theia::Track* track = CHECK_NOTNULL(reconstruction.Track(track_id));
+    for (const theia::ViewId view_id : track->ViewIds()) {
+      const theia::View* view = reconstruction.View(view_id);
+      AddReprojectionError(view->Camera(),
+                           track->Point(),
+                           *view->GetFeature(track_id),
+                           &reprojection_errors,
+                           &num_projections_behind_camera);
+    }
+  }
+  PrintReprojectionErrorStatistics(num_projections_behind_camera,
+                                   &reprojection_errors);
+}
 
+// Computes the same statistics as PrintReprojectionErrors directly from the
+// columns of a memory-mapped compact reconstruction file.
+inline void PrintReprojectionErrors(
+    const theia::MappedCompactReconstruction& reconstruction) {
+  std::vector<theia::Camera> cameras(reconstruction.NumViews());
+  for (int i = 0; i < reconstruction.NumViews(); i++) {
+    reconstruction.GetCamera(i, &cameras[i]);
+  }
+
+  std::vector<double> reprojection_errors;
+  reprojection_errors.reserve(reconstruction.NumObservations());
+  int num_projections_behind_camera = 0;
+  for (int i = 0; i < reconstruction.NumTracks(); i++) {
+    const Eigen::Vector4d point = reconstruction.Point(i);
+    for (uint64_t j = reconstruction.ObservationsBegin(i);
+         j < reconstruction.ObservationsEnd(i); j++) {
+      AddReprojectionError(cameras[reconstruction.ObservationView(j)],
+                           point,
+                           reconstruction.ObservationFeature(j),
+                           &reprojection_errors,
+                           &num_projections_behind_camera);
+    }
+  }
+  PrintReprojectionErrorStatistics(num_projections_behind_camera,
+                                   &reprojection_errors);
+}
+
+inline void PrintTrackLengthHistogram(
+    const theia::Reconstruction& reconstruction) {
+  std::vector<int> track_lengths;
+  for (const theia::TrackId track_id : reconstruction.TrackIds()) {
+    track_lengths.emplace_back(reconstruction.Track(track_id)->NumViews());
+  }
+  PrintTrackLengthStatistics(&track_lengths);
+}
+
+inline void PrintTrackLengthHistogram(
+    const theia::MappedCompactReconstruction& reconstruction) {
+  std::vector<int> track_lengths(reconstruction.NumTracks());
+  for (int i = 0; i < reconstruction.NumTracks(); i++) {
+    track_lengths[i] = reconstruction.TrackLength(i);
+  }
+  PrintTrackLengthStatistics(&track_lengths);
 }
 
 #endif  // APPLICATIONS_PRINT_RECONSTRUCTION_STATISTICS_H_
@@ -41,6 +41,14 @@ DEFINE_string(ply_file, "", "Output PLY file.");
 DEFINE_int32(min_num_observations_per_point, 3,
              "Minimum number of observations for a point to be written out to "
              "the PLY file. This helps reduce noise in the resulty PLY file.");
+DEFINE_bool(binary, false,
+            "Write a binary_little_endian PLY file instead of an ASCII file.");
+DEFINE_bool(write_normals, false,
+            "Write a normal for each point pointing towards the cameras that "
+            "observe it.");
+DEFINE_bool(write_num_observations, false,
+            "Write the number of observations of each point.");
+DEFINE_int32(num_threads, 1, "Number of threads used to format the points.");
 
 int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
@@ -50,9 +58,14 @@ int main(int argc, char* argv[]) {
   CHECK(theia::ReadReconstruction(FLAGS_reconstruction, &reconstruction))
       << "Could not read Reconstruction files.";
 
-  CHECK(WritePlyFile(FLAGS_ply_file,
-                     reconstruction,
-                     FLAGS_min_num_observations_per_point))
+  theia::WritePlyFileOptions options;
+  options.min_num_observations_per_point =
+      FLAGS_min_num_observations_per_point;
+  options.binary = FLAGS_binary;
+  options.write_normals = FLAGS_write_normals;
+  options.write_num_observations = FLAGS_write_num_observations;
+  options.num_threads = FLAGS_num_threads;
+  CHECK(WritePlyFile(FLAGS_ply_file, reconstruction, options))
       << "Could not write out PLY file.";
   return 0;
 }
@@ -39,14 +39,17 @@
 #include "theia/image/descriptor/akaze_descriptor.h"
 #include "theia/image/descriptor/create_descriptor_extractor.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
 #include "theia/image/descriptor/sift_descriptor.h"
 #include "theia/image/image.h"
 #include "theia/image/image_cache.h"
 #include "theia/image/keypoint_detector/keypoint.h"
 #include "theia/image/keypoint_detector/keypoint_detector.h"
+#include "theia/image/keypoint_detector/select_keypoints.h"
 #include "theia/image/keypoint_detector/sift_detector.h"
 #include "theia/image/keypoint_detector/sift_parameters.h"
 #include "theia/io/bundler_file_reader.h"
+#include "theia/io/compact_reconstruction.h"
 #include "theia/io/eigen_serializable.h"
 #include "theia/io/import_nvm_file.h"
 #include "theia/io/populate_image_sizes.h"
@@ -59,6 +62,7 @@
 #include "theia/io/reconstruction_writer.h"
 #include "theia/io/sift_binary_file.h"
 #include "theia/io/sift_text_file.h"
+#include "theia/io/text_tokenizer.h"
 #include "theia/io/write_bundler_files.h"
 #include "theia/io/write_calibration.h"
 #include "theia/io/write_keypoints_and_descriptors.h"
@@ -109,9 +113,12 @@
 #include "theia/sfm/bundle_adjustment/bundle_adjust_two_views.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjuster.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjustment_session.h"
 #include "theia/sfm/bundle_adjustment/create_loss_function.h"
 #include "theia/sfm/bundle_adjustment/optimize_relative_position_with_known_rotation.h"
 #include "theia/sfm/bundle_adjustment/orthogonal_vector_error.h"
+#include "theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/refine_track_points.h"
 #include "theia/sfm/bundle_adjustment/unit_norm_three_vector_parameterization.h"
 #include "theia/sfm/camera/camera.h"
 #include "theia/sfm/camera/camera_intrinsics_model.h"
@@ -128,6 +135,7 @@
 #include "theia/sfm/colorize_reconstruction.h"
 #include "theia/sfm/estimate_track.h"
 #include "theia/sfm/estimate_twoview_info.h"
+#include "theia/sfm/estimators/batch_residuals.h"
 #include "theia/sfm/estimators/estimate_absolute_pose_with_known_orientation.h"
 #include "theia/sfm/estimators/estimate_calibrated_absolute_pose.h"
 #include "theia/sfm/estimators/estimate_dominant_plane_from_points.h"
@@ -199,6 +207,7 @@
 #include "theia/sfm/reconstruction_estimator.h"
 #include "theia/sfm/reconstruction_estimator_options.h"
 #include "theia/sfm/reconstruction_estimator_utils.h"
+#include "theia/sfm/reconstruction_localizer.h"
 #include "theia/sfm/rigid_transformation.h"
 #include "theia/sfm/select_good_tracks_for_bundle_adjustment.h"
 #include "theia/sfm/set_camera_intrinsics_from_priors.h"
@@ -237,10 +246,12 @@
 #include "theia/solvers/ransac.h"
 #include "theia/solvers/sample_consensus_estimator.h"
 #include "theia/solvers/sampler.h"
+#include "theia/util/bounded_queue.h"
 #include "theia/util/enable_enum_bitmask_operators.h"
 #include "theia/util/filesystem.h"
 #include "theia/util/hash.h"
 #include "theia/util/lru_cache.h"
+#include "theia/util/mapped_file.h"
 #include "theia/util/map_util.h"
 #include "theia/util/mutable_priority_queue.h"
 #include "theia/util/random.h"
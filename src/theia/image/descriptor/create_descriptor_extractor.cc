@@ -85,12 +85,27 @@ inline AkazeParameters FeatureDensityToAkazeParameters(
 std::unique_ptr<DescriptorExtractor> CreateDescriptorExtractor(
     const DescriptorExtractorType& descriptor_type,
     const FeatureDensity& feature_density) {
+  return CreateDescriptorExtractor(
+      descriptor_type, feature_density, KeypointSelectionOptions());
+}
+
+std::unique_ptr<DescriptorExtractor> CreateDescriptorExtractor(
+    const DescriptorExtractorType& descriptor_type,
+    const FeatureDensity& feature_density,
+    const KeypointSelectionOptions& keypoint_selection) {
   std::unique_ptr<DescriptorExtractor> descriptor_extractor;
   switch (descriptor_type) {
-    case DescriptorExtractorType::SIFT:
-      descriptor_extractor.reset(new SiftDescriptorExtractor(
-          FeatureDensityToSiftParameters(feature_density)));
+    case DescriptorExtractorType::SIFT: {
+      SiftParameters sift_params =
+          FeatureDensityToSiftParameters(feature_density);
+      sift_params.keypoint_selection = keypoint_selection;
+      // The extractors created here are run one per image on the thread pools
+      // of the feature extractors, so each extractor must be single-threaded
+      // to avoid creating num_threads^2 threads.
+      sift_params.num_threads = 1;
+      descriptor_extractor.reset(new SiftDescriptorExtractor(sift_params));
       break;
+    }
     case DescriptorExtractorType::AKAZE:
       descriptor_extractor.reset(new AkazeDescriptorExtractor(
           FeatureDensityToAkazeParameters(feature_density)));
@@ -37,6 +37,8 @@
 
 #include <memory>
 
+#include "theia/image/keypoint_detector/select_keypoints.h"
+
 namespace theia {
 class DescriptorExtractor;
 
@@ -60,11 +62,22 @@ enum class FeatureDensity {
   DENSE = 2
 };
 
-// Factory method to create the keypoint detector and descriptor extractor.
+// Factory method to create the keypoint detector and descriptor extractor. The
+// extractor is single-threaded since extractors are run in parallel over
+// images.
 std::unique_ptr<DescriptorExtractor> CreateDescriptorExtractor(
     const DescriptorExtractorType& descriptor_type,
     const FeatureDensity& feature_density);
 
+// Same as above, but extractors that are able to select keypoints before
+// computing descriptors (currently only SIFT) will only compute descriptors for
+// the keypoints chosen with the selection options. Other extractors ignore the
+// selection options.
+std::unique_ptr<DescriptorExtractor> CreateDescriptorExtractor(
+    const DescriptorExtractorType& descriptor_type,
+    const FeatureDensity& feature_density,
+    const KeypointSelectionOptions& keypoint_selection);
+
 }  // namespace theia
 
 #endif  // THEIA_IMAGE_DESCRIPTOR_CREATE_DESCRIPTOR_EXTRACTOR_H_
@@ -0,0 +1,91 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor.h"
+
+namespace theia {
+
+DescriptorExtractorPool::DescriptorExtractorPool(
+    const DescriptorExtractorType& descriptor_type,
+    const FeatureDensity& feature_density)
+    : DescriptorExtractorPool(
+          descriptor_type, feature_density, KeypointSelectionOptions()) {}
+
+DescriptorExtractorPool::DescriptorExtractorPool(
+    const DescriptorExtractorType& descriptor_type,
+    const FeatureDensity& feature_density,
+    const KeypointSelectionOptions& keypoint_selection)
+    : descriptor_type_(descriptor_type),
+      feature_density_(feature_density),
+      keypoint_selection_(keypoint_selection) {}
+
+DescriptorExtractorPool::~DescriptorExtractorPool() {}
+
+DescriptorExtractorPool::Workspace*
+DescriptorExtractorPool::GetWorkspaceForThisThread() {
+  const std::thread::id thread_id = std::this_thread::get_id();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto& workspace = workspaces_.find(thread_id);
+    if (workspace != workspaces_.end()) {
+      return workspace->second.get();
+    }
+  }
+
+  // Create the extractor outside of the lock since initialization may be
+  // expensive. No other thread can create a workspace with this thread id.
+  std::unique_ptr<Workspace> workspace(new Workspace);
+  workspace->descriptor_extractor =
+      CreateDescriptorExtractor(
+          descriptor_type_, feature_density_, keypoint_selection_);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Workspace* workspace_ptr = workspace.get();
+  workspaces_[thread_id] = std::move(workspace);
+  return workspace_ptr;
+}
+
+int DescriptorExtractorPool::NumWorkspaces() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return workspaces_.size();
+}
+
+}  // namespace theia
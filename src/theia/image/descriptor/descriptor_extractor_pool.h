@@ -0,0 +1,99 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_IMAGE_DESCRIPTOR_DESCRIPTOR_EXTRACTOR_POOL_H_
+#define THEIA_IMAGE_DESCRIPTOR_DESCRIPTOR_EXTRACTOR_POOL_H_
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_map>
+
+#include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/image.h"
+#include "theia/image/keypoint_detector/select_keypoints.h"
+#include "theia/util/util.h"
+
+namespace theia {
+class DescriptorExtractor;
+
+// Descriptor extractors hold on to internal buffers (e.g., the VLFeat scale
+// space for SIFT) that can be reused for successive images of the same size, so
+// they should not be recreated for each image. This class lazily creates one
+// workspace for each thread that requests one, containing a descriptor
+// extractor and image buffers that the thread may reuse for every image it
+// processes. A workspace is only ever handed out to the thread it was created
+// for, so it may be used without any locking.
+class DescriptorExtractorPool {
+ public:
+  struct Workspace {
+    std::unique_ptr<DescriptorExtractor> descriptor_extractor;
+
+    // Buffers for loading an image and its mask. FloatImage::Read reuses the
+    // pixel buffer when the image has the same size as the previous one.
+    FloatImage image;
+    FloatImage mask;
+  };
+
+  DescriptorExtractorPool(const DescriptorExtractorType& descriptor_type,
+                          const FeatureDensity& feature_density);
+  // The extractors are created with the given keypoint selection options. See
+  // CreateDescriptorExtractor for details.
+  DescriptorExtractorPool(const DescriptorExtractorType& descriptor_type,
+                          const FeatureDensity& feature_density,
+                          const KeypointSelectionOptions& keypoint_selection);
+  ~DescriptorExtractorPool();
+
+  // Returns the workspace of the calling thread, creating it if necessary. The
+  // workspace is owned by the pool and remains valid for its lifetime. This
+  // method is thread-safe.
+  Workspace* GetWorkspaceForThisThread();
+
+  // The number of workspaces that have been created.
+  int NumWorkspaces();
+
+ private:
+  const DescriptorExtractorType descriptor_type_;
+  const FeatureDensity feature_density_;
+  const KeypointSelectionOptions keypoint_selection_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::thread::id, std::unique_ptr<Workspace> > workspaces_;
+
+  DISALLOW_COPY_AND_ASSIGN(DescriptorExtractorPool);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_IMAGE_DESCRIPTOR_DESCRIPTOR_EXTRACTOR_POOL_H_
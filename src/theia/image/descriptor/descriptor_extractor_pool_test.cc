@@ -0,0 +1,80 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <thread>  // NOLINT
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
+
+namespace theia {
+
+TEST(DescriptorExtractorPool, SameThreadReusesWorkspace) {
+  DescriptorExtractorPool pool(DescriptorExtractorType::SIFT,
+                               FeatureDensity::NORMAL);
+  DescriptorExtractorPool::Workspace* workspace =
+      pool.GetWorkspaceForThisThread();
+  EXPECT_NE(workspace->descriptor_extractor.get(), nullptr);
+  EXPECT_EQ(workspace, pool.GetWorkspaceForThisThread());
+  EXPECT_EQ(pool.NumWorkspaces(), 1);
+}
+
+TEST(DescriptorExtractorPool, OneWorkspacePerThread) {
+  static const int kNumThreads = 4;
+  DescriptorExtractorPool pool(DescriptorExtractorType::SIFT,
+                               FeatureDensity::NORMAL);
+
+  std::vector<DescriptorExtractorPool::Workspace*> workspaces(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&pool, &workspaces, i]() {
+      workspaces[i] = pool.GetWorkspaceForThisThread();
+      // Repeated calls from the same thread must return the same workspace.
+      EXPECT_EQ(workspaces[i], pool.GetWorkspaceForThisThread());
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(pool.NumWorkspaces(), kNumThreads);
+  for (int i = 0; i < kNumThreads; i++) {
+    for (int j = i + 1; j < kNumThreads; j++) {
+      EXPECT_NE(workspaces[i], workspaces[j]);
+    }
+  }
+}
+
+}  // namespace theia
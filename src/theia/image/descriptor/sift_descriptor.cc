@@ -35,15 +35,22 @@
 #include "theia/image/descriptor/sift_descriptor.h"
 
 #include <algorithm>
+#include <cmath>
 extern "C" {
 #include "vl/sift.h"
 }
+#include <functional>
+#include <future>  // NOLINT
+#include <iterator>
+#include <utility>
 #include <vector>
 
 #include "glog/logging.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
 #include "theia/image/image.h"
 #include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/image/keypoint_detector/select_keypoints.h"
+#include "theia/util/threadpool.h"
 #include <Eigen/Core>
 
 namespace theia {
@@ -67,6 +74,284 @@ double GetValidFirstOctave(const int first_octave,
   return valid_first_octave;
 }
 
+// Keypoints are only kept if they lie in [min_x, max_x) x [min_y, max_y) of the
+// image buffer that the filter processes. The positions of the kept keypoints
+// are then shifted by (offset_x, offset_y) so that they are expressed in the
+// coordinates of the full image.
+struct SiftImageRegion {
+  bool Contains(const double x, const double y) const {
+    return x >= min_x && x < max_x && y >= min_y && y < max_y;
+  }
+
+  double min_x, max_x, min_y, max_y;
+  double offset_x = 0.0;
+  double offset_y = 0.0;
+};
+
+// The orientations and descriptors computed for a single VLFeat keypoint.
+struct OrientedSiftFeatures {
+  int num_orientations = 0;
+  double orientations[4];
+  Eigen::VectorXf descriptors[4];
+};
+
+// Computes (up to 4) orientations of the keypoint and a descriptor for each
+// orientation. This only reads from the filter once its gradient has been
+// computed for the current octave, so it may be called concurrently for
+// keypoints of the same octave.
+void ComputeOrientedSiftFeatures(const SiftParameters& sift_params,
+                                 VlSiftFilt* sift_filter,
+                                 const VlSiftKeypoint& vl_keypoint,
+                                 OrientedSiftFeatures* features) {
+  features->num_orientations = vl_sift_calc_keypoint_orientations(
+      sift_filter, features->orientations, &vl_keypoint);
+  // If upright sift is enabled, only use the first keypoint at a given pixel
+  // location.
+  if (sift_params.upright_sift && features->num_orientations > 1) {
+    features->num_orientations = 1;
+  }
+
+  for (int i = 0; i < features->num_orientations; ++i) {
+    Eigen::VectorXf& descriptor = features->descriptors[i];
+    descriptor.setZero(kNumSiftDimensions);
+    vl_sift_calc_keypoint_descriptor(sift_filter,
+                                     descriptor.data(),
+                                     &vl_keypoint,
+                                     features->orientations[i]);
+    if (sift_params.root_sift) {
+      SiftDescriptorExtractor::ConvertToRootSift(&descriptor);
+      CHECK(!descriptor.hasNaN());
+    }
+  }
+}
+
+// Returns the magnitude of the DoG response at a keypoint of the current
+// octave, which is used as the strength of the keypoint. The DoG of an octave is
+// only computed by vl_sift_detect, so this must be called right after detecting
+// the keypoints of the octave.
+float SiftKeypointResponse(const VlSiftFilt* sift_filter,
+                           const VlSiftKeypoint& vl_keypoint) {
+  const int width = vl_sift_get_octave_width(sift_filter);
+  const int height = vl_sift_get_octave_height(sift_filter);
+  const vl_sift_pix* dog_level =
+      sift_filter->dog + (vl_keypoint.is - sift_filter->s_min) * width * height;
+  return std::abs(dog_level[vl_keypoint.iy * width + vl_keypoint.ix]);
+}
+
+// Computes the orientations and descriptors of keypoints that were detected in
+// the current octave of the filter, where octave_strengths holds the strength of
+// each keypoint. Features are appended to the output in the order of the input
+// keypoints regardless of whether a thread pool is used to compute them in
+// parallel.
+void ExtractOctaveFeatures(
+    const SiftParameters& sift_params,
+    const SiftImageRegion& region,
+    const std::vector<const VlSiftKeypoint*>& octave_keypoints,
+    const std::vector<float>& octave_strengths,
+    VlSiftFilt* sift_filter,
+    ThreadPool* thread_pool,
+    std::vector<OrientedSiftFeatures>* octave_features,
+    std::vector<Keypoint>* keypoints,
+    std::vector<Eigen::VectorXf>* descriptors) {
+  // Parallelism is not worth the overhead for octaves with very few keypoints.
+  static const int kMinNumKeypointsPerTask = 32;
+
+  const int num_octave_keypoints = octave_keypoints.size();
+  octave_features->resize(num_octave_keypoints);
+
+  // VLFeat lazily computes the gradient of the octave the first time an
+  // orientation is requested for a keypoint that is not out of bounds, and
+  // caches it in the filter. Keypoints are processed serially until that has
+  // happened so that the parallel calls below only read from the filter.
+  int num_processed = 0;
+  while (num_processed < num_octave_keypoints) {
+    ComputeOrientedSiftFeatures(sift_params,
+                                sift_filter,
+                                *octave_keypoints[num_processed],
+                                &(*octave_features)[num_processed]);
+    ++num_processed;
+    if ((*octave_features)[num_processed - 1].num_orientations > 0) {
+      break;
+    }
+  }
+
+  const int num_remaining = num_octave_keypoints - num_processed;
+  if (thread_pool != nullptr && num_remaining >= 2 * kMinNumKeypointsPerTask) {
+    const int num_tasks = std::min(sift_params.num_threads,
+                                   num_remaining / kMinNumKeypointsPerTask);
+    const int task_size = (num_remaining + num_tasks - 1) / num_tasks;
+    std::vector<std::future<void> > tasks;
+    for (int start = num_processed; start < num_octave_keypoints;
+         start += task_size) {
+      const int end = std::min(start + task_size, num_octave_keypoints);
+      tasks.emplace_back(thread_pool->Add([&, start, end]() {
+        for (int i = start; i < end; ++i) {
+          ComputeOrientedSiftFeatures(sift_params,
+                                      sift_filter,
+                                      *octave_keypoints[i],
+                                      &(*octave_features)[i]);
+        }
+      }));
+    }
+    for (std::future<void>& task : tasks) {
+      task.get();
+    }
+  } else {
+    for (int i = num_processed; i < num_octave_keypoints; ++i) {
+      ComputeOrientedSiftFeatures(sift_params,
+                                  sift_filter,
+                                  *octave_keypoints[i],
+                                  &(*octave_features)[i]);
+    }
+  }
+
+  // Gather the features in order.
+  for (int i = 0; i < num_octave_keypoints; ++i) {
+    const VlSiftKeypoint& vl_keypoint = *octave_keypoints[i];
+    OrientedSiftFeatures& features = (*octave_features)[i];
+    for (int j = 0; j < features.num_orientations; ++j) {
+      Keypoint keypoint(vl_keypoint.x + region.offset_x,
+                        vl_keypoint.y + region.offset_y,
+                        Keypoint::SIFT);
+      keypoint.set_scale(vl_keypoint.sigma);
+      keypoint.set_orientation(features.orientations[j]);
+      keypoint.set_strength(octave_strengths[i]);
+      keypoints->push_back(keypoint);
+      descriptors->emplace_back(std::move(features.descriptors[j]));
+    }
+  }
+}
+
+// Detects SIFT keypoints in the grayscale image buffer with the given filter
+// and computes their orientations and descriptors. Features are appended to
+// the output in the order that VLFeat detects them.
+void DetectAndExtractWithFilter(const SiftParameters& sift_params,
+                                const float* grayscale_image,
+                                const SiftImageRegion& region,
+                                VlSiftFilt* sift_filter,
+                                ThreadPool* thread_pool,
+                                std::vector<Keypoint>* keypoints,
+                                std::vector<Eigen::VectorXf>* descriptors) {
+  std::vector<const VlSiftKeypoint*> octave_keypoints;
+  std::vector<float> octave_strengths;
+  std::vector<OrientedSiftFeatures> octave_features;
+
+  // Calculate the first octave to process.
+  int vl_status = vl_sift_process_first_octave(sift_filter, grayscale_image);
+
+  // Process octaves until you can't anymore.
+  while (vl_status != VL_ERR_EOF) {
+    // Detect the keypoints.
+    vl_sift_detect(sift_filter);
+
+    // Get the keypoints that lie within the region.
+    const VlSiftKeypoint* vl_keypoints = vl_sift_get_keypoints(sift_filter);
+    const int num_keypoints = vl_sift_get_nkeypoints(sift_filter);
+    octave_keypoints.clear();
+    octave_strengths.clear();
+    for (int i = 0; i < num_keypoints; ++i) {
+      if (region.Contains(vl_keypoints[i].x, vl_keypoints[i].y)) {
+        octave_keypoints.emplace_back(&vl_keypoints[i]);
+        octave_strengths.emplace_back(
+            SiftKeypointResponse(sift_filter, vl_keypoints[i]));
+      }
+    }
+
+    ExtractOctaveFeatures(sift_params,
+                          region,
+                          octave_keypoints,
+                          octave_strengths,
+                          sift_filter,
+                          thread_pool,
+                          &octave_features,
+                          keypoints,
+                          descriptors);
+
+    // Attempt to process the next octave.
+    vl_status = vl_sift_process_next_octave(sift_filter);
+  }
+}
+
+// Only detects the SIFT keypoints within the region, without computing any
+// orientations or descriptors. The candidate keypoints hold the position (in
+// full image coordinates), scale, and strength of each detected keypoint so
+// that keypoints may be selected before their descriptors are computed.
+void DetectWithFilter(const float* grayscale_image,
+                      const SiftImageRegion& region,
+                      VlSiftFilt* sift_filter,
+                      std::vector<VlSiftKeypoint>* vl_keypoints,
+                      std::vector<Keypoint>* candidate_keypoints) {
+  int vl_status = vl_sift_process_first_octave(sift_filter, grayscale_image);
+  while (vl_status != VL_ERR_EOF) {
+    vl_sift_detect(sift_filter);
+    const VlSiftKeypoint* octave_keypoints =
+        vl_sift_get_keypoints(sift_filter);
+    const int num_keypoints = vl_sift_get_nkeypoints(sift_filter);
+    for (int i = 0; i < num_keypoints; ++i) {
+      const VlSiftKeypoint& vl_keypoint = octave_keypoints[i];
+      if (!region.Contains(vl_keypoint.x, vl_keypoint.y)) {
+        continue;
+      }
+      vl_keypoints->emplace_back(vl_keypoint);
+
+      Keypoint keypoint(vl_keypoint.x + region.offset_x,
+                        vl_keypoint.y + region.offset_y,
+                        Keypoint::SIFT);
+      keypoint.set_scale(vl_keypoint.sigma);
+      keypoint.set_strength(SiftKeypointResponse(sift_filter, vl_keypoint));
+      candidate_keypoints->emplace_back(keypoint);
+    }
+    vl_status = vl_sift_process_next_octave(sift_filter);
+  }
+}
+
+// Processes the octaves of the image again and computes the orientations and
+// descriptors of the given keypoints, which must be ordered by octave (as they
+// are when detected). Octaves after the last keypoint are not processed. The
+// DoG is not computed again, so the strengths of the keypoints that were
+// computed during detection must be given.
+void ExtractWithFilter(const SiftParameters& sift_params,
+                       const float* grayscale_image,
+                       const SiftImageRegion& region,
+                       const std::vector<VlSiftKeypoint>& vl_keypoints,
+                       const std::vector<float>& strengths,
+                       VlSiftFilt* sift_filter,
+                       ThreadPool* thread_pool,
+                       std::vector<Keypoint>* keypoints,
+                       std::vector<Eigen::VectorXf>* descriptors) {
+  if (vl_keypoints.empty()) {
+    return;
+  }
+
+  CHECK_EQ(vl_keypoints.size(), strengths.size());
+  std::vector<const VlSiftKeypoint*> octave_keypoints;
+  std::vector<float> octave_strengths;
+  std::vector<OrientedSiftFeatures> octave_features;
+  int next_keypoint = 0;
+  int vl_status = vl_sift_process_first_octave(sift_filter, grayscale_image);
+  while (vl_status != VL_ERR_EOF && next_keypoint < vl_keypoints.size()) {
+    octave_keypoints.clear();
+    octave_strengths.clear();
+    while (next_keypoint < vl_keypoints.size() &&
+           vl_keypoints[next_keypoint].o == sift_filter->o_cur) {
+      octave_keypoints.emplace_back(&vl_keypoints[next_keypoint]);
+      octave_strengths.emplace_back(strengths[next_keypoint]);
+      ++next_keypoint;
+    }
+
+    ExtractOctaveFeatures(sift_params,
+                          region,
+                          octave_keypoints,
+                          octave_strengths,
+                          sift_filter,
+                          thread_pool,
+                          &octave_features,
+                          keypoints,
+                          descriptors);
+    vl_status = vl_sift_process_next_octave(sift_filter);
+  }
+}
+
 }  // namespace
 
 SiftDescriptorExtractor::SiftDescriptorExtractor(
@@ -217,6 +502,27 @@ bool SiftDescriptorExtractor::DetectAndExtractDescriptors(
     const FloatImage& image,
     std::vector<Keypoint>* keypoints,
     std::vector<Eigen::VectorXf>* descriptors) {
+  if (sift_params_.num_threads > 1 && !thread_pool_) {
+    thread_pool_.reset(new ThreadPool(sift_params_.num_threads));
+  }
+
+  // VLFeat only reads from the input image, so a copy is only needed to
+  // convert the image to grayscale.
+  FloatImage grayscale_image;
+  const float* grayscale_data = image.Data();
+  if (image.Channels() != 1) {
+    grayscale_image = image.AsGrayscaleImage();
+    grayscale_data = grayscale_image.Data();
+  }
+
+  if (sift_params_.tile_size > 0 &&
+      (image.Cols() > sift_params_.tile_size ||
+       image.Rows() > sift_params_.tile_size)) {
+    DetectAndExtractDescriptorsInTiles(
+        grayscale_data, image.Cols(), image.Rows(), keypoints, descriptors);
+    return true;
+  }
+
   // If the filter has been set, but is not usable for the input image (i.e. the
   // width and height are different) then we must make a new filter. Adding this
   // statement will save the function from regenerating the filter for
@@ -234,61 +540,227 @@ bool SiftDescriptorExtractor::DetectAndExtractDescriptors(
     vl_sift_set_peak_thresh(sift_filter_.get(), sift_params_.peak_threshold);
   }
 
-  // The VLFeat functions take in a non-const image pointer so that it can
-  // calculate gaussian pyramids. Obviously, we do not want to break our const
-  // input, so the best solution (for now) is to copy the image.
-  FloatImage mutable_image = image.AsGrayscaleImage();
+  SiftImageRegion region;
+  region.min_x = 0;
+  region.max_x = image.Cols();
+  region.min_y = 0;
+  region.max_y = image.Rows();
+  if (sift_params_.keypoint_selection.max_num_keypoints <= 0) {
+    DetectAndExtractWithFilter(sift_params_,
+                               grayscale_data,
+                               region,
+                               sift_filter_.get(),
+                               thread_pool_.get(),
+                               keypoints,
+                               descriptors);
+    return true;
+  }
 
-  // Calculate the first octave to process.
-  int vl_status =
-      vl_sift_process_first_octave(sift_filter_.get(), mutable_image.Data());
-  
-  // Process octaves until you can't anymore.
-  while (vl_status != VL_ERR_EOF) {
-    // Detect the keypoints.
-    vl_sift_detect(sift_filter_.get());
+  // Detect all keypoints first so that descriptors are only computed for the
+  // selected keypoints.
+  std::vector<VlSiftKeypoint> vl_keypoints;
+  std::vector<Keypoint> candidate_keypoints;
+  DetectWithFilter(grayscale_data,
+                   region,
+                   sift_filter_.get(),
+                   &vl_keypoints,
+                   &candidate_keypoints);
+
+  std::vector<int> selected_indices;
+  SelectKeypoints(sift_params_.keypoint_selection,
+                  image.Cols(),
+                  image.Rows(),
+                  candidate_keypoints,
+                  &selected_indices);
+  std::vector<VlSiftKeypoint> selected_keypoints;
+  std::vector<float> selected_strengths;
+  selected_keypoints.reserve(selected_indices.size());
+  selected_strengths.reserve(selected_indices.size());
+  for (const int selected_index : selected_indices) {
+    selected_keypoints.emplace_back(vl_keypoints[selected_index]);
+    selected_strengths.emplace_back(
+        candidate_keypoints[selected_index].strength());
+  }
 
-    // Get the keypoints.
-    const VlSiftKeypoint* vl_keypoints =
-        vl_sift_get_keypoints(sift_filter_.get());
-    const int num_keypoints = vl_sift_get_nkeypoints(sift_filter_.get());
+  ExtractWithFilter(sift_params_,
+                    grayscale_data,
+                    region,
+                    selected_keypoints,
+                    selected_strengths,
+                    sift_filter_.get(),
+                    thread_pool_.get(),
+                    keypoints,
+                    descriptors);
+  return true;
+}
 
-    for (int i = 0; i < num_keypoints; ++i) {
-      // Calculate (up to 4) orientations of the keypoint.
-      double angles[4];
-      int num_angles = vl_sift_calc_keypoint_orientations(
-          sift_filter_.get(), angles, &vl_keypoints[i]);
-      // If upright sift is enabled, only use the first keypoint at a given
-      // pixel location.
-      if (sift_params_.upright_sift && num_angles > 1) {
-        num_angles = 1;
-      }
+void SiftDescriptorExtractor::DetectAndExtractDescriptorsInTiles(
+    const float* grayscale_image,
+    const int width,
+    const int height,
+    std::vector<Keypoint>* keypoints,
+    std::vector<Eigen::VectorXf>* descriptors) {
+  const int tile_size = sift_params_.tile_size;
+  const int overlap = std::max(sift_params_.tile_overlap, 0);
+  const int num_tiles_x = (width + tile_size - 1) / tile_size;
+  const int num_tiles_y = (height + tile_size - 1) / tile_size;
+  const int num_tiles = num_tiles_x * num_tiles_y;
+
+  // All tiles use the first octave of the full image so that keypoints are
+  // detected at the same scales as they would be without tiling.
+  const int first_octave =
+      GetValidFirstOctave(sift_params_.first_octave, height, width);
+
+  while (tile_filters_.size() < num_tiles) {
+    tile_filters_.emplace_back(nullptr, vl_sift_delete);
+  }
+  tile_images_.resize(num_tiles);
+
+  // Copy each padded tile into its own buffer and set up its filter.
+  std::vector<SiftImageRegion> tile_regions(num_tiles);
+  for (int tile = 0; tile < num_tiles; ++tile) {
+    const int tile_x = tile % num_tiles_x;
+    const int tile_y = tile / num_tiles_x;
+
+    // The tile itself, and the tile padded by the overlap.
+    const int min_x = tile_x * tile_size;
+    const int max_x = std::min(min_x + tile_size, width);
+    const int min_y = tile_y * tile_size;
+    const int max_y = std::min(min_y + tile_size, height);
+    const int padded_min_x = std::max(min_x - overlap, 0);
+    const int padded_max_x = std::min(max_x + overlap, width);
+    const int padded_min_y = std::max(min_y - overlap, 0);
+    const int padded_max_y = std::min(max_y + overlap, height);
+    const int padded_width = padded_max_x - padded_min_x;
+    const int padded_height = padded_max_y - padded_min_y;
+
+    std::vector<float>& tile_image = tile_images_[tile];
+    tile_image.resize(padded_width * padded_height);
+    for (int y = padded_min_y; y < padded_max_y; ++y) {
+      std::copy(grayscale_image + y * width + padded_min_x,
+                grayscale_image + y * width + padded_max_x,
+                tile_image.data() + (y - padded_min_y) * padded_width);
+    }
 
-      Eigen::VectorXf descriptor(kNumSiftDimensions);
-      for (int j = 0; j < num_angles; ++j) {
-        descriptor.setZero();
-        vl_sift_calc_keypoint_descriptor(
-            sift_filter_.get(), descriptor.data(), &vl_keypoints[i], angles[j]);
-        descriptors->push_back(descriptor);
-
-        Keypoint keypoint(vl_keypoints[i].x, vl_keypoints[i].y, Keypoint::SIFT);
-        keypoint.set_scale(vl_keypoints[i].sigma);
-        keypoint.set_orientation(angles[j]);
-        keypoints->push_back(keypoint);
-      }
+    SiftFilterPtr& tile_filter = tile_filters_[tile];
+    if (!tile_filter || tile_filter->width != padded_width ||
+        tile_filter->height != padded_height) {
+      tile_filter.reset(vl_sift_new(padded_width,
+                                    padded_height,
+                                    sift_params_.num_octaves,
+                                    sift_params_.num_levels,
+                                    first_octave));
+      vl_sift_set_edge_thresh(tile_filter.get(), sift_params_.edge_threshold);
+      vl_sift_set_peak_thresh(tile_filter.get(), sift_params_.peak_threshold);
     }
-    // Attempt to process the next octave.
-    vl_status = vl_sift_process_next_octave(sift_filter_.get());
+
+    SiftImageRegion& region = tile_regions[tile];
+    region.min_x = min_x - padded_min_x;
+    region.max_x = max_x - padded_min_x;
+    region.min_y = min_y - padded_min_y;
+    region.max_y = max_y - padded_min_y;
+    region.offset_x = padded_min_x;
+    region.offset_y = padded_min_y;
   }
 
-  if (sift_params_.root_sift) {
-    for (auto& descriptor : *descriptors) {
-      ConvertToRootSift(&descriptor);
-      CHECK(!descriptor.hasNaN());
+  // Tiles are processed in parallel, but the features within each tile are
+  // computed serially.
+  auto for_each_tile = [&](const std::function<void(int)>& process_tile) {
+    if (thread_pool_) {
+      std::vector<std::future<void> > tasks;
+      tasks.reserve(num_tiles);
+      for (int i = 0; i < num_tiles; ++i) {
+        tasks.emplace_back(thread_pool_->Add(process_tile, i));
+      }
+      for (std::future<void>& task : tasks) {
+        task.get();
+      }
+    } else {
+      for (int i = 0; i < num_tiles; ++i) {
+        process_tile(i);
+      }
     }
+  };
+
+  std::vector<std::vector<Keypoint> > tile_keypoints(num_tiles);
+  std::vector<std::vector<Eigen::VectorXf> > tile_descriptors(num_tiles);
+  if (sift_params_.keypoint_selection.max_num_keypoints <= 0) {
+    for_each_tile([&](const int tile) {
+      DetectAndExtractWithFilter(sift_params_,
+                                 tile_images_[tile].data(),
+                                 tile_regions[tile],
+                                 tile_filters_[tile].get(),
+                                 nullptr,
+                                 &tile_keypoints[tile],
+                                 &tile_descriptors[tile]);
+    });
+  } else {
+    // Detect the keypoints of all tiles and select among all of them so that
+    // the selection is the same as for the full image.
+    std::vector<std::vector<VlSiftKeypoint> > tile_vl_keypoints(num_tiles);
+    std::vector<std::vector<Keypoint> > tile_candidates(num_tiles);
+    for_each_tile([&](const int tile) {
+      DetectWithFilter(tile_images_[tile].data(),
+                       tile_regions[tile],
+                       tile_filters_[tile].get(),
+                       &tile_vl_keypoints[tile],
+                       &tile_candidates[tile]);
+    });
+
+    std::vector<Keypoint> candidate_keypoints;
+    for (int i = 0; i < num_tiles; ++i) {
+      candidate_keypoints.insert(candidate_keypoints.end(),
+                                 tile_candidates[i].begin(),
+                                 tile_candidates[i].end());
+    }
+    std::vector<int> selected_indices;
+    SelectKeypoints(sift_params_.keypoint_selection,
+                    width,
+                    height,
+                    candidate_keypoints,
+                    &selected_indices);
+
+    // The selected indices are sorted, so they may be assigned back to their
+    // tiles in a single pass.
+    std::vector<std::vector<VlSiftKeypoint> > tile_selected_keypoints(
+        num_tiles);
+    std::vector<std::vector<float> > tile_selected_strengths(num_tiles);
+    int tile = 0;
+    int tile_start_index = 0;
+    for (const int selected_index : selected_indices) {
+      while (selected_index >=
+             tile_start_index + tile_vl_keypoints[tile].size()) {
+        tile_start_index += tile_vl_keypoints[tile].size();
+        ++tile;
+      }
+      tile_selected_keypoints[tile].emplace_back(
+          tile_vl_keypoints[tile][selected_index - tile_start_index]);
+      tile_selected_strengths[tile].emplace_back(
+          candidate_keypoints[selected_index].strength());
+    }
+
+    for_each_tile([&](const int tile) {
+      ExtractWithFilter(sift_params_,
+                        tile_images_[tile].data(),
+                        tile_regions[tile],
+                        tile_selected_keypoints[tile],
+                        tile_selected_strengths[tile],
+                        tile_filters_[tile].get(),
+                        nullptr,
+                        &tile_keypoints[tile],
+                        &tile_descriptors[tile]);
+    });
   }
 
-  return true;
+  // Gather the features in tile order so that the output is deterministic.
+  for (int i = 0; i < num_tiles; ++i) {
+    keypoints->insert(keypoints->end(),
+                      tile_keypoints[i].begin(),
+                      tile_keypoints[i].end());
+    std::move(tile_descriptors[i].begin(),
+              tile_descriptors[i].end(),
+              std::back_inserter(*descriptors));
+  }
 }
 
 // Converts to a RootSIFT descriptor which is proven to provide better matches
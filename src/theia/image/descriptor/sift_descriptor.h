@@ -50,6 +50,7 @@ namespace theia {
 
 class FloatImage;
 class Keypoint;
+class ThreadPool;
 
 class SiftDescriptorExtractor : public DescriptorExtractor {
  public:
@@ -81,8 +82,29 @@ class SiftDescriptorExtractor : public DescriptorExtractor {
   static void ConvertToRootSift(Eigen::VectorXf* descriptor);
 
  private:
+  typedef std::unique_ptr<VlSiftFilt, void (*)(VlSiftFilt*)> SiftFilterPtr;
+
+  // Detects and extracts features by splitting the image into overlapping
+  // tiles that are each processed with a separate filter.
+  void DetectAndExtractDescriptorsInTiles(
+      const float* grayscale_image,
+      const int width,
+      const int height,
+      std::vector<Keypoint>* keypoints,
+      std::vector<Eigen::VectorXf>* descriptors);
+
   const SiftParameters sift_params_;
-  std::unique_ptr<VlSiftFilt, void (*)(VlSiftFilt*)> sift_filter_;
+  SiftFilterPtr sift_filter_;
+
+  // Filters and grayscale image buffers for each tile when the image is
+  // processed in tiles. These are kept so that they may be reused for
+  // successive images of the same size.
+  std::vector<SiftFilterPtr> tile_filters_;
+  std::vector<std::vector<float> > tile_images_;
+
+  // Used to compute features in parallel when sift_params_.num_threads > 1.
+  std::unique_ptr<ThreadPool> thread_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(SiftDescriptorExtractor);
 };
 
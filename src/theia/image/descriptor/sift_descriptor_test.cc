@@ -33,6 +33,8 @@
 // Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
 
 #include <gflags/gflags.h>
+#include <algorithm>
+#include <functional>
 #include <glog/logging.h>
 #include <string>
 #include "gtest/gtest.h"
@@ -103,4 +105,160 @@ TEST(SiftDescriptor, DifferentImageSizes) {
                                                          &descriptors));
 }
 
+TEST(SiftDescriptor, MultithreadedMatchesSingleThreaded) {
+  FloatImage input_img(img_filename);
+
+  SiftDescriptorExtractor sift_extractor;
+  std::vector<Keypoint> keypoints;
+  std::vector<Eigen::VectorXf> descriptors;
+  EXPECT_TRUE(sift_extractor.DetectAndExtractDescriptors(input_img,
+                                                         &keypoints,
+                                                         &descriptors));
+
+  SiftParameters sift_params;
+  sift_params.num_threads = 4;
+  SiftDescriptorExtractor multithreaded_sift_extractor(sift_params);
+  std::vector<Keypoint> multithreaded_keypoints;
+  std::vector<Eigen::VectorXf> multithreaded_descriptors;
+  EXPECT_TRUE(multithreaded_sift_extractor.DetectAndExtractDescriptors(
+      input_img, &multithreaded_keypoints, &multithreaded_descriptors));
+
+  // The features must be identical and in the same order.
+  ASSERT_EQ(keypoints.size(), multithreaded_keypoints.size());
+  ASSERT_EQ(descriptors.size(), multithreaded_descriptors.size());
+  for (int i = 0; i < keypoints.size(); i++) {
+    EXPECT_EQ(keypoints[i].x(), multithreaded_keypoints[i].x());
+    EXPECT_EQ(keypoints[i].y(), multithreaded_keypoints[i].y());
+    EXPECT_EQ(keypoints[i].scale(), multithreaded_keypoints[i].scale());
+    EXPECT_EQ(keypoints[i].orientation(),
+              multithreaded_keypoints[i].orientation());
+    EXPECT_EQ(descriptors[i], multithreaded_descriptors[i]);
+  }
+}
+
+TEST(SiftDescriptor, TiledExtractionIsDeterministic) {
+  FloatImage input_img(img_filename);
+
+  SiftParameters sift_params;
+  sift_params.tile_size = 256;
+  SiftDescriptorExtractor sift_extractor(sift_params);
+  std::vector<Keypoint> keypoints;
+  std::vector<Eigen::VectorXf> descriptors;
+  EXPECT_TRUE(sift_extractor.DetectAndExtractDescriptors(input_img,
+                                                         &keypoints,
+                                                         &descriptors));
+  EXPECT_GT(keypoints.size(), 0);
+  EXPECT_EQ(keypoints.size(), descriptors.size());
+  for (const Keypoint& keypoint : keypoints) {
+    EXPECT_GE(keypoint.x(), 0);
+    EXPECT_LT(keypoint.x(), input_img.Cols());
+    EXPECT_GE(keypoint.y(), 0);
+    EXPECT_LT(keypoint.y(), input_img.Rows());
+  }
+
+  sift_params.num_threads = 4;
+  SiftDescriptorExtractor multithreaded_sift_extractor(sift_params);
+  std::vector<Keypoint> multithreaded_keypoints;
+  std::vector<Eigen::VectorXf> multithreaded_descriptors;
+  EXPECT_TRUE(multithreaded_sift_extractor.DetectAndExtractDescriptors(
+      input_img, &multithreaded_keypoints, &multithreaded_descriptors));
+
+  ASSERT_EQ(keypoints.size(), multithreaded_keypoints.size());
+  for (int i = 0; i < keypoints.size(); i++) {
+    EXPECT_EQ(keypoints[i].x(), multithreaded_keypoints[i].x());
+    EXPECT_EQ(keypoints[i].y(), multithreaded_keypoints[i].y());
+    EXPECT_EQ(descriptors[i], multithreaded_descriptors[i]);
+  }
+}
+
+TEST(SiftDescriptor, KeypointSelectionBeforeExtraction) {
+  FloatImage input_img(img_filename);
+
+  SiftDescriptorExtractor sift_extractor;
+  std::vector<Keypoint> keypoints;
+  std::vector<Eigen::VectorXf> descriptors;
+  EXPECT_TRUE(sift_extractor.DetectAndExtractDescriptors(input_img,
+                                                         &keypoints,
+                                                         &descriptors));
+  ASSERT_GT(keypoints.size(), 100);
+
+  SiftParameters sift_params;
+  sift_params.keypoint_selection.selection_type =
+      KeypointSelectionType::STRENGTH;
+  sift_params.keypoint_selection.max_num_keypoints = 100;
+  SiftDescriptorExtractor selecting_sift_extractor(sift_params);
+  std::vector<Keypoint> selected_keypoints;
+  std::vector<Eigen::VectorXf> selected_descriptors;
+  EXPECT_TRUE(selecting_sift_extractor.DetectAndExtractDescriptors(
+      input_img, &selected_keypoints, &selected_descriptors));
+  EXPECT_EQ(selected_keypoints.size(), 100);
+  EXPECT_EQ(selected_descriptors.size(), 100);
+
+  // The selected keypoints are the strongest keypoints, with the same
+  // descriptors as when all keypoints are extracted.
+  std::vector<double> strengths;
+  for (const Keypoint& keypoint : keypoints) {
+    ASSERT_TRUE(keypoint.has_strength());
+    strengths.emplace_back(keypoint.strength());
+  }
+  std::sort(strengths.begin(), strengths.end(), std::greater<double>());
+  for (int i = 0; i < selected_keypoints.size(); i++) {
+    EXPECT_GE(selected_keypoints[i].strength(), strengths[99]);
+    const auto& it = std::find_if(
+        keypoints.begin(), keypoints.end(), [&](const Keypoint& keypoint) {
+          return keypoint.x() == selected_keypoints[i].x() &&
+                 keypoint.y() == selected_keypoints[i].y() &&
+                 keypoint.scale() == selected_keypoints[i].scale();
+        });
+    ASSERT_TRUE(it != keypoints.end());
+    EXPECT_EQ(descriptors[it - keypoints.begin()], selected_descriptors[i]);
+  }
+}
+
+TEST(SiftDescriptor, SelectionPathMatchesOnePassStrengths) {
+  FloatImage input_img(img_filename);
+
+  SiftDescriptorExtractor sift_extractor;
+  std::vector<Keypoint> keypoints;
+  std::vector<Eigen::VectorXf> descriptors;
+  EXPECT_TRUE(sift_extractor.DetectAndExtractDescriptors(input_img,
+                                                         &keypoints,
+                                                         &descriptors));
+  ASSERT_GT(keypoints.size(), 0);
+
+  // Allowing more keypoints than are detected still detects all keypoints
+  // before extracting them, but every keypoint is selected. The features and
+  // their strengths must then be the same as when detecting and extracting in
+  // a single pass. This is checked with and without tiling.
+  for (const int tile_size : {0, 256}) {
+    SiftParameters one_pass_params;
+    one_pass_params.tile_size = tile_size;
+    SiftDescriptorExtractor one_pass_sift_extractor(one_pass_params);
+    std::vector<Keypoint> one_pass_keypoints;
+    std::vector<Eigen::VectorXf> one_pass_descriptors;
+    EXPECT_TRUE(one_pass_sift_extractor.DetectAndExtractDescriptors(
+        input_img, &one_pass_keypoints, &one_pass_descriptors));
+
+    SiftParameters sift_params = one_pass_params;
+    sift_params.keypoint_selection.max_num_keypoints =
+        2 * one_pass_keypoints.size();
+    SiftDescriptorExtractor selecting_sift_extractor(sift_params);
+    std::vector<Keypoint> selected_keypoints;
+    std::vector<Eigen::VectorXf> selected_descriptors;
+    EXPECT_TRUE(selecting_sift_extractor.DetectAndExtractDescriptors(
+        input_img, &selected_keypoints, &selected_descriptors));
+
+    ASSERT_EQ(one_pass_keypoints.size(), selected_keypoints.size());
+    for (int i = 0; i < one_pass_keypoints.size(); i++) {
+      EXPECT_EQ(one_pass_keypoints[i].x(), selected_keypoints[i].x());
+      EXPECT_EQ(one_pass_keypoints[i].y(), selected_keypoints[i].y());
+      EXPECT_EQ(one_pass_keypoints[i].scale(), selected_keypoints[i].scale());
+      ASSERT_TRUE(selected_keypoints[i].has_strength());
+      EXPECT_EQ(one_pass_keypoints[i].strength(),
+                selected_keypoints[i].strength());
+      EXPECT_EQ(one_pass_descriptors[i], selected_descriptors[i]);
+    }
+  }
+}
+
 }  // namespace theia
@@ -0,0 +1,281 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/image/keypoint_detector/select_keypoints.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "theia/image/keypoint_detector/keypoint.h"
+
+namespace theia {
+namespace {
+
+double KeypointStrength(const Keypoint& keypoint) {
+  return keypoint.has_strength() ? keypoint.strength() : 0.0;
+}
+
+// Returns the keypoint indices ordered from the strongest to the weakest
+// keypoint. Keypoints with equal strength keep their original order.
+std::vector<int> OrderByStrength(const std::vector<Keypoint>& keypoints) {
+  std::vector<int> order(keypoints.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](const int i, const int j) {
+    return KeypointStrength(keypoints[i]) > KeypointStrength(keypoints[j]);
+  });
+  return order;
+}
+
+// Maps pixel positions to the cells of a regular grid over the image.
+// Positions outside of the image are assigned to the nearest border cell.
+class ImageGrid {
+ public:
+  ImageGrid(const int image_width,
+            const int image_height,
+            const int num_cells_x,
+            const int num_cells_y)
+      : num_cells_x_(num_cells_x),
+        num_cells_y_(num_cells_y),
+        cell_width_(std::max(image_width, 1) / static_cast<double>(num_cells_x)),
+        cell_height_(std::max(image_height, 1) /
+                     static_cast<double>(num_cells_y)) {}
+
+  int CellX(const double x) const {
+    return std::min(std::max(static_cast<int>(x / cell_width_), 0),
+                    num_cells_x_ - 1);
+  }
+
+  int CellY(const double y) const {
+    return std::min(std::max(static_cast<int>(y / cell_height_), 0),
+                    num_cells_y_ - 1);
+  }
+
+  int Cell(const Keypoint& keypoint) const {
+    return CellY(keypoint.y()) * num_cells_x_ + CellX(keypoint.x());
+  }
+
+  int num_cells_x() const { return num_cells_x_; }
+  int num_cells_y() const { return num_cells_y_; }
+  int num_cells() const { return num_cells_x_ * num_cells_y_; }
+  double min_cell_size() const { return std::min(cell_width_, cell_height_); }
+
+ private:
+  const int num_cells_x_, num_cells_y_;
+  const double cell_width_, cell_height_;
+};
+
+// Selects the strongest remaining keypoint of each grid cell in turn. This is
+// implemented by ranking each keypoint within its cell and choosing the
+// keypoints with the lowest rank, breaking ties by strength.
+void SelectKeypointsFromGrid(const KeypointSelectionOptions& options,
+                             const int image_width,
+                             const int image_height,
+                             const std::vector<Keypoint>& keypoints,
+                             const std::vector<int>& strength_order,
+                             std::vector<int>* selected_indices) {
+  CHECK_GT(options.num_grid_cells, 0);
+  const ImageGrid grid(image_width,
+                       image_height,
+                       options.num_grid_cells,
+                       options.num_grid_cells);
+
+  std::vector<int> num_keypoints_in_cell(grid.num_cells(), 0);
+  // Pairs of (rank within cell, position in the strength order).
+  std::vector<std::pair<int, int> > ranks(strength_order.size());
+  for (int i = 0; i < strength_order.size(); i++) {
+    const int cell = grid.Cell(keypoints[strength_order[i]]);
+    ranks[i] = std::make_pair(num_keypoints_in_cell[cell]++, i);
+  }
+
+  const int num_selected = options.max_num_keypoints;
+  std::partial_sort(ranks.begin(), ranks.begin() + num_selected, ranks.end());
+  for (int i = 0; i < num_selected; i++) {
+    selected_indices->emplace_back(strength_order[ranks[i].second]);
+  }
+}
+
+// Adaptive non-maximal suppression. The keypoints are processed from strongest
+// to weakest and the suppression radius of each keypoint is the distance to
+// the nearest keypoint that is sufficiently stronger than it. The stronger
+// keypoints are stored in a grid to accelerate the nearest neighbor search.
+void SelectKeypointsWithAnms(const KeypointSelectionOptions& options,
+                             const int image_width,
+                             const int image_height,
+                             const std::vector<Keypoint>& keypoints,
+                             const std::vector<int>& strength_order,
+                             std::vector<int>* selected_indices) {
+  const int num_keypoints = strength_order.size();
+
+  // Use cells that hold a few keypoints each on average.
+  static const double kKeypointsPerCell = 4.0;
+  const double cell_size = std::max(
+      std::sqrt(kKeypointsPerCell * std::max(image_width, 1) *
+                std::max(image_height, 1) / num_keypoints),
+      1.0);
+  const ImageGrid grid(
+      image_width,
+      image_height,
+      std::max(static_cast<int>(std::ceil(image_width / cell_size)), 1),
+      std::max(static_cast<int>(std::ceil(image_height / cell_size)), 1));
+  std::vector<std::vector<int> > cells(grid.num_cells());
+
+  // The squared suppression radius for each position in the strength order.
+  std::vector<double> sq_radii(num_keypoints,
+                               std::numeric_limits<double>::infinity());
+  int num_suppressors = 0;
+  for (int i = 0; i < num_keypoints; i++) {
+    const Keypoint& keypoint = keypoints[strength_order[i]];
+    const double strength = KeypointStrength(keypoint);
+
+    // Add all keypoints that are now strong enough to suppress this one.
+    // Since the keypoints are sorted by strength, these form a prefix of the
+    // strength order.
+    while (num_suppressors < i &&
+           options.anms_robustness *
+                   KeypointStrength(keypoints[strength_order[num_suppressors]]) >
+               strength) {
+      const int suppressor = strength_order[num_suppressors];
+      cells[grid.Cell(keypoints[suppressor])].emplace_back(suppressor);
+      ++num_suppressors;
+    }
+    if (num_suppressors == 0) {
+      continue;
+    }
+
+    // Search the grid in rings of cells around the keypoint. Any keypoint in
+    // ring r is at least (r - 1) cells away, so the search stops once that
+    // distance exceeds the nearest keypoint found so far.
+    const int cell_x = grid.CellX(keypoint.x());
+    const int cell_y = grid.CellY(keypoint.y());
+    const int max_ring = std::max(grid.num_cells_x(), grid.num_cells_y());
+    double& sq_radius = sq_radii[i];
+    for (int ring = 0; ring <= max_ring; ring++) {
+      const double min_ring_distance = (ring - 1) * grid.min_cell_size();
+      if (ring > 1 && min_ring_distance * min_ring_distance >= sq_radius) {
+        break;
+      }
+
+      for (int y = cell_y - ring; y <= cell_y + ring; y++) {
+        if (y < 0 || y >= grid.num_cells_y()) {
+          continue;
+        }
+        // Only the first and last rows of the ring contain all of its columns.
+        const int x_step =
+            (y == cell_y - ring || y == cell_y + ring) ? 1 : 2 * ring;
+        for (int x = cell_x - ring; x <= cell_x + ring;
+             x += std::max(x_step, 1)) {
+          if (x < 0 || x >= grid.num_cells_x()) {
+            continue;
+          }
+          for (const int suppressor : cells[y * grid.num_cells_x() + x]) {
+            const double dx = keypoints[suppressor].x() - keypoint.x();
+            const double dy = keypoints[suppressor].y() - keypoint.y();
+            sq_radius = std::min(sq_radius, dx * dx + dy * dy);
+          }
+        }
+      }
+    }
+  }
+
+  // Keep the keypoints with the largest suppression radii.
+  std::vector<int> radius_order(num_keypoints);
+  std::iota(radius_order.begin(), radius_order.end(), 0);
+  const int num_selected = options.max_num_keypoints;
+  std::partial_sort(radius_order.begin(),
+                    radius_order.begin() + num_selected,
+                    radius_order.end(),
+                    [&](const int i, const int j) {
+                      if (sq_radii[i] != sq_radii[j]) {
+                        return sq_radii[i] > sq_radii[j];
+                      }
+                      return i < j;
+                    });
+  for (int i = 0; i < num_selected; i++) {
+    selected_indices->emplace_back(strength_order[radius_order[i]]);
+  }
+}
+
+}  // namespace
+
+void SelectKeypoints(const KeypointSelectionOptions& options,
+                     const int image_width,
+                     const int image_height,
+                     const std::vector<Keypoint>& keypoints,
+                     std::vector<int>* selected_indices) {
+  CHECK_NOTNULL(selected_indices)->clear();
+  const int num_keypoints = keypoints.size();
+  if (options.max_num_keypoints <= 0 ||
+      num_keypoints <= options.max_num_keypoints) {
+    selected_indices->resize(num_keypoints);
+    std::iota(selected_indices->begin(), selected_indices->end(), 0);
+    return;
+  }
+
+  const std::vector<int> strength_order = OrderByStrength(keypoints);
+  selected_indices->reserve(options.max_num_keypoints);
+  switch (options.selection_type) {
+    case KeypointSelectionType::STRENGTH:
+      selected_indices->assign(
+          strength_order.begin(),
+          strength_order.begin() + options.max_num_keypoints);
+      break;
+    case KeypointSelectionType::GRID:
+      SelectKeypointsFromGrid(options,
+                              image_width,
+                              image_height,
+                              keypoints,
+                              strength_order,
+                              selected_indices);
+      break;
+    case KeypointSelectionType::ANMS:
+      SelectKeypointsWithAnms(options,
+                              image_width,
+                              image_height,
+                              keypoints,
+                              strength_order,
+                              selected_indices);
+      break;
+    default:
+      LOG(FATAL) << "Invalid keypoint selection type.";
+  }
+
+  std::sort(selected_indices->begin(), selected_indices->end());
+}
+
+}  // namespace theia
@@ -0,0 +1,89 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_IMAGE_KEYPOINT_DETECTOR_SELECT_KEYPOINTS_H_
+#define THEIA_IMAGE_KEYPOINT_DETECTOR_SELECT_KEYPOINTS_H_
+
+#include <vector>
+
+namespace theia {
+class Keypoint;
+
+// Methods for choosing which keypoints to keep when an image has more
+// keypoints than desired. All methods rank keypoints by their strength (e.g.,
+// the DoG response for SIFT) so that the most repeatable keypoints are kept.
+enum class KeypointSelectionType {
+  // Keep the strongest keypoints.
+  STRENGTH = 0,
+
+  // Divide the image into a grid and pick the strongest remaining keypoint of
+  // each cell in a round-robin fashion so that the keypoints cover the image.
+  GRID = 1,
+
+  // Adaptive non-maximal suppression from "Multi-Image Matching using
+  // Multi-Scale Oriented Patches" by Brown et al. (CVPR 2005). Keypoints are
+  // ranked by the distance to the nearest significantly stronger keypoint,
+  // which spreads them evenly while favoring strong keypoints.
+  ANMS = 2,
+};
+
+struct KeypointSelectionOptions {
+  KeypointSelectionType selection_type = KeypointSelectionType::STRENGTH;
+
+  // The maximum number of keypoints to select. If this is <= 0 then all
+  // keypoints are selected.
+  int max_num_keypoints = 0;
+
+  // The number of grid cells along each image dimension for GRID selection.
+  int num_grid_cells = 8;
+
+  // A keypoint only suppresses a weaker keypoint for ANMS if the weaker
+  // keypoint's strength is below this fraction of its own strength.
+  double anms_robustness = 0.9;
+};
+
+// Selects at most options.max_num_keypoints keypoints from an image of the
+// given size. The indices of the selected keypoints are returned in increasing
+// order so that the selected keypoints keep their original relative order.
+// Keypoints without a strength are treated as equally strong, and ties are
+// always broken by the keypoint index so that the selection is deterministic.
+void SelectKeypoints(const KeypointSelectionOptions& options,
+                     const int image_width,
+                     const int image_height,
+                     const std::vector<Keypoint>& keypoints,
+                     std::vector<int>* selected_indices);
+
+}  // namespace theia
+
+#endif  // THEIA_IMAGE_KEYPOINT_DETECTOR_SELECT_KEYPOINTS_H_
@@ -0,0 +1,154 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <algorithm>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/image/keypoint_detector/select_keypoints.h"
+
+namespace theia {
+
+namespace {
+
+Keypoint MakeKeypoint(const double x, const double y, const double strength) {
+  Keypoint keypoint(x, y, Keypoint::OTHER);
+  keypoint.set_strength(strength);
+  return keypoint;
+}
+
+// Creates a cluster of strong keypoints in the top-left corner of the image
+// and weaker keypoints spread over the rest of the image.
+std::vector<Keypoint> MakeClusteredKeypoints() {
+  std::vector<Keypoint> keypoints;
+  for (int i = 0; i < 10; i++) {
+    for (int j = 0; j < 10; j++) {
+      keypoints.emplace_back(MakeKeypoint(i, j, 100.0 + i * 10 + j));
+    }
+  }
+  for (int i = 0; i < 10; i++) {
+    for (int j = 0; j < 10; j++) {
+      keypoints.emplace_back(MakeKeypoint(50 + 100 * i, 50 + 100 * j, 1.0));
+    }
+  }
+  return keypoints;
+}
+
+}  // namespace
+
+TEST(SelectKeypoints, AllKeypointsWhenUnderLimit) {
+  const std::vector<Keypoint> keypoints = MakeClusteredKeypoints();
+  KeypointSelectionOptions options;
+  options.max_num_keypoints = keypoints.size();
+  std::vector<int> selected;
+  SelectKeypoints(options, 1000, 1000, keypoints, &selected);
+  ASSERT_EQ(selected.size(), keypoints.size());
+  for (int i = 0; i < selected.size(); i++) {
+    EXPECT_EQ(selected[i], i);
+  }
+}
+
+TEST(SelectKeypoints, Strength) {
+  std::vector<Keypoint> keypoints;
+  keypoints.emplace_back(MakeKeypoint(0, 0, 1.0));
+  keypoints.emplace_back(MakeKeypoint(1, 0, 5.0));
+  keypoints.emplace_back(MakeKeypoint(2, 0, 3.0));
+  keypoints.emplace_back(MakeKeypoint(3, 0, 4.0));
+
+  KeypointSelectionOptions options;
+  options.selection_type = KeypointSelectionType::STRENGTH;
+  options.max_num_keypoints = 2;
+  std::vector<int> selected;
+  SelectKeypoints(options, 10, 10, keypoints, &selected);
+  ASSERT_EQ(selected.size(), 2);
+  // The indices are returned in increasing order.
+  EXPECT_EQ(selected[0], 1);
+  EXPECT_EQ(selected[1], 3);
+}
+
+TEST(SelectKeypoints, GridCoversImage) {
+  const std::vector<Keypoint> keypoints = MakeClusteredKeypoints();
+  KeypointSelectionOptions options;
+  options.selection_type = KeypointSelectionType::GRID;
+  options.num_grid_cells = 10;
+  options.max_num_keypoints = 100;
+  std::vector<int> selected;
+  SelectKeypoints(options, 1000, 1000, keypoints, &selected);
+  ASSERT_EQ(selected.size(), 100);
+
+  // Every cell receives one keypoint, so only the strongest keypoint of the
+  // clustered cell is kept.
+  const int num_clustered = std::count_if(
+      selected.begin(), selected.end(), [](const int i) { return i < 100; });
+  EXPECT_EQ(num_clustered, 1);
+  EXPECT_EQ(selected[0], 99);
+}
+
+TEST(SelectKeypoints, AnmsSpreadsKeypoints) {
+  const std::vector<Keypoint> keypoints = MakeClusteredKeypoints();
+  KeypointSelectionOptions options;
+  options.selection_type = KeypointSelectionType::ANMS;
+  options.anms_robustness = 1.0;
+  options.max_num_keypoints = 50;
+  std::vector<int> selected;
+  SelectKeypoints(options, 1000, 1000, keypoints, &selected);
+  ASSERT_EQ(selected.size(), 50);
+
+  // The clustered keypoints suppress each other within a few pixels, so only
+  // the strongest one is kept and the rest come from the rest of the image.
+  const int num_clustered = std::count_if(
+      selected.begin(), selected.end(), [](const int i) { return i < 100; });
+  EXPECT_EQ(num_clustered, 1);
+  EXPECT_EQ(selected[0], 99);
+  EXPECT_TRUE(std::is_sorted(selected.begin(), selected.end()));
+}
+
+TEST(SelectKeypoints, Deterministic) {
+  const std::vector<Keypoint> keypoints = MakeClusteredKeypoints();
+  for (const KeypointSelectionType type :
+       {KeypointSelectionType::STRENGTH,
+        KeypointSelectionType::GRID,
+        KeypointSelectionType::ANMS}) {
+    KeypointSelectionOptions options;
+    options.selection_type = type;
+    options.max_num_keypoints = 37;
+    std::vector<int> selected1, selected2;
+    SelectKeypoints(options, 1000, 1000, keypoints, &selected1);
+    SelectKeypoints(options, 1000, 1000, keypoints, &selected2);
+    EXPECT_EQ(selected1, selected2);
+  }
+}
+
+}  // namespace theia
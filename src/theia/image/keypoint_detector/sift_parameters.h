@@ -35,6 +35,8 @@
 #ifndef THEIA_IMAGE_KEYPOINT_DETECTOR_SIFT_PARAMETERS_H_
 #define THEIA_IMAGE_KEYPOINT_DETECTOR_SIFT_PARAMETERS_H_
 
+#include "theia/image/keypoint_detector/select_keypoints.h"
+
 namespace theia {
 // Sift blob feature detector parameters. Since the Sift implementation is based
 // on the VLFeat one, please visit (http://www.vlfeat.org/api/sift.html) for
@@ -70,6 +72,31 @@ struct SiftParameters {
   // location. This is useful for SfM for a number of reasons, especially during
   // geometric verification.
   bool upright_sift = true;
+
+  // Multithreading parameters for extracting features from a single image. If
+  // num_threads > 1, the orientations and descriptors of the keypoints found in
+  // each octave are computed in parallel. The output is identical to (and in
+  // the same order as) the single-threaded output. This is only useful when
+  // extracting features from a single image at a time: extractors created with
+  // CreateDescriptorExtractor are run in parallel over images by the feature
+  // extractors and always use a single thread.
+  int num_threads = 1;
+
+  // If tile_size > 0, the image is split into tile_size x tile_size tiles that
+  // are processed independently (and in parallel when num_threads > 1) with
+  // separate filters. Each tile is padded by tile_overlap pixels of context on
+  // every side and only keeps the keypoints that fall inside of the tile, so
+  // keypoints are never duplicated and are returned in tile order. Since each
+  // filter only sees its padded tile, blobs larger than the overlap may be
+  // missed and so this is mostly useful for very large images.
+  int tile_size = 0;
+  int tile_overlap = 64;
+
+  // If keypoint_selection.max_num_keypoints > 0, all keypoints are detected
+  // first and descriptors are only computed for the selected keypoints. The
+  // magnitude of the DoG response is used as the keypoint strength. Note that
+  // when upright_sift is false a keypoint may produce more than one feature.
+  KeypointSelectionOptions keypoint_selection;
 };
 
 }  // namespace theia
@@ -34,32 +34,31 @@
 
 #include "theia/io/bundler_file_reader.h"
 
-#include <stdio.h>
-#include <stdlib.h>
+#include <algorithm>
+#include <future>  // NOLINT
 #include <string>
 #include <vector>
 
 #include <Eigen/Core>
 #include <glog/logging.h>
 
+#include "theia/io/text_tokenizer.h"
 #include "theia/sfm/reconstruction.h"
+#include "theia/util/mapped_file.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 namespace {
-bool ReadHeader(FILE* in, int* num_cameras, int* num_points) {
+bool ReadHeader(TextTokenizer* in, int* num_cameras, int* num_points) {
   // Read the comment.
-  char* line = nullptr;
-  size_t length = 0;
-  if ((getline(&line, &length, in) == -1) || line[0] != '#') {
-    free(line);
+  std::string line;
+  if (!in->ReadLine(&line) || line.empty() || line[0] != '#') {
     return false;
   }
   VLOG(3) << "Comment: " << line;
-  free(line);
   // Read number of points and cameras.
-  if (fscanf(in, "%d %d",
-             CHECK_NOTNULL(num_cameras),
-             CHECK_NOTNULL(num_points)) != 2 ||
+  if (!in->Read(CHECK_NOTNULL(num_cameras)) ||
+      !in->Read(CHECK_NOTNULL(num_points)) ||
       *num_cameras < 1 || *num_points < 1) {
     return false;
   }
@@ -68,36 +67,27 @@ bool ReadHeader(FILE* in, int* num_cameras, int* num_points) {
   return true;
 }
 
-bool ReadCamera(FILE* in, BundlerCamera* camera) {
+bool ReadCamera(TextTokenizer* in, BundlerCamera* camera) {
   // Read focal length and radial distortion coeffs.
-  if (fscanf(in, "%f %f %f",
-             &camera->focal_length,
-             &camera->radial_coeff_1,
-             &camera->radial_coeff_2) != 3) {
+  if (!in->Read(&camera->focal_length) ||
+      !in->Read(&camera->radial_coeff_1) ||
+      !in->Read(&camera->radial_coeff_2)) {
     VLOG(3) << "Unable to read focal length and radial distortion coeffs.";
     return false;
   }
   // Read rotation matrix.
   Eigen::Matrix3d& rotation = camera->rotation;
-  if (fscanf(in, "%lf %lf %lf",
-             &rotation(0, 0), &rotation(0, 1), &rotation(0, 2)) != 3) {
-    VLOG(3) << "Unable to read first row of rotation matrix.";
-    return false;
-  }
-  if (fscanf(in, "%lf %lf %lf",
-             &rotation(1, 0), &rotation(1, 1), &rotation(1, 2)) != 3) {
-    VLOG(3) << "Unable to read second row of rotation matrix.";
-    return false;
-  }
-  if (fscanf(in, "%lf %lf %lf",
-             &rotation(2, 0), &rotation(2, 1), &rotation(2, 2)) != 3) {
-    VLOG(3) << "Unable to read third row of rotation matrix.";
-    return false;
+  for (int i = 0; i < 3; ++i) {
+    if (!in->Read(&rotation(i, 0)) || !in->Read(&rotation(i, 1)) ||
+        !in->Read(&rotation(i, 2))) {
+      VLOG(3) << "Unable to read row " << i << " of rotation matrix.";
+      return false;
+    }
   }
   // Read position.
   Eigen::Vector3d& translation = camera->translation;
-  if (fscanf(in, "%lf %lf %lf",
-             &translation(0), &translation(1), &translation(2)) != 3) {
+  if (!in->Read(&translation(0)) || !in->Read(&translation(1)) ||
+      !in->Read(&translation(2))) {
     VLOG(3) << "Unable to read camera translation.";
     return false;
   }
@@ -105,7 +95,7 @@ bool ReadCamera(FILE* in, BundlerCamera* camera) {
 }
 
 bool ReadCameras(const int num_cameras,
-                 FILE* in,
+                 TextTokenizer* in,
                  std::vector<BundlerCamera>* cameras) {
   CHECK_NOTNULL(cameras)->reserve(num_cameras);
   for (int i = 0; i < num_cameras; ++i) {
@@ -129,52 +119,42 @@ bool ReadCameras(const int num_cameras,
   return true;
 }
 
-bool ReadViewList(FILE* in, std::vector<FeatureInfo>* view_list) {
+bool ReadViewList(TextTokenizer* in, std::vector<FeatureInfo>* view_list) {
   // Read number of views.
   int num_views = 0;
-  if (fscanf(in, "%d", &num_views) != 1) {
+  if (!in->Read(&num_views)) {
     VLOG(3) << "Unable to read number of views for point.";
+    return false;
   }
   VLOG(3) << "Num. views to read: " << num_views;
   view_list->resize(num_views);
-  float entry = 0;
+  // The entries are read as floats and truncated since some writers output the
+  // keypoint positions with a fractional part.
+  float camera_index, sift_index, kpt_x, kpt_y;
   for (int i = 0; i < view_list->size(); ++i) {
-    // Camera index.
-    if (fscanf(in, "%f", &entry) != 1) {
-      return false;
-    }
-    (*view_list)[i].camera_index = static_cast<int>(entry);
-    // Sift index.
-    if (fscanf(in, "%f", &entry) != 1) {
-      return false;
-    }
-    (*view_list)[i].sift_index = static_cast<int>(entry);
-    // Kpt x.
-    if (fscanf(in, "%f", &entry) != 1) {
-      return false;
-    }
-    (*view_list)[i].kpt_x = static_cast<int>(entry);
-    // Kpt y.
-    if (fscanf(in, "%f", &entry) != 1) {
+    if (!in->Read(&camera_index) || !in->Read(&sift_index) ||
+        !in->Read(&kpt_x) || !in->Read(&kpt_y)) {
       return false;
     }
-    (*view_list)[i].kpt_y = static_cast<int>(entry);
+    (*view_list)[i].camera_index = static_cast<int>(camera_index);
+    (*view_list)[i].sift_index = static_cast<int>(sift_index);
+    (*view_list)[i].kpt_x = static_cast<int>(kpt_x);
+    (*view_list)[i].kpt_y = static_cast<int>(kpt_y);
   }
   return true;
 }
 
-bool ReadPoint(FILE* in, BundlerPoint* point) {
+bool ReadPoint(TextTokenizer* in, BundlerPoint* point) {
   // Read position.
   Eigen::Vector3d& position = point->position;
-  if (fscanf(in, "%lf %lf %lf",
-             &position(0), &position(1), &position(2)) != 3) {
-      VLOG(3) << "Unable to read point position. ";
+  if (!in->Read(&position(0)) || !in->Read(&position(1)) ||
+      !in->Read(&position(2))) {
+    VLOG(3) << "Unable to read point position. ";
     return false;
   }
   // Read color.
   Eigen::Vector3d& color = point->color;
-  if (fscanf(in, "%lf %lf %lf",
-             &color(0), &color(1), &color(2)) != 3) {
+  if (!in->Read(&color(0)) || !in->Read(&color(1)) || !in->Read(&color(2))) {
     VLOG(3) << "Unable to read point color.";
     return false;
   }
@@ -186,19 +166,73 @@ bool ReadPoint(FILE* in, BundlerPoint* point) {
   return true;
 }
 
-bool ReadPoints(const int num_points,
-                FILE* in,
-                std::vector<BundlerPoint>* points) {
-  CHECK_NOTNULL(points)->reserve(num_points);
-  for (int i = 0; i < num_points; ++i) {
-    points->emplace_back();
-    if (!ReadPoint(in, &points->back())) {
+// Reads points [first_point, first_point + num_points) into the preallocated
+// points vector.
+bool ReadPointRange(const TextRange& text,
+                    const int first_point,
+                    const int num_points,
+                    std::vector<BundlerPoint>* points) {
+  TextTokenizer in(text);
+  for (int i = first_point; i < first_point + num_points; ++i) {
+    if (!ReadPoint(&in, &(*points)[i])) {
       return false;
     }
   }
   return true;
 }
 
+// Reads the points. Each point is written on exactly three lines by Bundler
+// (position, color and view list), so with more than one thread the points are
+// split at line boundaries and parsed in parallel.
+bool ReadPoints(const int num_points,
+                const int num_threads,
+                TextTokenizer* in,
+                const char* end,
+                std::vector<BundlerPoint>* points) {
+  CHECK_NOTNULL(points)->resize(num_points);
+  if (num_threads <= 1) {
+    return ReadPointRange(
+        TextRange(in->position(), end), 0, num_points, points);
+  }
+
+  // The points start on the line after the last camera.
+  in->SkipLine();
+  static const int kLinesPerPoint = 3;
+  std::vector<TextRange> chunks;
+  const char* points_end;
+  if (!SplitRecordsIntoChunks(TextRange(in->position(), end),
+                              num_points,
+                              kLinesPerPoint,
+                              num_threads,
+                              &chunks,
+                              &points_end)) {
+    VLOG(3) << "The file contains fewer points than specified.";
+    return false;
+  }
+
+  const int points_per_chunk = RecordsPerChunk(num_points, num_threads);
+  std::vector<std::future<bool> > chunk_status;
+  chunk_status.reserve(chunks.size());
+  {
+    ThreadPool pool(std::min(num_threads, static_cast<int>(chunks.size())));
+    for (int i = 0; i < chunks.size(); ++i) {
+      const int first_point = i * points_per_chunk;
+      chunk_status.emplace_back(
+          pool.Add(ReadPointRange,
+                   chunks[i],
+                   first_point,
+                   std::min(points_per_chunk, num_points - first_point),
+                   points));
+    }
+  }
+
+  bool success = true;
+  for (auto& status : chunk_status) {
+    success = status.get() && success;
+  }
+  return success;
+}
+
 }  // namespace
 
 // The bundle files contain the estimated scene and camera geometry have the
@@ -239,33 +273,34 @@ bool ReadPoints(const int num_points,
 // the image, and (w/2, h/2) is the top-right corner (where w and h are the
 // width and height of the image).
 bool BundlerFileReader::ParseBundleFile() {
-  FILE* in = fopen(bundler_filepath_.c_str(), "r");
-  if (in == nullptr) {
+  return ParseBundleFile(1);
+}
+
+bool BundlerFileReader::ParseBundleFile(const int num_threads) {
+  MappedFile file;
+  if (!file.Open(bundler_filepath_)) {
     LOG(INFO) << "Could not open: " << bundler_filepath_;
     return false;
   }
+  const char* end = file.data() + file.size();
+  TextTokenizer in(file.data(), end);
   // Read Header.
   int num_cameras;
   int num_points;
-  if (!ReadHeader(in, &num_cameras, &num_points)) {
-    fclose(in);
+  if (!ReadHeader(&in, &num_cameras, &num_points)) {
     VLOG(3) << "Unable to read header.";
     return false;
   }
   // Read Cameras.
-  if (!ReadCameras(num_cameras, in, &cameras_)) {
-    fclose(in);
+  if (!ReadCameras(num_cameras, &in, &cameras_)) {
     VLOG(3) << "Unable to read cameras.";
     return false;
   }
   // Read Points.
-  if (!ReadPoints(num_points, in, &points_)) {
-    fclose(in);
+  if (!ReadPoints(num_points, num_threads, &in, end, &points_)) {
     VLOG(3) << "Unable to read points.";
     return false;
   }
-  // Close the file.
-  fclose(in);
   bundler_file_parsed_ = true;
   return true;
 }
@@ -293,29 +328,32 @@ bool BundlerFileReader::ParseBundleFile() {
 // NOTE: We set the exif focal length to zero if it is not available (since 0 is
 // never a valid focal length).
 bool BundlerFileReader::ParseListsFile() {
-  FILE* in = fopen(lists_filepath_.c_str(), "r");
-  if (in == nullptr) {
-    LOG(INFO) << "Could not open: " << bundler_filepath_;
+  MappedFile file;
+  if (!file.Open(lists_filepath_)) {
+    LOG(INFO) << "Could not open: " << lists_filepath_;
     return false;
   }
+  TextTokenizer in(file.data(), file.data() + file.size());
   // Read line by line
-  char* line = nullptr;
-  size_t length = 0;
   img_entries_.reserve(1024);
-  char filename[1024];
-  while (getline(&line, &length, in) != -1) {
+  std::string filename;
+  while (in.ReadToken(&filename)) {
     img_entries_.emplace_back();
     ListImgEntry& entry = img_entries_.back();
-    const int read_items = sscanf(line, "%s %f %f",
-           filename, &entry.second_entry, &entry.focal_length);
-    if (read_items != 1 && read_items !=3 ) {
-      VLOG(3) << "Invalid line: " << line;
+    entry.filename = filename;
+    entry.second_entry = 0;
+    entry.focal_length = 0;
+    if (in.HasTokenOnLine() &&
+        (!in.Read(&entry.second_entry) || !in.Read(&entry.focal_length))) {
+      VLOG(3) << "Invalid line for image: " << filename;
       return false;
     }
-    entry.filename = filename;
+    if (in.HasTokenOnLine()) {
+      VLOG(3) << "Invalid line for image: " << filename;
+      return false;
+    }
+    in.SkipLine();
   }
-  free(line);
-  fclose(in);
   lists_file_parsed_ = true;
   return true;
 }
@@ -108,6 +108,10 @@ class BundlerFileReader {
   // success, and false otherwise.
   bool ParseBundleFile();
 
+  // Same as above, but the points are parsed with num_threads threads. This
+  // requires each point to be written on three lines as Bundler does.
+  bool ParseBundleFile(const int num_threads);
+
   // Parses the lists.txt file. Returns true upon success, and false otherwise.
   bool ParseListsFile();
 
@@ -0,0 +1,110 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/io/bundler_file_reader.h"
+
+namespace theia {
+namespace {
+
+static const std::string kListsFile =
+    THEIA_DATA_DIR + std::string("/io/bundler_test/list.txt");
+static const std::string kBundleFile =
+    THEIA_DATA_DIR + std::string("/io/bundler_test/bundle.out");
+
+static const double kTolerance = 1e-6;
+
+// The expected values are the results of the previous stream based parser. The
+// points are split into one chunk per thread, so the thread counts put the
+// chunk boundaries at different points.
+TEST(BundlerFileReader, ParseBundleFile) {
+  for (const int num_threads : {1, 2, 4, 8}) {
+    BundlerFileReader reader(kListsFile, kBundleFile);
+    ASSERT_TRUE(reader.ParseBundleFile(num_threads));
+
+    ASSERT_EQ(reader.NumCameras(), 3);
+    const BundlerCamera& camera = reader.cameras()[2];
+    EXPECT_NEAR(camera.focal_length, 700.0, kTolerance);
+    EXPECT_NEAR(camera.radial_coeff_1, 0.1, kTolerance);
+    EXPECT_NEAR(camera.radial_coeff_2, -0.05, kTolerance);
+    Eigen::Matrix3d rotation;
+    rotation << 0.36, 0.48, -0.8, -0.8, 0.6, 0, 0.48, 0.64, 0.6;
+    EXPECT_LT((camera.rotation - rotation).norm(), kTolerance);
+    EXPECT_LT((camera.translation - Eigen::Vector3d(-1, 2, -3)).norm(),
+              kTolerance);
+    EXPECT_LT((reader.cameras()[1].translation -
+               Eigen::Vector3d(0.5, -1.25, 0.2)).norm(),
+              kTolerance);
+
+    const std::vector<Eigen::Vector3d> positions = {
+        Eigen::Vector3d(0.5, 1.5, -10),   Eigen::Vector3d(-1, 0.25, -8.5),
+        Eigen::Vector3d(2, -3, -12),      Eigen::Vector3d(0, 0, -9),
+        Eigen::Vector3d(1.25, -0.5, -11), Eigen::Vector3d(-2.5, 3.5, -7)};
+    const std::vector<int> num_views = {2, 3, 2, 2, 3, 2};
+    ASSERT_EQ(reader.NumPoints(), positions.size());
+    for (int i = 0; i < positions.size(); i++) {
+      const BundlerPoint& point = reader.points()[i];
+      EXPECT_LT((point.position - positions[i]).norm(), kTolerance);
+      EXPECT_EQ(point.view_list.size(), num_views[i]);
+    }
+    EXPECT_EQ(reader.points()[3].color, Eigen::Vector3d(10, 20, 30));
+
+    // The keypoint positions are truncated to integers.
+    const FeatureInfo& feature = reader.points()[1].view_list[2];
+    EXPECT_EQ(feature.camera_index, 2);
+    EXPECT_EQ(feature.sift_index, 2);
+    EXPECT_EQ(feature.kpt_x, 0);
+    EXPECT_EQ(feature.kpt_y, -15);
+    EXPECT_EQ(reader.points()[0].view_list[0].kpt_x, 10);
+    EXPECT_EQ(reader.points()[0].view_list[0].kpt_y, -3);
+  }
+}
+
+TEST(BundlerFileReader, ParseListsFile) {
+  BundlerFileReader reader(kListsFile, kBundleFile);
+  ASSERT_TRUE(reader.ParseListsFile());
+  ASSERT_EQ(reader.NumListEntries(), 3);
+  EXPECT_EQ(reader.img_entries()[0].filename, "images/a.jpg");
+  EXPECT_EQ(reader.img_entries()[0].focal_length, 600.5f);
+  EXPECT_EQ(reader.img_entries()[1].filename, "images/b.jpg");
+  EXPECT_EQ(reader.img_entries()[1].focal_length, 0.0f);
+  EXPECT_EQ(reader.img_entries()[2].focal_length, 700.0f);
+}
+
+}  // namespace
+}  // namespace theia
@@ -0,0 +1,718 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/io/compact_reconstruction.h"
+
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>   // NOLINT
+#include <sstream>   // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/camera_intrinsics_model.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/view.h"
+
+namespace theia {
+
+namespace {
+
+const char kSignature[8] = {'T', 'H', 'E', 'I', 'A', 'C', 'R', 'F'};
+
+// Increment this whenever the layout of the file changes.
+const uint32_t kVersion = 1;
+
+// The mark is written in the byte order of the writer so that a reader with a
+// different byte order rejects the file instead of misreading the columns.
+const uint32_t kByteOrderMark = 0x01020304;
+
+// The columns are buffered and written in chunks of this size.
+const size_t kChunkSizeInBytes = 1 << 20;
+
+enum Section {
+  VIEW_METADATA = 0,
+  VIEW_GROUPS,
+  VIEW_IMAGE_SIZES,
+  VIEW_INTRINSICS_TYPES,
+  VIEW_EXTRINSICS,
+  VIEW_INTRINSICS_OFFSETS,
+  INTRINSICS,
+  POINTS,
+  COLORS,
+  OBSERVATION_OFFSETS,
+  OBSERVATION_VIEWS,
+  OBSERVATION_FEATURES,
+  NUM_SECTIONS
+};
+
+struct FileHeader {
+  char signature[8];
+  uint32_t version;
+  uint32_t byte_order_mark;
+  uint64_t num_views;
+  uint64_t num_tracks;
+  uint64_t num_observations;
+  // The byte offset of each section. The last entry is the size of the file.
+  uint64_t section_offsets[NUM_SECTIONS + 1];
+};
+
+uint64_t AlignedSize(const uint64_t num_bytes) {
+  return (num_bytes + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Computes the section offsets from the unpadded size of each section.
+void ComputeSectionOffsets(const std::vector<uint64_t>& section_sizes,
+                           FileHeader* header) {
+  header->section_offsets[0] = AlignedSize(sizeof(*header));
+  for (int i = 0; i < NUM_SECTIONS; i++) {
+    header->section_offsets[i + 1] =
+        header->section_offsets[i] + AlignedSize(section_sizes[i]);
+  }
+}
+
+// Buffers the values of a section and writes them to the stream in chunks.
+class SectionWriter {
+ public:
+  explicit SectionWriter(std::ofstream* stream)
+      : stream_(stream), num_bytes_in_section_(0) {
+    buffer_.reserve(kChunkSizeInBytes);
+  }
+
+  template <typename T>
+  void Write(const T* values, const int num_values) {
+    const char* bytes = reinterpret_cast<const char*>(values);
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T) * num_values);
+    if (buffer_.size() >= kChunkSizeInBytes) {
+      Flush();
+    }
+  }
+
+  template <typename T>
+  void Write(const T& value) {
+    Write(&value, 1);
+  }
+
+  // Pads the section to the next 8-byte boundary, writes it out and checks
+  // that it has the size that was recorded in the header.
+  void FinishSection(const uint64_t expected_size) {
+    CHECK_EQ(num_bytes_in_section_ + buffer_.size(), expected_size);
+    buffer_.resize(buffer_.size() + AlignedSize(expected_size) - expected_size,
+                   0);
+    Flush();
+    num_bytes_in_section_ = 0;
+  }
+
+ private:
+  void Flush() {
+    stream_->write(buffer_.data(), buffer_.size());
+    num_bytes_in_section_ += buffer_.size();
+    buffer_.clear();
+  }
+
+  std::ofstream* stream_;
+  std::vector<char> buffer_;
+  uint64_t num_bytes_in_section_;
+};
+
+// Returns the indices of the estimated views that observe the track, sorted so
+// that the output is deterministic.
+void GetObservationViewIndices(
+    const Track& track,
+    const std::unordered_map<ViewId, int>& view_indices,
+    std::vector<int>* observation_view_indices) {
+  observation_view_indices->clear();
+  for (const ViewId view_id : track.ViewIds()) {
+    const auto view_index = view_indices.find(view_id);
+    if (view_index != view_indices.end()) {
+      observation_view_indices->emplace_back(view_index->second);
+    }
+  }
+  std::sort(observation_view_indices->begin(),
+            observation_view_indices->end());
+}
+
+}  // namespace
+
+bool WriteCompactReconstruction(const Reconstruction& reconstruction,
+                                const std::string& output_file) {
+  std::ofstream output_writer(output_file, std::ios::out | std::ios::binary);
+  if (!output_writer.is_open()) {
+    LOG(ERROR) << "Could not open the file: " << output_file << " for writing.";
+    return false;
+  }
+
+  // Assign consecutive indices to the estimated views and to their camera
+  // intrinsics groups.
+  std::vector<ViewId> view_ids;
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    if (reconstruction.View(view_id)->IsEstimated()) {
+      view_ids.emplace_back(view_id);
+    }
+  }
+  std::sort(view_ids.begin(), view_ids.end());
+
+  std::unordered_map<ViewId, int> view_indices;
+  std::unordered_map<CameraIntrinsicsGroupId, int> group_indices;
+  uint64_t num_intrinsics = 0;
+  for (int i = 0; i < view_ids.size(); i++) {
+    view_indices.emplace(view_ids[i], i);
+    group_indices.emplace(
+        reconstruction.CameraIntrinsicsGroupIdFromViewId(view_ids[i]),
+        group_indices.size());
+    num_intrinsics += reconstruction.View(view_ids[i])
+                          ->Camera()
+                          .CameraIntrinsics()
+                          ->NumParameters();
+  }
+
+  // Find the tracks that are written and count their observations.
+  std::vector<TrackId> track_ids;
+  uint64_t num_observations = 0;
+  std::vector<int> observation_view_indices;
+  std::vector<TrackId> all_track_ids = reconstruction.TrackIds();
+  std::sort(all_track_ids.begin(), all_track_ids.end());
+  for (const TrackId track_id : all_track_ids) {
+    const Track& track = *reconstruction.Track(track_id);
+    if (!track.IsEstimated()) {
+      continue;
+    }
+    GetObservationViewIndices(track, view_indices, &observation_view_indices);
+    if (observation_view_indices.size() < 2) {
+      continue;
+    }
+    track_ids.emplace_back(track_id);
+    num_observations += observation_view_indices.size();
+  }
+  std::vector<TrackId>().swap(all_track_ids);
+
+  // The view names and priors are the only variable-sized view data, and are
+  // small enough to be serialized with cereal in memory.
+  std::string view_metadata;
+  {
+    std::vector<std::string> view_names(view_ids.size());
+    std::vector<CameraIntrinsicsPrior> view_priors(view_ids.size());
+    for (int i = 0; i < view_ids.size(); i++) {
+      const View* view = reconstruction.View(view_ids[i]);
+      view_names[i] = view->Name();
+      view_priors[i] = view->CameraIntrinsicsPrior();
+    }
+    std::ostringstream metadata_stream;
+    {
+      cereal::PortableBinaryOutputArchive metadata_archive(metadata_stream);
+      metadata_archive(view_names, view_priors);
+    }
+    view_metadata = metadata_stream.str();
+  }
+
+  const uint64_t num_views = view_ids.size();
+  const uint64_t num_tracks = track_ids.size();
+  std::vector<uint64_t> section_sizes(NUM_SECTIONS);
+  section_sizes[VIEW_METADATA] = view_metadata.size();
+  section_sizes[VIEW_GROUPS] = sizeof(int32_t) * num_views;
+  section_sizes[VIEW_IMAGE_SIZES] = 2 * sizeof(int32_t) * num_views;
+  section_sizes[VIEW_INTRINSICS_TYPES] = sizeof(int32_t) * num_views;
+  section_sizes[VIEW_EXTRINSICS] =
+      Camera::kExtrinsicsSize * sizeof(double) * num_views;
+  section_sizes[VIEW_INTRINSICS_OFFSETS] = sizeof(uint64_t) * (num_views + 1);
+  section_sizes[INTRINSICS] = sizeof(double) * num_intrinsics;
+  section_sizes[POINTS] = 4 * sizeof(double) * num_tracks;
+  section_sizes[COLORS] = 3 * sizeof(uint8_t) * num_tracks;
+  section_sizes[OBSERVATION_OFFSETS] = sizeof(uint64_t) * (num_tracks + 1);
+  section_sizes[OBSERVATION_VIEWS] = sizeof(uint32_t) * num_observations;
+  section_sizes[OBSERVATION_FEATURES] = 2 * sizeof(double) * num_observations;
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.signature, kSignature, sizeof(kSignature));
+  header.version = kVersion;
+  header.byte_order_mark = kByteOrderMark;
+  header.num_views = num_views;
+  header.num_tracks = num_tracks;
+  header.num_observations = num_observations;
+  ComputeSectionOffsets(section_sizes, &header);
+
+  SectionWriter writer(&output_writer);
+  writer.Write(header);
+  writer.FinishSection(sizeof(header));
+
+  writer.Write(view_metadata.data(), view_metadata.size());
+  writer.FinishSection(section_sizes[VIEW_METADATA]);
+
+  for (const ViewId view_id : view_ids) {
+    const int32_t group_index = group_indices.at(
+        reconstruction.CameraIntrinsicsGroupIdFromViewId(view_id));
+    writer.Write(group_index);
+  }
+  writer.FinishSection(section_sizes[VIEW_GROUPS]);
+
+  for (const ViewId view_id : view_ids) {
+    const Camera& camera = reconstruction.View(view_id)->Camera();
+    const int32_t image_size[2] = { camera.ImageWidth(), camera.ImageHeight() };
+    writer.Write(image_size, 2);
+  }
+  writer.FinishSection(section_sizes[VIEW_IMAGE_SIZES]);
+
+  for (const ViewId view_id : view_ids) {
+    const int32_t intrinsics_type = static_cast<int32_t>(
+        reconstruction.View(view_id)->Camera().GetCameraIntrinsicsModelType());
+    writer.Write(intrinsics_type);
+  }
+  writer.FinishSection(section_sizes[VIEW_INTRINSICS_TYPES]);
+
+  for (const ViewId view_id : view_ids) {
+    writer.Write(reconstruction.View(view_id)->Camera().extrinsics(),
+                 Camera::kExtrinsicsSize);
+  }
+  writer.FinishSection(section_sizes[VIEW_EXTRINSICS]);
+
+  uint64_t intrinsics_offset = 0;
+  writer.Write(intrinsics_offset);
+  for (const ViewId view_id : view_ids) {
+    intrinsics_offset += reconstruction.View(view_id)
+                             ->Camera()
+                             .CameraIntrinsics()
+                             ->NumParameters();
+    writer.Write(intrinsics_offset);
+  }
+  writer.FinishSection(section_sizes[VIEW_INTRINSICS_OFFSETS]);
+
+  for (const ViewId view_id : view_ids) {
+    const Camera& camera = reconstruction.View(view_id)->Camera();
+    writer.Write(camera.intrinsics(),
+                 camera.CameraIntrinsics()->NumParameters());
+  }
+  writer.FinishSection(section_sizes[INTRINSICS]);
+
+  for (const TrackId track_id : track_ids) {
+    writer.Write(reconstruction.Track(track_id)->Point().data(), 4);
+  }
+  writer.FinishSection(section_sizes[POINTS]);
+
+  for (const TrackId track_id : track_ids) {
+    writer.Write(reconstruction.Track(track_id)->Color().data(), 3);
+  }
+  writer.FinishSection(section_sizes[COLORS]);
+
+  uint64_t observation_offset = 0;
+  writer.Write(observation_offset);
+  for (const TrackId track_id : track_ids) {
+    GetObservationViewIndices(*reconstruction.Track(track_id),
+                              view_indices,
+                              &observation_view_indices);
+    observation_offset += observation_view_indices.size();
+    writer.Write(observation_offset);
+  }
+  writer.FinishSection(section_sizes[OBSERVATION_OFFSETS]);
+
+  for (const TrackId track_id : track_ids) {
+    GetObservationViewIndices(*reconstruction.Track(track_id),
+                              view_indices,
+                              &observation_view_indices);
+    for (const int view_index : observation_view_indices) {
+      writer.Write(static_cast<uint32_t>(view_index));
+    }
+  }
+  writer.FinishSection(section_sizes[OBSERVATION_VIEWS]);
+
+  for (const TrackId track_id : track_ids) {
+    GetObservationViewIndices(*reconstruction.Track(track_id),
+                              view_indices,
+                              &observation_view_indices);
+    for (const int view_index : observation_view_indices) {
+      const Feature& feature =
+          *reconstruction.View(view_ids[view_index])->GetFeature(track_id);
+      writer.Write(feature.data(), 2);
+    }
+  }
+  writer.FinishSection(section_sizes[OBSERVATION_FEATURES]);
+
+  if (!output_writer.good()) {
+    LOG(ERROR) << "Could not write the reconstruction to " << output_file;
+    return false;
+  }
+  return true;
+}
+
+bool ReadCompactReconstruction(const std::string& input_file,
+                               Reconstruction* reconstruction) {
+  CHECK_NOTNULL(reconstruction);
+  CHECK_EQ(reconstruction->NumViews(), 0) << "You must provide an empty "
+                                             "reconstruction before reading a "
+                                             "reconstruction from disk";
+  CHECK_EQ(reconstruction->NumTracks(), 0) << "You must provide an empty "
+                                              "reconstruction before reading a "
+                                              "reconstruction from disk";
+
+  MappedCompactReconstruction mapped_reconstruction;
+  if (!mapped_reconstruction.Open(input_file)) {
+    return false;
+  }
+  mapped_reconstruction.ExtractReconstruction(true, reconstruction);
+  return true;
+}
+
+bool IsCompactReconstructionFile(const std::string& filename) {
+  std::ifstream input_reader(filename, std::ios::in | std::ios::binary);
+  char signature[sizeof(kSignature)];
+  if (!input_reader.read(signature, sizeof(signature))) {
+    return false;
+  }
+  return std::memcmp(signature, kSignature, sizeof(kSignature)) == 0;
+}
+
+MappedCompactReconstruction::MappedCompactReconstruction()
+    : data_(nullptr),
+      size_(0),
+      num_views_(0),
+      num_tracks_(0),
+      num_observations_(0) {}
+
+MappedCompactReconstruction::~MappedCompactReconstruction() { Close(); }
+
+void MappedCompactReconstruction::Close() {
+  file_.Close();
+  data_ = nullptr;
+  size_ = 0;
+  num_views_ = 0;
+  num_tracks_ = 0;
+  num_observations_ = 0;
+  view_names_.clear();
+  view_priors_.clear();
+}
+
+bool MappedCompactReconstruction::Open(const std::string& filename) {
+  Close();
+  if (!file_.Open(filename)) {
+    return false;
+  }
+  data_ = file_.data();
+  size_ = file_.size();
+
+  // Validate the header and the section layout before using any columns.
+  FileHeader header;
+  if (size_ < sizeof(header)) {
+    LOG(ERROR) << filename << " is not a compact reconstruction file.";
+    Close();
+    return false;
+  }
+  std::memcpy(&header, data_, sizeof(header));
+  if (std::memcmp(header.signature, kSignature, sizeof(kSignature)) != 0) {
+    LOG(ERROR) << filename << " is not a compact reconstruction file.";
+    Close();
+    return false;
+  }
+  if (header.version != kVersion) {
+    LOG(ERROR) << "The compact reconstruction " << filename << " has version "
+               << header.version << " but version " << kVersion
+               << " is required.";
+    Close();
+    return false;
+  }
+  if (header.byte_order_mark != kByteOrderMark) {
+    LOG(ERROR) << "The compact reconstruction " << filename
+               << " was written on a machine with a different byte order.";
+    Close();
+    return false;
+  }
+
+  std::vector<uint64_t> section_sizes(NUM_SECTIONS);
+  section_sizes[VIEW_METADATA] =
+      header.section_offsets[VIEW_METADATA + 1] -
+      header.section_offsets[VIEW_METADATA];
+  section_sizes[VIEW_GROUPS] = sizeof(int32_t) * header.num_views;
+  section_sizes[VIEW_IMAGE_SIZES] = 2 * sizeof(int32_t) * header.num_views;
+  section_sizes[VIEW_INTRINSICS_TYPES] = sizeof(int32_t) * header.num_views;
+  section_sizes[VIEW_EXTRINSICS] =
+      Camera::kExtrinsicsSize * sizeof(double) * header.num_views;
+  section_sizes[VIEW_INTRINSICS_OFFSETS] =
+      sizeof(uint64_t) * (header.num_views + 1);
+  section_sizes[INTRINSICS] = header.section_offsets[INTRINSICS + 1] -
+                              header.section_offsets[INTRINSICS];
+  section_sizes[POINTS] = 4 * sizeof(double) * header.num_tracks;
+  section_sizes[COLORS] = 3 * sizeof(uint8_t) * header.num_tracks;
+  section_sizes[OBSERVATION_OFFSETS] =
+      sizeof(uint64_t) * (header.num_tracks + 1);
+  section_sizes[OBSERVATION_VIEWS] =
+      sizeof(uint32_t) * header.num_observations;
+  section_sizes[OBSERVATION_FEATURES] =
+      2 * sizeof(double) * header.num_observations;
+  FileHeader expected_header = header;
+  ComputeSectionOffsets(section_sizes, &expected_header);
+  if (std::memcmp(header.section_offsets,
+                  expected_header.section_offsets,
+                  sizeof(header.section_offsets)) != 0 ||
+      header.section_offsets[NUM_SECTIONS] > size_) {
+    LOG(ERROR) << "The compact reconstruction " << filename
+               << " is truncated or corrupted.";
+    Close();
+    return false;
+  }
+
+  num_views_ = header.num_views;
+  num_tracks_ = header.num_tracks;
+  num_observations_ = header.num_observations;
+  const uint64_t* offsets = header.section_offsets;
+  view_groups_ = reinterpret_cast<const int32_t*>(data_ + offsets[VIEW_GROUPS]);
+  view_image_sizes_ =
+      reinterpret_cast<const int32_t*>(data_ + offsets[VIEW_IMAGE_SIZES]);
+  view_intrinsics_types_ =
+      reinterpret_cast<const int32_t*>(data_ + offsets[VIEW_INTRINSICS_TYPES]);
+  view_extrinsics_ =
+      reinterpret_cast<const double*>(data_ + offsets[VIEW_EXTRINSICS]);
+  view_intrinsics_offsets_ =
+      reinterpret_cast<const uint64_t*>(data_ + offsets[VIEW_INTRINSICS_OFFSETS]);
+  intrinsics_ = reinterpret_cast<const double*>(data_ + offsets[INTRINSICS]);
+  points_ = reinterpret_cast<const double*>(data_ + offsets[POINTS]);
+  colors_ = reinterpret_cast<const uint8_t*>(data_ + offsets[COLORS]);
+  observation_offsets_ =
+      reinterpret_cast<const uint64_t*>(data_ + offsets[OBSERVATION_OFFSETS]);
+  observation_views_ =
+      reinterpret_cast<const uint32_t*>(data_ + offsets[OBSERVATION_VIEWS]);
+  observation_features_ =
+      reinterpret_cast<const double*>(data_ + offsets[OBSERVATION_FEATURES]);
+
+  // The accessors index the columns with the offsets, view indices and
+  // intrinsics types of the file, so they are validated here and a corrupted
+  // file cannot cause reads outside of the mapped file.
+  if (!HasValidColumns(section_sizes[INTRINSICS])) {
+    LOG(ERROR) << "The compact reconstruction " << filename
+               << " is truncated or corrupted.";
+    Close();
+    return false;
+  }
+
+  // Decode the view names and priors.
+  std::istringstream metadata_stream(
+      std::string(data_ + offsets[VIEW_METADATA], section_sizes[VIEW_METADATA]));
+  try {
+    cereal::PortableBinaryInputArchive metadata_archive(metadata_stream);
+    metadata_archive(view_names_, view_priors_);
+  } catch (const std::exception& e) {
+    // Corrupted lengths can also make cereal fail to allocate the strings and
+    // vectors, which throws standard exceptions rather than cereal::Exception.
+    LOG(ERROR) << "The view metadata of the compact reconstruction "
+               << filename << " could not be decoded: " << e.what();
+    Close();
+    return false;
+  }
+  if (view_names_.size() != num_views_ || view_priors_.size() != num_views_) {
+    LOG(ERROR) << "The compact reconstruction " << filename
+               << " is truncated or corrupted.";
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool MappedCompactReconstruction::HasValidColumns(
+    const uint64_t intrinsics_section_size) const {
+  // The number of intrinsics parameters of each known camera intrinsics model.
+  std::vector<uint64_t> num_intrinsics_parameters;
+  for (int type = static_cast<int>(CameraIntrinsicsModelType::PINHOLE);
+       type <= static_cast<int>(CameraIntrinsicsModelType::DIVISION_UNDISTORTION);
+       type++) {
+    num_intrinsics_parameters.emplace_back(
+        CameraIntrinsicsModel::Create(
+            static_cast<CameraIntrinsicsModelType>(type))
+            ->NumParameters());
+  }
+
+  if (view_intrinsics_offsets_[0] != 0 ||
+      view_intrinsics_offsets_[num_views_] * sizeof(double) >
+          intrinsics_section_size) {
+    return false;
+  }
+  for (int i = 0; i < num_views_; i++) {
+    const int32_t type = view_intrinsics_types_[i];
+    if (view_intrinsics_offsets_[i + 1] < view_intrinsics_offsets_[i] ||
+        type < 0 || type >= num_intrinsics_parameters.size() ||
+        view_intrinsics_offsets_[i + 1] - view_intrinsics_offsets_[i] !=
+            num_intrinsics_parameters[type]) {
+      return false;
+    }
+  }
+
+  if (observation_offsets_[0] != 0 ||
+      observation_offsets_[num_tracks_] != num_observations_) {
+    return false;
+  }
+  for (int i = 0; i < num_tracks_; i++) {
+    if (observation_offsets_[i + 1] < observation_offsets_[i]) {
+      return false;
+    }
+  }
+  for (uint64_t i = 0; i < num_observations_; i++) {
+    if (observation_views_[i] >= num_views_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const std::string& MappedCompactReconstruction::ViewName(
+    const int view_index) const {
+  return view_names_[view_index];
+}
+
+const CameraIntrinsicsPrior&
+MappedCompactReconstruction::ViewCameraIntrinsicsPrior(
+    const int view_index) const {
+  return view_priors_[view_index];
+}
+
+CameraIntrinsicsGroupId MappedCompactReconstruction::ViewCameraIntrinsicsGroup(
+    const int view_index) const {
+  return view_groups_[view_index];
+}
+
+void MappedCompactReconstruction::GetCamera(const int view_index,
+                                            Camera* camera) const {
+  CHECK_NOTNULL(camera);
+  // Views in the same intrinsics group of a reconstruction share the same
+  // intrinsics model, so setting the type is a no-op for them and the shared
+  // intrinsics are preserved.
+  camera->SetCameraIntrinsicsModelType(static_cast<CameraIntrinsicsModelType>(
+      view_intrinsics_types_[view_index]));
+  const uint64_t intrinsics_begin = view_intrinsics_offsets_[view_index];
+  const uint64_t intrinsics_end = view_intrinsics_offsets_[view_index + 1];
+  CHECK_EQ(intrinsics_end - intrinsics_begin,
+           camera->CameraIntrinsics()->NumParameters());
+  std::copy(intrinsics_ + intrinsics_begin,
+            intrinsics_ + intrinsics_end,
+            camera->mutable_intrinsics());
+  std::copy(view_extrinsics_ + Camera::kExtrinsicsSize * view_index,
+            view_extrinsics_ + Camera::kExtrinsicsSize * (view_index + 1),
+            camera->mutable_extrinsics());
+  camera->SetImageSize(view_image_sizes_[2 * view_index],
+                       view_image_sizes_[2 * view_index + 1]);
+}
+
+Eigen::Map<const Eigen::Vector4d> MappedCompactReconstruction::Point(
+    const int track_index) const {
+  return Eigen::Map<const Eigen::Vector4d>(points_ + 4 * track_index);
+}
+
+Eigen::Map<const Eigen::Matrix<uint8_t, 3, 1> >
+MappedCompactReconstruction::Color(const int track_index) const {
+  return Eigen::Map<const Eigen::Matrix<uint8_t, 3, 1> >(colors_ +
+                                                         3 * track_index);
+}
+
+int MappedCompactReconstruction::TrackLength(const int track_index) const {
+  return observation_offsets_[track_index + 1] -
+         observation_offsets_[track_index];
+}
+
+uint64_t MappedCompactReconstruction::ObservationsBegin(
+    const int track_index) const {
+  return observation_offsets_[track_index];
+}
+
+uint64_t MappedCompactReconstruction::ObservationsEnd(
+    const int track_index) const {
+  return observation_offsets_[track_index + 1];
+}
+
+int MappedCompactReconstruction::ObservationView(
+    const uint64_t observation_index) const {
+  return observation_views_[observation_index];
+}
+
+Eigen::Map<const Eigen::Vector2d>
+MappedCompactReconstruction::ObservationFeature(
+    const uint64_t observation_index) const {
+  return Eigen::Map<const Eigen::Vector2d>(observation_features_ +
+                                           2 * observation_index);
+}
+
+void MappedCompactReconstruction::ExtractReconstruction(
+    const bool include_tracks, Reconstruction* reconstruction) const {
+  CHECK_NOTNULL(reconstruction);
+  CHECK_EQ(reconstruction->NumViews(), 0);
+  CHECK_EQ(reconstruction->NumTracks(), 0);
+
+  // The first view of each group creates a new camera intrinsics group and the
+  // remaining views of the group are added to it.
+  std::vector<ViewId> view_ids(num_views_);
+  std::unordered_map<int32_t, CameraIntrinsicsGroupId> group_ids;
+  for (int i = 0; i < num_views_; i++) {
+    const auto group_id = group_ids.find(view_groups_[i]);
+    if (group_id == group_ids.end()) {
+      view_ids[i] = reconstruction->AddView(view_names_[i]);
+      CHECK_NE(view_ids[i], kInvalidViewId);
+      group_ids.emplace(
+          view_groups_[i],
+          reconstruction->CameraIntrinsicsGroupIdFromViewId(view_ids[i]));
+    } else {
+      view_ids[i] = reconstruction->AddView(view_names_[i], group_id->second);
+      CHECK_NE(view_ids[i], kInvalidViewId);
+    }
+
+    View* view = reconstruction->MutableView(view_ids[i]);
+    view->SetEstimated(true);
+    *view->MutableCameraIntrinsicsPrior() = view_priors_[i];
+    GetCamera(i, view->MutableCamera());
+  }
+
+  if (!include_tracks) {
+    return;
+  }
+
+  for (int i = 0; i < num_tracks_; i++) {
+    const TrackId track_id = reconstruction->AddTrack();
+    for (uint64_t j = ObservationsBegin(i); j < ObservationsEnd(i); j++) {
+      CHECK(reconstruction->AddObservation(view_ids[ObservationView(j)],
+                                           track_id,
+                                           Feature(ObservationFeature(j))));
+    }
+    Track* track = reconstruction->MutableTrack(track_id);
+    track->SetEstimated(true);
+    *track->MutablePoint() = Point(i);
+    *track->MutableColor() = Color(i);
+  }
+}
+
+}  // namespace theia
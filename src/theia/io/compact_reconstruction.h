@@ -0,0 +1,175 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_IO_COMPACT_RECONSTRUCTION_H_
+#define THEIA_IO_COMPACT_RECONSTRUCTION_H_
+
+#include <Eigen/Core>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "theia/sfm/camera_intrinsics_prior.h"
+#include "theia/sfm/types.h"
+#include "theia/util/mapped_file.h"
+#include "theia/util/util.h"
+
+namespace theia {
+
+class Camera;
+class Reconstruction;
+
+// The compact reconstruction format is a columnar binary file that stores the
+// estimated views and tracks of a reconstruction as flat arrays:
+//
+//   header | view names and priors | view columns (intrinsics group, image
+//   size, intrinsics type, extrinsics, intrinsics offsets) | intrinsics |
+//   points | colors | observation offsets | observation views |
+//   observation features
+//
+// Observations are stored in compressed sparse row (CSR) order: the
+// observations of track i are in [offsets[i], offsets[i + 1]) and each
+// observation stores the index of its view and its feature. Every section
+// starts at an 8-byte aligned offset that is recorded in the header, so the
+// file can be written as a single stream and the columns can be used directly
+// from a memory-mapped file.
+//
+// As with WriteReconstruction, only estimated views and estimated tracks that
+// are observed by at least two estimated views are written. View and track ids
+// are not preserved; views and tracks are referred to by their index in the
+// file.
+
+// Writes the reconstruction to a compact reconstruction file. Unlike
+// WriteReconstruction, this does not create a copy of the reconstruction and
+// the columns are written in fixed-size chunks so the memory overhead is
+// independent of the number of observations.
+bool WriteCompactReconstruction(const Reconstruction& reconstruction,
+                                const std::string& output_file);
+
+// Reads a compact reconstruction file into an empty reconstruction. Views that
+// were in the same camera intrinsics group share their intrinsics.
+bool ReadCompactReconstruction(const std::string& input_file,
+                               Reconstruction* reconstruction);
+
+// Returns true if the file starts with the compact reconstruction file
+// signature.
+bool IsCompactReconstructionFile(const std::string& filename);
+
+// Read-only access to a memory-mapped compact reconstruction file. Only the
+// view names and priors are decoded when the file is opened; all other data is
+// read from the mapped file on demand, so opening a file is nearly free and
+// tools that only need a subset of the data (e.g. only the cameras) never touch
+// the rest of the file.
+class MappedCompactReconstruction {
+ public:
+  MappedCompactReconstruction();
+  ~MappedCompactReconstruction();
+
+  // Maps the file into memory and validates its header. Returns false if the
+  // file could not be opened or is not a valid compact reconstruction file.
+  bool Open(const std::string& filename);
+
+  // Unmaps the file. This is called automatically by the destructor.
+  void Close();
+
+  int NumViews() const { return num_views_; }
+  int NumTracks() const { return num_tracks_; }
+  uint64_t NumObservations() const { return num_observations_; }
+
+  // View accessors. The camera intrinsics group is the index of the group in
+  // the file rather than the group id of the original reconstruction.
+  const std::string& ViewName(const int view_index) const;
+  const CameraIntrinsicsPrior& ViewCameraIntrinsicsPrior(
+      const int view_index) const;
+  CameraIntrinsicsGroupId ViewCameraIntrinsicsGroup(const int view_index) const;
+
+  // Sets the camera intrinsics model, intrinsics, extrinsics and image size of
+  // the camera to those of the view.
+  void GetCamera(const int view_index, Camera* camera) const;
+
+  // Track accessors.
+  Eigen::Map<const Eigen::Vector4d> Point(const int track_index) const;
+  Eigen::Map<const Eigen::Matrix<uint8_t, 3, 1> > Color(
+      const int track_index) const;
+  int TrackLength(const int track_index) const;
+
+  // The observations of the track are in the range
+  // [ObservationsBegin(track_index), ObservationsEnd(track_index)).
+  uint64_t ObservationsBegin(const int track_index) const;
+  uint64_t ObservationsEnd(const int track_index) const;
+  int ObservationView(const uint64_t observation_index) const;
+  Eigen::Map<const Eigen::Vector2d> ObservationFeature(
+      const uint64_t observation_index) const;
+
+  // Adds the views, and the tracks if include_tracks is true, to the empty
+  // reconstruction.
+  void ExtractReconstruction(const bool include_tracks,
+                             Reconstruction* reconstruction) const;
+
+ private:
+  // Returns true if the offsets of the columns are non-decreasing and within
+  // their columns, every view has a known camera intrinsics model with as many
+  // intrinsics as its offsets span, and every observation refers to a view.
+  bool HasValidColumns(const uint64_t intrinsics_section_size) const;
+
+  MappedFile file_;
+  const char* data_;
+  uint64_t size_;
+
+  int num_views_;
+  int num_tracks_;
+  uint64_t num_observations_;
+
+  std::vector<std::string> view_names_;
+  std::vector<CameraIntrinsicsPrior> view_priors_;
+
+  // Pointers to the columns in the mapped file.
+  const int32_t* view_groups_;
+  const int32_t* view_image_sizes_;
+  const int32_t* view_intrinsics_types_;
+  const double* view_extrinsics_;
+  const uint64_t* view_intrinsics_offsets_;
+  const double* intrinsics_;
+  const double* points_;
+  const uint8_t* colors_;
+  const uint64_t* observation_offsets_;
+  const uint32_t* observation_views_;
+  const double* observation_features_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedCompactReconstruction);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_IO_COMPACT_RECONSTRUCTION_H_
@@ -0,0 +1,413 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/io/compact_reconstruction.h"
+#include "theia/io/reconstruction_reader.h"
+#include "theia/io/reconstruction_writer.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/util/random.h"
+
+namespace theia {
+namespace {
+
+static const std::string kCompactReconstructionFile =
+    THEIA_DATA_DIR + std::string("/compact_reconstruction_test.bin");
+
+RandomNumberGenerator rng(61);
+
+// Creates a reconstruction with two views that share their intrinsics, one
+// view with a different intrinsics model, one unestimated view, and tracks
+// with random observations.
+void CreateReconstruction(Reconstruction* reconstruction) {
+  const ViewId view_id0 = reconstruction->AddView("view_0");
+  const ViewId view_id1 = reconstruction->AddView(
+      "view_1", reconstruction->CameraIntrinsicsGroupIdFromViewId(view_id0));
+  const ViewId view_id2 = reconstruction->AddView("view_2");
+  const ViewId view_id3 = reconstruction->AddView("view_3");
+  reconstruction->MutableView(view_id2)
+      ->MutableCamera()
+      ->SetCameraIntrinsicsModelType(
+          CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL);
+  reconstruction->MutableView(view_id2)
+      ->MutableCameraIntrinsicsPrior()
+      ->focal_length.is_set = true;
+  reconstruction->MutableView(view_id2)
+      ->MutableCameraIntrinsicsPrior()
+      ->focal_length.value[0] = 1234.0;
+
+  for (const ViewId view_id : {view_id0, view_id1, view_id2, view_id3}) {
+    View* view = reconstruction->MutableView(view_id);
+    view->SetEstimated(view_id != view_id3);
+    Camera* camera = view->MutableCamera();
+    camera->SetImageSize(1000 + view_id, 800 + view_id);
+    camera->SetFocalLength(rng.RandDouble(500.0, 1500.0));
+    camera->SetPrincipalPoint(rng.RandDouble(400.0, 600.0),
+                              rng.RandDouble(300.0, 500.0));
+    camera->SetPosition(rng.RandVector3d());
+    camera->SetOrientationFromAngleAxis(0.2 * rng.RandVector3d());
+  }
+
+  for (int i = 0; i < 100; i++) {
+    const TrackId track_id = reconstruction->AddTrack();
+    for (const ViewId view_id : {view_id0, view_id1, view_id2, view_id3}) {
+      if (rng.RandDouble(0.0, 1.0) < 0.7) {
+        reconstruction->AddObservation(
+            view_id, track_id, rng.RandVector2d(0.0, 800.0));
+      }
+    }
+    Track* track = reconstruction->MutableTrack(track_id);
+    track->SetEstimated(i % 10 != 0);
+    *track->MutablePoint() = rng.RandVector4d();
+    *track->MutableColor() =
+        Eigen::Matrix<uint8_t, 3, 1>(i, 2 * i, 255 - i);
+  }
+}
+
+// Returns the number of estimated views that observe the track.
+int NumEstimatedViews(const Reconstruction& reconstruction,
+                      const Track& track) {
+  int num_estimated_views = 0;
+  for (const ViewId view_id : track.ViewIds()) {
+    if (reconstruction.View(view_id)->IsEstimated()) {
+      ++num_estimated_views;
+    }
+  }
+  return num_estimated_views;
+}
+
+// Checks that the written reconstruction contains exactly the estimated views
+// and the estimated tracks with at least two estimated views of the original.
+void VerifyReconstruction(const Reconstruction& reconstruction,
+                          const Reconstruction& read_reconstruction) {
+  int num_estimated_views = 0;
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    const View* view = reconstruction.View(view_id);
+    const ViewId read_view_id =
+        read_reconstruction.ViewIdFromName(view->Name());
+    if (!view->IsEstimated()) {
+      EXPECT_EQ(read_view_id, kInvalidViewId);
+      continue;
+    }
+    ++num_estimated_views;
+    ASSERT_NE(read_view_id, kInvalidViewId);
+    const View* read_view = read_reconstruction.View(read_view_id);
+    EXPECT_TRUE(read_view->IsEstimated());
+
+    const Camera& camera = view->Camera();
+    const Camera& read_camera = read_view->Camera();
+    EXPECT_EQ(read_camera.GetCameraIntrinsicsModelType(),
+              camera.GetCameraIntrinsicsModelType());
+    EXPECT_EQ(read_camera.ImageWidth(), camera.ImageWidth());
+    EXPECT_EQ(read_camera.ImageHeight(), camera.ImageHeight());
+    for (int i = 0; i < Camera::kExtrinsicsSize; i++) {
+      EXPECT_EQ(read_camera.extrinsics()[i], camera.extrinsics()[i]);
+    }
+    for (int i = 0; i < camera.CameraIntrinsics()->NumParameters(); i++) {
+      EXPECT_EQ(read_camera.intrinsics()[i], camera.intrinsics()[i]);
+    }
+    EXPECT_EQ(read_view->CameraIntrinsicsPrior().focal_length.is_set,
+              view->CameraIntrinsicsPrior().focal_length.is_set);
+    EXPECT_EQ(read_view->CameraIntrinsicsPrior().focal_length.value[0],
+              view->CameraIntrinsicsPrior().focal_length.value[0]);
+  }
+  EXPECT_EQ(read_reconstruction.NumViews(), num_estimated_views);
+
+  // The first two views must still share their intrinsics.
+  const ViewId read_view_id0 = read_reconstruction.ViewIdFromName("view_0");
+  const ViewId read_view_id1 = read_reconstruction.ViewIdFromName("view_1");
+  EXPECT_EQ(read_reconstruction.View(read_view_id0)->Camera().intrinsics(),
+            read_reconstruction.View(read_view_id1)->Camera().intrinsics());
+  EXPECT_NE(read_reconstruction.View(read_view_id0)->Camera().intrinsics(),
+            read_reconstruction.View(read_reconstruction.ViewIdFromName(
+                                         "view_2"))->Camera().intrinsics());
+
+  // Track ids are not preserved, so match the tracks by their points.
+  int num_written_tracks = 0;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Track* track = reconstruction.Track(track_id);
+    if (!track->IsEstimated() ||
+        NumEstimatedViews(reconstruction, *track) < 2) {
+      continue;
+    }
+    ++num_written_tracks;
+
+    const Track* read_track = nullptr;
+    for (const TrackId read_track_id : read_reconstruction.TrackIds()) {
+      if (read_reconstruction.Track(read_track_id)->Point() == track->Point()) {
+        read_track = read_reconstruction.Track(read_track_id);
+        for (const ViewId view_id : track->ViewIds()) {
+          const View* view = reconstruction.View(view_id);
+          if (!view->IsEstimated()) {
+            continue;
+          }
+          const View* read_view = read_reconstruction.View(
+              read_reconstruction.ViewIdFromName(view->Name()));
+          ASSERT_NE(read_view->GetFeature(read_track_id), nullptr);
+          EXPECT_EQ(*read_view->GetFeature(read_track_id),
+                    *view->GetFeature(track_id));
+        }
+        break;
+      }
+    }
+    ASSERT_NE(read_track, nullptr);
+    EXPECT_TRUE(read_track->IsEstimated());
+    EXPECT_EQ(read_track->Color(), track->Color());
+    EXPECT_EQ(read_track->NumViews(),
+              NumEstimatedViews(reconstruction, *track));
+  }
+  EXPECT_EQ(read_reconstruction.NumTracks(), num_written_tracks);
+}
+
+TEST(CompactReconstruction, WriteAndReadReconstruction) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  ASSERT_TRUE(
+      WriteCompactReconstruction(reconstruction, kCompactReconstructionFile));
+  EXPECT_TRUE(IsCompactReconstructionFile(kCompactReconstructionFile));
+
+  Reconstruction read_reconstruction;
+  ASSERT_TRUE(ReadCompactReconstruction(kCompactReconstructionFile,
+                                        &read_reconstruction));
+  VerifyReconstruction(reconstruction, read_reconstruction);
+
+  // ReadReconstruction detects the compact format as well.
+  Reconstruction read_reconstruction2;
+  ASSERT_TRUE(
+      ReadReconstruction(kCompactReconstructionFile, &read_reconstruction2));
+  VerifyReconstruction(reconstruction, read_reconstruction2);
+  std::remove(kCompactReconstructionFile.c_str());
+}
+
+TEST(CompactReconstruction, MappedColumnsMatchReconstruction) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  ASSERT_TRUE(
+      WriteCompactReconstruction(reconstruction, kCompactReconstructionFile));
+
+  MappedCompactReconstruction mapped_reconstruction;
+  ASSERT_TRUE(mapped_reconstruction.Open(kCompactReconstructionFile));
+  EXPECT_EQ(mapped_reconstruction.NumViews(), 3);
+
+  uint64_t num_observations = 0;
+  for (int i = 0; i < mapped_reconstruction.NumTracks(); i++) {
+    EXPECT_EQ(mapped_reconstruction.TrackLength(i),
+              mapped_reconstruction.ObservationsEnd(i) -
+                  mapped_reconstruction.ObservationsBegin(i));
+    EXPECT_GE(mapped_reconstruction.TrackLength(i), 2);
+    num_observations += mapped_reconstruction.TrackLength(i);
+
+    // Every observation must reproject to the stored feature of its view.
+    for (uint64_t j = mapped_reconstruction.ObservationsBegin(i);
+         j < mapped_reconstruction.ObservationsEnd(i); j++) {
+      const View* view = reconstruction.View(reconstruction.ViewIdFromName(
+          mapped_reconstruction.ViewName(
+              mapped_reconstruction.ObservationView(j))));
+      bool found_feature = false;
+      for (const TrackId track_id : view->TrackIds()) {
+        if (reconstruction.Track(track_id)->Point() ==
+            mapped_reconstruction.Point(i)) {
+          EXPECT_EQ(*view->GetFeature(track_id),
+                    mapped_reconstruction.ObservationFeature(j));
+          found_feature = true;
+        }
+      }
+      EXPECT_TRUE(found_feature);
+    }
+  }
+  EXPECT_EQ(mapped_reconstruction.NumObservations(), num_observations);
+
+  // Extracting only the views leaves out the tracks.
+  Reconstruction cameras_only;
+  mapped_reconstruction.ExtractReconstruction(false, &cameras_only);
+  EXPECT_EQ(cameras_only.NumViews(), 3);
+  EXPECT_EQ(cameras_only.NumTracks(), 0);
+  std::remove(kCompactReconstructionFile.c_str());
+}
+
+TEST(CompactReconstruction, RejectsOtherFiles) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  ASSERT_TRUE(WriteReconstruction(reconstruction, kCompactReconstructionFile));
+  EXPECT_FALSE(IsCompactReconstructionFile(kCompactReconstructionFile));
+  MappedCompactReconstruction mapped_reconstruction;
+  EXPECT_FALSE(mapped_reconstruction.Open(kCompactReconstructionFile));
+  std::remove(kCompactReconstructionFile.c_str());
+}
+
+TEST(CompactReconstruction, RejectsTruncatedFiles) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  ASSERT_TRUE(
+      WriteCompactReconstruction(reconstruction, kCompactReconstructionFile));
+
+  std::string contents;
+  {
+    std::ifstream input(kCompactReconstructionFile, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(input),
+                    std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream output(kCompactReconstructionFile, std::ios::binary);
+    output.write(contents.data(), contents.size() / 2);
+  }
+  MappedCompactReconstruction mapped_reconstruction;
+  EXPECT_FALSE(mapped_reconstruction.Open(kCompactReconstructionFile));
+  std::remove(kCompactReconstructionFile.c_str());
+}
+
+// The byte offsets of the fields of the file header.
+static const int kNumViewsOffset = 16;
+static const int kNumObservationsOffset = 32;
+static const int kSectionOffsetsOffset = 40;
+
+// The sections of the file in the order of the section offsets of the header.
+enum Section {
+  VIEW_METADATA = 0,
+  VIEW_INTRINSICS_TYPES = 3,
+  VIEW_INTRINSICS_OFFSETS = 5,
+  OBSERVATION_OFFSETS = 9,
+  OBSERVATION_VIEWS = 10
+};
+
+template <typename T>
+T GetValue(const std::string& contents, const uint64_t offset) {
+  T value;
+  std::memcpy(&value, contents.data() + offset, sizeof(value));
+  return value;
+}
+
+template <typename T>
+void SetValue(const T value, const uint64_t offset, std::string* contents) {
+  std::memcpy(&(*contents)[offset], &value, sizeof(value));
+}
+
+uint64_t SectionOffset(const std::string& contents, const Section section) {
+  return GetValue<uint64_t>(contents,
+                            kSectionOffsetsOffset + sizeof(uint64_t) * section);
+}
+
+// Writes a compact reconstruction, corrupts its contents and returns whether
+// the corrupted file can be opened.
+bool OpenCorruptedFile(const std::function<void(std::string*)>& corrupt) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  CHECK(WriteCompactReconstruction(reconstruction, kCompactReconstructionFile));
+
+  std::string contents;
+  {
+    std::ifstream input(kCompactReconstructionFile, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(input),
+                    std::istreambuf_iterator<char>());
+  }
+  corrupt(&contents);
+  {
+    std::ofstream output(kCompactReconstructionFile, std::ios::binary);
+    output.write(contents.data(), contents.size());
+  }
+  MappedCompactReconstruction mapped_reconstruction;
+  const bool opened = mapped_reconstruction.Open(kCompactReconstructionFile);
+  std::remove(kCompactReconstructionFile.c_str());
+  return opened;
+}
+
+TEST(CompactReconstruction, RejectsCorruptedColumns) {
+  // The unmodified file is valid.
+  EXPECT_TRUE(OpenCorruptedFile([](std::string* contents) {}));
+
+  // An observation of a view that is not in the file.
+  EXPECT_FALSE(OpenCorruptedFile([](std::string* contents) {
+    const uint32_t num_views =
+        GetValue<uint64_t>(*contents, kNumViewsOffset);
+    SetValue(num_views,
+             SectionOffset(*contents, OBSERVATION_VIEWS),
+             contents);
+  }));
+
+  // Decreasing observation offsets.
+  EXPECT_FALSE(OpenCorruptedFile([](std::string* contents) {
+    const uint64_t num_observations =
+        GetValue<uint64_t>(*contents, kNumObservationsOffset);
+    SetValue(num_observations,
+             SectionOffset(*contents, OBSERVATION_OFFSETS) + sizeof(uint64_t),
+             contents);
+  }));
+
+  // Decreasing intrinsics offsets.
+  EXPECT_FALSE(OpenCorruptedFile([](std::string* contents) {
+    SetValue(uint64_t(1000),
+             SectionOffset(*contents, VIEW_INTRINSICS_OFFSETS) +
+                 sizeof(uint64_t),
+             contents);
+  }));
+
+  // An unknown camera intrinsics model.
+  EXPECT_FALSE(OpenCorruptedFile([](std::string* contents) {
+    SetValue(int32_t(100),
+             SectionOffset(*contents, VIEW_INTRINSICS_TYPES),
+             contents);
+  }));
+
+  // A camera intrinsics model with a different number of parameters than the
+  // intrinsics of the view.
+  EXPECT_FALSE(OpenCorruptedFile([](std::string* contents) {
+    SetValue(static_cast<int32_t>(
+                 CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL),
+             SectionOffset(*contents, VIEW_INTRINSICS_TYPES),
+             contents);
+  }));
+
+  // View metadata that cannot be decoded.
+  EXPECT_FALSE(OpenCorruptedFile([](std::string* contents) {
+    std::fill(contents->begin() + SectionOffset(*contents, VIEW_METADATA),
+              contents->begin() + SectionOffset(*contents, VIEW_METADATA) + 8,
+              static_cast<char>(0xff));
+  }));
+}
+
+}  // namespace
+}  // namespace theia
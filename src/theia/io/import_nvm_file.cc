@@ -34,17 +34,24 @@
 
 #include <Eigen/Core>
 #include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <future>  // NOLINT
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "theia/io/import_nvm_file.h"
+#include "theia/io/text_tokenizer.h"
 #include "theia/sfm/camera/camera.h"
 #include "theia/sfm/reconstruction.h"
 #include "theia/sfm/track.h"
 #include "theia/sfm/view.h"
 #include "theia/util/filesystem.h"
 #include "theia/util/map_util.h"
+#include "theia/util/mapped_file.h"
+#include "theia/util/threadpool.h"
 
 #include "visual_sfm/util.h"
 #include "visual_sfm/DataInterface.h"
@@ -61,38 +68,163 @@ struct VSFMReconstruction {
   std::vector<string> view_names;
   std::vector<int> point_colors;
 };
-}  // namespace
 
-bool ImportNVMFile(const std::string& nvm_filepath,
-                   Reconstruction* reconstruction) {
-  CHECK_GT(nvm_filepath.length(), 0);
-  CHECK_NOTNULL(reconstruction);
+// A 3D point of the NVM file along with its observations.
+struct NVMPoint {
+  Eigen::Vector3f position;
+  Eigen::Vector3i color;
+  std::vector<std::pair<ViewId, Feature> > features;
+};
 
-  // Read VSFM file.
-  VSFMReconstruction vsfm_reconstruction;
-  CHECK(LoadModelFile(nvm_filepath.c_str(),
-                      vsfm_reconstruction.camera_data,
-                      vsfm_reconstruction.point_data,
-                      vsfm_reconstruction.measurements,
-                      vsfm_reconstruction.point_index,
-                      vsfm_reconstruction.camera_index,
-                      vsfm_reconstruction.view_names,
-                      vsfm_reconstruction.point_colors));
+// Parses the cameras of an NVM file with the same conventions as VisualSfM's
+// LoadNVM.
+bool ReadNVMCameras(TextTokenizer* in,
+                    std::vector<CameraT>* camera_data,
+                    std::vector<std::string>* view_names) {
+  int rotation_parameter_num = 4;
+  bool format_r9t = false;
+  std::string token;
+  if (!in->AtEnd() && *in->position() == 'N') {
+    in->ReadToken(&token);  // file header
+    if (strstr(token.c_str(), "R9T")) {
+      rotation_parameter_num = 9;  // rotation as 3x3 matrix
+      format_r9t = true;
+    }
+    in->SkipLine();
+  }
 
-  // Check the NVM reconstruction for sanity.
-  CHECK_EQ(vsfm_reconstruction.view_names.size(),
-           vsfm_reconstruction.camera_data.size());
-  CHECK_EQ(vsfm_reconstruction.measurements.size(),
-           vsfm_reconstruction.point_index.size());
-  CHECK_EQ(vsfm_reconstruction.point_index.size(),
-           vsfm_reconstruction.camera_index.size());
+  // Read # of cameras.
+  int ncam = 0;
+  if (!in->Read(&ncam) || ncam <= 1) {
+    return false;
+  }
 
-  // Add all cameras to the reconstruction.
-  for (int i = 0; i < vsfm_reconstruction.camera_data.size(); i++) {
+  camera_data->resize(ncam);
+  view_names->resize(ncam);
+  for (int i = 0; i < ncam; ++i) {
+    double f, q[9], c[3], d[2];
+    if (!in->ReadToken(&(*view_names)[i]) || !in->Read(&f)) {
+      return false;
+    }
+    for (int j = 0; j < rotation_parameter_num; ++j) {
+      if (!in->Read(&q[j])) {
+        return false;
+      }
+    }
+    if (!in->Read(&c[0]) || !in->Read(&c[1]) || !in->Read(&c[2]) ||
+        !in->Read(&d[0]) || !in->Read(&d[1])) {
+      return false;
+    }
+
+    CameraT& camera = (*camera_data)[i];
+    camera.SetFocalLength(f);
+    if (format_r9t) {
+      camera.SetMatrixRotation(q);
+      camera.SetTranslation(c);
+    } else {
+      // Older format for compatibility.
+      camera.SetQuaternionRotation(q);
+      camera.SetCameraCenterAfterRotation(c);
+    }
+    camera.SetNormalizedMeasurementDistortion(d[0]);
+  }
+  return true;
+}
+
+// Parses the points [first_point, first_point + num_points) from the text.
+bool ReadNVMPointRange(const TextRange& text,
+                       const int first_point,
+                       const int num_points,
+                       std::vector<NVMPoint>* points) {
+  TextTokenizer in(text);
+  for (int i = first_point; i < first_point + num_points; ++i) {
+    NVMPoint& point = (*points)[i];
+    int num_projections;
+    if (!in.Read(&point.position[0]) || !in.Read(&point.position[1]) ||
+        !in.Read(&point.position[2]) || !in.Read(&point.color[0]) ||
+        !in.Read(&point.color[1]) || !in.Read(&point.color[2]) ||
+        !in.Read(&num_projections)) {
+      LOG(ERROR) << "Invalid NVM point " << i;
+      return false;
+    }
+
+    point.features.reserve(num_projections);
+    for (int j = 0; j < num_projections; ++j) {
+      int camera_index, feature_index;
+      float x, y;
+      if (!in.Read(&camera_index) || !in.Read(&feature_index) ||
+          !in.Read(&x) || !in.Read(&y)) {
+        LOG(ERROR) << "Invalid projection " << j << " of NVM point " << i;
+        return false;
+      }
+      point.features.emplace_back(camera_index, Feature(x, y));
+    }
+  }
+  return true;
+}
+
+// Parses the points. Each point is written on a single line, so the points are
+// split at line boundaries and parsed with num_threads threads.
+bool ReadNVMPoints(TextTokenizer* in,
+                   const char* end,
+                   const int num_threads,
+                   std::vector<NVMPoint>* points) {
+  int npoint = 0;
+  if (!in->Read(&npoint) || npoint <= 0) {
+    return false;
+  }
+  in->SkipLine();
+
+  points->resize(npoint);
+  std::vector<TextRange> chunks;
+  const char* points_end;
+  if (!SplitRecordsIntoChunks(TextRange(in->position(), end),
+                              npoint,
+                              1,
+                              num_threads,
+                              &chunks,
+                              &points_end)) {
+    LOG(ERROR) << "The NVM file contains fewer than " << npoint << " points.";
+    return false;
+  }
+
+  const int points_per_chunk = RecordsPerChunk(npoint, num_threads);
+  if (num_threads <= 1 || chunks.size() <= 1) {
+    return ReadNVMPointRange(TextRange(chunks.front().begin, points_end),
+                             0,
+                             npoint,
+                             points);
+  }
+
+  std::vector<std::future<bool> > chunk_status;
+  chunk_status.reserve(chunks.size());
+  {
+    ThreadPool pool(std::min(num_threads, static_cast<int>(chunks.size())));
+    for (int i = 0; i < chunks.size(); ++i) {
+      const int first_point = i * points_per_chunk;
+      chunk_status.emplace_back(
+          pool.Add(ReadNVMPointRange,
+                   chunks[i],
+                   first_point,
+                   std::min(points_per_chunk, npoint - first_point),
+                   points));
+    }
+  }
+
+  bool success = true;
+  for (auto& status : chunk_status) {
+    success = status.get() && success;
+  }
+  return success;
+}
+
+// Adds the cameras as estimated views of the reconstruction.
+void AddNVMCamerasToReconstruction(const std::vector<CameraT>& camera_data,
+                                   const std::vector<std::string>& view_names,
+                                   Reconstruction* reconstruction) {
+  for (int i = 0; i < camera_data.size(); i++) {
     std::string view_name;
-    GetFilenameFromFilepath(vsfm_reconstruction.view_names[i],
-                                   true,
-                                   &view_name);
+    GetFilenameFromFilepath(view_names[i], true, &view_name);
     // Add the view to the reconstruction.
     LOG(INFO) << "Adding view " << view_name << " to the reconstruction.";
     const ViewId view_id = reconstruction->AddView(view_name);
@@ -101,7 +233,7 @@ bool ImportNVMFile(const std::string& nvm_filepath,
     view->SetEstimated(true);
 
     // Set the camera intrinsic parameters.
-    const CameraT& vsfm_camera = vsfm_reconstruction.camera_data[i];
+    const CameraT& vsfm_camera = camera_data[i];
     Camera* camera = view->MutableCamera();
     camera->SetCameraIntrinsicsModelType(CameraIntrinsicsModelType::PINHOLE);
     camera->SetFocalLength(vsfm_camera.GetFocalLength());
@@ -116,6 +248,34 @@ bool ImportNVMFile(const std::string& nvm_filepath,
     vsfm_camera.GetCameraCenter(position.data());
     camera->SetPosition(position.cast<double>());
   }
+}
+
+// Reads Bundler models and other formats supported by VisualSfM.
+bool ImportVSFMModelFile(const std::string& model_filepath,
+                         Reconstruction* reconstruction) {
+  // Read VSFM file.
+  VSFMReconstruction vsfm_reconstruction;
+  CHECK(LoadModelFile(model_filepath.c_str(),
+                      vsfm_reconstruction.camera_data,
+                      vsfm_reconstruction.point_data,
+                      vsfm_reconstruction.measurements,
+                      vsfm_reconstruction.point_index,
+                      vsfm_reconstruction.camera_index,
+                      vsfm_reconstruction.view_names,
+                      vsfm_reconstruction.point_colors));
+
+  // Check the NVM reconstruction for sanity.
+  CHECK_EQ(vsfm_reconstruction.view_names.size(),
+           vsfm_reconstruction.camera_data.size());
+  CHECK_EQ(vsfm_reconstruction.measurements.size(),
+           vsfm_reconstruction.point_index.size());
+  CHECK_EQ(vsfm_reconstruction.point_index.size(),
+           vsfm_reconstruction.camera_index.size());
+
+  // Add all cameras to the reconstruction.
+  AddNVMCamerasToReconstruction(vsfm_reconstruction.camera_data,
+                                vsfm_reconstruction.view_names,
+                                reconstruction);
 
   // Create the track correspondences.
   std::unordered_map<int, std::vector<std::pair<ViewId, Feature>>>
@@ -148,4 +308,52 @@ bool ImportNVMFile(const std::string& nvm_filepath,
   return true;
 }
 
+}  // namespace
+
+bool ImportNVMFile(const std::string& nvm_filepath,
+                   Reconstruction* reconstruction) {
+  return ImportNVMFile(nvm_filepath, 1, reconstruction);
+}
+
+bool ImportNVMFile(const std::string& nvm_filepath,
+                   const int num_threads,
+                   Reconstruction* reconstruction) {
+  CHECK_GT(nvm_filepath.length(), 0);
+  CHECK_NOTNULL(reconstruction);
+
+  // Other model formats are still loaded through VisualSfM.
+  if (nvm_filepath.find(".nvm") == std::string::npos) {
+    return ImportVSFMModelFile(nvm_filepath, reconstruction);
+  }
+
+  MappedFile file;
+  CHECK(file.Open(nvm_filepath)) << "Could not open " << nvm_filepath;
+  const char* end = file.data() + file.size();
+  TextTokenizer in(file.data(), end);
+
+  std::vector<CameraT> camera_data;
+  std::vector<std::string> view_names;
+  CHECK(ReadNVMCameras(&in, &camera_data, &view_names))
+      << "Could not read the cameras of " << nvm_filepath;
+  std::vector<NVMPoint> points;
+  CHECK(ReadNVMPoints(&in, end, std::max(num_threads, 1), &points))
+      << "Could not read the points of " << nvm_filepath;
+
+  // Add all cameras to the reconstruction.
+  AddNVMCamerasToReconstruction(camera_data, view_names, reconstruction);
+
+  // Add all tracks to the reconstruction and set the 3d position.
+  for (const NVMPoint& point : points) {
+    const TrackId track_id = reconstruction->AddTrack(point.features);
+    CHECK_NE(track_id, kInvalidTrackId);
+    Track* track = reconstruction->MutableTrack(track_id);
+    track->SetEstimated(true);
+    *track->MutablePoint() =
+        point.position.cast<double>().homogeneous();
+    *track->MutableColor() = point.color.cast<uint8_t>();
+  }
+
+  return true;
+}
+
 }  // namespace theia
@@ -48,6 +48,12 @@ class Reconstruction;
 bool ImportNVMFile(const std::string& nvm_filepath,
                    Reconstruction* reconstruction);
 
+// Same as above, but the points of the NVM file are parsed with num_threads
+// threads.
+bool ImportNVMFile(const std::string& nvm_filepath,
+                   const int num_threads,
+                   Reconstruction* reconstruction);
+
 }  // namespace theia
 
 #endif  // THEIA_IO_IMPORT_NVM_FILE_H_
@@ -0,0 +1,199 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/io/import_nvm_file.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/view.h"
+#include "theia/util/map_util.h"
+
+namespace theia {
+namespace {
+
+static const std::string kNVMFile =
+    THEIA_DATA_DIR + std::string("/io/nvm_test.nvm");
+static const std::string kNVMR9TFile =
+    THEIA_DATA_DIR + std::string("/io/nvm_r9t_test.nvm");
+
+// The points are split into one chunk per thread, so these thread counts put
+// the chunk boundaries at different points of the fixtures.
+static const int kNumThreads[] = {1, 2, 3, 8};
+
+static const double kTolerance = 1e-6;
+
+// Expects the views and tracks of both reconstructions to be identical. The
+// track ids are assigned in the order of the points in the file.
+void ExpectEqualReconstructions(const Reconstruction& expected,
+                                const Reconstruction& actual) {
+  ASSERT_EQ(expected.NumViews(), actual.NumViews());
+  ASSERT_EQ(expected.NumTracks(), actual.NumTracks());
+  for (const ViewId view_id : expected.ViewIds()) {
+    const View* expected_view = expected.View(view_id);
+    const View* view = actual.View(view_id);
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(view->Name(), expected_view->Name());
+    EXPECT_EQ(view->Camera().FocalLength(),
+              expected_view->Camera().FocalLength());
+    EXPECT_EQ(view->Camera().GetPosition(),
+              expected_view->Camera().GetPosition());
+    EXPECT_EQ(view->Camera().GetOrientationAsAngleAxis(),
+              expected_view->Camera().GetOrientationAsAngleAxis());
+  }
+
+  for (const TrackId track_id : expected.TrackIds()) {
+    const Track* expected_track = expected.Track(track_id);
+    const Track* track = actual.Track(track_id);
+    ASSERT_NE(track, nullptr);
+    EXPECT_EQ(track->Point(), expected_track->Point());
+    EXPECT_EQ(track->Color(), expected_track->Color());
+    EXPECT_EQ(track->ViewIds(), expected_track->ViewIds());
+    for (const ViewId view_id : expected_track->ViewIds()) {
+      EXPECT_EQ(*actual.View(view_id)->GetFeature(track_id),
+                *expected.View(view_id)->GetFeature(track_id));
+    }
+  }
+}
+
+// Expects the tracks to have the given points, colors and number of views.
+void ExpectTracks(const std::vector<Eigen::Vector3d>& points,
+                  const std::vector<Eigen::Vector3i>& colors,
+                  const std::vector<int>& num_views,
+                  const Reconstruction& reconstruction) {
+  ASSERT_EQ(reconstruction.NumTracks(), points.size());
+  for (int i = 0; i < points.size(); i++) {
+    const Track* track = reconstruction.Track(i);
+    ASSERT_NE(track, nullptr);
+    EXPECT_TRUE(track->IsEstimated());
+    EXPECT_LT((track->Point() - points[i].homogeneous()).norm(), kTolerance);
+    EXPECT_EQ(track->Color().cast<int>(), colors[i]);
+    EXPECT_EQ(track->NumViews(), num_views[i]);
+  }
+}
+
+void ExpectView(const Reconstruction& reconstruction,
+                const std::string& name,
+                const double focal_length,
+                const Eigen::Vector3d& position,
+                const Eigen::Vector3d& orientation) {
+  const View* view =
+      reconstruction.View(reconstruction.ViewIdFromName(name));
+  ASSERT_NE(view, nullptr);
+  EXPECT_TRUE(view->IsEstimated());
+  EXPECT_NEAR(view->Camera().FocalLength(), focal_length, kTolerance);
+  EXPECT_LT((view->Camera().GetPosition() - position).norm(), kTolerance);
+  EXPECT_LT((view->Camera().GetOrientationAsAngleAxis() - orientation).norm(),
+            kTolerance);
+}
+
+// The expected values are the results of VisualSfM's LoadNVM, which the file
+// was parsed with before.
+TEST(ImportNVMFile, QuaternionFormat) {
+  Reconstruction single_threaded;
+  ASSERT_TRUE(ImportNVMFile(kNVMFile, 1, &single_threaded));
+
+  // The rotations are 90 degrees about the z axis and 120 degrees about the
+  // (1, 1, 1) axis.
+  const double kAngle = 2.0 * M_PI / 3.0 / std::sqrt(3.0);
+  ASSERT_EQ(single_threaded.NumViews(), 3);
+  ExpectView(single_threaded, "img0.jpg", 500.0, Eigen::Vector3d::Zero(),
+             Eigen::Vector3d::Zero());
+  ExpectView(single_threaded, "img1.jpg", 510.0, Eigen::Vector3d(1, 2, 3),
+             Eigen::Vector3d(0, 0, M_PI / 2.0));
+  ExpectView(single_threaded, "img2.jpg", 520.0, Eigen::Vector3d(-1, 0.5, 2),
+             Eigen::Vector3d(kAngle, kAngle, kAngle));
+
+  const std::vector<Eigen::Vector3d> points = {
+      Eigen::Vector3d(0.5, 1.5, 10),   Eigen::Vector3d(-1, 0.25, 8.5),
+      Eigen::Vector3d(2, -3, 12),      Eigen::Vector3d(0, 0, 9),
+      Eigen::Vector3d(1.25, -0.5, 11), Eigen::Vector3d(-2.5, 3.5, 7),
+      Eigen::Vector3d(3, 3, 15)};
+  const std::vector<Eigen::Vector3i> colors = {
+      Eigen::Vector3i(255, 0, 0),    Eigen::Vector3i(0, 255, 0),
+      Eigen::Vector3i(1, 2, 3),      Eigen::Vector3i(10, 20, 30),
+      Eigen::Vector3i(40, 50, 60),   Eigen::Vector3i(70, 80, 90),
+      Eigen::Vector3i(100, 110, 120)};
+  ExpectTracks(points, colors, {2, 3, 2, 2, 3, 2, 2}, single_threaded);
+
+  // Features in scientific notation.
+  const Feature* feature =
+      single_threaded.View(single_threaded.ViewIdFromName("img2.jpg"))
+          ->GetFeature(1);
+  ASSERT_NE(feature, nullptr);
+  EXPECT_NEAR((*feature)[0], 1e-3, kTolerance);
+  EXPECT_NEAR((*feature)[1], -15.0, kTolerance);
+
+  for (const int num_threads : kNumThreads) {
+    Reconstruction reconstruction;
+    ASSERT_TRUE(ImportNVMFile(kNVMFile, num_threads, &reconstruction));
+    ExpectEqualReconstructions(single_threaded, reconstruction);
+  }
+}
+
+TEST(ImportNVMFile, RotationMatrixFormat) {
+  Reconstruction single_threaded;
+  ASSERT_TRUE(ImportNVMFile(kNVMR9TFile, 1, &single_threaded));
+
+  // The R9T format stores the rotation and translation, so the position is
+  // -R^t * t.
+  ASSERT_EQ(single_threaded.NumViews(), 2);
+  ExpectView(single_threaded, "a.jpg", 400.0, Eigen::Vector3d(-0.5, 0.5, -1),
+             Eigen::Vector3d::Zero());
+  ExpectView(single_threaded, "b.jpg", 410.0, Eigen::Vector3d(-2, -1, -0.5),
+             Eigen::Vector3d(0, 0, M_PI / 2.0));
+
+  const std::vector<Eigen::Vector3d> points = {
+      Eigen::Vector3d(0.5, 1.5, 10), Eigen::Vector3d(-1, 0.25, 8.5),
+      Eigen::Vector3d(2, -3, 12),    Eigen::Vector3d(0, 0, 9),
+      Eigen::Vector3d(1.25, -0.5, 11)};
+  const std::vector<Eigen::Vector3i> colors = {
+      Eigen::Vector3i(255, 0, 0), Eigen::Vector3i(0, 255, 0),
+      Eigen::Vector3i(1, 2, 3),   Eigen::Vector3i(10, 20, 30),
+      Eigen::Vector3i(40, 50, 60)};
+  ExpectTracks(points, colors, {2, 2, 2, 2, 2}, single_threaded);
+
+  for (const int num_threads : kNumThreads) {
+    Reconstruction reconstruction;
+    ASSERT_TRUE(ImportNVMFile(kNVMR9TFile, num_threads, &reconstruction));
+    ExpectEqualReconstructions(single_threaded, reconstruction);
+  }
+}
+
+}  // namespace
+}  // namespace theia
@@ -40,13 +40,15 @@
 #include <glog/logging.h>
 
 #include <algorithm>
-#include <fstream>  // NOLINT
+#include <cstdio>
+#include <future>  // NOLINT
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "theia/io/text_tokenizer.h"
 #include "theia/sfm/find_common_tracks_in_views.h"
 #include "theia/sfm/reconstruction.h"
 #include "theia/sfm/track.h"
@@ -55,15 +57,84 @@
 #include "theia/sfm/view_graph/view_graph.h"
 #include "theia/util/filesystem.h"
 #include "theia/util/map_util.h"
+#include "theia/util/mapped_file.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 
+namespace {
+
+// The feature coordinates and colors of one image in the coords file.
+struct CoordsBlock {
+  ViewId view_id;
+  float principal_point_x;
+  float principal_point_y;
+  std::vector<Feature> features;
+  std::vector<Eigen::Matrix<uint8_t, 3, 1> > colors;
+};
+
+// One line of the EGs file.
+struct EGRecord {
+  ViewId view_id1;
+  ViewId view_id2;
+  TwoViewInfo info;
+};
+
+bool OpenDatasetFile(const std::string& filename,
+                     const std::string& description,
+                     MappedFile* file) {
+  if (!file->Open(filename)) {
+    LOG(ERROR) << "Cannot read the " << description << " file from "
+               << filename;
+    return false;
+  }
+  return true;
+}
+
+// Runs parse_chunk on each chunk, in parallel if more than one thread is
+// requested, and returns the results in the order of the chunks.
+template <typename Result, typename ParseChunk>
+bool ParseChunksInParallel(const std::vector<TextRange>& chunks,
+                           const int num_threads,
+                           const ParseChunk& parse_chunk,
+                           std::vector<Result>* results) {
+  results->resize(chunks.size());
+  if (num_threads <= 1 || chunks.size() <= 1) {
+    for (int i = 0; i < chunks.size(); i++) {
+      if (!parse_chunk(chunks[i], &(*results)[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<std::future<bool> > chunk_status;
+  chunk_status.reserve(chunks.size());
+  {
+    ThreadPool pool(std::min(num_threads, static_cast<int>(chunks.size())));
+    for (int i = 0; i < chunks.size(); i++) {
+      chunk_status.emplace_back(
+          pool.Add(parse_chunk, chunks[i], &(*results)[i]));
+    }
+  }
+
+  bool success = true;
+  for (auto& status : chunk_status) {
+    success = status.get() && success;
+  }
+  return success;
+}
+
+}  // namespace
+
 class Input1DSFM {
  public:
   Input1DSFM(const std::string& dataset_directory,
+             const int num_threads,
              Reconstruction* reconstruction,
              ViewGraph* view_graph)
       : dataset_directory_(dataset_directory),
+        num_threads_(std::max(num_threads, 1)),
         reconstruction_(reconstruction),
         view_graph_(view_graph) {}
 
@@ -74,11 +145,13 @@ class Input1DSFM {
   bool ReadEGs();
 
  private:
-  bool ReadCoordsHeaderLine(const std::string& line,
-                            ViewId* image_index,
-                            int* num_keys);
+  bool ReadCoordsChunk(const TextRange& chunk,
+                       std::vector<CoordsBlock>* blocks) const;
+  bool ReadEGsChunk(const TextRange& chunk,
+                    std::vector<EGRecord>* records) const;
 
   const std::string& dataset_directory_;
+  const int num_threads_;
   Reconstruction* reconstruction_;
   ViewGraph* view_graph_;
 
@@ -91,17 +164,18 @@ class Input1DSFM {
 
 // Reads the connected components file.
 bool Input1DSFM::ReadCC(std::unordered_set<int>* valid_image_index) {
-  const std::string cc_filename = dataset_directory_ + "/cc.txt";
-
-  std::ifstream ifs(cc_filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    LOG(ERROR) << "Cannot read the cc file from " << cc_filename;
+  MappedFile file;
+  if (!OpenDatasetFile(dataset_directory_ + "/cc.txt", "cc", &file)) {
     return false;
   }
 
-  while (!ifs.eof()) {
+  TextTokenizer tokenizer(file.data(), file.data() + file.size());
+  while (!tokenizer.AtEnd()) {
     int img_index;
-    ifs >> img_index;
+    if (!tokenizer.Read(&img_index)) {
+      LOG(ERROR) << "Invalid image index in the cc file.";
+      return false;
+    }
     valid_image_index->insert(img_index);
   }
 
@@ -112,33 +186,28 @@ bool Input1DSFM::ReadCC(std::unordered_set<int>* valid_image_index) {
 // from the coords file.
 bool Input1DSFM::ReadListsFile(
     const std::unordered_set<int>& valid_image_index) {
-  const std::string list_filename = dataset_directory_ + "/list.txt";
-  std::ifstream ifs(list_filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    LOG(ERROR) << "Cannot read the list file from " << list_filename;
+  MappedFile file;
+  if (!OpenDatasetFile(dataset_directory_ + "/list.txt", "list", &file)) {
     return false;
   }
 
-  const char space = static_cast<char>(' ');
-  while (!ifs.eof()) {
-    // Read in the filename.
-    std::string filename, truncated_filename;
-
-    ifs >> filename;
-    if (filename.length() == 0) {
-      break;
-    }
+  TextTokenizer tokenizer(file.data(), file.data() + file.size());
+  std::string filename, truncated_filename;
+  while (tokenizer.ReadToken(&filename)) {
     CHECK(theia::GetFilenameFromFilepath(filename, true, &truncated_filename));
     const ViewId view_id = reconstruction_->AddView(truncated_filename);
     CHECK_NE(view_id, kInvalidViewId);
 
     // Check to see if the exif focal length is given.
     double focal_length = 0;
-    if (ifs.peek() == space) {
+    if (tokenizer.HasTokenOnLine()) {
       int temp;
-      ifs >> temp;
-      ifs >> focal_length;
+      if (!tokenizer.Read(&temp) || !tokenizer.Read(&focal_length)) {
+        LOG(ERROR) << "Invalid focal length for image " << filename;
+        return false;
+      }
     }
+    tokenizer.SkipLine();
 
     // If the view is not in the connected component remove it. Adding it first
     // then removing it allows for our ViewIds to stay in sync with the index of
@@ -166,82 +235,102 @@ bool Input1DSFM::ReadListsFile(
   return true;
 }
 
-bool Input1DSFM::ReadCoordsHeaderLine(const std::string& line,
-                                      ViewId* view_id,
-                                      int* num_keys) {
-  float principal_point_x, principal_point_y, focal_length;
-  char name[256];
-  sscanf(line.c_str(),
-         "#index = %d, name = %s keys = %d, px = %f, py = %f, focal = %f",
-         view_id,
-         name,
-         num_keys,
-         &principal_point_x,
-         &principal_point_y,
-         &focal_length);
-
-  View* view = reconstruction_->MutableView(*view_id);
-  if (view == nullptr) {
-    return false;
-  }
+// Parses the images in a chunk of the coords file. Each chunk starts at a
+// header line so that chunks can be parsed independently. The reconstruction is
+// only read here; the results are added to it by ReadCoords.
+bool Input1DSFM::ReadCoordsChunk(const TextRange& chunk,
+                                 std::vector<CoordsBlock>* blocks) const {
+  TextTokenizer tokenizer(chunk);
+  std::string line;
+  while (!tokenizer.AtEnd()) {
+    tokenizer.ReadLine(&line);
+
+    CoordsBlock block;
+    int num_keys = 0;
+    float focal_length;
+    char name[256];
+    if (sscanf(line.c_str(),
+               "#index = %d, name = %255s keys = %d, px = %f, py = %f, "
+               "focal = %f",
+               &block.view_id,
+               name,
+               &num_keys,
+               &block.principal_point_x,
+               &block.principal_point_y,
+               &focal_length) < 5) {
+      LOG(ERROR) << "Invalid coords header line: " << line;
+      return false;
+    }
+
+    // If the image is not in the connected component then do not read it.
+    if (reconstruction_->View(block.view_id) == nullptr) {
+      for (int i = 0; i < num_keys; i++) {
+        tokenizer.SkipLine();
+      }
+      continue;
+    }
 
-  // Set the metadata.
-  CameraIntrinsicsPrior* prior = view->MutableCameraIntrinsicsPrior();
-  prior->image_width = principal_point_x * 2.0;
-  prior->image_height = principal_point_y * 2.0;
-  prior->principal_point.is_set = true;
-  prior->principal_point.value[0] = principal_point_x;
-  prior->principal_point.value[1] = principal_point_y;
+    block.features.reserve(num_keys);
+    block.colors.reserve(num_keys);
+    Eigen::Vector2d keypoint;
+    Eigen::Vector3i color;
+    for (int i = 0; i < num_keys; i++) {
+      // Each line is "index x y 0 0 r g b".
+      int index;
+      double unused;
+      if (!tokenizer.Read(&index) || !tokenizer.Read(&keypoint[0]) ||
+          !tokenizer.Read(&keypoint[1]) || !tokenizer.Read(&unused) ||
+          !tokenizer.Read(&unused) || !tokenizer.Read(&color[0]) ||
+          !tokenizer.Read(&color[1]) || !tokenizer.Read(&color[2])) {
+        LOG(ERROR) << "Invalid feature " << i << " of image "
+                   << block.view_id << " in the coords file.";
+        return false;
+      }
+      tokenizer.SkipLine();
+      block.features.emplace_back(keypoint);
+      block.colors.emplace_back(color.cast<uint8_t>());
+    }
+    blocks->emplace_back(std::move(block));
+  }
   return true;
 }
 
 // Reads the coords file. Only the coords with a valid track in the connected
 // component are kept.
 bool Input1DSFM::ReadCoords() {
-  const std::string coords_filename = dataset_directory_ + "/coords.txt";
-  std::ifstream ifs(coords_filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    LOG(ERROR) << "Cannot read the coords file from " << coords_filename;
+  MappedFile file;
+  if (!OpenDatasetFile(dataset_directory_ + "/coords.txt", "coords", &file)) {
+    return false;
+  }
+
+  // Each image starts with a header line beginning with '#', so the file may
+  // be split at any header line.
+  const std::vector<TextRange> chunks = SplitTextIntoChunks(
+      TextRange(file.data(), file.data() + file.size()), num_threads_, '#');
+  std::vector<std::vector<CoordsBlock> > chunk_blocks;
+  const auto read_chunk = [this](const TextRange& chunk,
+                                 std::vector<CoordsBlock>* blocks) {
+    return ReadCoordsChunk(chunk, blocks);
+  };
+  if (!ParseChunksInParallel(chunks, num_threads_, read_chunk, &chunk_blocks)) {
     return false;
   }
 
   feature_coordinates_.reserve(reconstruction_->NumViews());
   feature_colors_.reserve(reconstruction_->NumViews());
-  while (!ifs.eof()) {
-    std::string line;
-    std::getline(ifs, line);
-    if (ifs.eof()) {
-      break;
-    }
-
-    int num_keys;
-    ViewId view_id;
-    // If the image is not in the connected component then do not read it.
-    if (!ReadCoordsHeaderLine(line, &view_id, &num_keys)) {
-      for (int i = 0; i < num_keys; i++) {
-        std::getline(ifs, line);
-      }
-      continue;
-    }
-
-    auto& features = feature_coordinates_[view_id];
-    features.reserve(num_keys);
-    auto& colors = feature_colors_[view_id];
-    colors.reserve(num_keys);
-
-    Eigen::Vector2d keypoint;
-    Eigen::Vector3i color;
-    for (int i = 0; i < num_keys; i++) {
-      std::getline(ifs, line);
-      sscanf(line.c_str(),
-             "%*d %lf %lf 0 0 %d %d %d",
-             &keypoint[0],
-             &keypoint[1],
-             &color[0],
-             &color[1],
-             &color[2]);
-      features.emplace_back(keypoint);
-      colors.emplace_back(color.cast<uint8_t>());
+  for (auto& blocks : chunk_blocks) {
+    for (CoordsBlock& block : blocks) {
+      // Set the metadata.
+      CameraIntrinsicsPrior* prior = reconstruction_->MutableView(block.view_id)
+                                         ->MutableCameraIntrinsicsPrior();
+      prior->image_width = block.principal_point_x * 2.0;
+      prior->image_height = block.principal_point_y * 2.0;
+      prior->principal_point.is_set = true;
+      prior->principal_point.value[0] = block.principal_point_x;
+      prior->principal_point.value[1] = block.principal_point_y;
+
+      feature_coordinates_[block.view_id] = std::move(block.features);
+      feature_colors_[block.view_id] = std::move(block.colors);
     }
   }
 
@@ -249,29 +338,38 @@ bool Input1DSFM::ReadCoords() {
 }
 
 bool Input1DSFM::ReadTracks() {
-  const std::string tracks_filename = dataset_directory_ + "/tracks.txt";
-  std::ifstream ifs(tracks_filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    LOG(ERROR) << "Cannot read the coords file from " << tracks_filename;
+  MappedFile file;
+  if (!OpenDatasetFile(dataset_directory_ + "/tracks.txt", "tracks", &file)) {
     return false;
   }
+  TextTokenizer tokenizer(file.data(), file.data() + file.size());
 
   // Read number of tracks.
   int num_tracks;
-  ifs >> num_tracks;
+  if (!tokenizer.Read(&num_tracks)) {
+    LOG(ERROR) << "Invalid number of tracks in the tracks file.";
+    return false;
+  }
 
+  std::vector<std::pair<ViewId, Feature> > track;
   for (int i = 0; i < num_tracks; i++) {
     int num_features;
-    ifs >> num_features;
+    if (!tokenizer.Read(&num_features)) {
+      LOG(ERROR) << "Invalid length of track " << i << " in the tracks file.";
+      return false;
+    }
 
-    std::vector<std::pair<ViewId, Feature> > track;
+    track.clear();
     track.reserve(num_features);
     int feature_id;
     ViewId view_id;
     Eigen::Vector3f color = Eigen::Vector3f::Zero();
     for (int j = 0; j < num_features; j++) {
-      ifs >> view_id;
-      ifs >> feature_id;
+      if (!tokenizer.Read(&view_id) || !tokenizer.Read(&feature_id)) {
+        LOG(ERROR) << "Invalid observation of track " << i
+                   << " in the tracks file.";
+        return false;
+      }
 
       // Aggregate the features that form this track.
       const auto& features = FindOrDie(feature_coordinates_, view_id);
@@ -295,22 +393,23 @@ bool Input1DSFM::ReadTracks() {
   return true;
 }
 
-// Reads the epipolar geometry files.
-bool Input1DSFM::ReadEGs() {
-  const std::string eg_filename = dataset_directory_ + "/EGs.txt";
-  std::ifstream ifs(eg_filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    LOG(ERROR) << "Cannot read the EG file from " << eg_filename;
-    return false;
-  }
-
+// Parses the two view geometries in a chunk of the EGs file. The reconstruction
+// is only read here so that chunks may be parsed concurrently; the edges are
+// added to the view graph by ReadEGs.
+bool Input1DSFM::ReadEGsChunk(const TextRange& chunk,
+                              std::vector<EGRecord>* records) const {
   const Eigen::Matrix3d bundler_to_theia =
       Eigen::Vector3d(1.0, -1.0, -1.0).asDiagonal();
-  while (!ifs.eof()) {
-    TwoViewInfo info;
-    ViewId view_id1, view_id2;
-    ifs >> view_id1;
-    ifs >> view_id2;
+
+  TextTokenizer tokenizer(chunk);
+  while (!tokenizer.AtEnd()) {
+    EGRecord record;
+    TwoViewInfo& info = record.info;
+    if (!tokenizer.Read(&record.view_id1) ||
+        !tokenizer.Read(&record.view_id2)) {
+      LOG(ERROR) << "Invalid view ids in the EGs file.";
+      return false;
+    }
 
     // The rotation defines the camera 2 to camera 1 transformation in row-major
     // order). We want a camera 1 to camera 2 transformation so we read in the
@@ -318,29 +417,40 @@ bool Input1DSFM::ReadEGs() {
     Eigen::Matrix3d rotation;
     for (int i = 0; i < 3; i++) {
       for (int j = 0; j < 3; j++) {
-        ifs >> rotation(i, j);
+        if (!tokenizer.Read(&rotation(i, j))) {
+          LOG(ERROR) << "Invalid rotation in the EGs file.";
+          return false;
+        }
+      }
+    }
+
+    // Read the position.
+    for (int i = 0; i < 3; i++) {
+      if (!tokenizer.Read(&info.position_2[i])) {
+        LOG(ERROR) << "Invalid position in the EGs file.";
+        return false;
       }
     }
 
+    // Only keep the matches between images of the connected component.
+    const View* view1 = reconstruction_->View(record.view_id1);
+    const View* view2 = reconstruction_->View(record.view_id2);
+    if (view1 == nullptr || view2 == nullptr) {
+      continue;
+    }
+
     rotation = bundler_to_theia * rotation.transpose() * bundler_to_theia;
 
     // Convert to angle axis.
     ceres::RotationMatrixToAngleAxis(rotation.data(), info.rotation_2.data());
 
-    // Assign the position.
-    ifs >> info.position_2[0];
-    ifs >> info.position_2[1];
-    ifs >> info.position_2[2];
-
     info.position_2 = bundler_to_theia * info.position_2;
 
     // Add the focal lengths. If they are known from EXIF, add that value
     // otherwise add a focal length guess correspdonding to a median viewing
     // angle.
-    const CameraIntrinsicsPrior prior1 =
-        reconstruction_->View(view_id1)->CameraIntrinsicsPrior();
-    const CameraIntrinsicsPrior prior2 =
-        reconstruction_->View(view_id2)->CameraIntrinsicsPrior();
+    const CameraIntrinsicsPrior& prior1 = view1->CameraIntrinsicsPrior();
+    const CameraIntrinsicsPrior& prior2 = view2->CameraIntrinsicsPrior();
     if (prior1.focal_length.is_set) {
       info.focal_length_1 = prior1.focal_length.value[0];
     } else {
@@ -354,7 +464,7 @@ bool Input1DSFM::ReadEGs() {
     }
 
     // Add the number of inliers.
-    const std::vector<ViewId> views = {view_id1, view_id2};
+    const std::vector<ViewId> views = {record.view_id1, record.view_id2};
     const std::vector<TrackId> common_tracks =
         FindCommonTracksInViews(*reconstruction_, views);
     info.num_verified_matches = common_tracks.size();
@@ -363,10 +473,35 @@ bool Input1DSFM::ReadEGs() {
     // visibility score using the VisibilityPyramid.
     info.visibility_score = common_tracks.size();
 
-    // Add the match to the output.
-    if (reconstruction_->View(view_id1) != nullptr &&
-        reconstruction_->View(view_id2) != nullptr) {
-      view_graph_->AddEdge(view_id1, view_id2, info);
+    records->emplace_back(record);
+  }
+  return true;
+}
+
+// Reads the epipolar geometry files.
+bool Input1DSFM::ReadEGs() {
+  MappedFile file;
+  if (!OpenDatasetFile(dataset_directory_ + "/EGs.txt", "EG", &file)) {
+    return false;
+  }
+
+  // Each two view geometry is on its own line.
+  const std::vector<TextRange> chunks = SplitTextIntoChunks(
+      TextRange(file.data(), file.data() + file.size()), num_threads_);
+  std::vector<std::vector<EGRecord> > chunk_records;
+  const auto read_chunk = [this](const TextRange& chunk,
+                                 std::vector<EGRecord>* records) {
+    return ReadEGsChunk(chunk, records);
+  };
+  if (!ParseChunksInParallel(chunks, num_threads_, read_chunk,
+                             &chunk_records)) {
+    return false;
+  }
+
+  // Add the matches to the output in the order of the file.
+  for (const auto& records : chunk_records) {
+    for (const EGRecord& record : records) {
+      view_graph_->AddEdge(record.view_id1, record.view_id2, record.info);
     }
   }
   return true;
@@ -375,10 +510,18 @@ bool Input1DSFM::ReadEGs() {
 bool Read1DSFM(const std::string& dataset_directory,
                Reconstruction* reconstruction,
                ViewGraph* view_graph) {
+  return Read1DSFM(dataset_directory, 1, reconstruction, view_graph);
+}
+
+bool Read1DSFM(const std::string& dataset_directory,
+               const int num_threads,
+               Reconstruction* reconstruction,
+               ViewGraph* view_graph) {
   CHECK_NOTNULL(reconstruction);
   CHECK_NOTNULL(view_graph);
 
-  Input1DSFM input_reader(dataset_directory, reconstruction, view_graph);
+  Input1DSFM input_reader(dataset_directory, num_threads, reconstruction,
+                          view_graph);
 
   LOG(INFO) << "Reading connected components.";
   std::unordered_set<int> valid_images;
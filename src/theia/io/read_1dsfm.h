@@ -68,6 +68,13 @@ bool Read1DSFM(const std::string& dataset_directory,
                Reconstruction* reconstruction,
                ViewGraph* view_graph);
 
+// Same as above, but the coords and EGs files, which make up most of a 1dSfM
+// dataset, are parsed with num_threads threads.
+bool Read1DSFM(const std::string& dataset_directory,
+               const int num_threads,
+               Reconstruction* reconstruction,
+               ViewGraph* view_graph);
+
 }  // namespace theia
 
 #endif  // THEIA_IO_READ_1DSFM_H_
@@ -0,0 +1,148 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/io/read_1dsfm.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/twoview_info.h"
+#include "theia/sfm/view.h"
+#include "theia/sfm/view_graph/view_graph.h"
+
+namespace theia {
+namespace {
+
+static const std::string kDatasetDirectory =
+    THEIA_DATA_DIR + std::string("/io/1dsfm_test");
+
+static const double kTolerance = 1e-6;
+
+void ExpectTwoViewInfo(const ViewGraph& view_graph,
+                       const ViewId view_id1,
+                       const ViewId view_id2,
+                       const Eigen::Vector3d& rotation,
+                       const Eigen::Vector3d& position,
+                       const double focal_length1,
+                       const double focal_length2,
+                       const int num_verified_matches) {
+  const TwoViewInfo* info = view_graph.GetEdge(view_id1, view_id2);
+  ASSERT_NE(info, nullptr);
+  EXPECT_LT((info->rotation_2 - rotation).norm(), kTolerance);
+  EXPECT_LT((info->position_2 - position).norm(), kTolerance);
+  EXPECT_NEAR(info->focal_length_1, focal_length1, kTolerance);
+  EXPECT_NEAR(info->focal_length_2, focal_length2, kTolerance);
+  EXPECT_EQ(info->num_verified_matches, num_verified_matches);
+  EXPECT_EQ(info->visibility_score, num_verified_matches);
+}
+
+// The expected values are the results of the previous stream based parser.
+// The coords file has one header line per image and the EGs file one line per
+// image pair, and the files are split into one chunk per thread, so the thread
+// counts put the chunk boundaries at different records.
+TEST(Read1DSFM, ReadDataset) {
+  for (const int num_threads : {1, 2, 3, 8}) {
+    Reconstruction reconstruction;
+    ViewGraph view_graph;
+    ASSERT_TRUE(Read1DSFM(
+        kDatasetDirectory, num_threads, &reconstruction, &view_graph));
+
+    // Image 3 is not in the connected component.
+    ASSERT_EQ(reconstruction.NumViews(), 4);
+    EXPECT_EQ(reconstruction.View(3), nullptr);
+    const std::vector<std::string> names = {
+        "img0.jpg", "img1.jpg", "img2.jpg", "", "img4.jpg"};
+    const std::vector<double> focal_lengths = {520.5, 0, 480, 0, 0};
+    for (const ViewId view_id : {0, 1, 2, 4}) {
+      const View* view = reconstruction.View(view_id);
+      ASSERT_NE(view, nullptr);
+      EXPECT_EQ(view->Name(), names[view_id]);
+
+      const CameraIntrinsicsPrior& prior = view->CameraIntrinsicsPrior();
+      EXPECT_EQ(prior.focal_length.is_set, focal_lengths[view_id] != 0);
+      if (prior.focal_length.is_set) {
+        EXPECT_EQ(prior.focal_length.value[0], focal_lengths[view_id]);
+      }
+      EXPECT_TRUE(prior.principal_point.is_set);
+      EXPECT_EQ(prior.principal_point.value[0], 320 + 10 * view_id);
+      EXPECT_EQ(prior.principal_point.value[1], 240 - 5 * view_id);
+      EXPECT_EQ(prior.image_width, 640 + 20 * view_id);
+      EXPECT_EQ(prior.image_height, 480 - 10 * view_id);
+    }
+
+    // The colors of the tracks are the mean colors of their features.
+    const std::vector<std::vector<ViewId> > track_views = {
+        {0, 1}, {0, 1, 2}, {1, 4}, {0, 2, 4}, {2, 4}};
+    const std::vector<Eigen::Vector3i> colors = {
+        Eigen::Vector3i(105, 198, 24),  Eigen::Vector3i(190, 191, 158),
+        Eigen::Vector3i(105, 153, 33),  Eigen::Vector3i(146, 170, 134),
+        Eigen::Vector3i(134, 109, 168)};
+    ASSERT_EQ(reconstruction.NumTracks(), track_views.size());
+    for (TrackId track_id = 0; track_id < track_views.size(); track_id++) {
+      const Track* track = reconstruction.Track(track_id);
+      ASSERT_NE(track, nullptr);
+      EXPECT_EQ(track->NumViews(), track_views[track_id].size());
+      for (const ViewId view_id : track_views[track_id]) {
+        EXPECT_NE(reconstruction.View(view_id)->GetFeature(track_id), nullptr);
+      }
+      EXPECT_EQ(track->Color().cast<int>(), colors[track_id]);
+    }
+    const Feature* feature = reconstruction.View(2)->GetFeature(3);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_NEAR((*feature)[0], -47.31, kTolerance);
+    EXPECT_NEAR((*feature)[1], 133.39, kTolerance);
+
+    // The pair (1, 3) is skipped since image 3 is not in the connected
+    // component. The focal length of images without an EXIF focal length is
+    // 1.2 times the x coordinate of the principal point.
+    ASSERT_EQ(view_graph.NumEdges(), 4);
+    EXPECT_EQ(view_graph.GetEdge(1, 3), nullptr);
+    ExpectTwoViewInfo(view_graph, 0, 1, Eigen::Vector3d::Zero(),
+                      Eigen::Vector3d(0.5, -0.1, 0.2), 520.5, 396, 2);
+    ExpectTwoViewInfo(view_graph, 0, 2, Eigen::Vector3d(0, 0, M_PI / 2.0),
+                      Eigen::Vector3d(-1, 0, 0), 520.5, 480, 2);
+    ExpectTwoViewInfo(view_graph, 1, 4,
+                      Eigen::Vector3d(-0.429000739, -0.858001478, -0.858001478),
+                      Eigen::Vector3d(0.2, -0.3, -0.4), 396, 432, 1);
+    ExpectTwoViewInfo(view_graph, 2, 4, Eigen::Vector3d(-M_PI / 2.0, 0, 0),
+                      Eigen::Vector3d(1, -1, -1), 480, 432, 2);
+  }
+}
+
+}  // namespace
+}  // namespace theia
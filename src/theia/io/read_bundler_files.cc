@@ -151,7 +151,7 @@ int AddTracksToReconstruction(
   const int num_points = reader.NumPoints();
   const std::vector<BundlerPoint>& points = reader.points();
   for (int i = 0; i < num_points; i++) {
-    const BundlerPoint point = points[i];
+    const BundlerPoint& point = points[i];
     const Eigen::Vector3d& position = point.position;
     const Eigen::Vector3d& color = point.color;
     const int num_views = point.view_list.size();
@@ -241,6 +241,13 @@ int AddTracksToReconstruction(
 bool ReadBundlerFiles(const std::string& lists_file,
                       const std::string& bundle_file,
                       Reconstruction* reconstruction) {
+  return ReadBundlerFiles(lists_file, bundle_file, 1, reconstruction);
+}
+
+bool ReadBundlerFiles(const std::string& lists_file,
+                      const std::string& bundle_file,
+                      const int num_threads,
+                      Reconstruction* reconstruction) {
   CHECK_EQ(reconstruction->NumViews(), 0)
       << "An empty reconstruction must be provided to load a bundler dataset.";
   CHECK_EQ(reconstruction->NumTracks(), 0)
@@ -255,7 +262,7 @@ bool ReadBundlerFiles(const std::string& lists_file,
   }
 
   VLOG(1) << "Parsing bundler file: " << bundle_file;
-  if (!bundler_file_reader.ParseBundleFile()) {
+  if (!bundler_file_reader.ParseBundleFile(num_threads)) {
     LOG(ERROR) << "Could not parse the bundler file from " << bundle_file;
     return false;
   }
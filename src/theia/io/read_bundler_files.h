@@ -61,6 +61,13 @@ bool ReadBundlerFiles(const std::string& lists_file,
                       const std::string& bundle_file,
                       Reconstruction* reconstruction);
 
+// Same as above, but the points of the bundle file are parsed with num_threads
+// threads.
+bool ReadBundlerFiles(const std::string& lists_file,
+                      const std::string& bundle_file,
+                      const int num_threads,
+                      Reconstruction* reconstruction);
+
 }  // namespace theia
 
 #endif  // THEIA_IO_READ_BUNDLER_FILES_H_
@@ -73,4 +73,23 @@ bool ReadKeypointsAndDescriptors(const std::string& features_file,
   return true;
 }
 
+// Reads the keypoints from a file.
+bool ReadKeypoints(const std::string& features_file,
+                   std::vector<Keypoint>* keypoints) {
+  CHECK_NOTNULL(keypoints)->clear();
+
+  // Return false if the file cannot be opened.
+  std::ifstream features_reader(features_file, std::ios::in | std::ios::binary);
+  if (!features_reader.is_open()) {
+    LOG(ERROR) << "Could not open the feature file: " << features_file
+               << " for reading.";
+    return false;
+  }
+
+  cereal::PortableBinaryInputArchive input_archive(features_reader);
+  input_archive(*keypoints);
+
+  return true;
+}
+
 }  // namespace theia
@@ -47,6 +47,11 @@ bool ReadKeypointsAndDescriptors(const std::string& features_file,
                                  std::vector<Keypoint>* keypoints,
                                  std::vector<Eigen::VectorXf>* descriptors);
 
+// Reads only the keypoints from a features file. The descriptors, which are
+// stored after the keypoints, are not read.
+bool ReadKeypoints(const std::string& features_file,
+                   std::vector<Keypoint>* keypoints);
+
 }  // namespace theia
 
 #endif  // THEIA_IO_READ_KEYPOINTS_AND_DESCRIPTORS_H_
@@ -46,6 +46,7 @@
 #include <utility>
 #include <vector>
 
+#include "theia/io/compact_reconstruction.h"
 #include "theia/sfm/reconstruction.h"
 
 namespace theia {
@@ -60,6 +61,10 @@ bool ReadReconstruction(const std::string& input_file,
                                               "reconstruction before reading a "
                                               "reconstruction from disk";
 
+  if (IsCompactReconstructionFile(input_file)) {
+    return ReadCompactReconstruction(input_file, reconstruction);
+  }
+
   std::ifstream input_reader(input_file, std::ios::in | std::ios::binary);
   if (!input_reader.is_open()) {
     LOG(ERROR) << "Could not open the file: " << input_file << " for reading.";
@@ -43,7 +43,8 @@ class Reconstruction;
 
 // Reads the reconstruction from a binary file. All views and tracks are assumed
 // to be estimated. The ids of the views and tracks will not be preserved, but
-// all views and tracks will be present and complete.
+// all views and tracks will be present and complete. Files written with
+// WriteCompactReconstruction are detected and read as well.
 //
 // See //theia/sfm/reconstruction.h for more details about the information
 // contained in a reconstruction.
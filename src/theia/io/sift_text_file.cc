@@ -38,14 +38,12 @@
 #include <glog/logging.h>
 #include <stdint.h>
 
-#include <cstdio>
-#include <cstdlib>
-#include <fstream>  // NOLINT
-#include <iostream>  // NOLINT
 #include <string>
 #include <vector>
 
 #include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/io/text_tokenizer.h"
+#include "theia/util/mapped_file.h"
 
 namespace theia {
 
@@ -56,23 +54,24 @@ namespace theia {
 //   row col scale orientation (all as floats)
 //   128 ints describing sift descriptor. Normalizing this 128-vector to unit
 //     length will yield the true sift descriptor.
-// NOTE: We use getline and strtof which should be much faster than letting the
-// stream parse the string with operator >>.
+// NOTE: The file is mapped into memory and parsed in place with a
+// TextTokenizer, which is much faster than scanning it one value at a time.
 bool ReadSiftKeyTextFile(const std::string& sift_key_file,
                          std::vector<Eigen::VectorXf>* descriptor,
                          std::vector<Keypoint>* keypoint) {
   CHECK_NOTNULL(descriptor)->clear();
   CHECK_NOTNULL(keypoint)->clear();
 
-  FILE* fp = fopen(sift_key_file.c_str(), "r");
-  int num_descriptors, len;
-  if (fp == nullptr) {
+  MappedFile file;
+  if (!file.Open(sift_key_file)) {
     return false;
   }
+  TextTokenizer tokenizer(file.data(), file.data() + file.size());
 
-  if (fscanf(fp, "%d %d", &num_descriptors, &len) != 2) {
-    printf("Invalid keypoint file\n");
-    return 0;
+  int num_descriptors, len;
+  if (!tokenizer.Read(&num_descriptors) || !tokenizer.Read(&len)) {
+    LOG(ERROR) << "Invalid keypoint file: " << sift_key_file;
+    return false;
   }
 
   CHECK_EQ(len, 128);
@@ -80,12 +79,13 @@ bool ReadSiftKeyTextFile(const std::string& sift_key_file,
   descriptor->reserve(num_descriptors);
   keypoint->reserve(num_descriptors);
 
+  Eigen::VectorXf float_descriptor(128);
   for (int i = 0; i < num_descriptors; i++) {
     float x, y, scale, ori;
-
-    if (fscanf(fp, "%f %f %f %f\n", &y, &x, &scale, &ori) != 4) {
-      printf("Invalid keypoint file format.");
-      return 0;
+    if (!tokenizer.Read(&y) || !tokenizer.Read(&x) ||
+        !tokenizer.Read(&scale) || !tokenizer.Read(&ori)) {
+      LOG(ERROR) << "Invalid keypoint file format: " << sift_key_file;
+      return false;
     }
 
     Keypoint kp(x, y, Keypoint::SIFT);
@@ -93,29 +93,18 @@ bool ReadSiftKeyTextFile(const std::string& sift_key_file,
     kp.set_orientation(ori);
     keypoint->push_back(kp);
 
-    char buf[1024];
-    Eigen::Matrix<uint8_t, Eigen::Dynamic, 1> int_descriptor(128);
-    uint8_t* p = int_descriptor.data();
-    for (int line = 0; line < 6; line++) {
-      CHECK_NOTNULL(fgets(buf, 1024, fp));
-      sscanf(buf, "%hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu "
-             "%hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu",
-             p + 0, p + 1, p + 2, p + 3, p + 4, p + 5, p + 6, p + 7, p + 8,
-             p + 9, p + 10, p + 11, p + 12, p + 13, p + 14, p + 15, p + 16,
-             p + 17, p + 18, p + 19);
-
-      p += 20;
+    for (int j = 0; j < 128; j++) {
+      int value;
+      if (!tokenizer.Read(&value)) {
+        LOG(ERROR) << "Invalid keypoint file format: " << sift_key_file;
+        return false;
+      }
+      float_descriptor[j] = static_cast<float>(static_cast<uint8_t>(value));
     }
-    CHECK_NOTNULL(fgets(buf, 1024, fp));
-    sscanf(buf, "%hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu", p + 0, p + 1,
-           p + 2, p + 3, p + 4, p + 5, p + 6, p + 7);
-
-    Eigen::VectorXf float_descriptor = int_descriptor.cast<float>();
     float_descriptor /= 255.0;
     descriptor->push_back(float_descriptor);
   }
 
-  fclose(fp);
   return true;
 }
 
@@ -0,0 +1,179 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/io/text_tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace theia {
+
+namespace {
+
+// Returns the beginning of the line after the one containing position, or end
+// if position is on the last line.
+const char* NextLine(const char* position, const char* end) {
+  const char* line_break =
+      static_cast<const char*>(std::memchr(position, '\n', end - position));
+  return line_break == nullptr ? end : line_break + 1;
+}
+
+// Returns true if the line starting at position contains only whitespace.
+bool IsBlankLine(const char* position, const char* end) {
+  for (; position != end && *position != '\n'; ++position) {
+    if (*position != ' ' && *position != '\t' && *position != '\r') {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool TextTokenizer::ReadToken(std::string* token) {
+  SkipWhitespace();
+  const char* begin = position_;
+  while (position_ != end_ && !IsWhitespace(*position_)) {
+    ++position_;
+  }
+  if (position_ == begin) {
+    return false;
+  }
+  token->assign(begin, position_);
+  return true;
+}
+
+bool TextTokenizer::ReadLine(std::string* line) {
+  if (position_ == end_) {
+    return false;
+  }
+  const char* line_end = NextLine(position_, end_);
+  const char* next_line = line_end;
+  if (line_end != position_ && *(line_end - 1) == '\n') {
+    --line_end;
+  }
+  if (line_end != position_ && *(line_end - 1) == '\r') {
+    --line_end;
+  }
+  line->assign(position_, line_end);
+  position_ = next_line;
+  return true;
+}
+
+void TextTokenizer::SkipLine() {
+  if (position_ != end_) {
+    position_ = NextLine(position_, end_);
+  }
+}
+
+bool TextTokenizer::HasTokenOnLine() {
+  while (position_ != end_ && *position_ != '\n' && IsWhitespace(*position_)) {
+    ++position_;
+  }
+  return position_ != end_ && *position_ != '\n';
+}
+
+bool TextTokenizer::AtEnd() {
+  SkipWhitespace();
+  return position_ == end_;
+}
+
+std::vector<TextRange> SplitTextIntoChunks(const TextRange& text,
+                                           const int num_chunks,
+                                           const char line_prefix) {
+  std::vector<TextRange> chunks;
+  const size_t size = text.end - text.begin;
+  const size_t chunk_size = size / std::max(num_chunks, 1) + 1;
+
+  const char* chunk_begin = text.begin;
+  while (chunk_begin != text.end) {
+    // Move the nominal end of the chunk forward to the next line that a chunk
+    // may start at.
+    const char* chunk_end =
+        chunk_begin + std::min<size_t>(chunk_size, text.end - chunk_begin);
+    if (chunk_end != text.end && *(chunk_end - 1) != '\n') {
+      chunk_end = NextLine(chunk_end, text.end);
+    }
+    if (line_prefix != '\0') {
+      while (chunk_end != text.end && *chunk_end != line_prefix) {
+        chunk_end = NextLine(chunk_end, text.end);
+      }
+    }
+    chunks.emplace_back(chunk_begin, chunk_end);
+    chunk_begin = chunk_end;
+  }
+  return chunks;
+}
+
+int RecordsPerChunk(const int num_records, const int num_chunks) {
+  const int clamped_num_chunks = std::max(1, std::min(num_chunks, num_records));
+  return (num_records + clamped_num_chunks - 1) / clamped_num_chunks;
+}
+
+bool SplitRecordsIntoChunks(const TextRange& text,
+                            const int num_records,
+                            const int lines_per_record,
+                            const int num_chunks,
+                            std::vector<TextRange>* chunks,
+                            const char** records_end) {
+  chunks->clear();
+  const int records_per_chunk = RecordsPerChunk(num_records, num_chunks);
+  const int lines_per_chunk = records_per_chunk * lines_per_record;
+
+  const char* position = text.begin;
+  const char* chunk_begin = position;
+  int num_remaining_lines = num_records * lines_per_record;
+  int num_lines_in_chunk = 0;
+  while (num_remaining_lines > 0) {
+    if (position == text.end) {
+      return false;
+    }
+    if (!IsBlankLine(position, text.end)) {
+      --num_remaining_lines;
+      ++num_lines_in_chunk;
+    }
+    position = NextLine(position, text.end);
+    if (num_lines_in_chunk == lines_per_chunk || num_remaining_lines == 0) {
+      chunks->emplace_back(chunk_begin, position);
+      chunk_begin = position;
+      num_lines_in_chunk = 0;
+    }
+  }
+  *records_end = position;
+  return true;
+}
+
+}  // namespace theia
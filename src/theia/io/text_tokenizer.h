@@ -0,0 +1,198 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_IO_TEXT_TOKENIZER_H_
+#define THEIA_IO_TEXT_TOKENIZER_H_
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace theia {
+
+// A contiguous range [begin, end) of text, typically a part of a MappedFile.
+struct TextRange {
+  TextRange() : begin(nullptr), end(nullptr) {}
+  TextRange(const char* begin, const char* end) : begin(begin), end(end) {}
+
+  const char* begin;
+  const char* end;
+};
+
+// Parses whitespace-delimited tokens in place from a range of text. Numbers
+// are converted with std::from_chars so that no locale, stream state or
+// intermediate string is involved. This is meant for the large text formats
+// that Theia imports (1DSfM, Bundler, NVM and Lowe's SIFT keys), where a
+// stream extraction per value dominates the loading time.
+//
+// All Read methods return false if no token could be parsed, in which case the
+// position of the tokenizer is undefined.
+class TextTokenizer {
+ public:
+  TextTokenizer(const char* begin, const char* end)
+      : position_(begin), end_(end) {}
+  explicit TextTokenizer(const TextRange& range)
+      : position_(range.begin), end_(range.end) {}
+
+  // Reads the next token as an integral or floating point number. A leading
+  // '+' is accepted. The number must be followed by whitespace or the end of
+  // the text.
+  template <typename T>
+  bool Read(T* value);
+
+  // Reads the next token as a string.
+  bool ReadToken(std::string* token);
+
+  // Reads the remainder of the current line, without the line break, and moves
+  // to the beginning of the next line. Returns false at the end of the text.
+  bool ReadLine(std::string* line);
+
+  // Moves to the beginning of the next line.
+  void SkipLine();
+
+  // Returns true if there is a token before the end of the current line.
+  bool HasTokenOnLine();
+
+  // Returns true if only whitespace remains.
+  bool AtEnd();
+
+  const char* position() const { return position_; }
+
+ private:
+  static bool IsWhitespace(const char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+           c == '\f';
+  }
+
+  void SkipWhitespace() {
+    while (position_ != end_ && IsWhitespace(*position_)) {
+      ++position_;
+    }
+  }
+
+  template <typename T>
+  static std::from_chars_result ParseNumber(const char* begin,
+                                            const char* end,
+                                            T* value);
+
+  const char* position_;
+  const char* end_;
+};
+
+// Splits the text into at most num_chunks ranges of approximately equal size
+// that can be parsed independently. Each range starts at the beginning of a
+// line. If line_prefix is not '\0', ranges only start at lines beginning with
+// line_prefix so that records spanning several lines (such as the per-image
+// blocks of a 1DSfM coords file) are never split.
+std::vector<TextRange> SplitTextIntoChunks(const TextRange& text,
+                                           const int num_chunks,
+                                           const char line_prefix = '\0');
+
+// Splits the first num_records records of the text, each spanning
+// lines_per_record non-empty lines, into at most num_chunks ranges holding
+// (nearly) the same number of records. The text must start at the beginning of
+// a line. On success records_end is set to the position after the last record.
+// Returns false if the text contains fewer lines than required.
+bool SplitRecordsIntoChunks(const TextRange& text,
+                            const int num_records,
+                            const int lines_per_record,
+                            const int num_chunks,
+                            std::vector<TextRange>* chunks,
+                            const char** records_end);
+
+// Returns the number of records in each chunk returned by
+// SplitRecordsIntoChunks, so that chunk i holds the records starting at
+// i * RecordsPerChunk(num_records, num_chunks).
+int RecordsPerChunk(const int num_records, const int num_chunks);
+
+// ------------------------- Implementation details ------------------------- //
+
+template <typename T>
+std::from_chars_result TextTokenizer::ParseNumber(const char* begin,
+                                                  const char* end,
+                                                  T* value) {
+#if defined(__cpp_lib_to_chars)
+  return std::from_chars(begin, end, *value);
+#else
+  if constexpr (std::is_integral<T>::value) {
+    return std::from_chars(begin, end, *value);
+  } else {
+    // Floating point from_chars is not available in all standard libraries, so
+    // fall back to strtod on a null-terminated copy of the token.
+    char buffer[64];
+    const char* token_end = begin;
+    while (token_end != end && !IsWhitespace(*token_end)) {
+      ++token_end;
+    }
+    const size_t length = token_end - begin;
+    if (length == 0 || length >= sizeof(buffer)) {
+      return {begin, std::errc::invalid_argument};
+    }
+    std::memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+    char* parsed_end;
+    *value = static_cast<T>(std::strtod(buffer, &parsed_end));
+    if (parsed_end == buffer) {
+      return {begin, std::errc::invalid_argument};
+    }
+    return {begin + (parsed_end - buffer), std::errc()};
+  }
+#endif
+}
+
+template <typename T>
+bool TextTokenizer::Read(T* value) {
+  static_assert(std::is_arithmetic<T>::value,
+                "TextTokenizer::Read only parses numbers.");
+  SkipWhitespace();
+  const char* begin = position_;
+  if (begin != end_ && *begin == '+') {
+    ++begin;
+  }
+  const std::from_chars_result result = ParseNumber(begin, end_, value);
+  if (result.ec != std::errc() ||
+      (result.ptr != end_ && !IsWhitespace(*result.ptr))) {
+    return false;
+  }
+  position_ = result.ptr;
+  return true;
+}
+
+}  // namespace theia
+
+#endif  // THEIA_IO_TEXT_TOKENIZER_H_
@@ -0,0 +1,169 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/io/text_tokenizer.h"
+
+namespace theia {
+namespace {
+
+TextRange RangeFromString(const std::string& text) {
+  return TextRange(text.data(), text.data() + text.size());
+}
+
+TEST(TextTokenizer, ReadNumbersAndTokens) {
+  const std::string text =
+      "# comment line\n 12 -7 +3\t0.5 -1.25e2\r\nname.jpg 4";
+  TextTokenizer tokenizer(RangeFromString(text));
+
+  std::string line;
+  EXPECT_TRUE(tokenizer.ReadLine(&line));
+  EXPECT_EQ(line, "# comment line");
+
+  int a, b, c;
+  EXPECT_TRUE(tokenizer.Read(&a));
+  EXPECT_TRUE(tokenizer.Read(&b));
+  EXPECT_TRUE(tokenizer.Read(&c));
+  EXPECT_EQ(a, 12);
+  EXPECT_EQ(b, -7);
+  EXPECT_EQ(c, 3);
+
+  float f;
+  double d;
+  EXPECT_TRUE(tokenizer.Read(&f));
+  EXPECT_TRUE(tokenizer.Read(&d));
+  EXPECT_EQ(f, 0.5f);
+  EXPECT_EQ(d, -125.0);
+  EXPECT_FALSE(tokenizer.HasTokenOnLine());
+  tokenizer.SkipLine();
+
+  // A token that is not a number must not be parsed as one.
+  const char* position = tokenizer.position();
+  EXPECT_FALSE(tokenizer.Read(&a));
+  TextTokenizer token_reader(position, text.data() + text.size());
+  std::string token;
+  EXPECT_TRUE(token_reader.ReadToken(&token));
+  EXPECT_EQ(token, "name.jpg");
+  EXPECT_TRUE(token_reader.HasTokenOnLine());
+  EXPECT_TRUE(token_reader.Read(&a));
+  EXPECT_EQ(a, 4);
+  EXPECT_TRUE(token_reader.AtEnd());
+  EXPECT_FALSE(token_reader.ReadToken(&token));
+}
+
+TEST(TextTokenizer, RejectsPartialNumbers) {
+  const std::string text = "12abc 1.5.2";
+  TextTokenizer tokenizer(RangeFromString(text));
+  int value;
+  EXPECT_FALSE(tokenizer.Read(&value));
+
+  TextTokenizer float_tokenizer(text.data() + 6, text.data() + text.size());
+  double float_value;
+  EXPECT_FALSE(float_tokenizer.Read(&float_value));
+}
+
+TEST(SplitTextIntoChunks, ChunksStartAtLines) {
+  std::string text;
+  for (int i = 0; i < 100; i++) {
+    text += "#header " + std::to_string(i) + "\n";
+    for (int j = 0; j < i % 5; j++) {
+      text += std::to_string(j) + " 1.0 2.0\n";
+    }
+  }
+
+  for (const char prefix : {'\0', '#'}) {
+    const std::vector<TextRange> chunks =
+        SplitTextIntoChunks(RangeFromString(text), 7, prefix);
+    ASSERT_FALSE(chunks.empty());
+    EXPECT_LE(chunks.size(), 7);
+    EXPECT_EQ(chunks.front().begin, text.data());
+    EXPECT_EQ(chunks.back().end, text.data() + text.size());
+    for (int i = 0; i < chunks.size(); i++) {
+      EXPECT_LT(chunks[i].begin, chunks[i].end);
+      if (prefix != '\0') {
+        EXPECT_EQ(*chunks[i].begin, prefix);
+      }
+      if (i > 0) {
+        EXPECT_EQ(chunks[i].begin, chunks[i - 1].end);
+        EXPECT_EQ(*(chunks[i].begin - 1), '\n');
+      }
+    }
+  }
+}
+
+TEST(SplitRecordsIntoChunks, SplitsRecordsEvenly) {
+  // Ten records of two lines each with a blank line in between and trailing
+  // text after the records.
+  std::string text;
+  for (int i = 0; i < 10; i++) {
+    text += std::to_string(i) + "\n\n" + std::to_string(10 * i) + " 5\n";
+  }
+  text += "trailing text\n";
+
+  std::vector<TextRange> chunks;
+  const char* records_end;
+  EXPECT_TRUE(SplitRecordsIntoChunks(
+      RangeFromString(text), 10, 2, 4, &chunks, &records_end));
+  EXPECT_EQ(std::string(records_end), "trailing text\n");
+
+  const int records_per_chunk = RecordsPerChunk(10, 4);
+  EXPECT_EQ(records_per_chunk, 3);
+  ASSERT_EQ(chunks.size(), 4);
+  for (int i = 0; i < chunks.size(); i++) {
+    TextTokenizer tokenizer(chunks[i]);
+    for (int j = i * records_per_chunk;
+         j < std::min(10, (i + 1) * records_per_chunk);
+         j++) {
+      int index, value, five;
+      EXPECT_TRUE(tokenizer.Read(&index));
+      EXPECT_TRUE(tokenizer.Read(&value));
+      EXPECT_TRUE(tokenizer.Read(&five));
+      EXPECT_EQ(index, j);
+      EXPECT_EQ(value, 10 * j);
+      EXPECT_EQ(five, 5);
+    }
+    EXPECT_TRUE(tokenizer.AtEnd());
+  }
+
+  // There are not enough lines for twelve records.
+  EXPECT_FALSE(SplitRecordsIntoChunks(
+      RangeFromString(text), 12, 2, 4, &chunks, &records_end));
+}
+
+}  // namespace
+}  // namespace theia
@@ -34,90 +34,264 @@
 
 #include "theia/io/write_ply_file.h"
 
+#include <Eigen/Core>
 #include <glog/logging.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>  // NOLINT
+#include <future>   // NOLINT
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "theia/sfm/reconstruction.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 
-// Gather points from tracks.
-void GatherTracks(const Reconstruction& reconstruction,
-                  std::vector<Eigen::Vector3d>* points_to_write,
-                  std::vector<Eigen::Vector3i>* colors_to_write) {
-  for (const TrackId track_id : reconstruction.TrackIds()) {
-    const Track& track = *reconstruction.Track(track_id);
-    points_to_write->emplace_back(track.Point().hnormalized());
-    colors_to_write->emplace_back(track.Color()[0],
-                                  track.Color()[1],
-                                  track.Color()[2]);
+namespace {
+
+// Tracks are filtered and formatted in chunks of this size.
+const int kNumTracksPerChunk = 1 << 16;
+
+// The number of chunks per thread that may be formatted ahead of the chunk that
+// is currently being written. This bounds the memory used for the buffers.
+const int kNumChunksInFlightPerThread = 4;
+
+bool IsLittleEndian() {
+  const uint16_t value = 1;
+  return *reinterpret_cast<const uint8_t*>(&value) == 1;
+}
+
+template <typename T>
+void AppendLittleEndian(const T value, std::string* buffer) {
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  if (!IsLittleEndian()) {
+    std::reverse(bytes, bytes + sizeof(T));
   }
+  buffer->append(bytes, sizeof(T));
 }
 
-// Gather camera positions.
-void GatherCameras(const Reconstruction& reconstruction,
-                   std::vector<Eigen::Vector3d>* points_to_write,
-                   std::vector<Eigen::Vector3i>* colors_to_write) {
-  for (const ViewId view_id : reconstruction.ViewIds()) {
-    const View& view = *reconstruction.View(view_id);
-    if (!view.IsEstimated()) {
+bool IsTrackWritten(const Track& track,
+                    const int min_num_observations_per_point) {
+  return track.IsEstimated() &&
+         track.NumViews() >= min_num_observations_per_point;
+}
+
+// Appends a single vertex with the properties selected in the options.
+void AppendVertex(const WritePlyFileOptions& options,
+                  const Eigen::Vector3d& point,
+                  const Eigen::Vector3d& normal,
+                  const Eigen::Matrix<uint8_t, 3, 1>& color,
+                  const int num_observations,
+                  std::string* buffer) {
+  if (options.binary) {
+    for (int i = 0; i < 3; i++) {
+      AppendLittleEndian(static_cast<float>(point[i]), buffer);
+    }
+    if (options.write_normals) {
+      for (int i = 0; i < 3; i++) {
+        AppendLittleEndian(static_cast<float>(normal[i]), buffer);
+      }
+    }
+    buffer->append(reinterpret_cast<const char*>(color.data()), 3);
+    if (options.write_num_observations) {
+      AppendLittleEndian(static_cast<uint32_t>(num_observations), buffer);
+    }
+    return;
+  }
+
+  char line[256];
+  int length = std::snprintf(line, sizeof(line), "%g %g %g",
+                             point[0], point[1], point[2]);
+  buffer->append(line, length);
+  if (options.write_normals) {
+    length = std::snprintf(line, sizeof(line), " %g %g %g",
+                           normal[0], normal[1], normal[2]);
+    buffer->append(line, length);
+  }
+  length = std::snprintf(line, sizeof(line), " %d %d %d",
+                         color[0], color[1], color[2]);
+  buffer->append(line, length);
+  if (options.write_num_observations) {
+    length = std::snprintf(line, sizeof(line), " %d", num_observations);
+    buffer->append(line, length);
+  }
+  buffer->push_back('\n');
+}
+
+// Formats the tracks in [begin, end) that pass the filter.
+std::string FormatTracks(
+    const Reconstruction& reconstruction,
+    const std::unordered_map<ViewId, Eigen::Vector3d>& camera_positions,
+    const WritePlyFileOptions& options,
+    const std::vector<TrackId>& track_ids,
+    const int begin,
+    const int end) {
+  std::string buffer;
+  for (int i = begin; i < end; i++) {
+    const Track& track = *reconstruction.Track(track_ids[i]);
+    if (!IsTrackWritten(track, options.min_num_observations_per_point)) {
       continue;
     }
-    points_to_write->emplace_back(view.Camera().GetPosition());
-    colors_to_write->emplace_back(0, 255, 0);
+
+    const Eigen::Vector3d point = track.Point().hnormalized();
+    Eigen::Vector3d normal = Eigen::Vector3d::Zero();
+    if (options.write_normals) {
+      for (const ViewId view_id : track.ViewIds()) {
+        const auto camera_position = camera_positions.find(view_id);
+        if (camera_position != camera_positions.end()) {
+          normal += (camera_position->second - point).normalized();
+        }
+      }
+      if (normal.squaredNorm() > 0) {
+        normal.normalize();
+      }
+    }
+    AppendVertex(options,
+                 point,
+                 normal,
+                 track.Color(),
+                 track.NumViews(),
+                 &buffer);
   }
+  return buffer;
 }
 
-// Writes a PLY file for viewing in software such as MeshLab.
+}  // namespace
+
 bool WritePlyFile(const std::string& ply_file,
-                  const Reconstruction& const_reconstruction,
-                  const int min_num_observations_per_point) {
+                  const Reconstruction& reconstruction,
+                  const WritePlyFileOptions& options) {
   CHECK_GT(ply_file.length(), 0);
+  CHECK_GT(options.num_threads, 0);
 
   // Return false if the file cannot be opened for writing.
-  std::ofstream ply_writer(ply_file, std::ofstream::out);
+  std::ofstream ply_writer(ply_file, std::ios::out | std::ios::binary);
   if (!ply_writer.is_open()) {
     LOG(ERROR) << "Could not open the file: " << ply_file
                << " for writing a PLY file.";
     return false;
   }
 
-  // First, remove any points that are unestimated or do not have enough 3D
-  // points.
-  Reconstruction reconstruction = const_reconstruction;
-  const auto& track_ids = reconstruction.TrackIds();
-  for (const TrackId track_id : track_ids) {
-    const Track& track = *reconstruction.Track(track_id);
-    if (!track.IsEstimated() || track.NumViews() < min_num_observations_per_point) {
-      reconstruction.RemoveTrack(track_id);
+  // The camera positions are written as points and are used to compute the
+  // normals.
+  std::vector<ViewId> estimated_view_ids;
+  std::unordered_map<ViewId, Eigen::Vector3d> camera_positions;
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    const View& view = *reconstruction.View(view_id);
+    if (!view.IsEstimated()) {
+      continue;
+    }
+    estimated_view_ids.emplace_back(view_id);
+    camera_positions.emplace(view_id, view.Camera().GetPosition());
+  }
+
+  const std::vector<TrackId> track_ids = reconstruction.TrackIds();
+  const int num_chunks =
+      (track_ids.size() + kNumTracksPerChunk - 1) / kNumTracksPerChunk;
+  ThreadPool pool(options.num_threads);
+
+  // The number of vertices must be known for the header, so the tracks are
+  // filtered once before they are formatted.
+  int num_points = 0;
+  {
+    std::vector<std::future<int> > chunk_num_points;
+    for (int i = 0; i < num_chunks; i++) {
+      chunk_num_points.emplace_back(pool.Add([&, i]() {
+        const int end = std::min(static_cast<int>(track_ids.size()),
+                                 (i + 1) * kNumTracksPerChunk);
+        int num_written_tracks = 0;
+        for (int j = i * kNumTracksPerChunk; j < end; j++) {
+          if (IsTrackWritten(*reconstruction.Track(track_ids[j]),
+                             options.min_num_observations_per_point)) {
+            ++num_written_tracks;
+          }
+        }
+        return num_written_tracks;
+      }));
+    }
+    for (auto& chunk : chunk_num_points) {
+      num_points += chunk.get();
+    }
+  }
+  const int num_cameras =
+      options.write_cameras ? estimated_view_ids.size() : 0;
+
+  std::string header = "ply\n";
+  header += options.binary ? "format binary_little_endian 1.0\n"
+                           : "format ascii 1.0\n";
+  header += "element vertex " + std::to_string(num_points + num_cameras) + "\n";
+  header += "property float x\nproperty float y\nproperty float z\n";
+  if (options.write_normals) {
+    header += "property float nx\nproperty float ny\nproperty float nz\n";
+  }
+  header += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+  if (options.write_num_observations) {
+    header += "property uint num_observations\n";
+  }
+  header += "end_header\n";
+  ply_writer.write(header.data(), header.size());
+
+  // Format the chunks in parallel while writing the finished chunks in order.
+  const int max_num_chunks_in_flight =
+      options.num_threads * kNumChunksInFlightPerThread;
+  std::deque<std::future<std::string> > formatted_chunks;
+  int next_chunk = 0;
+  while (next_chunk < num_chunks || !formatted_chunks.empty()) {
+    while (next_chunk < num_chunks &&
+           formatted_chunks.size() < max_num_chunks_in_flight) {
+      const int begin = next_chunk * kNumTracksPerChunk;
+      const int end = std::min(static_cast<int>(track_ids.size()),
+                               begin + kNumTracksPerChunk);
+      formatted_chunks.emplace_back(pool.Add([&, begin, end]() {
+        return FormatTracks(reconstruction,
+                            camera_positions,
+                            options,
+                            track_ids,
+                            begin,
+                            end);
+      }));
+      ++next_chunk;
     }
+    const std::string buffer = formatted_chunks.front().get();
+    formatted_chunks.pop_front();
+    ply_writer.write(buffer.data(), buffer.size());
   }
 
-  // Extract points that we will write to the PLY file.
-  std::vector<Eigen::Vector3d> points_to_write;
-  std::vector<Eigen::Vector3i> colors_to_write;
-  GatherTracks(reconstruction, &points_to_write, &colors_to_write);
-  GatherCameras(reconstruction, &points_to_write, &colors_to_write);
-
-  ply_writer << "ply"
-    << '\n' << "format ascii 1.0"
-             << '\n' << "element vertex " << points_to_write.size()
-    << '\n' << "property float x"
-    << '\n' << "property float y"
-    << '\n' << "property float z"
-    << '\n' << "property uchar red"
-    << '\n' << "property uchar green"
-    << '\n' << "property uchar blue"
-    << '\n' << "end_header" << std::endl;
-
-  for (int i = 0; i < points_to_write.size(); i++) {
-    ply_writer << points_to_write[i].transpose() << " "
-               << colors_to_write[i].transpose() << "\n";
+  if (options.write_cameras) {
+    std::string buffer;
+    const Eigen::Matrix<uint8_t, 3, 1> camera_color(0, 255, 0);
+    for (const ViewId view_id : estimated_view_ids) {
+      AppendVertex(options,
+                   camera_positions.at(view_id),
+                   Eigen::Vector3d::Zero(),
+                   camera_color,
+                   0,
+                   &buffer);
+    }
+    ply_writer.write(buffer.data(), buffer.size());
   }
 
+  if (!ply_writer.good()) {
+    LOG(ERROR) << "Could not write the PLY file: " << ply_file;
+    return false;
+  }
   return true;
 }
 
+// Writes a PLY file for viewing in software such as MeshLab.
+bool WritePlyFile(const std::string& ply_file,
+                  const Reconstruction& reconstruction,
+                  const int min_num_observations_per_point) {
+  WritePlyFileOptions options;
+  options.min_num_observations_per_point = min_num_observations_per_point;
+  return WritePlyFile(ply_file, reconstruction, options);
+}
+
 }  // namespace theia
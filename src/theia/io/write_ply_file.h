@@ -41,7 +41,39 @@ namespace theia {
 
 class Reconstruction;
 
-// Writes a PLY file for viewing in software such as MeshLab.
+struct WritePlyFileOptions {
+  // Only estimated tracks with at least this many observations are written.
+  int min_num_observations_per_point = 2;
+
+  // If true, the points are written in the binary_little_endian PLY format,
+  // which is several times smaller and faster to write and load than ASCII.
+  bool binary = false;
+
+  // Write the positions of the estimated cameras as green points.
+  bool write_cameras = true;
+
+  // Write a normal for each point, which is the mean of the unit directions
+  // from the point to the estimated cameras that observe it. Cameras have a
+  // zero normal.
+  bool write_normals = false;
+
+  // Write the number of observations of each point as the "num_observations"
+  // vertex property. Cameras have zero observations.
+  bool write_num_observations = false;
+
+  // The points are filtered and formatted in parallel chunks with this many
+  // threads. The chunks are written in order so the output does not depend on
+  // the number of threads.
+  int num_threads = 1;
+};
+
+// Writes a PLY file for viewing in software such as MeshLab. The points are
+// streamed from the reconstruction, so the reconstruction is not copied.
+bool WritePlyFile(const std::string& ply_file,
+                  const Reconstruction& reconstruction,
+                  const WritePlyFileOptions& options);
+
+// Writes an ASCII PLY file with the points and camera positions.
 bool WritePlyFile(const std::string& ply_file,
                   const Reconstruction& reconstruction,
                   const int min_num_observations_per_point);
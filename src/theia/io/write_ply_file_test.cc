@@ -0,0 +1,213 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <cstdio>
+#include <cstring>
+#include <fstream>  // NOLINT
+#include <iterator>
+#include <sstream>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/io/write_ply_file.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/util/random.h"
+
+namespace theia {
+namespace {
+
+static const std::string kPlyFile =
+    THEIA_DATA_DIR + std::string("/write_ply_file_test.ply");
+
+RandomNumberGenerator rng(67);
+
+// Creates a reconstruction with three estimated views, one unestimated view
+// and tracks with one to four observations. Every tenth track is unestimated.
+void CreateReconstruction(Reconstruction* reconstruction) {
+  std::vector<ViewId> view_ids;
+  for (int i = 0; i < 4; i++) {
+    view_ids.emplace_back(reconstruction->AddView(std::to_string(i)));
+    View* view = reconstruction->MutableView(view_ids.back());
+    view->SetEstimated(i != 3);
+    view->MutableCamera()->SetPosition(Eigen::Vector3d(i, 0, -10.0));
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    const TrackId track_id = reconstruction->AddTrack();
+    for (int j = 0; j <= i % 4; j++) {
+      reconstruction->AddObservation(view_ids[j], track_id, Feature(0, 0));
+    }
+    Track* track = reconstruction->MutableTrack(track_id);
+    track->SetEstimated(i % 10 != 0);
+    *track->MutablePoint() = rng.RandVector3d().homogeneous();
+    *track->MutableColor() = Eigen::Matrix<uint8_t, 3, 1>(i % 256, 1, 2);
+  }
+}
+
+std::string ReadFile(const std::string& filename) {
+  std::ifstream input(filename, std::ios::in | std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(input),
+                     std::istreambuf_iterator<char>());
+}
+
+// Splits the PLY file into its header and body and returns the vertex count.
+int ParsePlyFile(const std::string& contents,
+                 std::string* header,
+                 std::string* body) {
+  const std::string kEndHeader = "end_header\n";
+  const size_t end_header = contents.find(kEndHeader);
+  EXPECT_NE(end_header, std::string::npos);
+  *header = contents.substr(0, end_header + kEndHeader.size());
+  *body = contents.substr(end_header + kEndHeader.size());
+
+  const std::string kElementVertex = "element vertex ";
+  const size_t element_vertex = header->find(kElementVertex);
+  EXPECT_NE(element_vertex, std::string::npos);
+  return std::stoi(header->substr(element_vertex + kElementVertex.size()));
+}
+
+int NumExpectedPoints(const Reconstruction& reconstruction,
+                      const int min_num_observations_per_point) {
+  int num_points = 0;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Track* track = reconstruction.Track(track_id);
+    if (track->IsEstimated() &&
+        track->NumViews() >= min_num_observations_per_point) {
+      ++num_points;
+    }
+  }
+  return num_points;
+}
+
+TEST(WritePlyFile, AsciiFile) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  ASSERT_TRUE(WritePlyFile(kPlyFile, reconstruction, 2));
+
+  std::string header, body;
+  const int num_vertices = ParsePlyFile(ReadFile(kPlyFile), &header, &body);
+  std::remove(kPlyFile.c_str());
+  EXPECT_NE(header.find("format ascii 1.0"), std::string::npos);
+  EXPECT_EQ(num_vertices, NumExpectedPoints(reconstruction, 2) + 3);
+
+  // Every vertex has a position and a color.
+  std::istringstream body_stream(body);
+  std::string line;
+  int num_lines = 0;
+  while (std::getline(body_stream, line)) {
+    std::istringstream line_stream(line);
+    std::vector<double> values((std::istream_iterator<double>(line_stream)),
+                               std::istream_iterator<double>());
+    EXPECT_EQ(values.size(), 6);
+    ++num_lines;
+  }
+  EXPECT_EQ(num_lines, num_vertices);
+}
+
+TEST(WritePlyFile, BinaryFileMatchesAsciiFile) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+
+  WritePlyFileOptions options;
+  options.min_num_observations_per_point = 3;
+  options.write_normals = true;
+  options.write_num_observations = true;
+  options.num_threads = 4;
+  ASSERT_TRUE(WritePlyFile(kPlyFile, reconstruction, options));
+  std::string ascii_header, ascii_body;
+  const int num_ascii_vertices =
+      ParsePlyFile(ReadFile(kPlyFile), &ascii_header, &ascii_body);
+
+  options.binary = true;
+  ASSERT_TRUE(WritePlyFile(kPlyFile, reconstruction, options));
+  std::string binary_header, binary_body;
+  const int num_binary_vertices =
+      ParsePlyFile(ReadFile(kPlyFile), &binary_header, &binary_body);
+  std::remove(kPlyFile.c_str());
+
+  EXPECT_NE(binary_header.find("format binary_little_endian 1.0"),
+            std::string::npos);
+  EXPECT_NE(binary_header.find("property float nx"), std::string::npos);
+  EXPECT_NE(binary_header.find("property uint num_observations"),
+            std::string::npos);
+  EXPECT_EQ(num_binary_vertices, NumExpectedPoints(reconstruction, 3) + 3);
+  EXPECT_EQ(num_binary_vertices, num_ascii_vertices);
+
+  // 6 floats, 3 uchars and a uint per vertex.
+  const int kVertexSize = 6 * sizeof(float) + 3 + sizeof(uint32_t);
+  ASSERT_EQ(binary_body.size(), kVertexSize * num_binary_vertices);
+
+  std::istringstream ascii_stream(ascii_body);
+  for (int i = 0; i < num_binary_vertices; i++) {
+    const char* vertex = binary_body.data() + i * kVertexSize;
+    float position_and_normal[6];
+    std::memcpy(position_and_normal, vertex, sizeof(position_and_normal));
+    uint8_t color[3];
+    std::memcpy(color, vertex + 6 * sizeof(float), 3);
+    uint32_t num_observations;
+    std::memcpy(&num_observations,
+                vertex + 6 * sizeof(float) + 3,
+                sizeof(num_observations));
+
+    for (int j = 0; j < 6; j++) {
+      double value;
+      ascii_stream >> value;
+      EXPECT_NEAR(position_and_normal[j], value, 1e-4);
+    }
+    for (int j = 0; j < 3; j++) {
+      int value;
+      ascii_stream >> value;
+      EXPECT_EQ(color[j], value);
+    }
+    int ascii_num_observations;
+    ascii_stream >> ascii_num_observations;
+    EXPECT_EQ(num_observations, ascii_num_observations);
+
+    // Points have unit normals and cameras (the last three vertices) have zero
+    // normals and no observations.
+    const Eigen::Map<const Eigen::Vector3f> normal(position_and_normal + 3);
+    if (i < num_binary_vertices - 3) {
+      EXPECT_NEAR(normal.norm(), 1.0, 1e-4);
+      EXPECT_GE(num_observations, 3);
+    } else {
+      EXPECT_EQ(normal.norm(), 0.0);
+      EXPECT_EQ(num_observations, 0);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace theia
@@ -33,6 +33,11 @@
 // Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
 
 #include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "theia/matching/brute_force_feature_matcher.h"
@@ -180,4 +185,147 @@ TEST(BruteForceFeatureMatcherTest, SymmetricMatches) {
   EXPECT_EQ(database.NumMatches(), 1);
 }
 
+TEST(BruteForceFeatureMatcherTest, MatchOnlyPendingImagePairs) {
+  // Set up descriptors.
+  KeypointsAndDescriptors features;
+  features.descriptors.resize(kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; i++) {
+    features.descriptors[i] =
+        VectorXf::Constant(kNumDescriptorDimensions, 1).normalized();
+  }
+  features.keypoints.resize(features.descriptors.size());
+
+  // Set options.
+  FeatureMatcherOptions options;
+  options.min_num_feature_matches = 0;
+  options.keep_only_symmetric_matches = false;
+  options.use_lowes_ratio = false;
+  options.perform_geometric_verification = false;
+  options.match_only_pending_image_pairs = true;
+
+  InMemoryFeaturesAndMatchesDatabase database;
+  database.PutFeatures("1", features);
+  database.PutFeatures("2", features);
+  database.PutFeatures("3", features);
+
+  // Mark a pair as already attempted by a previous run.
+  const std::vector<std::pair<std::string, std::string> > processed_pair = {
+      {"1", "2"}};
+  database.PutImagePairMatchStatuses(
+      processed_pair, {ImagePairMatchStatus::FAILED_VERIFICATION});
+
+  BruteForceFeatureMatcher matcher(options, &database);
+  matcher.AddImage("1");
+  matcher.AddImage("2");
+  matcher.AddImage("3");
+  matcher.MatchImages();
+
+  // Only the pending pairs should have been matched.
+  EXPECT_EQ(database.NumMatches(), 2);
+  const std::vector<std::pair<std::string, std::string> > all_pairs = {
+      {"1", "2"}, {"1", "3"}, {"2", "3"}};
+  const std::vector<ImagePairMatchStatus> statuses =
+      database.GetImagePairMatchStatuses(all_pairs);
+  EXPECT_EQ(statuses[0], ImagePairMatchStatus::FAILED_VERIFICATION);
+  EXPECT_EQ(statuses[1], ImagePairMatchStatus::MATCHED);
+  EXPECT_EQ(statuses[2], ImagePairMatchStatus::MATCHED);
+}
+
+// A matcher that accepts the image pairs involving image "1" during
+// verification and records whether the descriptors were available to it.
+class VerifyImageOneMatcher : public BruteForceFeatureMatcher {
+ public:
+  VerifyImageOneMatcher(const FeatureMatcherOptions& options,
+                        FeaturesAndMatchesDatabase* database)
+      : BruteForceFeatureMatcher(options, database),
+        num_verified_with_descriptors_(0) {}
+
+  // Written by the verification threads.
+  std::atomic<int> num_verified_with_descriptors_;
+
+ protected:
+  bool GeometricVerification(
+      const KeypointsAndDescriptors& features1,
+      const KeypointsAndDescriptors& features2,
+      const std::vector<IndexedFeatureMatch>& putative_matches,
+      ImagePairMatch* image_pair_match) override {
+    if (!features1.descriptors.empty() || !features2.descriptors.empty()) {
+      ++num_verified_with_descriptors_;
+    }
+    if (features1.image_name != "1") {
+      return false;
+    }
+    image_pair_match->correspondences.resize(putative_matches.size());
+    return true;
+  }
+};
+
+TEST(BruteForceFeatureMatcherTest, PipelinedGeometricVerification) {
+  // Set up descriptors.
+  KeypointsAndDescriptors features;
+  features.descriptors.resize(kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; i++) {
+    features.descriptors[i] =
+        VectorXf::Constant(kNumDescriptorDimensions, 1).normalized();
+  }
+  features.keypoints.resize(features.descriptors.size());
+
+  // Set options. Use a small queue so that the matching threads have to wait
+  // for the verification threads.
+  FeatureMatcherOptions options;
+  options.num_threads = 3;
+  options.num_verification_threads = 2;
+  options.verification_queue_capacity = 1;
+  options.min_num_feature_matches = 0;
+  options.keep_only_symmetric_matches = false;
+  options.use_lowes_ratio = false;
+  options.perform_geometric_verification = true;
+
+  static const int kNumImages = 6;
+  InMemoryFeaturesAndMatchesDatabase database;
+  VerifyImageOneMatcher matcher(options, &database);
+  for (int i = 1; i <= kNumImages; i++) {
+    database.PutFeatures(std::to_string(i), features);
+    matcher.AddImage(std::to_string(i));
+  }
+
+  // Record the matches that are streamed out of the verification threads.
+  std::mutex streamed_matches_mutex;
+  std::vector<std::pair<std::string, std::string> > streamed_matches;
+  matcher.SetImagePairMatchCallback(
+      [&](const ImagePairMatch& match) {
+        std::lock_guard<std::mutex> lock(streamed_matches_mutex);
+        streamed_matches.emplace_back(match.image1, match.image2);
+      });
+  matcher.MatchImages();
+
+  // Only the pairs with image "1" pass verification, and the verification
+  // does not receive descriptors since guided matching is disabled.
+  EXPECT_EQ(database.NumMatches(), kNumImages - 1);
+  EXPECT_EQ(matcher.num_verified_with_descriptors_, 0);
+
+  // Every stored match is also passed to the callback.
+  ASSERT_EQ(streamed_matches.size(), kNumImages - 1);
+  std::vector<std::pair<std::string, std::string> > stored_matches =
+      database.ImageNamesOfMatches();
+  std::sort(streamed_matches.begin(), streamed_matches.end());
+  std::sort(stored_matches.begin(), stored_matches.end());
+  EXPECT_EQ(streamed_matches, stored_matches);
+
+  std::vector<std::pair<std::string, std::string> > all_pairs;
+  for (int i = 1; i <= kNumImages; i++) {
+    for (int j = i + 1; j <= kNumImages; j++) {
+      all_pairs.emplace_back(std::to_string(i), std::to_string(j));
+    }
+  }
+  const std::vector<ImagePairMatchStatus> statuses =
+      database.GetImagePairMatchStatuses(all_pairs);
+  for (int i = 0; i < all_pairs.size(); i++) {
+    EXPECT_EQ(statuses[i],
+              all_pairs[i].first == "1"
+                  ? ImagePairMatchStatus::MATCHED
+                  : ImagePairMatchStatus::FAILED_VERIFICATION);
+  }
+}
+
 }  // namespace theia
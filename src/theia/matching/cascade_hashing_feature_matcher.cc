@@ -50,6 +50,7 @@
 #include "theia/matching/indexed_feature_match.h"
 #include "theia/util/lru_cache.h"
 #include "theia/util/map_util.h"
+#include "theia/util/random.h"
 #include "theia/util/threadpool.h"
 #include "theia/util/util.h"
 
@@ -83,8 +84,15 @@ std::shared_ptr<HashedImage> CascadeHashingFeatureMatcher::FetchHashedImage(
 void CascadeHashingFeatureMatcher::InitializeCascadeHasher(
     int descriptor_dimension) {
   CHECK_GT(descriptor_dimension, 0);
-  // Initialize the cascade hasher
-  cascade_hasher_.reset(new CascadeHasher());
+  // Initialize the cascade hasher. The projections are drawn from a dedicated
+  // stream so that they are reproducible when a generator is given.
+  if (this->options_.rng != nullptr) {
+    cascade_hasher_.reset(
+        new CascadeHasher(std::make_shared<RandomNumberGenerator>(
+            this->options_.rng->Stream(StreamIdFromString("CascadeHasher")))));
+  } else {
+    cascade_hasher_.reset(new CascadeHasher());
+  }
   CHECK(cascade_hasher_->Initialize(descriptor_dimension))
       << "Could not initialize the cascade hasher.";
 }
@@ -37,6 +37,7 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <string>
@@ -54,12 +55,80 @@
 #include "theia/sfm/camera_intrinsics_prior.h"
 #include "theia/sfm/two_view_match_geometric_verification.h"
 
+#include "theia/util/bounded_queue.h"
 #include "theia/util/map_util.h"
+#include "theia/util/random.h"
 #include "theia/util/threadpool.h"
 #include "theia/util/util.h"
 
 namespace theia {
+
+// The putative matches of an image pair that are handed from the matching stage
+// to the verification stage. Only the keypoints are kept in the features unless
+// guided matching, which needs the descriptors, is enabled.
+struct PutativeImagePairMatch {
+  KeypointsAndDescriptors features1;
+  KeypointsAndDescriptors features2;
+  std::vector<IndexedFeatureMatch> putative_matches;
+};
+
 namespace {
+
+// The features of the image pairs that a matching task processes are read from
+// the database in batches of this many pairs.
+static const int kNumImagePairsPerFeatureBatch = 5;
+
+// Reads the features of all images in the image pairs [start_index, end_index)
+// with one batched lookup. Images that appear in several pairs are read once,
+// and the number of pairs in the batch that use each image is counted so that
+// the features can be moved out of the batch by the last pair that uses them.
+void ReadFeaturesOfImagePairs(
+    FeaturesAndMatchesDatabase* features_and_matches_db,
+    const std::vector<std::pair<std::string, std::string>>& image_pairs,
+    const int start_index,
+    const int end_index,
+    std::unordered_map<std::string, KeypointsAndDescriptors>* batch_features,
+    std::unordered_map<std::string, int>* num_pairs_of_image) {
+  batch_features->clear();
+  num_pairs_of_image->clear();
+  for (int i = start_index; i < end_index; i++) {
+    ++(*num_pairs_of_image)[image_pairs[i].first];
+    ++(*num_pairs_of_image)[image_pairs[i].second];
+  }
+
+  std::vector<std::string> image_names;
+  image_names.reserve(num_pairs_of_image->size());
+  for (const auto& num_pairs : *num_pairs_of_image) {
+    image_names.emplace_back(num_pairs.first);
+  }
+
+  std::vector<KeypointsAndDescriptors> features =
+      features_and_matches_db->GetFeaturesOfImages(image_names);
+  batch_features->reserve(image_names.size());
+  for (int i = 0; i < image_names.size(); i++) {
+    batch_features->emplace(image_names[i], std::move(features[i]));
+  }
+}
+
+// Returns the features of the image from the batch. The features are moved out
+// of the batch for the last pair of the batch that uses the image and copied
+// for all other pairs.
+KeypointsAndDescriptors TakeFeaturesOfImage(
+    const std::string& image_name,
+    std::unordered_map<std::string, KeypointsAndDescriptors>* batch_features,
+    std::unordered_map<std::string, int>* num_pairs_of_image) {
+  auto features = batch_features->find(image_name);
+  CHECK(features != batch_features->end())
+      << "The features of image " << image_name << " were not read.";
+  int& num_remaining_pairs = FindOrDie(*num_pairs_of_image, image_name);
+  if (--num_remaining_pairs > 0) {
+    return features->second;
+  }
+  KeypointsAndDescriptors last_features = std::move(features->second);
+  batch_features->erase(features);
+  return last_features;
+}
+
 void SelectAllPairs(
     const std::vector<std::string>& image_names,
     std::vector<std::pair<std::string, std::string>>* pairs_to_match) {
@@ -75,6 +144,17 @@ void SelectAllPairs(
     }
   }
 }
+
+// Sets the feature indices of the image pair match from the indexed matches.
+void SetFeatureIndices(const std::vector<IndexedFeatureMatch>& matches,
+                       ImagePairMatch* image_pair_match) {
+  image_pair_match->feature_indices.reserve(matches.size());
+  for (const IndexedFeatureMatch& match : matches) {
+    image_pair_match->feature_indices.emplace_back(match.feature1_ind,
+                                                   match.feature2_ind);
+  }
+}
+
 }  // namespace
 
 FeatureMatcher::~FeatureMatcher() {}
@@ -101,6 +181,11 @@ void FeatureMatcher::SetImagePairsToMatch(
   pairs_to_match_ = pairs_to_match;
 }
 
+void FeatureMatcher::SetImagePairMatchCallback(
+    const std::function<void(const ImagePairMatch&)>& callback) {
+  image_pair_match_callback_ = callback;
+}
+
 void FeatureMatcher::MatchImages() {
   // If SetImagePairsToMatch has not been called, match all image-to-image
   // pairs.
@@ -108,11 +193,41 @@ void FeatureMatcher::MatchImages() {
     SelectAllPairs(image_names_, &pairs_to_match_);
   }
 
+  // Skip the image pairs that were already processed by a previous run.
+  if (options_.match_only_pending_image_pairs) {
+    RemoveProcessedImagePairs();
+  }
+
   // Add workers for matching. It is more efficient to let each thread compute
   // multiple matches at a time than add each matching task to the pool. This is
   // sort of like OpenMP's dynamic schedule in that it is able to balance
   // threads fairly efficiently.
   const int num_matches = pairs_to_match_.size();
+  if (num_matches == 0) {
+    return;
+  }
+
+  // Geometric verification runs in its own thread pool that consumes the
+  // putative matches as they are produced, so that a few pairs with long
+  // RANSAC runs do not hold up the descriptor matching of the others.
+  std::unique_ptr<BoundedQueue<PutativeImagePairMatch>> verification_queue;
+  std::unique_ptr<ThreadPool> verification_pool;
+  if (options_.perform_geometric_verification) {
+    const int num_verification_threads =
+        std::min(options_.num_verification_threads > 0
+                     ? options_.num_verification_threads
+                     : options_.num_threads,
+                 num_matches);
+    verification_queue.reset(new BoundedQueue<PutativeImagePairMatch>(
+        options_.verification_queue_capacity));
+    verification_pool.reset(new ThreadPool(num_verification_threads));
+    for (int i = 0; i < num_verification_threads; i++) {
+      verification_pool->Add(&FeatureMatcher::VerifyImagePairs,
+                             this,
+                             verification_queue.get());
+    }
+  }
+
   const int num_threads =
       std::min(options_.num_threads, static_cast<int>(num_matches));
   std::unique_ptr<ThreadPool> pool(new ThreadPool(num_threads));
@@ -120,78 +235,199 @@ void FeatureMatcher::MatchImages() {
       std::min(this->kMaxThreadingStepSize_, num_matches / num_threads);
   for (int i = 0; i < num_matches; i += interval_step) {
     const int end_interval = std::min(num_matches, i + interval_step);
-    pool->Add(&FeatureMatcher::MatchAndVerifyImagePairs, this, i, end_interval);
+    pool->Add(&FeatureMatcher::MatchImagePairs,
+              this,
+              i,
+              end_interval,
+              verification_queue.get());
   }
-  // Wait for all threads to finish.
+  // Wait for all threads to finish. Once matching is done, the verification
+  // workers drain the queue and return.
   pool.reset(nullptr);
+  if (verification_queue != nullptr) {
+    verification_queue->Close();
+    verification_pool.reset(nullptr);
+  }
 
   VLOG(1) << "Matched " << feature_and_matches_db_->NumMatches()
           << " image pairs out of " << num_matches
           << " pairs selected for matching.";
 }
 
-void FeatureMatcher::MatchAndVerifyImagePairs(const int start_index,
-                                              const int end_index) {
+void FeatureMatcher::RemoveProcessedImagePairs() {
+  const std::vector<ImagePairMatchStatus> statuses =
+      feature_and_matches_db_->GetImagePairMatchStatuses(pairs_to_match_);
+
+  int num_pending_pairs = 0;
+  for (int i = 0; i < pairs_to_match_.size(); i++) {
+    if (statuses[i] == ImagePairMatchStatus::PENDING) {
+      std::swap(pairs_to_match_[num_pending_pairs++], pairs_to_match_[i]);
+    }
+  }
+
+  VLOG(1) << "Skipping " << pairs_to_match_.size() - num_pending_pairs
+          << " image pairs that were already processed.";
+  pairs_to_match_.resize(num_pending_pairs);
+}
+
+void FeatureMatcher::MatchImagePairs(
+    const int start_index,
+    const int end_index,
+    BoundedQueue<PutativeImagePairMatch>* verification_queue) {
+  // The status of each image pair is written to the database in one batch
+  // after all pairs have been processed. If matching is interrupted before
+  // then, the pairs remain PENDING and are matched again when resuming. Pairs
+  // that are passed on to verification get their status from the verification
+  // stage.
+  std::vector<std::pair<std::string, std::string>> processed_pairs;
+  std::vector<ImagePairMatchStatus> statuses;
+  processed_pairs.reserve(end_index - start_index);
+  statuses.reserve(end_index - start_index);
+
+  // The features are read from the database in batches of image pairs. The
+  // matching tasks of the other threads keep the CPU busy while one task waits
+  // on a read, so each batch is read synchronously when it is reached.
+  std::unordered_map<std::string, KeypointsAndDescriptors> batch_features;
+  std::unordered_map<std::string, int> num_pairs_of_image;
   for (int i = start_index; i < end_index; i++) {
+    if ((i - start_index) % kNumImagePairsPerFeatureBatch == 0) {
+      ReadFeaturesOfImagePairs(
+          feature_and_matches_db_,
+          pairs_to_match_,
+          i,
+          std::min(end_index, i + kNumImagePairsPerFeatureBatch),
+          &batch_features,
+          &num_pairs_of_image);
+    }
+
     const std::string image1_name = pairs_to_match_[i].first;
     const std::string image2_name = pairs_to_match_[i].second;
 
-    // Match the image pair. If the pair fails to match then continue to the
-    // next match.
-    ImagePairMatch image_pair_match;
-    image_pair_match.image1 = image1_name;
-    image_pair_match.image2 = image2_name;
-
-    // Get the keypoints and descriptors from the db.
-    const KeypointsAndDescriptors& features1 =
-        feature_and_matches_db_->GetFeatures(image1_name);
-    const KeypointsAndDescriptors& features2 =
-        feature_and_matches_db_->GetFeatures(image2_name);
+    // Get the keypoints and descriptors from the batch.
+    PutativeImagePairMatch putative_image_pair_match;
+    KeypointsAndDescriptors& features1 = putative_image_pair_match.features1;
+    KeypointsAndDescriptors& features2 = putative_image_pair_match.features2;
+    features1 =
+        TakeFeaturesOfImage(image1_name, &batch_features, &num_pairs_of_image);
+    features2 =
+        TakeFeaturesOfImage(image2_name, &batch_features, &num_pairs_of_image);
+    features1.image_name = image1_name;
+    features2.image_name = image2_name;
 
-    // Compute the visual matches from feature descriptors.
-    std::vector<IndexedFeatureMatch> putative_matches;
+    // Compute the visual matches from feature descriptors. If the pair fails to
+    // match then continue to the next match.
+    std::vector<IndexedFeatureMatch>& putative_matches =
+        putative_image_pair_match.putative_matches;
     if (!MatchImagePair(features1, features2, &putative_matches)) {
       VLOG(2)
           << "Could not match a sufficient number of features between images "
           << image1_name << " and " << image2_name;
+      processed_pairs.emplace_back(pairs_to_match_[i]);
+      statuses.emplace_back(ImagePairMatchStatus::FAILED_MATCHING);
       continue;
     }
 
-    // Perform geometric verification if applicable.
-    if (options_.perform_geometric_verification) {
-      // If geometric verification fails, do not add the match to the output.
-      if (!GeometricVerification(
-              features1, features2, putative_matches, &image_pair_match)) {
-        VLOG(2) << "Geometric verification between images " << image1_name
-                << " and " << image2_name << " failed.";
-        continue;
-      }
-    } else {
-      // If no geometric verification is performed then the putative matches are
-      // output.
-      image_pair_match.correspondences.reserve(putative_matches.size());
-      for (int i = 0; i < putative_matches.size(); i++) {
-        const Keypoint& keypoint1 =
-            features1.keypoints[putative_matches[i].feature1_ind];
-        const Keypoint& keypoint2 =
-            features2.keypoints[putative_matches[i].feature2_ind];
-        image_pair_match.correspondences.emplace_back(
-            Feature(keypoint1.x(), keypoint1.y()),
-            Feature(keypoint2.x(), keypoint2.y()));
+    // Hand the pair to the verification stage. The descriptors are only needed
+    // for guided matching, so they are released here rather than held in the
+    // queue.
+    if (verification_queue != nullptr) {
+      if (!options_.geometric_verification_options.guided_matching) {
+        std::vector<Eigen::VectorXf>().swap(features1.descriptors);
+        std::vector<Eigen::VectorXf>().swap(features2.descriptors);
       }
+      verification_queue->Push(std::move(putative_image_pair_match));
+      continue;
     }
 
-    // Log information about the matching results.
+    // If no geometric verification is performed then the putative matches are
+    // output.
+    ImagePairMatch image_pair_match;
+    image_pair_match.image1 = image1_name;
+    image_pair_match.image2 = image2_name;
+    SetFeatureIndices(putative_matches, &image_pair_match);
+    CHECK(ResolveCorrespondences(
+        features1.keypoints, features2.keypoints, &image_pair_match));
+
     VLOG(1) << "Images " << image1_name << " and " << image2_name
-            << " were matched with " << image_pair_match.correspondences.size()
-            << " verified matches and "
-            << image_pair_match.twoview_info.num_homography_inliers
-            << " homography matches out of " << putative_matches.size()
+            << " were matched with " << putative_matches.size()
             << " putative matches.";
 
     // This operation is thread safe.
     feature_and_matches_db_->PutImagePairMatch(
         image1_name, image2_name, image_pair_match);
+    if (image_pair_match_callback_) {
+      image_pair_match_callback_(image_pair_match);
+    }
+    processed_pairs.emplace_back(pairs_to_match_[i]);
+    statuses.emplace_back(ImagePairMatchStatus::MATCHED);
+  }
+
+  if (!processed_pairs.empty()) {
+    feature_and_matches_db_->PutImagePairMatchStatuses(processed_pairs,
+                                                       statuses);
+  }
+}
+
+void FeatureMatcher::VerifyImagePairs(
+    BoundedQueue<PutativeImagePairMatch>* verification_queue) {
+  // Statuses are written in batches of kMaxThreadingStepSize_ pairs, and only
+  // after the matches of those pairs have been written.
+  std::vector<std::pair<std::string, std::string>> processed_pairs;
+  std::vector<ImagePairMatchStatus> statuses;
+  processed_pairs.reserve(kMaxThreadingStepSize_);
+  statuses.reserve(kMaxThreadingStepSize_);
+
+  PutativeImagePairMatch putative_image_pair_match;
+  while (verification_queue->Pop(&putative_image_pair_match)) {
+    const KeypointsAndDescriptors& features1 =
+        putative_image_pair_match.features1;
+    const KeypointsAndDescriptors& features2 =
+        putative_image_pair_match.features2;
+    const std::vector<IndexedFeatureMatch>& putative_matches =
+        putative_image_pair_match.putative_matches;
+    processed_pairs.emplace_back(features1.image_name, features2.image_name);
+
+    ImagePairMatch image_pair_match;
+    image_pair_match.image1 = features1.image_name;
+    image_pair_match.image2 = features2.image_name;
+
+    // If geometric verification fails, do not add the match to the output.
+    if (!GeometricVerification(
+            features1, features2, putative_matches, &image_pair_match)) {
+      VLOG(2) << "Geometric verification between images "
+              << features1.image_name << " and " << features2.image_name
+              << " failed.";
+      statuses.emplace_back(ImagePairMatchStatus::FAILED_VERIFICATION);
+    } else {
+      // Log information about the matching results.
+      VLOG(1) << "Images " << features1.image_name << " and "
+              << features2.image_name << " were matched with "
+              << image_pair_match.correspondences.size()
+              << " verified matches and "
+              << image_pair_match.twoview_info.num_homography_inliers
+              << " homography matches out of " << putative_matches.size()
+              << " putative matches.";
+
+      // This operation is thread safe.
+      feature_and_matches_db_->PutImagePairMatch(
+          features1.image_name, features2.image_name, image_pair_match);
+      if (image_pair_match_callback_) {
+        image_pair_match_callback_(image_pair_match);
+      }
+      statuses.emplace_back(ImagePairMatchStatus::MATCHED);
+    }
+
+    if (processed_pairs.size() >= kMaxThreadingStepSize_) {
+      feature_and_matches_db_->PutImagePairMatchStatuses(processed_pairs,
+                                                         statuses);
+      processed_pairs.clear();
+      statuses.clear();
+    }
+  }
+
+  if (!processed_pairs.empty()) {
+    feature_and_matches_db_->PutImagePairMatchStatuses(processed_pairs,
+                                                       statuses);
   }
 }
 
@@ -214,8 +450,24 @@ bool FeatureMatcher::GeometricVerification(
         features2.image_name);
   }
 
+  // Give each image pair its own random stream, keyed by the image names, so
+  // that the verification does not depend on the thread or the order in which
+  // the pairs are processed.
+  TwoViewMatchGeometricVerification::Options verification_options =
+      options_.geometric_verification_options;
+  std::shared_ptr<RandomNumberGenerator>& rng =
+      verification_options.estimate_twoview_info_options.rng;
+  if (options_.rng != nullptr) {
+    rng = options_.rng;
+  }
+  if (rng != nullptr) {
+    rng = std::make_shared<RandomNumberGenerator>(
+        rng->Stream(StreamIdFromString(features1.image_name))
+            .Stream(StreamIdFromString(features2.image_name)));
+  }
+
   TwoViewMatchGeometricVerification geometric_verification(
-      options_.geometric_verification_options,
+      verification_options,
       intrinsics1,
       intrinsics2,
       features1,
@@ -223,8 +475,13 @@ bool FeatureMatcher::GeometricVerification(
       putative_matches);
 
   // Return whether geometric verification succeeds.
-  return geometric_verification.VerifyMatches(
-      &image_pair_match->correspondences, &image_pair_match->twoview_info);
+  if (!geometric_verification.VerifyMatches(
+          &image_pair_match->correspondences, &image_pair_match->twoview_info)) {
+    return false;
+  }
+  SetFeatureIndices(geometric_verification.VerifiedMatchIndices(),
+                    image_pair_match);
+  return true;
 }
 
 }  // namespace theia
@@ -37,6 +37,7 @@
 
 #include <Eigen/Core>
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -47,11 +48,14 @@
 #include "theia/util/util.h"
 
 namespace theia {
+template <typename T>
+class BoundedQueue;
 class FeaturesAndMatchesDatabase;
 class Keypoint;
 struct ImagePairMatch;
 struct IndexedFeatureMatche;
 struct KeypointsAndDescriptors;
+struct PutativeImagePairMatch;
 
 // Class for matching features between images. The intended use for these
 // classes is for matching photos in image collections, so all pairwise matches
@@ -104,6 +108,13 @@ class FeatureMatcher {
   virtual void SetImagePairsToMatch(
       const std::vector<std::pair<std::string, std::string> >& pairs_to_match);
 
+  // Sets a callback that receives each image pair match after it has been
+  // written to the database, so that consumers can process the matches while
+  // the remaining pairs are matched. The callback is called concurrently from
+  // the matching and verification threads and must be thread safe.
+  void SetImagePairMatchCallback(
+      const std::function<void(const ImagePairMatch&)>& callback);
+
  protected:
   // NOTE: This method should be overridden in the subclass implementations!
   // Returns true if the image pair is a valid match.
@@ -112,11 +123,25 @@ class FeatureMatcher {
       const KeypointsAndDescriptors& features2,
       std::vector<IndexedFeatureMatch>* matched_features) = 0;
 
-  // Performs matching and geometric verification (if desired) on the
-  // pairs_to_match_ between the specified indices. This is useful for thread
-  // pooling.
-  virtual void MatchAndVerifyImagePairs(const int start_index,
-                                        const int end_index);
+  // Removes the image pairs from pairs_to_match_ that already have a matching
+  // status other than PENDING in the database. The order of the remaining
+  // pairs is preserved.
+  void RemoveProcessedImagePairs();
+
+  // Performs descriptor matching on the pairs_to_match_ between the specified
+  // indices. This is useful for thread pooling. If verification_queue is not
+  // a nullptr, the putative matches are pushed to it for geometric
+  // verification. Otherwise, the putative matches are written directly to the
+  // database.
+  virtual void MatchImagePairs(
+      const int start_index,
+      const int end_index,
+      BoundedQueue<PutativeImagePairMatch>* verification_queue);
+
+  // Performs geometric verification on the image pairs popped from the queue
+  // until it is closed and empty. Each verification worker runs this method.
+  virtual void VerifyImagePairs(
+      BoundedQueue<PutativeImagePairMatch>* verification_queue);
 
   // Performs geometric verification. By making this a virtual method, derived
   // classes may implement custom verification methods (e.g., if rotations are
@@ -142,6 +167,9 @@ class FeatureMatcher {
   // DB to store and retrieve features and matches.
   FeaturesAndMatchesDatabase* feature_and_matches_db_;
 
+  // Called with each image pair match that is written to the database.
+  std::function<void(const ImagePairMatch&)> image_pair_match_callback_;
+
   // Pairs that we will perform matching on.
   std::vector<std::pair<std::string, std::string> > pairs_to_match_;
 
@@ -35,17 +35,37 @@
 #ifndef THEIA_MATCHING_FEATURE_MATCHER_OPTIONS_H_
 #define THEIA_MATCHING_FEATURE_MATCHER_OPTIONS_H_
 
+#include <memory>
 #include <string>
 
 #include "theia/sfm/two_view_match_geometric_verification.h"
 
 namespace theia {
+class RandomNumberGenerator;
 
 // Options for matching image collections.
 struct FeatureMatcherOptions {
   // Number of threads to use in parallel for matching.
   int num_threads = 1;
 
+  // When geometric verification is performed, descriptor matching and
+  // verification run as two pipelined stages with their own thread pools. The
+  // putative matches of each image pair are handed from the matching stage to
+  // the verification stage through a queue that holds at most
+  // verification_queue_capacity image pairs, so matching threads wait rather
+  // than buffer more pairs when verification falls behind. The number of
+  // verification threads defaults to num_threads if it is not positive.
+  int num_verification_threads = 0;
+  int verification_queue_capacity = 64;
+
+  // The random number generator for the randomized parts of matching (e.g.,
+  // the cascade hashing projections and the RANSAC of geometric
+  // verification). Each image pair uses its own stream of this generator, so
+  // the matches do not depend on the number of threads. If this is a nullptr,
+  // the generator of geometric_verification_options is used instead, and if
+  // that is also a nullptr the generators are seeded from the current time.
+  std::shared_ptr<RandomNumberGenerator> rng;
+
   // Only symmetric matches are kept.
   bool keep_only_symmetric_matches = true;
 
@@ -68,6 +88,12 @@ struct FeatureMatcherOptions {
   // Only images that contain more feature matches than this number will be
   // returned.
   int min_num_feature_matches = 30;
+
+  // The outcome of matching each image pair is recorded in the features and
+  // matches database. If set to true, only the image pairs that have not been
+  // matched yet (i.e. those with a PENDING status) are matched. This allows
+  // matching jobs that were interrupted to resume where they left off.
+  bool match_only_pending_image_pairs = false;
 };
 
 }  // namespace theia
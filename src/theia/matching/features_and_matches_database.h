@@ -35,6 +35,8 @@
 #ifndef THEIA_MATCHING_FEATURES_AND_MATCHES_DATABASE_H_
 #define THEIA_MATCHING_FEATURES_AND_MATCHES_DATABASE_H_
 
+#include <glog/logging.h>
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -45,6 +47,16 @@
 
 namespace theia {
 
+// The outcome of matching an image pair. Pairs are PENDING until matching has
+// been attempted so that interrupted matching jobs can skip the pairs that
+// were already processed.
+enum class ImagePairMatchStatus {
+  PENDING = 0,
+  MATCHED = 1,
+  FAILED_MATCHING = 2,
+  FAILED_VERIFICATION = 3,
+};
+
 // An interface for retreiving feature and match related data. This data is
 // typically memory intensive so caches or database systems may be used to
 // access the data more efficiently. This class is guaranteed to be thread safe.
@@ -73,15 +85,48 @@ class FeaturesAndMatchesDatabase {
   virtual KeypointsAndDescriptors GetFeatures(
       const std::string& image_name) = 0;
 
+  // Get only the keypoints of the image. Stages that only need the keypoint
+  // positions (e.g., geometric verification and track building) should use
+  // this method since descriptors are typically most of the feature data.
+  virtual std::vector<Keypoint> GetKeypoints(
+      const std::string& image_name) = 0;
+
+  // Get the features of several images. Databases that support batched lookups
+  // should override this so that the features of a chunk of image pairs can be
+  // read with one request.
+  virtual std::vector<KeypointsAndDescriptors> GetFeaturesOfImages(
+      const std::vector<std::string>& image_names) {
+    std::vector<KeypointsAndDescriptors> features;
+    features.reserve(image_names.size());
+    for (const std::string& image_name : image_names) {
+      features.emplace_back(GetFeatures(image_name));
+    }
+    return features;
+  }
+
   // Set the features for the image.
   virtual void PutFeatures(const std::string& image_name,
                            const KeypointsAndDescriptors& features) = 0;
 
+  // Set the features of several images. Databases that support batched writes
+  // should override this so that extracted features are written in bulk.
+  virtual void PutFeaturesOfImages(
+      const std::vector<std::string>& image_names,
+      const std::vector<KeypointsAndDescriptors>& features) {
+    CHECK_EQ(image_names.size(), features.size());
+    for (int i = 0; i < image_names.size(); i++) {
+      PutFeatures(image_names[i], features[i]);
+    }
+  }
+
   // Supply an iterator to iterate over the features.
   virtual std::vector<std::string> ImageNamesOfFeatures() = 0;
   virtual size_t NumImages() = 0;
 
-  // Get the image pair match for the images.
+  // Get the image pair match for the images. Databases that also store the
+  // keypoints may return only the feature indices of the match, in which case
+  // the correspondences can be recovered with ResolveCorrespondences and the
+  // keypoints from GetKeypoints.
   virtual ImagePairMatch GetImagePairMatch(const std::string& image_name1,
                                            const std::string& image_name2) = 0;
 
@@ -95,7 +140,19 @@ class FeaturesAndMatchesDatabase {
   ImageNamesOfMatches() = 0;
   virtual size_t NumMatches() = 0;
 
-  // Clear all matches from the DB.
+  // Get the matching status of each image pair. Pairs that do not have a
+  // recorded status are PENDING.
+  virtual std::vector<ImagePairMatchStatus> GetImagePairMatchStatuses(
+      const std::vector<std::pair<std::string, std::string>>& image_pairs) = 0;
+
+  // Set the matching status of the image pairs. All statuses are written in a
+  // single batch so callers should accumulate updates rather than writing the
+  // status of each pair individually.
+  virtual void PutImagePairMatchStatuses(
+      const std::vector<std::pair<std::string, std::string>>& image_pairs,
+      const std::vector<ImagePairMatchStatus>& statuses) = 0;
+
+  // Clear all matches and image pair match statuses from the DB.
   virtual void RemoveAllMatches() = 0;
 };
 }  // namespace theia
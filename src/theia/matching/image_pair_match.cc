@@ -0,0 +1,164 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+
+#include "theia/matching/image_pair_match.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/matching/feature_correspondence.h"
+#include "theia/sfm/feature.h"
+
+namespace theia {
+
+namespace {
+
+void AppendVarint(uint64_t value, std::string* output) {
+  while (value >= 0x80) {
+    output->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  output->push_back(static_cast<char>(value));
+}
+
+bool ReadVarint(const std::string& input, size_t* position, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *position < input.size(); shift += 7) {
+    const uint8_t byte = static_cast<uint8_t>(input[(*position)++]);
+    *value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Maps signed integers to unsigned integers so that values with a small
+// magnitude have a short varint encoding.
+inline uint64_t ZigZagEncode(const int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t ZigZagDecode(const uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+}  // namespace
+
+void EncodeFeatureIndices(const std::vector<FeatureIndexPair>& feature_indices,
+                          std::string* encoded_feature_indices) {
+  CHECK_NOTNULL(encoded_feature_indices)->clear();
+  AppendVarint(feature_indices.size(), encoded_feature_indices);
+  if (feature_indices.empty()) {
+    return;
+  }
+
+  // The pairs are encoded in their original order so that they stay aligned
+  // with the correspondences. Matches are usually found in the order of the
+  // features in the first image, so the differences of both indices are small
+  // but may be negative and are zigzag encoded.
+  encoded_feature_indices->reserve(3 * feature_indices.size() + 4);
+  int64_t previous_feature1_ind = 0, previous_feature2_ind = 0;
+  for (const FeatureIndexPair& pair : feature_indices) {
+    AppendVarint(ZigZagEncode(pair.feature1_ind - previous_feature1_ind),
+                 encoded_feature_indices);
+    AppendVarint(ZigZagEncode(pair.feature2_ind - previous_feature2_ind),
+                 encoded_feature_indices);
+    previous_feature1_ind = pair.feature1_ind;
+    previous_feature2_ind = pair.feature2_ind;
+  }
+}
+
+bool DecodeFeatureIndices(const std::string& encoded_feature_indices,
+                          std::vector<FeatureIndexPair>* feature_indices) {
+  CHECK_NOTNULL(feature_indices)->clear();
+  // Matches serialized without indices have an empty encoding.
+  if (encoded_feature_indices.empty()) {
+    return true;
+  }
+
+  size_t position = 0;
+  uint64_t num_feature_indices;
+  if (!ReadVarint(encoded_feature_indices, &position, &num_feature_indices) ||
+      num_feature_indices > encoded_feature_indices.size()) {
+    return false;
+  }
+
+  feature_indices->reserve(num_feature_indices);
+  int64_t feature1_ind = 0, feature2_ind = 0;
+  for (uint64_t i = 0; i < num_feature_indices; i++) {
+    uint64_t feature1_delta, feature2_delta;
+    if (!ReadVarint(encoded_feature_indices, &position, &feature1_delta) ||
+        !ReadVarint(encoded_feature_indices, &position, &feature2_delta)) {
+      return false;
+    }
+    feature1_ind += ZigZagDecode(feature1_delta);
+    feature2_ind += ZigZagDecode(feature2_delta);
+    if (feature1_ind < 0 || feature1_ind > UINT32_MAX || feature2_ind < 0 ||
+        feature2_ind > UINT32_MAX) {
+      return false;
+    }
+    feature_indices->emplace_back(feature1_ind, feature2_ind);
+  }
+  return position == encoded_feature_indices.size();
+}
+
+bool ResolveCorrespondences(const std::vector<Keypoint>& keypoints1,
+                            const std::vector<Keypoint>& keypoints2,
+                            ImagePairMatch* match) {
+  CHECK_NOTNULL(match)->correspondences.clear();
+  match->correspondences.reserve(match->feature_indices.size());
+  for (const FeatureIndexPair& pair : match->feature_indices) {
+    if (pair.feature1_ind >= keypoints1.size() ||
+        pair.feature2_ind >= keypoints2.size()) {
+      LOG(ERROR) << "The feature indices of the image pair (" << match->image1
+                 << ", " << match->image2
+                 << ") are out of range for the keypoints.";
+      match->correspondences.clear();
+      return false;
+    }
+    const Keypoint& keypoint1 = keypoints1[pair.feature1_ind];
+    const Keypoint& keypoint2 = keypoints2[pair.feature2_ind];
+    match->correspondences.emplace_back(Feature(keypoint1.x(), keypoint1.y()),
+                                        Feature(keypoint2.x(), keypoint2.y()));
+  }
+  return true;
+}
+
+}  // namespace theia
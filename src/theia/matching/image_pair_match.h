@@ -37,7 +37,9 @@
 
 #include <cereal/access.hpp>
 #include <cereal/cereal.hpp>
+#include <cereal/types/string.hpp>
 #include <cereal/types/vector.hpp>
+#include <glog/logging.h>
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -47,6 +49,35 @@
 #include "theia/sfm/twoview_info.h"
 
 namespace theia {
+class Keypoint;
+
+// The indices of two corresponding features in the keypoints of the first and
+// second image of an image pair.
+struct FeatureIndexPair {
+  FeatureIndexPair() {}
+  FeatureIndexPair(const uint32_t feature1_ind, const uint32_t feature2_ind)
+      : feature1_ind(feature1_ind), feature2_ind(feature2_ind) {}
+
+  bool operator==(const FeatureIndexPair& other) const {
+    return feature1_ind == other.feature1_ind &&
+           feature2_ind == other.feature2_ind;
+  }
+
+  uint32_t feature1_ind;
+  uint32_t feature2_ind;
+};
+
+// Encodes the feature index pairs compactly and in their original order. The
+// differences between the indices of consecutive pairs are written as zigzag
+// coded varints, which typically needs 2-4 bytes per pair instead of the 32
+// bytes of a FeatureCorrespondence.
+void EncodeFeatureIndices(const std::vector<FeatureIndexPair>& feature_indices,
+                          std::string* encoded_feature_indices);
+
+// Decodes feature index pairs that were encoded with EncodeFeatureIndices.
+// Returns false if the encoding is malformed.
+bool DecodeFeatureIndices(const std::string& encoded_feature_indices,
+                          std::vector<FeatureIndexPair>* feature_indices);
 
 struct ImagePairMatch {
  public:
@@ -61,18 +92,49 @@ struct ImagePairMatch {
   // then this only contains inlier correspondences.
   std::vector<FeatureCorrespondence> correspondences;
 
+  // The indices of the matched features in the keypoints of image1 and image2.
+  // When both are set, feature_indices and correspondences describe the same
+  // matches in the same order. Databases that also store the keypoints may
+  // only store the indices, in which case correspondences is empty and the
+  // pixel coordinates can be recovered with ResolveCorrespondences. The
+  // indices are serialized with EncodeFeatureIndices, which preserves their
+  // order.
+  std::vector<FeatureIndexPair> feature_indices;
+
  private:
-  // Templated method for disk I/O with cereal. This method tells cereal which
+  // Templated methods for disk I/O with cereal. These methods tell cereal which
   // data members should be used when reading/writing to/from disk.
   friend class cereal::access;
   template <class Archive>
-  void serialize(Archive& ar, const std::uint32_t version) {  // NOLINT
+  void save(Archive& ar, const std::uint32_t version) const {  // NOLINT
+    std::string encoded_feature_indices;
+    EncodeFeatureIndices(feature_indices, &encoded_feature_indices);
+    ar(image1, image2, twoview_info, correspondences, encoded_feature_indices);
+  }
+
+  template <class Archive>
+  void load(Archive& ar, const std::uint32_t version) {  // NOLINT
     ar(image1, image2, twoview_info, correspondences);
+    feature_indices.clear();
+    if (version >= 1) {
+      std::string encoded_feature_indices;
+      ar(encoded_feature_indices);
+      CHECK(DecodeFeatureIndices(encoded_feature_indices, &feature_indices))
+          << "Could not decode the feature indices of the image pair ("
+          << image1 << ", " << image2 << ")";
+    }
   }
 };
 
+// Sets the correspondences of the image pair match to the pixel coordinates of
+// the keypoints referenced by its feature indices. Returns false if an index is
+// out of range for the keypoints.
+bool ResolveCorrespondences(const std::vector<Keypoint>& keypoints1,
+                            const std::vector<Keypoint>& keypoints2,
+                            ImagePairMatch* match);
+
 }  // namespace theia
 
-CEREAL_CLASS_VERSION(theia::ImagePairMatch, 0);
+CEREAL_CLASS_VERSION(theia::ImagePairMatch, 1);
 
 #endif  // THEIA_MATCHING_IMAGE_PAIR_MATCH_H_
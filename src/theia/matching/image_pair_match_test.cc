@@ -0,0 +1,138 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+
+#include <Eigen/Core>
+#include <cereal/archives/portable_binary.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/matching/image_pair_match.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+TEST(ImagePairMatch, EncodeAndDecodeFeatureIndices) {
+  RandomNumberGenerator rng(51);
+  std::vector<FeatureIndexPair> feature_indices;
+  for (int i = 0; i < 1000; i++) {
+    feature_indices.emplace_back(rng.RandInt(0, 5000), rng.RandInt(0, 5000));
+  }
+  feature_indices.emplace_back(0, UINT32_MAX);
+  feature_indices.emplace_back(UINT32_MAX, 0);
+
+  std::string encoded_feature_indices;
+  EncodeFeatureIndices(feature_indices, &encoded_feature_indices);
+  // The encoding should be much smaller than the pixel coordinates.
+  EXPECT_LT(encoded_feature_indices.size(),
+            feature_indices.size() * sizeof(FeatureCorrespondence) / 4);
+
+  std::vector<FeatureIndexPair> decoded_feature_indices;
+  ASSERT_TRUE(
+      DecodeFeatureIndices(encoded_feature_indices, &decoded_feature_indices));
+  ASSERT_EQ(decoded_feature_indices.size(), feature_indices.size());
+
+  // The decoded indices are in their original order.
+  EXPECT_EQ(decoded_feature_indices, feature_indices);
+
+  // Malformed encodings are rejected.
+  encoded_feature_indices.pop_back();
+  EXPECT_FALSE(
+      DecodeFeatureIndices(encoded_feature_indices, &decoded_feature_indices));
+}
+
+TEST(ImagePairMatch, SerializeFeatureIndices) {
+  ImagePairMatch match;
+  match.image1 = "image1";
+  match.image2 = "image2";
+  match.twoview_info.num_verified_matches = 3;
+  match.feature_indices = {{4, 2}, {1, 7}, {3, 3}};
+  for (const FeatureIndexPair& pair : match.feature_indices) {
+    match.correspondences.emplace_back(Feature(pair.feature1_ind, 0),
+                                       Feature(pair.feature2_ind, 0));
+  }
+
+  std::stringstream ss;
+  {
+    cereal::PortableBinaryOutputArchive output_archive(ss);
+    output_archive(match);
+  }
+  ImagePairMatch loaded_match;
+  {
+    cereal::PortableBinaryInputArchive input_archive(ss);
+    input_archive(loaded_match);
+  }
+
+  EXPECT_EQ(loaded_match.image1, match.image1);
+  EXPECT_EQ(loaded_match.image2, match.image2);
+  EXPECT_EQ(loaded_match.twoview_info.num_verified_matches, 3);
+  // The feature indices stay aligned with the correspondences.
+  EXPECT_EQ(loaded_match.feature_indices, match.feature_indices);
+  ASSERT_EQ(loaded_match.correspondences.size(), 3);
+  for (int i = 0; i < loaded_match.feature_indices.size(); i++) {
+    EXPECT_EQ(loaded_match.correspondences[i].feature1.x(),
+              loaded_match.feature_indices[i].feature1_ind);
+    EXPECT_EQ(loaded_match.correspondences[i].feature2.x(),
+              loaded_match.feature_indices[i].feature2_ind);
+  }
+}
+
+TEST(ImagePairMatch, ResolveCorrespondences) {
+  std::vector<Keypoint> keypoints1, keypoints2;
+  for (int i = 0; i < 10; i++) {
+    keypoints1.emplace_back(i, 2 * i, Keypoint::OTHER);
+    keypoints2.emplace_back(3 * i, 4 * i, Keypoint::OTHER);
+  }
+
+  ImagePairMatch match;
+  match.feature_indices = {{1, 2}, {5, 9}};
+  ASSERT_TRUE(ResolveCorrespondences(keypoints1, keypoints2, &match));
+  ASSERT_EQ(match.correspondences.size(), 2);
+  EXPECT_EQ(match.correspondences[0].feature1, Feature(1, 2));
+  EXPECT_EQ(match.correspondences[0].feature2, Feature(6, 8));
+  EXPECT_EQ(match.correspondences[1].feature1, Feature(5, 10));
+  EXPECT_EQ(match.correspondences[1].feature2, Feature(27, 36));
+
+  // Indices that are out of range cannot be resolved.
+  match.feature_indices.emplace_back(10, 0);
+  EXPECT_FALSE(ResolveCorrespondences(keypoints1, keypoints2, &match));
+  EXPECT_TRUE(match.correspondences.empty());
+}
+
+}  // namespace theia
@@ -96,6 +96,11 @@ KeypointsAndDescriptors InMemoryFeaturesAndMatchesDatabase::GetFeatures(
   return FindOrDie(features_, image_name);
 }
 
+std::vector<Keypoint> InMemoryFeaturesAndMatchesDatabase::GetKeypoints(
+    const std::string& image_name) {
+  return FindOrDie(features_, image_name).keypoints;
+}
+
 // Set the features for the image.
 void InMemoryFeaturesAndMatchesDatabase::PutFeatures(
     const std::string& image_name, const KeypointsAndDescriptors& features) {
@@ -145,6 +150,29 @@ size_t InMemoryFeaturesAndMatchesDatabase::NumMatches() {
   return matches_.size();
 }
 
+std::vector<ImagePairMatchStatus>
+InMemoryFeaturesAndMatchesDatabase::GetImagePairMatchStatuses(
+    const std::vector<std::pair<std::string, std::string>>& image_pairs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<ImagePairMatchStatus> statuses;
+  statuses.reserve(image_pairs.size());
+  for (const auto& image_pair : image_pairs) {
+    statuses.emplace_back(FindWithDefault(
+        match_statuses_, image_pair, ImagePairMatchStatus::PENDING));
+  }
+  return statuses;
+}
+
+void InMemoryFeaturesAndMatchesDatabase::PutImagePairMatchStatuses(
+    const std::vector<std::pair<std::string, std::string>>& image_pairs,
+    const std::vector<ImagePairMatchStatus>& statuses) {
+  CHECK_EQ(image_pairs.size(), statuses.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < image_pairs.size(); i++) {
+    match_statuses_[image_pairs[i]] = statuses[i];
+  }
+}
+
 bool InMemoryFeaturesAndMatchesDatabase::ReadFromFile(
     const std::string& filepath) {
   // Return false if the file cannot be opened.
@@ -212,6 +240,7 @@ bool InMemoryFeaturesAndMatchesDatabase::WriteToFile(
 
 void InMemoryFeaturesAndMatchesDatabase::RemoveAllMatches() {
   matches_.clear();
+  match_statuses_.clear();
 }
 
 }  // namespace theia
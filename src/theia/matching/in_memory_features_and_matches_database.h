@@ -39,6 +39,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "theia/io/read_keypoints_and_descriptors.h"
 #include "theia/io/write_keypoints_and_descriptors.h"
@@ -76,6 +77,7 @@ class InMemoryFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
 
   // Get/set the features for the image.
   KeypointsAndDescriptors GetFeatures(const std::string& image_name) override;
+  std::vector<Keypoint> GetKeypoints(const std::string& image_name) override;
 
   // Set the features for the image.
   void PutFeatures(const std::string& image_name,
@@ -99,6 +101,13 @@ class InMemoryFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
       override;
   size_t NumMatches() override;
 
+  std::vector<ImagePairMatchStatus> GetImagePairMatchStatuses(
+      const std::vector<std::pair<std::string, std::string>>& image_pairs)
+      override;
+  void PutImagePairMatchStatuses(
+      const std::vector<std::pair<std::string, std::string>>& image_pairs,
+      const std::vector<ImagePairMatchStatus>& statuses) override;
+
   bool ReadFromFile(const std::string& filepath);
   bool WriteToFile(const std::string& filepath);
 
@@ -112,6 +121,8 @@ class InMemoryFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
   std::unordered_map<std::string, KeypointsAndDescriptors> features_;
   std::unordered_map<std::pair<std::string, std::string>, ImagePairMatch>
       matches_;
+  std::unordered_map<std::pair<std::string, std::string>, ImagePairMatchStatus>
+      match_statuses_;
 };
 }  // namespace theia
 #endif  // THEIA_MATCHING_IN_MEMORY_FEATURES_AND_MATCHES_DATABASE_H_
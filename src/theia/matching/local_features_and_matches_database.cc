@@ -102,6 +102,14 @@ KeypointsAndDescriptors LocalFeaturesAndMatchesDatabase::GetFeatures(
   return features_cache_->Fetch(image_name);
 }
 
+std::vector<Keypoint> LocalFeaturesAndMatchesDatabase::GetKeypoints(
+    const std::string& image_name) {
+  std::vector<Keypoint> keypoints;
+  CHECK(ReadKeypoints(FeatureFilenameFromImage(directory_, image_name),
+                      &keypoints));
+  return keypoints;
+}
+
 // Set the features for the image.
 void LocalFeaturesAndMatchesDatabase::PutFeatures(
     const std::string& image_name, const KeypointsAndDescriptors& features) {
@@ -64,6 +64,10 @@ class LocalFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
   // the database and false otherwise.
   KeypointsAndDescriptors GetFeatures(const std::string& image_name) override;
 
+  // Get the keypoints of the image. Only the keypoints are read from the
+  // feature file, and the feature cache is not modified.
+  std::vector<Keypoint> GetKeypoints(const std::string& image_name) override;
+
   // Set the features for the image.
   void PutFeatures(const std::string& image_name,
                    const KeypointsAndDescriptors& features) override;
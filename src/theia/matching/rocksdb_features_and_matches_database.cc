@@ -34,9 +34,12 @@
 
 #include "theia/matching/rocksdb_features_and_matches_database.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <glog/logging.h>
 #include <istream>
+#include <memory>
 #include <mutex>
 #include <streambuf>
 #include <string>
@@ -48,9 +51,13 @@
 #include <cereal/types/vector.hpp>
 #include <rocksdb/db.h>
 #include <rocksdb/filter_policy.h>
+#include <rocksdb/slice_transform.h>
 #include <rocksdb/table.h>
 #include <rocksdb/statistics.h>
+#include <rocksdb/write_batch.h>
 
+#include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/io/eigen_serializable.h"
 #include "theia/matching/image_pair_match.h"
 #include "theia/matching/keypoints_and_descriptors.h"
 #include "theia/util/filesystem.h"
@@ -61,9 +68,17 @@ namespace theia {
 namespace {
 using StringPair = std::pair<std::string, std::string>;
 
-static const std::string kFeaturesColumnFamilyName =
+// Keypoints and descriptors are stored in separate column families so that
+// the keypoints, which are a small fraction of the bytes, can be read without
+// touching the descriptors.
+static const std::string kKeypointsColumnFamilyName = "keypoints";
+static const std::string kDescriptorsColumnFamilyName = "descriptors";
+// Older databases stored the keypoints and descriptors in a single value.
+static const std::string kLegacyFeaturesColumnFamilyName =
     "keypoints_and_descriptors";
 static const std::string kMatchesColumnFamilyName = "image_pair_matches";
+static const std::string kMatchStatusesColumnFamilyName =
+    "image_pair_match_statuses";
 static const std::string kIntrinsicsColumnFamilyName =
     "camera_intrinsics_prior";
 static const std::string kNamePairSeparator = "/";
@@ -78,10 +93,56 @@ struct ZeroCopyBuffer : std::streambuf {
   }
 };
 
+// Deserializes a value read from RocksDB without copying it.
+template <typename T>
+void DeserializeValue(const rocksdb::Slice& value, T* object) {
+  ZeroCopyBuffer buffer(value.data(), value.size());
+  std::istream ins(&buffer);
+  cereal::PortableBinaryInputArchive input_archive(ins);
+  input_archive(*object);
+}
+
+// The keys of the image pair matches are "image1/image2". This transform
+// extracts "image1/" so that all matches of an image share a prefix, which
+// allows prefix bloom filters to be used when scanning the matches of an
+// image.
+class FirstImageNameTransform : public rocksdb::SliceTransform {
+ public:
+  const char* Name() const override { return "theia.FirstImageNameTransform"; }
+
+  rocksdb::Slice Transform(const rocksdb::Slice& key) const override {
+    const char* separator = static_cast<const char*>(
+        memchr(key.data(), kNamePairSeparator[0], key.size()));
+    return rocksdb::Slice(key.data(), separator - key.data() + 1);
+  }
+
+  bool InDomain(const rocksdb::Slice& key) const override {
+    return memchr(key.data(), kNamePairSeparator[0], key.size()) != nullptr;
+  }
+};
+
+rocksdb::CompressionType ToRocksDbCompressionType(
+    const RocksDbCompressionType compression) {
+  switch (compression) {
+    case RocksDbCompressionType::NONE:
+      return rocksdb::kNoCompression;
+    case RocksDbCompressionType::SNAPPY:
+      return rocksdb::kSnappyCompression;
+    case RocksDbCompressionType::LZ4:
+      return rocksdb::kLZ4Compression;
+    case RocksDbCompressionType::ZSTD:
+      return rocksdb::kZSTD;
+    default:
+      LOG(FATAL) << "Invalid compression type specified.";
+      return rocksdb::kNoCompression;
+  }
+}
+
 // Creates a column family with the specified name and returns the handle.s
-rocksdb::ColumnFamilyHandle* CreateColumnFamily(const rocksdb::Options& options,
-                                                const std::string& column_name,
-                                                rocksdb::DB* database) {
+rocksdb::ColumnFamilyHandle* CreateColumnFamily(
+    const rocksdb::ColumnFamilyOptions& options,
+    const std::string& column_name,
+    rocksdb::DB* database) {
   rocksdb::ColumnFamilyHandle* temp_col_family_handle = nullptr;
   database->CreateColumnFamily(options, column_name, &temp_col_family_handle);
   return temp_col_family_handle;
@@ -92,16 +153,50 @@ std::string ComposeImageNamePair(const std::string& image1,
   return image1 + kNamePairSeparator + image2;
 }
 
-StringPair DecomposeImageNamePair(const std::string& image_pair) {
-  const auto delimiter_index = image_pair.find(kNamePairSeparator);
-  return std::make_pair(image_pair.substr(0, delimiter_index),
-                        image_pair.substr(delimiter_index + 1));
+StringPair DecomposeImageNamePair(const rocksdb::Slice& image_pair) {
+  const char* begin = image_pair.data();
+  const char* end = begin + image_pair.size();
+  const char* separator = std::find(begin, end, kNamePairSeparator[0]);
+  CHECK(separator != end) << "Invalid image pair key: "
+                          << image_pair.ToString();
+  return StringPair(std::string(begin, separator),
+                    std::string(separator + 1, end));
+}
+
+// Adds the keypoints and descriptors of the image to the write batch.
+void PutFeaturesInBatch(rocksdb::ColumnFamilyHandle* keypoints_handle,
+                        rocksdb::ColumnFamilyHandle* descriptors_handle,
+                        const std::string& image_name,
+                        const KeypointsAndDescriptors& features,
+                        rocksdb::WriteBatch* batch) {
+  std::stringstream keypoints_ss, descriptors_ss;
+  {
+    cereal::PortableBinaryOutputArchive output_archive(keypoints_ss);
+    output_archive(features.keypoints);
+  }
+  {
+    cereal::PortableBinaryOutputArchive output_archive(descriptors_ss);
+    output_archive(features.descriptors);
+  }
+
+  const rocksdb::Slice key(image_name);
+  batch->Put(keypoints_handle, key, keypoints_ss.str());
+  batch->Put(descriptors_handle, key, descriptors_ss.str());
 }
 }  // namespace
 
 RocksDbFeaturesAndMatchesDatabase::RocksDbFeaturesAndMatchesDatabase(
     const std::string& directory)
-    : directory_(directory) {
+    : RocksDbFeaturesAndMatchesDatabase(
+          directory, RocksDbFeaturesAndMatchesDatabaseOptions()) {}
+
+RocksDbFeaturesAndMatchesDatabase::RocksDbFeaturesAndMatchesDatabase(
+    const std::string& directory,
+    const RocksDbFeaturesAndMatchesDatabaseOptions& options)
+    : database_options_(options), directory_(directory) {
+  CHECK_GT(database_options_.block_cache_size_mb, 0);
+  CHECK_GT(database_options_.db_write_buffer_size_mb, 0);
+  CHECK_GT(database_options_.max_background_jobs, 0);
   AppendTrailingSlashIfNeeded(&directory_);
   InitializeRocksDB();
 }
@@ -109,18 +204,21 @@ RocksDbFeaturesAndMatchesDatabase::RocksDbFeaturesAndMatchesDatabase(
 void RocksDbFeaturesAndMatchesDatabase::InitializeRocksDB() {
   options_.reset(new rocksdb::Options);
   // Number of threads for writing to disk.
-  options_->max_background_jobs = 4;
-  options_->db_write_buffer_size = 1 << 30;
+  options_->max_background_jobs = database_options_.max_background_jobs;
+  options_->db_write_buffer_size =
+      static_cast<size_t>(database_options_.db_write_buffer_size_mb) << 20;
   // 1 MB.
   options_->bytes_per_sync = 1 << 20;
   options_->compaction_pri = rocksdb::kMinOverlappingRatio;
   options_->create_if_missing = true;
   options_->level_compaction_dynamic_level_bytes = true;
   options_->statistics = rocksdb::CreateDBStatistics();
+  options_->compression =
+      ToRocksDbCompressionType(database_options_.compression);
 
   rocksdb::BlockBasedTableOptions table_options;
-  // 512 MB.
-  table_options.block_cache = rocksdb::NewLRUCache(512 << 20);
+  table_options.block_cache = rocksdb::NewLRUCache(
+      static_cast<size_t>(database_options_.block_cache_size_mb) << 20);
   table_options.block_size = 16 * 1024;
   table_options.cache_index_and_filter_blocks = true;
   table_options.pin_l0_filter_and_index_blocks_in_cache = true;
@@ -128,6 +226,13 @@ void RocksDbFeaturesAndMatchesDatabase::InitializeRocksDB() {
   options_->table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(table_options));
 
+  // The matches are keyed by the name of the first image, so a prefix
+  // extractor on that name lets the matches of one image be range-scanned
+  // with prefix bloom filters.
+  matches_options_.reset(new rocksdb::ColumnFamilyOptions(*options_));
+  matches_options_->prefix_extractor.reset(new FirstImageNameTransform);
+  matches_options_->memtable_prefix_bloom_size_ratio = 0.1;
+
   // Get column family descriptors to open the database.
   std::vector<rocksdb::ColumnFamilyDescriptor> column_descriptors;
 
@@ -140,7 +245,11 @@ void RocksDbFeaturesAndMatchesDatabase::InitializeRocksDB() {
     LOG(INFO) << "Reading existing DB.";
     // Create column descriptors from the existing names.
     for (const std::string& column_family : existing_column_families) {
-      column_descriptors.emplace_back(column_family, *options_);
+      if (column_family == kMatchesColumnFamilyName) {
+        column_descriptors.emplace_back(column_family, *matches_options_);
+      } else {
+        column_descriptors.emplace_back(column_family, *options_);
+      }
     }
   } else {
     // RocksDB requires you to have the default column family when creating a
@@ -167,27 +276,82 @@ void RocksDbFeaturesAndMatchesDatabase::InitializeRocksDB() {
   // If the DB is new (i.e. no existing column families are present), then we
   // need to create the column families.
   if (existing_column_families.empty()) {
-    features_handle_.reset(CreateColumnFamily(
-        *options_, kFeaturesColumnFamilyName, database_.get()));
+    keypoints_handle_.reset(CreateColumnFamily(
+        *options_, kKeypointsColumnFamilyName, database_.get()));
+    descriptors_handle_.reset(CreateColumnFamily(
+        *options_, kDescriptorsColumnFamilyName, database_.get()));
     matches_handle_.reset(CreateColumnFamily(
-        *options_, kMatchesColumnFamilyName, database_.get()));
+        *matches_options_, kMatchesColumnFamilyName, database_.get()));
     intrinsics_prior_handle_.reset(CreateColumnFamily(
         *options_, kIntrinsicsColumnFamilyName, database_.get()));
+    match_statuses_handle_.reset(CreateColumnFamily(
+        *options_, kMatchStatusesColumnFamilyName, database_.get()));
   } else {
     // Otherwise, set up the mapping for the existing column families in the
     // database.
+    std::unique_ptr<rocksdb::ColumnFamilyHandle> legacy_features_handle;
     for (int i = 0; i < temp_col_family_handles.size(); i++) {
-      if (existing_column_families[i] == kFeaturesColumnFamilyName) {
-        features_handle_.reset(temp_col_family_handles[i]);
+      if (existing_column_families[i] == kKeypointsColumnFamilyName) {
+        keypoints_handle_.reset(temp_col_family_handles[i]);
+      } else if (existing_column_families[i] == kDescriptorsColumnFamilyName) {
+        descriptors_handle_.reset(temp_col_family_handles[i]);
+      } else if (existing_column_families[i] ==
+                 kLegacyFeaturesColumnFamilyName) {
+        legacy_features_handle.reset(temp_col_family_handles[i]);
       } else if (existing_column_families[i] == kMatchesColumnFamilyName) {
         matches_handle_.reset(temp_col_family_handles[i]);
       } else if (existing_column_families[i] == kIntrinsicsColumnFamilyName) {
         intrinsics_prior_handle_.reset(temp_col_family_handles[i]);
+      } else if (existing_column_families[i] ==
+                 kMatchStatusesColumnFamilyName) {
+        match_statuses_handle_.reset(temp_col_family_handles[i]);
       }
     }
+
+    // Databases created before match statuses were recorded do not contain the
+    // column family, so it is added here.
+    if (match_statuses_handle_ == nullptr) {
+      match_statuses_handle_.reset(CreateColumnFamily(
+          *options_, kMatchStatusesColumnFamilyName, database_.get()));
+    }
+    if (keypoints_handle_ == nullptr) {
+      keypoints_handle_.reset(CreateColumnFamily(
+          *options_, kKeypointsColumnFamilyName, database_.get()));
+    }
+    if (descriptors_handle_ == nullptr) {
+      descriptors_handle_.reset(CreateColumnFamily(
+          *options_, kDescriptorsColumnFamilyName, database_.get()));
+    }
+    if (legacy_features_handle != nullptr) {
+      SplitLegacyFeatures(legacy_features_handle.get());
+      database_->DropColumnFamily(legacy_features_handle.get());
+    }
   }
 }
 
+void RocksDbFeaturesAndMatchesDatabase::SplitLegacyFeatures(
+    rocksdb::ColumnFamilyHandle* legacy_features_handle) {
+  LOG(INFO) << "Splitting the features of the DB into separate keypoint and "
+               "descriptor column families.";
+  std::unique_ptr<rocksdb::Iterator> it(database_->NewIterator(
+      rocksdb::ReadOptions(), legacy_features_handle));
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    const rocksdb::Slice value = it->value();
+    ZeroCopyBuffer buffer(value.data(), value.size());
+    std::istream ins(&buffer);
+
+    KeypointsAndDescriptors features;
+    {
+      cereal::PortableBinaryInputArchive input_archive(ins);
+      input_archive(
+          features.image_name, features.keypoints, features.descriptors);
+    }
+    PutFeatures(it->key().ToString(), features);
+  }
+  CHECK(it->status().ok()) << "Could not read the features of the DB: "
+                           << it->status().ToString();
+}
+
 RocksDbFeaturesAndMatchesDatabase::~RocksDbFeaturesAndMatchesDatabase() {}
 
 bool RocksDbFeaturesAndMatchesDatabase::ContainsCameraIntrinsicsPrior(
@@ -271,59 +435,132 @@ bool RocksDbFeaturesAndMatchesDatabase::ContainsFeatures(
   const rocksdb::Slice key(image_name);
   rocksdb::PinnableSlice value;
   const rocksdb::Status status =
-      database_->Get(options, features_handle_.get(), key, &value);
+      database_->Get(options, keypoints_handle_.get(), key, &value);
   return !status.IsNotFound();
 }
 
 // Get/set the features for the image.
 KeypointsAndDescriptors RocksDbFeaturesAndMatchesDatabase::GetFeatures(
     const std::string& image_name) {
+  KeypointsAndDescriptors features;
+  features.keypoints = GetKeypoints(image_name);
+  features.image_name = image_name;
+
   rocksdb::ReadOptions options;
   const rocksdb::Slice key(image_name);
   rocksdb::PinnableSlice value;
   const rocksdb::Status status =
-      database_->Get(options, features_handle_.get(), key, &value);
+      database_->Get(options, descriptors_handle_.get(), key, &value);
   CHECK(!status.IsNotFound())
-      << "Could not find features for " << image_name << " in the database.";
+      << "Could not find descriptors for " << image_name << " in the database.";
 
-  // Create a stream wrapped around the rocksdb value.
-  ZeroCopyBuffer buffer(value.data(), value.size());
-  std::istream ins(&buffer);
+  DeserializeValue(value, &features.descriptors);
+  return features;
+}
 
-  // Load the keypoints and descriptors.
-  KeypointsAndDescriptors features;
-  {
-    cereal::PortableBinaryInputArchive input_archive(ins);
-    input_archive(
-        features.image_name, features.keypoints, features.descriptors);
+std::vector<KeypointsAndDescriptors>
+RocksDbFeaturesAndMatchesDatabase::GetFeaturesOfImages(
+    const std::vector<std::string>& image_names) {
+  const size_t num_images = image_names.size();
+  std::vector<KeypointsAndDescriptors> features(num_images);
+  if (num_images == 0) {
+    return features;
+  }
+
+  // Look up the keypoints and descriptors of all images with one MultiGet per
+  // column family so that RocksDB can batch the block reads.
+  const std::vector<rocksdb::Slice> keys(image_names.begin(),
+                                         image_names.end());
+  std::vector<rocksdb::PinnableSlice> keypoints_values(num_images);
+  std::vector<rocksdb::PinnableSlice> descriptors_values(num_images);
+  std::vector<rocksdb::Status> keypoints_statuses(num_images);
+  std::vector<rocksdb::Status> descriptors_statuses(num_images);
+  const rocksdb::ReadOptions options;
+  database_->MultiGet(options,
+                      keypoints_handle_.get(),
+                      num_images,
+                      keys.data(),
+                      keypoints_values.data(),
+                      keypoints_statuses.data());
+  database_->MultiGet(options,
+                      descriptors_handle_.get(),
+                      num_images,
+                      keys.data(),
+                      descriptors_values.data(),
+                      descriptors_statuses.data());
+
+  for (int i = 0; i < num_images; i++) {
+    CHECK(keypoints_statuses[i].ok() && descriptors_statuses[i].ok())
+        << "Could not find features for " << image_names[i]
+        << " in the database.";
+    features[i].image_name = image_names[i];
+    DeserializeValue(keypoints_values[i], &features[i].keypoints);
+    DeserializeValue(descriptors_values[i], &features[i].descriptors);
   }
   return features;
 }
 
+std::vector<Keypoint> RocksDbFeaturesAndMatchesDatabase::GetKeypoints(
+    const std::string& image_name) {
+  rocksdb::ReadOptions options;
+  const rocksdb::Slice key(image_name);
+  rocksdb::PinnableSlice value;
+  const rocksdb::Status status =
+      database_->Get(options, keypoints_handle_.get(), key, &value);
+  CHECK(!status.IsNotFound())
+      << "Could not find features for " << image_name << " in the database.";
+
+  std::vector<Keypoint> keypoints;
+  DeserializeValue(value, &keypoints);
+  return keypoints;
+}
+
 // Set the features for the image.
 void RocksDbFeaturesAndMatchesDatabase::PutFeatures(
     const std::string& image_name, const KeypointsAndDescriptors& features) {
-  std::stringstream ss;
-  {
-    cereal::PortableBinaryOutputArchive output_archive(ss);
-    output_archive(
-        features.image_name, features.keypoints, features.descriptors);
-  }
-
-  rocksdb::WriteOptions options;
-  const rocksdb::Slice key(image_name);
+  // Write the keypoints and descriptors atomically so that readers never see
+  // the keypoints of an image without its descriptors.
+  rocksdb::WriteBatch batch;
+  PutFeaturesInBatch(keypoints_handle_.get(),
+                     descriptors_handle_.get(),
+                     image_name,
+                     features,
+                     &batch);
   const rocksdb::Status status =
-      database_->Put(options, features_handle_.get(), key, ss.str());
+      database_->Write(rocksdb::WriteOptions(), &batch);
   CHECK(status.ok()) << "Could not insert features for " << image_name
                      << " into the database.";
 }
 
+void RocksDbFeaturesAndMatchesDatabase::PutFeaturesOfImages(
+    const std::vector<std::string>& image_names,
+    const std::vector<KeypointsAndDescriptors>& features) {
+  CHECK_EQ(image_names.size(), features.size());
+  if (image_names.empty()) {
+    return;
+  }
+
+  rocksdb::WriteBatch batch;
+  for (int i = 0; i < image_names.size(); i++) {
+    PutFeaturesInBatch(keypoints_handle_.get(),
+                       descriptors_handle_.get(),
+                       image_names[i],
+                       features[i],
+                       &batch);
+  }
+  const rocksdb::Status status =
+      database_->Write(rocksdb::WriteOptions(), &batch);
+  CHECK(status.ok()) << "Could not insert the features of "
+                     << image_names.size() << " images into the database: "
+                     << status.ToString();
+}
+
 std::vector<std::string>
 RocksDbFeaturesAndMatchesDatabase::ImageNamesOfFeatures() {
-  // Iterate over the features column family and grab the keys.
+  // Iterate over the keypoints column family and grab the keys.
   std::vector<std::string> image_names;
-  auto it =
-      database_->NewIterator(rocksdb::ReadOptions(), features_handle_.get());
+  std::unique_ptr<rocksdb::Iterator> it(
+      database_->NewIterator(rocksdb::ReadOptions(), keypoints_handle_.get()));
   for (it->SeekToFirst(); it->Valid(); it->Next()) {
     image_names.push_back(it->key().ToString());
   }
@@ -334,7 +571,7 @@ RocksDbFeaturesAndMatchesDatabase::ImageNamesOfFeatures() {
 size_t RocksDbFeaturesAndMatchesDatabase::NumImages() {
   std::uint64_t num_images;
   database_->GetIntProperty(
-      features_handle_.get(), "rocksdb.estimate-num-keys", &num_images);
+      keypoints_handle_.get(), "rocksdb.estimate-num-keys", &num_images);
   return static_cast<size_t>(num_images);
 }
 
@@ -352,16 +589,8 @@ ImagePairMatch RocksDbFeaturesAndMatchesDatabase::GetImagePairMatch(
   CHECK(!status.IsNotFound()) << "Could not find the image pair match for ("
                               << image_name1 << ", " << image_name2 << ")";
 
-  // Create a stream wrapped around the rocksdb value.
-  ZeroCopyBuffer buffer(value.data(), value.size());
-  std::istream ins(&buffer);
-
-  // Load the keypoints and descriptors.
   ImagePairMatch matches;
-  {
-    cereal::PortableBinaryInputArchive input_archive(ins);
-    input_archive(matches);
-  }
+  DeserializeValue(value, &matches);
   return matches;
 }
 
@@ -373,10 +602,27 @@ void RocksDbFeaturesAndMatchesDatabase::PutImagePairMatch(
   const std::string image_name_pair =
       ComposeImageNamePair(image_name1, image_name2);
 
+  // If the features of both images are in the database, only the feature
+  // indices are stored. The pixel coordinates of the correspondences can be
+  // recovered from the keypoints with ResolveCorrespondences.
+  const bool store_only_feature_indices =
+      !matches.feature_indices.empty() &&
+      (matches.correspondences.empty() ||
+       (ContainsFeatures(image_name1) && ContainsFeatures(image_name2)));
+
   std::stringstream ss;
   {
     cereal::PortableBinaryOutputArchive output_archive(ss);
-    output_archive(matches);
+    if (store_only_feature_indices) {
+      ImagePairMatch compact_matches;
+      compact_matches.image1 = matches.image1;
+      compact_matches.image2 = matches.image2;
+      compact_matches.twoview_info = matches.twoview_info;
+      compact_matches.feature_indices = matches.feature_indices;
+      output_archive(compact_matches);
+    } else {
+      output_archive(matches);
+    }
   }
 
   rocksdb::WriteOptions options;
@@ -388,17 +634,95 @@ void RocksDbFeaturesAndMatchesDatabase::PutImagePairMatch(
 
 std::vector<StringPair>
 RocksDbFeaturesAndMatchesDatabase::ImageNamesOfMatches() {
-  // Iterate over the features column family and grab the keys.
+  // Iterate over the matches column family and grab the keys. The scan touches
+  // every match once, so it should not evict the cached features.
+  rocksdb::ReadOptions options;
+  options.fill_cache = false;
+  options.total_order_seek = true;
   std::vector<StringPair> image_match_names;
-  auto it =
-      database_->NewIterator(rocksdb::ReadOptions(), matches_handle_.get());
+  image_match_names.reserve(NumMatches());
+  std::unique_ptr<rocksdb::Iterator> it(
+      database_->NewIterator(options, matches_handle_.get()));
   for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    image_match_names.push_back(DecomposeImageNamePair(it->key().ToString()));
+    image_match_names.emplace_back(DecomposeImageNamePair(it->key()));
   }
+  CHECK(it->status().ok()) << "Could not iterate over the image pair matches: "
+                           << it->status().ToString();
 
   return image_match_names;
 }
 
+bool RocksDbFeaturesAndMatchesDatabase::GetNextImagePairMatches(
+    const std::string& image_name1,
+    const std::string& image_name2,
+    const int max_num_matches,
+    std::vector<ImagePairMatch>* matches) {
+  CHECK_NOTNULL(matches)->clear();
+  CHECK_GT(max_num_matches, 0);
+
+  // The matches are streamed across the prefixes of all images, so the
+  // iterator must not be restricted to the prefix of the first key.
+  rocksdb::ReadOptions options;
+  options.fill_cache = false;
+  options.total_order_seek = true;
+  std::unique_ptr<rocksdb::Iterator> it(
+      database_->NewIterator(options, matches_handle_.get()));
+  if (image_name1.empty() && image_name2.empty()) {
+    it->SeekToFirst();
+  } else {
+    // Seek to the cursor position and skip past it if it is still present.
+    const std::string image_name_pair =
+        ComposeImageNamePair(image_name1, image_name2);
+    it->Seek(image_name_pair);
+    if (it->Valid() && it->key() == rocksdb::Slice(image_name_pair)) {
+      it->Next();
+    }
+  }
+
+  for (; it->Valid() && matches->size() < max_num_matches; it->Next()) {
+    // Deserialize directly from the iterator's value without copying.
+    matches->emplace_back();
+    DeserializeValue(it->value(), &matches->back());
+
+    // The key is authoritative for the names of the image pair.
+    const StringPair names = DecomposeImageNamePair(it->key());
+    matches->back().image1 = names.first;
+    matches->back().image2 = names.second;
+  }
+  CHECK(it->status().ok()) << "Could not iterate over the image pair matches: "
+                           << it->status().ToString();
+
+  return !matches->empty();
+}
+
+std::vector<ImagePairMatch>
+RocksDbFeaturesAndMatchesDatabase::GetImagePairMatchesOfImage(
+    const std::string& image_name1) {
+  // Seeking to the prefix of the image restricts the iterator to the matches
+  // of the image, and the prefix bloom filters skip the files without them.
+  const std::string prefix = image_name1 + kNamePairSeparator;
+  rocksdb::ReadOptions options;
+  options.prefix_same_as_start = true;
+  std::unique_ptr<rocksdb::Iterator> it(
+      database_->NewIterator(options, matches_handle_.get()));
+
+  std::vector<ImagePairMatch> matches;
+  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
+       it->Next()) {
+    matches.emplace_back();
+    DeserializeValue(it->value(), &matches.back());
+
+    // The key is authoritative for the names of the image pair.
+    matches.back().image1 = image_name1;
+    matches.back().image2 =
+        std::string(it->key().data() + prefix.size(),
+                    it->key().size() - prefix.size());
+  }
+  CHECK(it->status().ok()) << "Could not iterate over the matches of "
+                           << image_name1 << ": " << it->status().ToString();
+  return matches;
+}
+
 size_t RocksDbFeaturesAndMatchesDatabase::NumMatches() {
   std::uint64_t num_matches;
   database_->GetIntProperty(
@@ -406,14 +730,66 @@ size_t RocksDbFeaturesAndMatchesDatabase::NumMatches() {
   return static_cast<size_t>(num_matches);
 }
 
+std::vector<ImagePairMatchStatus>
+RocksDbFeaturesAndMatchesDatabase::GetImagePairMatchStatuses(
+    const std::vector<StringPair>& image_pairs) {
+  std::vector<ImagePairMatchStatus> statuses;
+  statuses.reserve(image_pairs.size());
+
+  rocksdb::ReadOptions options;
+  rocksdb::PinnableSlice value;
+  for (const StringPair& image_pair : image_pairs) {
+    const std::string image_name_pair =
+        ComposeImageNamePair(image_pair.first, image_pair.second);
+    value.Reset();
+    const rocksdb::Status status = database_->Get(
+        options, match_statuses_handle_.get(), image_name_pair, &value);
+    if (status.IsNotFound()) {
+      statuses.emplace_back(ImagePairMatchStatus::PENDING);
+      continue;
+    }
+    CHECK(status.ok() && value.size() == 1)
+        << "Could not read the match status for (" << image_pair.first << ", "
+        << image_pair.second << ")";
+    statuses.emplace_back(static_cast<ImagePairMatchStatus>(value.data()[0]));
+  }
+  return statuses;
+}
+
+void RocksDbFeaturesAndMatchesDatabase::PutImagePairMatchStatuses(
+    const std::vector<StringPair>& image_pairs,
+    const std::vector<ImagePairMatchStatus>& statuses) {
+  CHECK_EQ(image_pairs.size(), statuses.size());
+  if (image_pairs.empty()) {
+    return;
+  }
+
+  // Write all statuses with a single atomic write so that matching threads
+  // only pay for one write per batch of image pairs.
+  rocksdb::WriteBatch batch;
+  for (int i = 0; i < image_pairs.size(); i++) {
+    const char value = static_cast<char>(statuses[i]);
+    batch.Put(match_statuses_handle_.get(),
+              ComposeImageNamePair(image_pairs[i].first, image_pairs[i].second),
+              rocksdb::Slice(&value, 1));
+  }
+  const rocksdb::Status status =
+      database_->Write(rocksdb::WriteOptions(), &batch);
+  CHECK(status.ok()) << "Could not write image pair match statuses: "
+                     << status.ToString();
+}
+
 void RocksDbFeaturesAndMatchesDatabase::RemoveAllMatches() {
-  // Drop the column family handle -- this deletes all key/values in the column
-  // family.
+  // Drop the column family handles -- this deletes all key/values in the
+  // column families.
   database_->DropColumnFamily(matches_handle_.get());
+  database_->DropColumnFamily(match_statuses_handle_.get());
 
-  // Add the column family back again.
-  matches_handle_.reset(
-      CreateColumnFamily(*options_, kMatchesColumnFamilyName, database_.get()));
+  // Add the column families back again.
+  matches_handle_.reset(CreateColumnFamily(
+      *matches_options_, kMatchesColumnFamilyName, database_.get()));
+  match_statuses_handle_.reset(CreateColumnFamily(
+      *options_, kMatchStatusesColumnFamilyName, database_.get()));
 }
 
 }  // namespace theia
@@ -51,17 +51,49 @@
 namespace rocksdb {
 class ColumnFamilyHandle;
 class DB;
+struct ColumnFamilyOptions;
 struct Options;
 }  // namespace rocksdb
 
 namespace theia {
 
+// Compression of the values stored in the database. Descriptors are floating
+// point values that compress poorly, so LZ4 or NONE are usually the faster
+// choice for feature-heavy databases while ZSTD gives the smallest databases.
+enum class RocksDbCompressionType {
+  NONE = 0,
+  SNAPPY = 1,
+  LZ4 = 2,
+  ZSTD = 3,
+};
+
+// Tuning options of the RocksDB database. The defaults are suitable for a
+// single workstation; machines with more memory or faster disks should raise
+// the cache and write buffer sizes and the number of background jobs.
+struct RocksDbFeaturesAndMatchesDatabaseOptions {
+  // Size of the block cache that is shared by all column families.
+  int block_cache_size_mb = 512;
+
+  // Total size of the memtables of all column families before they are flushed
+  // to disk.
+  int db_write_buffer_size_mb = 1024;
+
+  // Number of threads for flushing and compacting the database in the
+  // background.
+  int max_background_jobs = 4;
+
+  RocksDbCompressionType compression = RocksDbCompressionType::SNAPPY;
+};
+
 // A simple implementation for storing features and feature matches. A local
 // filesystem and cache are used to retrieve the features efficiently. The
 // matches are kept in memory. This class is guaranteed to be thread safe.
 class RocksDbFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
  public:
   explicit RocksDbFeaturesAndMatchesDatabase(const std::string& directory);
+  RocksDbFeaturesAndMatchesDatabase(
+      const std::string& directory,
+      const RocksDbFeaturesAndMatchesDatabaseOptions& options);
   ~RocksDbFeaturesAndMatchesDatabase();
 
   bool ContainsCameraIntrinsicsPrior(const std::string& image_name) override;
@@ -85,10 +117,23 @@ class RocksDbFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
   // the database and false otherwise.
   KeypointsAndDescriptors GetFeatures(const std::string& image_name) override;
 
+  // Get only the keypoints of the image. The keypoints are stored in their own
+  // column family so the descriptors are never read.
+  std::vector<Keypoint> GetKeypoints(const std::string& image_name) override;
+
+  // Get the features of all images with a single batched lookup.
+  std::vector<KeypointsAndDescriptors> GetFeaturesOfImages(
+      const std::vector<std::string>& image_names) override;
+
   // Set the features for the image.
   void PutFeatures(const std::string& image_name,
                    const KeypointsAndDescriptors& features) override;
 
+  // Set the features of all images with a single atomic write.
+  void PutFeaturesOfImages(
+      const std::vector<std::string>& image_names,
+      const std::vector<KeypointsAndDescriptors>& features) override;
+
   // Supply an iterator to iterate over the features.
   std::vector<std::string> ImageNamesOfFeatures() override;
   size_t NumImages() override;
@@ -98,7 +143,9 @@ class RocksDbFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
   ImagePairMatch GetImagePairMatch(const std::string& image_name1,
                                    const std::string& image_name2) override;
 
-  // Set the image pair match for the images.
+  // Set the image pair match for the images. If the match has feature indices
+  // and the features of both images are in the database, the correspondences
+  // are not stored and the returned matches only contain the feature indices.
   void PutImagePairMatch(const std::string& image_name1,
                          const std::string& image_name2,
                          const ImagePairMatch& matches) override;
@@ -107,6 +154,29 @@ class RocksDbFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
       override;
   size_t NumMatches() override;
 
+  std::vector<ImagePairMatchStatus> GetImagePairMatchStatuses(
+      const std::vector<std::pair<std::string, std::string>>& image_pairs)
+      override;
+  void PutImagePairMatchStatuses(
+      const std::vector<std::pair<std::string, std::string>>& image_pairs,
+      const std::vector<ImagePairMatchStatus>& statuses) override;
+
+  // Reads up to max_num_matches image pair matches in key order, starting with
+  // the first match stored after the pair (image_name1, image_name2). Pass empty
+  // image names to start from the first match in the database. All matches may
+  // be streamed with bounded memory by passing the image names of the last
+  // returned match to the next call. Returns false if no matches remain.
+  bool GetNextImagePairMatches(const std::string& image_name1,
+                               const std::string& image_name2,
+                               const int max_num_matches,
+                               std::vector<ImagePairMatch>* matches);
+
+  // Get all image pair matches whose first image is image_name1. The matches
+  // are keyed by the name of the first image, so this is a range scan over
+  // the matches of the image rather than a scan of all matches.
+  std::vector<ImagePairMatch> GetImagePairMatchesOfImage(
+      const std::string& image_name1);
+
   void RemoveAllMatches() override;
 
  private:
@@ -114,12 +184,23 @@ class RocksDbFeaturesAndMatchesDatabase : public FeaturesAndMatchesDatabase {
 
   void InitializeRocksDB();
 
+  // Moves the features of a database that stores keypoints and descriptors in
+  // a single column family to the separate keypoint and descriptor column
+  // families.
+  void SplitLegacyFeatures(rocksdb::ColumnFamilyHandle* legacy_features_handle);
+
+  // Options of the column family of the matches, which is set up for range
+  // scans over the matches of each image.
+  std::unique_ptr<rocksdb::ColumnFamilyOptions> matches_options_;
+  RocksDbFeaturesAndMatchesDatabaseOptions database_options_;
   std::unique_ptr<rocksdb::Options> options_;
   std::string directory_;
   std::unique_ptr<rocksdb::DB> database_;
   std::unique_ptr<rocksdb::ColumnFamilyHandle> intrinsics_prior_handle_;
-  std::unique_ptr<rocksdb::ColumnFamilyHandle> features_handle_;
+  std::unique_ptr<rocksdb::ColumnFamilyHandle> keypoints_handle_;
+  std::unique_ptr<rocksdb::ColumnFamilyHandle> descriptors_handle_;
   std::unique_ptr<rocksdb::ColumnFamilyHandle> matches_handle_;
+  std::unique_ptr<rocksdb::ColumnFamilyHandle> match_statuses_handle_;
 };
 }  // namespace theia
 #endif  // THEIA_MATCHING_LOCAL_FEATURES_AND_MATCHES_DATABASE_H_
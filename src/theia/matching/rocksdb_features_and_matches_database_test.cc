@@ -1,5 +1,9 @@
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
 #include <gtest/gtest.h>
 #include <rocksdb/db.h>
+#include <sstream>
 
 #include "theia/matching/image_pair_match.h"
 #include "theia/matching/keypoints_and_descriptors.h"
@@ -105,6 +109,145 @@ TEST(RocksDbFeaturesAndMatchesDatabase, GetFeatureFromInputDB) {
   rocksdb::DestroyDB(db_directory, rocksdb::Options());
 }
 
+TEST(RocksDbFeaturesAndMatchesDatabase, GetKeypoints) {
+  static const std::string kImageName = "image_name";
+  static const int kNumFeatures = 1000;
+
+  // Create some features.
+  KeypointsAndDescriptors features;
+  features.keypoints.resize(kNumFeatures);
+  features.descriptors.resize(kNumFeatures);
+  for (int i = 0; i < kNumFeatures; i++) {
+    features.keypoints[i] = Keypoint(i, i + 1, Keypoint::OTHER);
+    features.descriptors[i].setRandom();
+  }
+
+  RocksDbFeaturesAndMatchesDatabase db(db_directory);
+  db.PutFeatures(kImageName, features);
+
+  // Only the keypoints should be returned.
+  const std::vector<Keypoint> keypoints = db.GetKeypoints(kImageName);
+  ASSERT_EQ(keypoints.size(), kNumFeatures);
+  for (int i = 0; i < kNumFeatures; i++) {
+    EXPECT_EQ(keypoints[i].x(), features.keypoints[i].x());
+    EXPECT_EQ(keypoints[i].y(), features.keypoints[i].y());
+  }
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
+
+TEST(RocksDbFeaturesAndMatchesDatabase, FeaturesOfImages) {
+  static const int kNumImages = 5;
+  static const int kNumFeatures = 100;
+
+  std::vector<std::string> image_names(kNumImages);
+  std::vector<KeypointsAndDescriptors> features(kNumImages);
+  for (int i = 0; i < kNumImages; i++) {
+    image_names[i] = "image" + std::to_string(i);
+    features[i].keypoints.resize(kNumFeatures);
+    features[i].descriptors.resize(kNumFeatures);
+    for (int j = 0; j < kNumFeatures; j++) {
+      features[i].keypoints[j] = Keypoint(i, j, Keypoint::OTHER);
+      features[i].descriptors[j].setRandom(8);
+    }
+  }
+
+  RocksDbFeaturesAndMatchesDatabaseOptions options;
+  options.block_cache_size_mb = 16;
+  options.compression = RocksDbCompressionType::NONE;
+  RocksDbFeaturesAndMatchesDatabase db(db_directory, options);
+  db.PutFeaturesOfImages(image_names, features);
+  EXPECT_EQ(db.ImageNamesOfFeatures().size(), kNumImages);
+
+  // Read the features back in a different order, including duplicates.
+  const std::vector<std::string> requested_names = {
+      image_names[3], image_names[0], image_names[3]};
+  const std::vector<KeypointsAndDescriptors> db_features =
+      db.GetFeaturesOfImages(requested_names);
+  ASSERT_EQ(db_features.size(), requested_names.size());
+  for (int i = 0; i < requested_names.size(); i++) {
+    const KeypointsAndDescriptors expected_features =
+        db.GetFeatures(requested_names[i]);
+    EXPECT_EQ(db_features[i].image_name, requested_names[i]);
+    ASSERT_EQ(db_features[i].keypoints.size(), kNumFeatures);
+    ASSERT_EQ(db_features[i].descriptors.size(), kNumFeatures);
+    for (int j = 0; j < kNumFeatures; j++) {
+      EXPECT_EQ(db_features[i].keypoints[j].x(),
+                expected_features.keypoints[j].x());
+      EXPECT_EQ(db_features[i].keypoints[j].y(),
+                expected_features.keypoints[j].y());
+      EXPECT_EQ(db_features[i].descriptors[j],
+                expected_features.descriptors[j]);
+    }
+  }
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
+
+TEST(RocksDbFeaturesAndMatchesDatabase, SplitLegacyFeatures) {
+  static const std::string kImageName = "image_name";
+  static const int kNumFeatures = 100;
+
+  // Create some features.
+  KeypointsAndDescriptors features;
+  features.image_name = kImageName;
+  features.keypoints.resize(kNumFeatures);
+  features.descriptors.resize(kNumFeatures);
+  for (int i = 0; i < kNumFeatures; i++) {
+    features.keypoints[i] = Keypoint(i, i + 1, Keypoint::OTHER);
+    features.descriptors[i].setRandom(8);
+  }
+
+  // Write the features in the layout of older databases where keypoints and
+  // descriptors are stored together.
+  {
+    rocksdb::Options options;
+    options.create_if_missing = true;
+    std::vector<rocksdb::ColumnFamilyDescriptor> column_descriptors = {
+        rocksdb::ColumnFamilyDescriptor(rocksdb::kDefaultColumnFamilyName,
+                                        options)};
+    std::vector<rocksdb::ColumnFamilyHandle*> handles;
+    rocksdb::DB* database;
+    ASSERT_TRUE(rocksdb::DB::Open(
+                    options, db_directory, column_descriptors, &handles,
+                    &database)
+                    .ok());
+    rocksdb::ColumnFamilyHandle* features_handle;
+    ASSERT_TRUE(database
+                    ->CreateColumnFamily(
+                        options, "keypoints_and_descriptors", &features_handle)
+                    .ok());
+
+    std::stringstream ss;
+    {
+      cereal::PortableBinaryOutputArchive output_archive(ss);
+      output_archive(
+          features.image_name, features.keypoints, features.descriptors);
+    }
+    ASSERT_TRUE(database
+                    ->Put(rocksdb::WriteOptions(), features_handle, kImageName,
+                          ss.str())
+                    .ok());
+    delete features_handle;
+    delete handles[0];
+    delete database;
+  }
+
+  // Opening the database should move the features to the new layout.
+  RocksDbFeaturesAndMatchesDatabase db(db_directory);
+  EXPECT_TRUE(db.ContainsFeatures(kImageName));
+  const KeypointsAndDescriptors db_features = db.GetFeatures(kImageName);
+  ASSERT_EQ(db_features.keypoints.size(), kNumFeatures);
+  ASSERT_EQ(db_features.descriptors.size(), kNumFeatures);
+  for (int i = 0; i < kNumFeatures; i++) {
+    EXPECT_EQ(db_features.keypoints[i].x(), features.keypoints[i].x());
+    EXPECT_EQ(db_features.keypoints[i].y(), features.keypoints[i].y());
+    EXPECT_EQ(db_features.descriptors[i], features.descriptors[i]);
+  }
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
+
 TEST(RocksDbFeaturesAndMatchesDatabase, ContainsFeature) {
   static const int kNumFeatures = 1000;
   static const int kStringLength = 64;
@@ -155,6 +298,55 @@ TEST(RocksDbFeaturesAndMatchesDatabase, PutMatch) {}
 TEST(RocksDbFeaturesAndMatchesDatabase, GetMatchFromInputDB) {}
 
 TEST(RocksDbFeaturesAndMatchesDatabase, ContainsMatch) {}
+
+TEST(RocksDbFeaturesAndMatchesDatabase, CompactMatches) {
+  static const int kNumFeatures = 10;
+
+  KeypointsAndDescriptors features;
+  features.keypoints.resize(kNumFeatures);
+  features.descriptors.resize(kNumFeatures);
+  for (int i = 0; i < kNumFeatures; i++) {
+    features.keypoints[i] = Keypoint(i, i + 1, Keypoint::OTHER);
+    features.descriptors[i].setRandom();
+  }
+
+  ImagePairMatch match;
+  match.image1 = "a";
+  match.image2 = "b";
+  match.feature_indices = {{1, 2}, {3, 4}};
+  ASSERT_TRUE(
+      ResolveCorrespondences(features.keypoints, features.keypoints, &match));
+
+  RocksDbFeaturesAndMatchesDatabase db(db_directory);
+
+  // The correspondences are kept if the features are not in the database.
+  db.PutImagePairMatch(match.image1, match.image2, match);
+  EXPECT_EQ(db.GetImagePairMatch(match.image1, match.image2)
+                .correspondences.size(),
+            match.correspondences.size());
+
+  // Otherwise, only the feature indices are stored and the correspondences can
+  // be resolved from the keypoints.
+  db.PutFeatures(match.image1, features);
+  db.PutFeatures(match.image2, features);
+  db.PutImagePairMatch(match.image1, match.image2, match);
+  ImagePairMatch db_match = db.GetImagePairMatch(match.image1, match.image2);
+  EXPECT_TRUE(db_match.correspondences.empty());
+  EXPECT_EQ(db_match.feature_indices, match.feature_indices);
+  ASSERT_TRUE(ResolveCorrespondences(db.GetKeypoints(match.image1),
+                                     db.GetKeypoints(match.image2),
+                                     &db_match));
+  ASSERT_EQ(db_match.correspondences.size(), match.correspondences.size());
+  for (int i = 0; i < match.correspondences.size(); i++) {
+    EXPECT_EQ(db_match.correspondences[i].feature1,
+              match.correspondences[i].feature1);
+    EXPECT_EQ(db_match.correspondences[i].feature2,
+              match.correspondences[i].feature2);
+  }
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
+
 TEST(RocksDbFeaturesAndMatchesDatabase, MatchNames) {
   static const int kNumMatches = 1000;
   static const int kStringLength = 64;
@@ -182,4 +374,77 @@ TEST(RocksDbFeaturesAndMatchesDatabase, MatchNames) {
 
   rocksdb::DestroyDB(db_directory, rocksdb::Options());
 }
+
+TEST(RocksDbFeaturesAndMatchesDatabase, MatchesOfImage) {
+  const std::vector<std::pair<std::string, std::string>> image_pairs = {
+      {"a", "b"}, {"a", "c"}, {"ab", "c"}, {"b", "a"}, {"b", "c"}};
+
+  {
+    RocksDbFeaturesAndMatchesDatabase db(db_directory);
+    for (const auto& image_pair : image_pairs) {
+      ImagePairMatch match;
+      match.image1 = image_pair.first;
+      match.image2 = image_pair.second;
+      match.twoview_info.num_verified_matches = image_pair.second[0];
+      db.PutImagePairMatch(image_pair.first, image_pair.second, match);
+    }
+  }
+
+  // The matches of an image must not include the matches of images whose name
+  // starts with the same characters.
+  RocksDbFeaturesAndMatchesDatabase db(db_directory);
+  const std::vector<ImagePairMatch> matches = db.GetImagePairMatchesOfImage("a");
+  ASSERT_EQ(matches.size(), 2);
+  EXPECT_EQ(matches[0].image1, "a");
+  EXPECT_EQ(matches[0].image2, "b");
+  EXPECT_EQ(matches[0].twoview_info.num_verified_matches, 'b');
+  EXPECT_EQ(matches[1].image1, "a");
+  EXPECT_EQ(matches[1].image2, "c");
+  EXPECT_EQ(matches[1].twoview_info.num_verified_matches, 'c');
+
+  EXPECT_EQ(db.GetImagePairMatchesOfImage("ab").size(), 1);
+  EXPECT_EQ(db.GetImagePairMatchesOfImage("c").size(), 0);
+
+  // Streaming all matches must still visit every image.
+  std::vector<ImagePairMatch> all_matches;
+  EXPECT_TRUE(db.GetNextImagePairMatches("a", "c", 10, &all_matches));
+  ASSERT_EQ(all_matches.size(), 3);
+  EXPECT_EQ(all_matches[0].image1, "ab");
+  EXPECT_EQ(all_matches[2].image2, "c");
+  EXPECT_EQ(db.ImageNamesOfMatches().size(), image_pairs.size());
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
+
+TEST(RocksDbFeaturesAndMatchesDatabase, ImagePairMatchStatuses) {
+  const std::vector<std::pair<std::string, std::string>> image_pairs = {
+      {"a", "b"}, {"a", "c"}, {"b", "c"}};
+  const std::vector<ImagePairMatchStatus> statuses = {
+      ImagePairMatchStatus::MATCHED,
+      ImagePairMatchStatus::FAILED_MATCHING,
+      ImagePairMatchStatus::FAILED_VERIFICATION};
+
+  {
+    RocksDbFeaturesAndMatchesDatabase db(db_directory);
+    // Pairs without a recorded status are pending.
+    for (const auto status : db.GetImagePairMatchStatuses(image_pairs)) {
+      EXPECT_EQ(status, ImagePairMatchStatus::PENDING);
+    }
+    db.PutImagePairMatchStatuses(image_pairs, statuses);
+  }
+
+  {
+    // The statuses must persist after reopening the DB.
+    RocksDbFeaturesAndMatchesDatabase db(db_directory);
+    EXPECT_EQ(db.GetImagePairMatchStatuses(image_pairs), statuses);
+
+    // Removing the matches resets all pairs to pending.
+    db.RemoveAllMatches();
+    for (const auto status : db.GetImagePairMatchStatuses(image_pairs)) {
+      EXPECT_EQ(status, ImagePairMatchStatus::PENDING);
+    }
+  }
+
+  rocksdb::DestroyDB(db_directory, rocksdb::Options());
+}
 }  // namespace theia
@@ -38,6 +38,7 @@
 #include <ceres/ceres.h>
 #include <glog/logging.h>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -47,12 +48,14 @@
 #include "theia/sfm/camera/create_reprojection_error_cost_function.h"
 #include "theia/sfm/reconstruction.h"
 #include "theia/sfm/reconstruction_estimator_utils.h"
+#include "theia/sfm/track.h"
 #include "theia/sfm/types.h"
+#include "theia/sfm/view.h"
 #include "theia/util/map_util.h"
 #include "theia/util/timer.h"
 
 namespace theia {
-namespace {
+
 // Set the solver options to defaults.
 void SetSolverOptions(const BundleAdjustmentOptions& options,
                       ceres::Solver::Options* solver_options) {
@@ -77,7 +80,94 @@ void SetSolverOptions(const BundleAdjustmentOptions& options,
   solver_options->linear_solver_ordering.reset(
       new ceres::ParameterBlockOrdering);
 }
-}  // namespace
+
+double SelectLinearSolver(const BundleAdjustmentOptions& options,
+                          const Reconstruction& reconstruction,
+                          const std::unordered_set<ViewId>& optimized_views,
+                          const std::unordered_set<TrackId>& optimized_tracks,
+                          ceres::Solver::Options* solver_options) {
+  // Sparse factorization gains little over dense factorization for a reduced
+  // camera matrix with at least this density, so dense Schur is used for
+  // somewhat larger problems in that case.
+  static const double kMinDensityForDenseSchur = 0.5;
+  static const int kDenseReducedCameraMatrixViewsMultiplier = 2;
+  // Views that are coupled to at least this many other views on average are
+  // clustered by visibility for preconditioning. Otherwise the block diagonal
+  // of the reduced camera matrix is a good enough preconditioner.
+  static const double kMinMeanNumCoupledViewsForClusterJacobi = 50.0;
+
+  std::unordered_map<ViewId, int> view_indices;
+  view_indices.reserve(optimized_views.size());
+  for (const ViewId view_id : optimized_views) {
+    if (reconstruction.View(view_id)->IsEstimated()) {
+      view_indices.emplace(view_id, view_indices.size());
+    }
+  }
+  const int num_views = view_indices.size();
+  if (num_views == 0) {
+    return 0.0;
+  }
+
+  // Count the nonzero blocks of each row of the reduced camera matrix. Each
+  // view is stamped at most once per row so that views that share several
+  // tracks are only counted once.
+  int64_t num_nonzero_blocks = 0;
+  std::vector<int> row_stamps(num_views, -1);
+  for (const auto& view_index : view_indices) {
+    const View* view = reconstruction.View(view_index.first);
+    row_stamps[view_index.second] = view_index.second;
+    ++num_nonzero_blocks;
+    for (const TrackId track_id : view->TrackIds()) {
+      if (!ContainsKey(optimized_tracks, track_id)) {
+        continue;
+      }
+      const Track* track = reconstruction.Track(track_id);
+      if (!track->IsEstimated()) {
+        continue;
+      }
+      for (const ViewId coupled_view_id : track->ViewIds()) {
+        const int* coupled_view_index = FindOrNull(view_indices,
+                                                   coupled_view_id);
+        if (coupled_view_index == nullptr ||
+            row_stamps[*coupled_view_index] == view_index.second) {
+          continue;
+        }
+        row_stamps[*coupled_view_index] = view_index.second;
+        ++num_nonzero_blocks;
+      }
+    }
+  }
+  const double density = static_cast<double>(num_nonzero_blocks) /
+                         (static_cast<double>(num_views) * num_views);
+
+  if (num_views <= options.max_num_views_for_dense_schur ||
+      (density >= kMinDensityForDenseSchur &&
+       num_views <= kDenseReducedCameraMatrixViewsMultiplier *
+                        options.max_num_views_for_dense_schur)) {
+    solver_options->linear_solver_type = ceres::DENSE_SCHUR;
+  } else if (num_views < options.min_num_views_for_iterative_schur) {
+    solver_options->linear_solver_type = ceres::SPARSE_SCHUR;
+  } else {
+    solver_options->linear_solver_type = ceres::ITERATIVE_SCHUR;
+  }
+
+  const double mean_num_coupled_views = density * num_views - 1.0;
+  if (solver_options->linear_solver_type == ceres::ITERATIVE_SCHUR &&
+      mean_num_coupled_views >= kMinMeanNumCoupledViewsForClusterJacobi) {
+    solver_options->preconditioner_type = ceres::CLUSTER_JACOBI;
+  } else {
+    solver_options->preconditioner_type = ceres::SCHUR_JACOBI;
+  }
+
+  VLOG(2) << "Selected linear solver "
+          << ceres::LinearSolverTypeToString(solver_options->linear_solver_type)
+          << " with preconditioner "
+          << ceres::PreconditionerTypeToString(
+                 solver_options->preconditioner_type)
+          << " for " << num_views
+          << " views with a reduced camera matrix density of " << density;
+  return density;
+}
 
 BundleAdjuster::BundleAdjuster(const BundleAdjustmentOptions& options,
                                Reconstruction* reconstruction)
@@ -190,6 +280,15 @@ BundleAdjustmentSummary BundleAdjuster::Optimize() {
   // intrinsics model.
   SetCameraIntrinsicsParameterization();
 
+  double reduced_camera_matrix_density = 0.0;
+  if (options_.automatic_linear_solver_selection) {
+    reduced_camera_matrix_density = SelectLinearSolver(options_,
+                                                       *reconstruction_,
+                                                       optimized_views_,
+                                                       optimized_tracks_,
+                                                       &solver_options_);
+  }
+
   // NOTE: csweeney found a thread on the Ceres Solver email group that
   // indicated using the reverse BA order (i.e., using cameras then points) is a
   // good idea for inner iterations.
@@ -212,6 +311,9 @@ BundleAdjustmentSummary BundleAdjuster::Optimize() {
   summary.solve_time_in_seconds = solver_summary.total_time_in_seconds;
   summary.initial_cost = solver_summary.initial_cost;
   summary.final_cost = solver_summary.final_cost;
+  summary.linear_solver_type = solver_options_.linear_solver_type;
+  summary.preconditioner_type = solver_options_.preconditioner_type;
+  summary.reduced_camera_matrix_density = reduced_camera_matrix_density;
 
   // This only indicates whether the optimization was successfully run and makes
   // no guarantees on the quality or convergence.
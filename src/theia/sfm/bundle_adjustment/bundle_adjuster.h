@@ -50,6 +50,22 @@ class CameraIntrinsicsModel;
 class Reconstruction;
 class Track;
 
+// Sets the ceres solver options from the bundle adjustment options. The linear
+// solver ordering is reset to an empty ordering.
+void SetSolverOptions(const BundleAdjustmentOptions& options,
+                      ceres::Solver::Options* solver_options);
+
+// Chooses the linear solver and preconditioner of the solver options from the
+// number of optimized views and the density of the reduced camera matrix as
+// described in BundleAdjustmentOptions::automatic_linear_solver_selection. Two
+// optimized views are coupled in the reduced camera matrix if they observe a
+// common optimized track. Returns the density of the reduced camera matrix.
+double SelectLinearSolver(const BundleAdjustmentOptions& options,
+                          const Reconstruction& reconstruction,
+                          const std::unordered_set<ViewId>& optimized_views,
+                          const std::unordered_set<TrackId>& optimized_tracks,
+                          ceres::Solver::Options* solver_options);
+
 // This class sets up nonlinear optimization problems for bundle adjustment.
 // Bundle adjustment problems are set up by adding views and tracks to be
 // optimized. Only the views and tracks supplied with AddView and AddTrack will
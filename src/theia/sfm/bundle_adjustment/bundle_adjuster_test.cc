@@ -0,0 +1,135 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <ceres/ceres.h>
+#include <Eigen/Core>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjuster.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/view.h"
+
+namespace theia {
+
+namespace {
+
+static const int kNumViews = 6;
+
+// Creates a reconstruction where each view shares a track with the next view
+// and, if all_views_coupled is true, with all other views.
+void CreateReconstruction(const bool all_views_coupled,
+                          Reconstruction* reconstruction,
+                          std::unordered_set<ViewId>* view_ids,
+                          std::unordered_set<TrackId>* track_ids) {
+  for (int i = 0; i < kNumViews; i++) {
+    const ViewId view_id = reconstruction->AddView(std::to_string(i));
+    reconstruction->MutableView(view_id)->SetEstimated(true);
+    view_ids->emplace(view_id);
+  }
+
+  for (int i = 0; i < kNumViews; i++) {
+    for (int j = i + 1; j < kNumViews; j++) {
+      if (!all_views_coupled && j != i + 1) {
+        continue;
+      }
+      const TrackId track_id = reconstruction->AddTrack();
+      reconstruction->AddObservation(i, track_id, Feature(0, 0));
+      reconstruction->AddObservation(j, track_id, Feature(0, 0));
+      reconstruction->MutableTrack(track_id)->SetEstimated(true);
+      track_ids->emplace(track_id);
+    }
+  }
+}
+
+}  // namespace
+
+TEST(SelectLinearSolver, SmallProblemsUseDenseSchur) {
+  Reconstruction reconstruction;
+  std::unordered_set<ViewId> view_ids;
+  std::unordered_set<TrackId> track_ids;
+  CreateReconstruction(true, &reconstruction, &view_ids, &track_ids);
+
+  BundleAdjustmentOptions options;
+  ceres::Solver::Options solver_options;
+  const double density = SelectLinearSolver(
+      options, reconstruction, view_ids, track_ids, &solver_options);
+  EXPECT_DOUBLE_EQ(density, 1.0);
+  EXPECT_EQ(solver_options.linear_solver_type, ceres::DENSE_SCHUR);
+}
+
+TEST(SelectLinearSolver, SparseProblemsUseSparseSchur) {
+  Reconstruction reconstruction;
+  std::unordered_set<ViewId> view_ids;
+  std::unordered_set<TrackId> track_ids;
+  CreateReconstruction(false, &reconstruction, &view_ids, &track_ids);
+
+  BundleAdjustmentOptions options;
+  options.max_num_views_for_dense_schur = 2;
+  ceres::Solver::Options solver_options;
+  const double density = SelectLinearSolver(
+      options, reconstruction, view_ids, track_ids, &solver_options);
+
+  // Each view is coupled to itself and its neighbors in the chain.
+  EXPECT_DOUBLE_EQ(density,
+                   (kNumViews + 2.0 * (kNumViews - 1)) / (kNumViews * kNumViews));
+  EXPECT_EQ(solver_options.linear_solver_type, ceres::SPARSE_SCHUR);
+
+  // Tracks that are not optimized do not couple the views.
+  const double density_without_tracks = SelectLinearSolver(
+      options, reconstruction, view_ids, {}, &solver_options);
+  EXPECT_DOUBLE_EQ(density_without_tracks, 1.0 / kNumViews);
+}
+
+TEST(SelectLinearSolver, LargeProblemsUseIterativeSchur) {
+  Reconstruction reconstruction;
+  std::unordered_set<ViewId> view_ids;
+  std::unordered_set<TrackId> track_ids;
+  CreateReconstruction(true, &reconstruction, &view_ids, &track_ids);
+
+  BundleAdjustmentOptions options;
+  options.max_num_views_for_dense_schur = 2;
+  options.min_num_views_for_iterative_schur = 4;
+  ceres::Solver::Options solver_options;
+  SelectLinearSolver(
+      options, reconstruction, view_ids, track_ids, &solver_options);
+  EXPECT_EQ(solver_options.linear_solver_type, ceres::ITERATIVE_SCHUR);
+  EXPECT_EQ(solver_options.preconditioner_type, ceres::SCHUR_JACOBI);
+}
+
+}  // namespace theia
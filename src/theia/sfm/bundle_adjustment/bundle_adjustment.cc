@@ -85,6 +85,7 @@ BundleAdjustmentSummary BundleAdjustView(const BundleAdjustmentOptions& options,
                                          Reconstruction* reconstruction) {
   BundleAdjustmentOptions ba_options = options;
   ba_options.linear_solver_type = ceres::DENSE_QR;
+  ba_options.automatic_linear_solver_selection = false;
   ba_options.use_inner_iterations = false;
 
   BundleAdjuster bundle_adjuster(ba_options, reconstruction);
@@ -99,6 +100,7 @@ BundleAdjustmentSummary BundleAdjustTrack(
     Reconstruction* reconstruction) {
   BundleAdjustmentOptions ba_options = options;
   ba_options.linear_solver_type = ceres::DENSE_QR;
+  ba_options.automatic_linear_solver_selection = false;
   ba_options.use_inner_iterations = false;
 
   BundleAdjuster bundle_adjuster(ba_options, reconstruction);
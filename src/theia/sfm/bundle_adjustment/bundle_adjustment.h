@@ -88,6 +88,20 @@ struct BundleAdjustmentOptions {
   ceres::VisibilityClusteringType visibility_clustering_type =
       ceres::CANONICAL_VIEWS;
 
+  // If true, the linear solver and preconditioner above are ignored and are
+  // instead chosen for each problem from the number of optimized views and the
+  // density of the reduced camera matrix (i.e., the Schur complement):
+  //   - DENSE_SCHUR for problems with at most max_num_views_for_dense_schur
+  //     views, or with a nearly dense reduced camera matrix.
+  //   - SPARSE_SCHUR for problems with fewer than
+  //     min_num_views_for_iterative_schur views.
+  //   - ITERATIVE_SCHUR otherwise. CLUSTER_JACOBI is used when the views are
+  //     strongly coupled and SCHUR_JACOBI otherwise.
+  // The choices are reported in the BundleAdjustmentSummary.
+  bool automatic_linear_solver_selection = false;
+  int max_num_views_for_dense_schur = 150;
+  int min_num_views_for_iterative_schur = 1000;
+
   // If true, ceres will log verbosely.
   bool verbose = false;
 
@@ -130,6 +144,14 @@ struct BundleAdjustmentSummary {
   double final_cost = 0.0;
   double setup_time_in_seconds = 0.0;
   double solve_time_in_seconds = 0.0;
+
+  // The linear solver and preconditioner that were used for the optimization.
+  ceres::LinearSolverType linear_solver_type = ceres::SPARSE_SCHUR;
+  ceres::PreconditionerType preconditioner_type = ceres::SCHUR_JACOBI;
+
+  // The fraction of nonzero blocks in the reduced camera matrix. This is only
+  // computed if the linear solver was selected automatically.
+  double reduced_camera_matrix_density = 0.0;
 };
 
 // Bundle adjust all views and tracks in the reconstruction.
@@ -0,0 +1,413 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/bundle_adjustment/bundle_adjustment_session.h"
+
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "theia/sfm/bundle_adjustment/bundle_adjuster.h"
+#include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/create_reprojection_error_cost_function.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/view.h"
+#include "theia/util/map_util.h"
+#include "theia/util/timer.h"
+
+namespace theia {
+namespace {
+
+// The Schur elimination groups of the parameters. See
+// BundleAdjuster::SetCameraSchurGroups for details.
+static const int kTrackParameterGroup = 0;
+static const int kIntrinsicsParameterGroup = 1;
+static const int kExtrinsicsParameterGroup = 2;
+
+ceres::Problem::Options GetProblemOptions() {
+  // The session owns all cost functions, loss functions and manifolds so that
+  // they outlive the residual blocks that are removed from the problem.
+  ceres::Problem::Options problem_options;
+  problem_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_options.manifold_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_options.enable_fast_removal = true;
+  return problem_options;
+}
+
+}  // namespace
+
+BundleAdjustmentSession::BundleAdjustmentSession(Reconstruction* reconstruction)
+    : reconstruction_(CHECK_NOTNULL(reconstruction)),
+      loss_function_type_(LossFunctionType::TRIVIAL),
+      robust_loss_width_(0.0) {
+  static const std::vector<int> position_parameters = {
+      Camera::POSITION + 0, Camera::POSITION + 1, Camera::POSITION + 2};
+  static const std::vector<int> orientation_parameters = {
+      Camera::ORIENTATION + 0,
+      Camera::ORIENTATION + 1,
+      Camera::ORIENTATION + 2};
+  constant_position_manifold_.reset(
+      new ceres::SubsetManifold(Camera::kExtrinsicsSize, position_parameters));
+  constant_orientation_manifold_.reset(new ceres::SubsetManifold(
+      Camera::kExtrinsicsSize, orientation_parameters));
+
+  problem_.reset(new ceres::Problem(GetProblemOptions()));
+}
+
+BundleAdjustmentSession::~BundleAdjustmentSession() {
+  // Destroy the problem before any of the objects it references.
+  problem_.reset();
+}
+
+void BundleAdjustmentSession::Reset() {
+  problem_.reset(new ceres::Problem(GetProblemOptions()));
+  parameter_ordering_.Clear();
+  parameter_block_references_.clear();
+  observation_residuals_.clear();
+  intrinsics_manifolds_.clear();
+}
+
+int BundleAdjustmentSession::NumResidualBlocks() const {
+  return problem_->NumResidualBlocks();
+}
+
+BundleAdjustmentSummary BundleAdjustmentSession::Optimize(
+    const BundleAdjustmentOptions& options,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize) {
+  Timer timer;
+  UpdateLossFunction(options);
+
+  // Update the residual blocks to match the views and tracks to optimize. Only
+  // the observations that changed since the last call are added or removed.
+  std::unordered_set<std::pair<ViewId, TrackId> > observations_to_optimize;
+  GetObservationsToOptimize(views_to_optimize,
+                            tracks_to_optimize,
+                            &observations_to_optimize);
+  UpdateResidualBlocks(observations_to_optimize);
+  SetParameterization(options, views_to_optimize, tracks_to_optimize);
+
+  // Ceres removes constant parameter blocks from the orderings it is given, so
+  // each solve receives its own copy of the ordering.
+  ceres::Solver::Options solver_options;
+  SetSolverOptions(options, &solver_options);
+  double reduced_camera_matrix_density = 0.0;
+  if (options.automatic_linear_solver_selection) {
+    reduced_camera_matrix_density = SelectLinearSolver(options,
+                                                       *reconstruction_,
+                                                       views_to_optimize,
+                                                       tracks_to_optimize,
+                                                       &solver_options);
+  }
+  solver_options.linear_solver_ordering.reset(
+      new ceres::ParameterBlockOrdering(parameter_ordering_));
+  if (solver_options.use_inner_iterations) {
+    solver_options.inner_iteration_ordering.reset(
+        new ceres::ParameterBlockOrdering(parameter_ordering_));
+    solver_options.inner_iteration_ordering->Reverse();
+  }
+
+  // Solve the problem.
+  const double internal_setup_time = timer.ElapsedTimeInSeconds();
+  ceres::Solver::Summary solver_summary;
+  ceres::Solve(solver_options, problem_.get(), &solver_summary);
+  LOG_IF(INFO, options.verbose) << solver_summary.FullReport();
+
+  // Set the BundleAdjustmentSummary.
+  BundleAdjustmentSummary summary;
+  summary.setup_time_in_seconds =
+      internal_setup_time + solver_summary.preprocessor_time_in_seconds;
+  summary.solve_time_in_seconds = solver_summary.total_time_in_seconds;
+  summary.initial_cost = solver_summary.initial_cost;
+  summary.final_cost = solver_summary.final_cost;
+  summary.linear_solver_type = solver_options.linear_solver_type;
+  summary.preconditioner_type = solver_options.preconditioner_type;
+  summary.reduced_camera_matrix_density = reduced_camera_matrix_density;
+  summary.success = solver_summary.IsSolutionUsable();
+  return summary;
+}
+
+void BundleAdjustmentSession::UpdateLossFunction(
+    const BundleAdjustmentOptions& options) {
+  if (loss_function_ != nullptr &&
+      loss_function_type_ == options.loss_function_type &&
+      robust_loss_width_ == options.robust_loss_width) {
+    return;
+  }
+
+  // All residual blocks refer to the loss function, so they must be recreated
+  // when it changes.
+  if (loss_function_ != nullptr) {
+    Reset();
+  }
+  loss_function_ =
+      CreateLossFunction(options.loss_function_type, options.robust_loss_width);
+  loss_function_type_ = options.loss_function_type;
+  robust_loss_width_ = options.robust_loss_width;
+}
+
+void BundleAdjustmentSession::GetObservationsToOptimize(
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize,
+    std::unordered_set<std::pair<ViewId, TrackId> >* observations_to_optimize)
+    const {
+  // Add residuals for all estimated tracks in the optimized views.
+  for (const ViewId view_id : views_to_optimize) {
+    const View* view = CHECK_NOTNULL(reconstruction_->View(view_id));
+    if (!view->IsEstimated()) {
+      continue;
+    }
+    for (const TrackId track_id : view->TrackIds()) {
+      const Track* track = CHECK_NOTNULL(reconstruction_->Track(track_id));
+      if (track->IsEstimated()) {
+        observations_to_optimize->emplace(view_id, track_id);
+      }
+    }
+  }
+
+  // Add residuals for all estimated views that observe the optimized tracks.
+  for (const TrackId track_id : tracks_to_optimize) {
+    const Track* track = CHECK_NOTNULL(reconstruction_->Track(track_id));
+    if (!track->IsEstimated()) {
+      continue;
+    }
+    for (const ViewId view_id : track->ViewIds()) {
+      const View* view = CHECK_NOTNULL(reconstruction_->View(view_id));
+      if (view->IsEstimated()) {
+        observations_to_optimize->emplace(view_id, track_id);
+      }
+    }
+  }
+}
+
+void BundleAdjustmentSession::UpdateResidualBlocks(
+    const std::unordered_set<std::pair<ViewId, TrackId> >&
+        observations_to_optimize) {
+  // Remove the residual blocks that are no longer optimized or whose parameters
+  // have moved in memory since they were added. This is done before any
+  // residual blocks are added so that a parameter block can never be confused
+  // with one that was freed and reallocated at the same address.
+  std::vector<std::pair<ViewId, TrackId> > observations_to_remove;
+  for (const auto& observation_residual : observation_residuals_) {
+    const std::pair<ViewId, TrackId>& observation = observation_residual.first;
+    if (!ContainsKey(observations_to_optimize, observation)) {
+      observations_to_remove.emplace_back(observation);
+      continue;
+    }
+
+    const ObservationResidual& residual = observation_residual.second;
+    Camera* camera =
+        reconstruction_->MutableView(observation.first)->MutableCamera();
+    Track* track = reconstruction_->MutableTrack(observation.second);
+    if (residual.extrinsics != camera->mutable_extrinsics() ||
+        residual.intrinsics != camera->mutable_intrinsics() ||
+        residual.point != track->MutablePoint()->data() ||
+        residual.camera_intrinsics_model_type !=
+            camera->GetCameraIntrinsicsModelType()) {
+      observations_to_remove.emplace_back(observation);
+    }
+  }
+
+  for (const auto& observation : observations_to_remove) {
+    RemoveResidualBlock(observation);
+  }
+
+  // Add the residual blocks of the new observations.
+  for (const auto& observation : observations_to_optimize) {
+    if (!ContainsKey(observation_residuals_, observation)) {
+      AddResidualBlock(observation);
+    }
+  }
+  DCHECK_EQ(observation_residuals_.size(), problem_->NumResidualBlocks());
+}
+
+void BundleAdjustmentSession::AddResidualBlock(
+    const std::pair<ViewId, TrackId>& observation) {
+  View* view = reconstruction_->MutableView(observation.first);
+  Camera* camera = view->MutableCamera();
+  Track* track = reconstruction_->MutableTrack(observation.second);
+
+  ObservationResidual& residual = observation_residuals_[observation];
+  const Feature* feature = CHECK_NOTNULL(view->GetFeature(observation.second));
+  residual.camera_intrinsics_model_type =
+      camera->GetCameraIntrinsicsModelType();
+  residual.cost_function.reset(CreateReprojectionErrorCostFunction(
+      residual.camera_intrinsics_model_type, *feature));
+
+  residual.extrinsics = camera->mutable_extrinsics();
+  residual.intrinsics = camera->mutable_intrinsics();
+  residual.point = track->MutablePoint()->data();
+  residual.residual_block_id =
+      problem_->AddResidualBlock(residual.cost_function.get(),
+                                 loss_function_.get(),
+                                 residual.extrinsics,
+                                 residual.intrinsics,
+                                 residual.point);
+  AddParameterBlockReference(residual.extrinsics, kExtrinsicsParameterGroup);
+  AddParameterBlockReference(residual.intrinsics, kIntrinsicsParameterGroup);
+  AddParameterBlockReference(residual.point, kTrackParameterGroup);
+}
+
+void BundleAdjustmentSession::RemoveResidualBlock(
+    const std::pair<ViewId, TrackId>& observation) {
+  const ObservationResidual& residual =
+      FindOrDie(observation_residuals_, observation);
+  problem_->RemoveResidualBlock(residual.residual_block_id);
+  RemoveParameterBlockReference(residual.extrinsics);
+  RemoveParameterBlockReference(residual.intrinsics);
+  RemoveParameterBlockReference(residual.point);
+  observation_residuals_.erase(observation);
+}
+
+void BundleAdjustmentSession::AddParameterBlockReference(
+    double* parameter_block, const int group) {
+  int& num_references = parameter_block_references_[parameter_block];
+  if (num_references == 0) {
+    parameter_ordering_.AddElementToGroup(parameter_block, group);
+  }
+  ++num_references;
+}
+
+void BundleAdjustmentSession::RemoveParameterBlockReference(
+    double* parameter_block) {
+  int& num_references = FindOrDie(parameter_block_references_, parameter_block);
+  --num_references;
+  if (num_references == 0) {
+    parameter_block_references_.erase(parameter_block);
+    parameter_ordering_.Remove(parameter_block);
+    problem_->RemoveParameterBlock(parameter_block);
+  }
+}
+
+void BundleAdjustmentSession::SetParameterization(
+    const BundleAdjustmentOptions& options,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize) {
+  std::unordered_set<ViewId> views_in_problem;
+  std::unordered_set<TrackId> tracks_in_problem;
+  for (const auto& observation_residual : observation_residuals_) {
+    views_in_problem.emplace(observation_residual.first.first);
+    tracks_in_problem.emplace(observation_residual.first.second);
+  }
+
+  // Set the extrinsics parameterization of the camera poses and find the
+  // intrinsics groups that are optimized. An intrinsics group is optimized if
+  // at least one of its views is optimized.
+  std::unordered_map<CameraIntrinsicsGroupId, std::pair<Camera*, bool> >
+      intrinsics_groups;
+  for (const ViewId view_id : views_in_problem) {
+    Camera* camera = reconstruction_->MutableView(view_id)->MutableCamera();
+    const bool is_optimized = ContainsKey(views_to_optimize, view_id);
+    const CameraIntrinsicsGroupId intrinsics_group_id =
+        reconstruction_->CameraIntrinsicsGroupIdFromViewId(view_id);
+    auto& intrinsics_group = intrinsics_groups[intrinsics_group_id];
+    intrinsics_group.first = camera;
+    intrinsics_group.second |= is_optimized;
+
+    double* extrinsics = camera->mutable_extrinsics();
+    if (!is_optimized || (options.constant_camera_orientation &&
+                          options.constant_camera_position)) {
+      problem_->SetParameterBlockConstant(extrinsics);
+      continue;
+    }
+
+    problem_->SetParameterBlockVariable(extrinsics);
+    if (options.constant_camera_orientation) {
+      problem_->SetManifold(extrinsics, constant_orientation_manifold_.get());
+    } else if (options.constant_camera_position) {
+      problem_->SetManifold(extrinsics, constant_position_manifold_.get());
+    } else {
+      problem_->SetManifold(extrinsics, nullptr);
+    }
+  }
+
+  // Set the intrinsics parameterization of each intrinsics group. Intrinsics
+  // groups that have no optimized views are held constant.
+  for (const auto& intrinsics_group : intrinsics_groups) {
+    Camera* camera = intrinsics_group.second.first;
+    double* intrinsics = camera->mutable_intrinsics();
+    if (!intrinsics_group.second.second) {
+      problem_->SetParameterBlockConstant(intrinsics);
+      continue;
+    }
+
+    const std::vector<int> constant_intrinsics =
+        camera->CameraIntrinsics()->GetSubsetFromOptimizeIntrinsicsType(
+            options.intrinsics_to_optimize);
+    const int num_intrinsics = camera->CameraIntrinsics()->NumParameters();
+    if (constant_intrinsics.size() == num_intrinsics) {
+      problem_->SetParameterBlockConstant(intrinsics);
+      continue;
+    }
+
+    problem_->SetParameterBlockVariable(intrinsics);
+    if (constant_intrinsics.empty()) {
+      problem_->SetManifold(intrinsics, nullptr);
+      continue;
+    }
+
+    // The previous manifold of the group may still be attached to the
+    // parameter block, so it is only destroyed after the new one is set.
+    auto& manifold = intrinsics_manifolds_[intrinsics_group.first];
+    std::unique_ptr<ceres::Manifold> replaced_manifold;
+    if (manifold.second == nullptr || manifold.first != constant_intrinsics) {
+      replaced_manifold = std::move(manifold.second);
+      manifold.first = constant_intrinsics;
+      manifold.second.reset(
+          new ceres::SubsetManifold(num_intrinsics, constant_intrinsics));
+    }
+    problem_->SetManifold(intrinsics, manifold.second.get());
+  }
+
+  // Only the optimized tracks are variable.
+  for (const TrackId track_id : tracks_in_problem) {
+    double* point =
+        reconstruction_->MutableTrack(track_id)->MutablePoint()->data();
+    if (ContainsKey(tracks_to_optimize, track_id)) {
+      problem_->SetParameterBlockVariable(point);
+    } else {
+      problem_->SetParameterBlockConstant(point);
+    }
+  }
+}
+
+}  // namespace theia
@@ -0,0 +1,181 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_BUNDLE_ADJUSTMENT_BUNDLE_ADJUSTMENT_SESSION_H_
+#define THEIA_SFM_BUNDLE_ADJUSTMENT_BUNDLE_ADJUSTMENT_SESSION_H_
+
+#include <ceres/ceres.h>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/camera/camera_intrinsics_model_type.h"
+#include "theia/sfm/types.h"
+#include "theia/util/hash.h"
+#include "theia/util/util.h"
+
+namespace theia {
+class Reconstruction;
+
+// A long-lived bundle adjustment problem for pipelines that repeatedly bundle
+// adjust overlapping subsets of the same reconstruction, e.g. the partial and
+// full bundle adjustment of incremental SfM. BundleAdjustPartialReconstruction
+// builds a new ceres::Problem for every call; this class instead keeps a single
+// ceres::Problem alive between calls to Optimize() and only adds or removes the
+// residual blocks of observations that entered or left the set of optimized
+// views and tracks since the previous call. The loss function, the manifolds
+// and the Schur elimination ordering are owned by the session and reused across
+// calls. The reprojection error cost function of an observation is owned by the
+// session while its residual block is in the problem.
+//
+// Finding the observations that entered or left the problem takes time linear
+// in the number of optimized observations, so a session only pays off if
+// consecutive calls optimize largely the same observations. Pipelines that
+// alternate between different kinds of bundle adjustment (e.g. partial and full
+// BA) should use one session for each.
+//
+// The residuals that are created for a given set of views and tracks are the
+// same as for BundleAdjustPartialReconstruction: all observations of estimated
+// tracks in the optimized views and all observations of the optimized tracks in
+// estimated views. Views and tracks that are not optimized are held constant.
+//
+// The session caches pointers to the camera and point parameters of the
+// reconstruction and detects views, tracks and intrinsics whose parameters
+// moved between calls. The feature of an observation must not change while it
+// is part of the session; call Reset() if the reconstruction was modified in
+// such a way.
+class BundleAdjustmentSession {
+ public:
+  explicit BundleAdjustmentSession(Reconstruction* reconstruction);
+  ~BundleAdjustmentSession();
+
+  // Bundle adjust the specified views and tracks. The solver options are taken
+  // from the provided options for each call, so e.g. the linear solver may
+  // change as the reconstruction grows.
+  BundleAdjustmentSummary Optimize(
+      const BundleAdjustmentOptions& options,
+      const std::unordered_set<ViewId>& views_to_optimize,
+      const std::unordered_set<TrackId>& tracks_to_optimize);
+
+  // Removes all residual and parameter blocks from the problem and drops all
+  // cached cost functions.
+  void Reset();
+
+  // The number of residual blocks currently in the problem.
+  int NumResidualBlocks() const;
+
+ private:
+  // The residual block of a single observation of a track in a view and the
+  // parameters that it was created with.
+  struct ObservationResidual {
+    std::unique_ptr<ceres::CostFunction> cost_function;
+    CameraIntrinsicsModelType camera_intrinsics_model_type;
+    ceres::ResidualBlockId residual_block_id = nullptr;
+    double* extrinsics = nullptr;
+    double* intrinsics = nullptr;
+    double* point = nullptr;
+  };
+
+  // Adds the observations of the views and tracks to optimize to
+  // observations_to_optimize.
+  void GetObservationsToOptimize(
+      const std::unordered_set<ViewId>& views_to_optimize,
+      const std::unordered_set<TrackId>& tracks_to_optimize,
+      std::unordered_set<std::pair<ViewId, TrackId> >* observations_to_optimize)
+      const;
+
+  // Adds or removes residual blocks so that the problem contains exactly the
+  // residuals of the given observations.
+  void UpdateResidualBlocks(
+      const std::unordered_set<std::pair<ViewId, TrackId> >&
+          observations_to_optimize);
+  void AddResidualBlock(const std::pair<ViewId, TrackId>& observation);
+  void RemoveResidualBlock(const std::pair<ViewId, TrackId>& observation);
+
+  // Reference counting of the parameter blocks so that parameter blocks are
+  // removed from the problem and the ordering once no residual uses them.
+  void AddParameterBlockReference(double* parameter_block, const int group);
+  void RemoveParameterBlockReference(double* parameter_block);
+
+  // Set the parameter blocks of the problem to be constant or variable based
+  // on the views and tracks that are optimized.
+  void SetParameterization(
+      const BundleAdjustmentOptions& options,
+      const std::unordered_set<ViewId>& views_to_optimize,
+      const std::unordered_set<TrackId>& tracks_to_optimize);
+
+  // Recreates the loss function if the loss options changed.
+  void UpdateLossFunction(const BundleAdjustmentOptions& options);
+
+  Reconstruction* reconstruction_;
+
+  // The loss function used by all residual blocks along with the options it
+  // was created with.
+  std::unique_ptr<ceres::LossFunction> loss_function_;
+  LossFunctionType loss_function_type_;
+  double robust_loss_width_;
+
+  // Manifolds that hold the camera position or orientation constant, and the
+  // subset manifolds for the intrinsics of each intrinsics group along with the
+  // constant parameters they were created for.
+  std::unique_ptr<ceres::Manifold> constant_position_manifold_;
+  std::unique_ptr<ceres::Manifold> constant_orientation_manifold_;
+  std::unordered_map<CameraIntrinsicsGroupId,
+                     std::pair<std::vector<int>,
+                               std::unique_ptr<ceres::Manifold> > >
+      intrinsics_manifolds_;
+
+  // The residual blocks of the observations that are in the problem.
+  std::unordered_map<std::pair<ViewId, TrackId>, ObservationResidual>
+      observation_residuals_;
+
+  // The number of residual blocks that use each parameter block.
+  std::unordered_map<double*, int> parameter_block_references_;
+
+  // The Schur elimination ordering of the parameter blocks in the problem.
+  ceres::ParameterBlockOrdering parameter_ordering_;
+
+  // The problem is declared last so that it is destroyed before the cost
+  // functions, loss function and manifolds that it does not own.
+  std::unique_ptr<ceres::Problem> problem_;
+
+  DISALLOW_COPY_AND_ASSIGN(BundleAdjustmentSession);
+};
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_BUNDLE_ADJUSTMENT_SESSION_H_
@@ -0,0 +1,191 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjustment_session.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/view.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+namespace {
+RandomNumberGenerator rng(59);
+
+static const int kNumViews = 6;
+static const int kNumTracks = 50;
+
+// Creates a reconstruction where every track is observed by every view and the
+// 3D points are slightly perturbed from their true positions.
+void CreateReconstruction(Reconstruction* reconstruction) {
+  for (int i = 0; i < kNumViews; i++) {
+    const ViewId view_id = reconstruction->AddView(std::to_string(i));
+    Camera* camera = reconstruction->MutableView(view_id)->MutableCamera();
+    camera->SetPosition(Eigen::Vector3d(i, 0, 0));
+    camera->SetOrientationFromAngleAxis(0.05 * rng.RandVector3d());
+    camera->SetImageSize(1000, 1000);
+    camera->SetFocalLength(800);
+    camera->SetPrincipalPoint(500.0, 500.0);
+    reconstruction->MutableView(view_id)->SetEstimated(true);
+  }
+
+  for (int i = 0; i < kNumTracks; i++) {
+    const Eigen::Vector3d point(rng.RandDouble(-2.0, 7.0),
+                                rng.RandDouble(-2.0, 2.0),
+                                rng.RandDouble(8.0, 12.0));
+    const TrackId track_id = reconstruction->AddTrack();
+    for (const ViewId view_id : reconstruction->ViewIds()) {
+      Feature feature;
+      reconstruction->View(view_id)->Camera().ProjectPoint(
+          point.homogeneous(), &feature);
+      reconstruction->AddObservation(view_id, track_id, feature);
+    }
+    Track* track = reconstruction->MutableTrack(track_id);
+    *track->MutablePoint() = point.homogeneous();
+    track->MutablePoint()->head<3>() += 0.05 * rng.RandVector3d();
+    track->SetEstimated(true);
+  }
+}
+
+BundleAdjustmentOptions GetBundleAdjustmentOptions() {
+  BundleAdjustmentOptions options;
+  options.linear_solver_type = ceres::DENSE_SCHUR;
+  options.use_inner_iterations = false;
+  options.intrinsics_to_optimize = OptimizeIntrinsicsType::NONE;
+  return options;
+}
+
+}  // namespace
+
+TEST(BundleAdjustmentSession, AddsAndRemovesResiduals) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  const std::vector<TrackId> track_ids = reconstruction.TrackIds();
+  const std::unordered_set<TrackId> all_tracks(track_ids.begin(),
+                                               track_ids.end());
+
+  BundleAdjustmentSession session(&reconstruction);
+  const BundleAdjustmentOptions options = GetBundleAdjustmentOptions();
+
+  // All tracks are observed in all views.
+  const std::unordered_set<ViewId> views_to_optimize = {3, 4, 5};
+  BundleAdjustmentSummary summary =
+      session.Optimize(options, views_to_optimize, all_tracks);
+  EXPECT_TRUE(summary.success);
+  EXPECT_LT(summary.final_cost, summary.initial_cost);
+  EXPECT_EQ(session.NumResidualBlocks(), kNumViews * kNumTracks);
+
+  // Optimizing a subset keeps the residuals of the tracks in the optimized
+  // views and of the optimized tracks in all views.
+  const std::unordered_set<ViewId> fewer_views_to_optimize = {4, 5};
+  std::unordered_set<TrackId> fewer_tracks_to_optimize;
+  for (int i = 0; i < kNumTracks / 2; i++) {
+    fewer_tracks_to_optimize.emplace(track_ids[i]);
+  }
+  summary = session.Optimize(
+      options, fewer_views_to_optimize, fewer_tracks_to_optimize);
+  EXPECT_TRUE(summary.success);
+  EXPECT_EQ(session.NumResidualBlocks(),
+            2 * kNumTracks + (kNumViews - 2) * kNumTracks / 2);
+
+  // Growing the problem again re-adds the removed residuals.
+  summary = session.Optimize(options, views_to_optimize, all_tracks);
+  EXPECT_TRUE(summary.success);
+  EXPECT_EQ(session.NumResidualBlocks(), kNumViews * kNumTracks);
+
+  session.Reset();
+  EXPECT_EQ(session.NumResidualBlocks(), 0);
+}
+
+TEST(BundleAdjustmentSession, SkipsUnestimatedViewsAndTracks) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  const std::vector<TrackId> track_ids = reconstruction.TrackIds();
+  const std::unordered_set<TrackId> all_tracks(track_ids.begin(),
+                                               track_ids.end());
+
+  BundleAdjustmentSession session(&reconstruction);
+  const BundleAdjustmentOptions options = GetBundleAdjustmentOptions();
+  const std::unordered_set<ViewId> views_to_optimize = {0, 1, 2};
+  session.Optimize(options, views_to_optimize, all_tracks);
+  EXPECT_EQ(session.NumResidualBlocks(), kNumViews * kNumTracks);
+
+  reconstruction.MutableView(5)->SetEstimated(false);
+  reconstruction.MutableTrack(track_ids[0])->SetEstimated(false);
+  const BundleAdjustmentSummary summary =
+      session.Optimize(options, views_to_optimize, all_tracks);
+  EXPECT_TRUE(summary.success);
+  EXPECT_EQ(session.NumResidualBlocks(), (kNumViews - 1) * (kNumTracks - 1));
+}
+
+TEST(BundleAdjustmentSession, ReleasesResidualsOfRemovedTracks) {
+  static const int kNumRemovedTracks = 10;
+
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  std::vector<TrackId> track_ids = reconstruction.TrackIds();
+
+  BundleAdjustmentSession session(&reconstruction);
+  const BundleAdjustmentOptions options = GetBundleAdjustmentOptions();
+  const std::unordered_set<ViewId> views_to_optimize = {3, 4, 5};
+  session.Optimize(options,
+                   views_to_optimize,
+                   std::unordered_set<TrackId>(track_ids.begin(),
+                                               track_ids.end()));
+  EXPECT_EQ(session.NumResidualBlocks(), kNumViews * kNumTracks);
+
+  // The residual blocks of the removed tracks are released from the problem.
+  for (int i = 0; i < kNumRemovedTracks; i++) {
+    ASSERT_TRUE(reconstruction.RemoveTrack(track_ids[i]));
+  }
+  track_ids = reconstruction.TrackIds();
+  const BundleAdjustmentSummary summary =
+      session.Optimize(options,
+                       views_to_optimize,
+                       std::unordered_set<TrackId>(track_ids.begin(),
+                                                   track_ids.end()));
+  EXPECT_TRUE(summary.success);
+  EXPECT_EQ(session.NumResidualBlocks(),
+            kNumViews * (kNumTracks - kNumRemovedTracks));
+}
+
+}  // namespace theia
@@ -0,0 +1,739 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h"
+
+#include <ceres/ceres.h>
+#include <glog/logging.h>
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "theia/math/graph/normalized_graph_cut.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjuster.h"
+#include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/create_reprojection_error_cost_function.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/view.h"
+#include "theia/util/hash.h"
+#include "theia/util/map_util.h"
+#include "theia/util/threadpool.h"
+#include "theia/util/timer.h"
+
+namespace theia {
+namespace {
+
+// The Schur elimination groups of the parameters. See
+// BundleAdjuster::SetCameraSchurGroups for details.
+static const int kTrackParameterGroup = 0;
+static const int kIntrinsicsParameterGroup = 1;
+static const int kExtrinsicsParameterGroup = 2;
+
+typedef Eigen::Matrix<double, Camera::kExtrinsicsSize, 1> CameraExtrinsics;
+
+// The ADMM penalty term of a point that is optimized in several partitions.
+// The point is pulled towards the consensus point shifted by the scaled dual
+// variable of the partition.
+struct PointConsensusError {
+ public:
+  PointConsensusError(const Eigen::Vector4d& target_point, const double weight)
+      : target_point_(target_point), weight_(weight) {}
+
+  template <typename T>
+  bool operator()(const T* point, T* residuals) const {
+    for (int i = 0; i < 4; i++) {
+      residuals[i] = T(weight_) * (point[i] - T(target_point_[i]));
+    }
+    return true;
+  }
+
+  static ceres::CostFunction* Create(const Eigen::Vector4d& target_point,
+                                     const double weight) {
+    static const int kPointSize = 4;
+    return new ceres::AutoDiffCostFunction<PointConsensusError,
+                                           kPointSize,
+                                           kPointSize>(
+        new PointConsensusError(target_point, weight));
+  }
+
+ private:
+  const Eigen::Vector4d target_point_;
+  const double weight_;
+};
+
+// A track that is optimized in more than one partition. Each partition keeps
+// its own estimate of the point and a scaled dual variable, and the point of
+// the track in the reconstruction holds the consensus point.
+struct ConsensusTrack {
+  std::vector<int> partitions;
+  std::vector<Eigen::Vector4d> estimates;
+  std::vector<Eigen::Vector4d> duals;
+};
+
+// The optimized parameters of a single partition.
+struct PartitionSolution {
+  bool success = false;
+  double setup_time_in_seconds = 0.0;
+  double solve_time_in_seconds = 0.0;
+  std::unordered_map<ViewId, CameraExtrinsics> extrinsics;
+  std::unordered_map<CameraIntrinsicsGroupId, Eigen::VectorXd> intrinsics;
+  std::unordered_map<TrackId, Eigen::Vector4d> points;
+};
+
+// Returns the tracks to optimize that are observed by the views.
+std::unordered_set<TrackId> GetTracksToOptimizeInViews(
+    const Reconstruction& reconstruction,
+    const std::vector<ViewId>& view_ids,
+    const std::unordered_set<TrackId>& tracks_to_optimize) {
+  std::unordered_set<TrackId> track_ids;
+  for (const ViewId view_id : view_ids) {
+    const View* view = reconstruction.View(view_id);
+    for (const TrackId track_id : view->TrackIds()) {
+      if (ContainsKey(tracks_to_optimize, track_id) &&
+          reconstruction.Track(track_id)->IsEstimated()) {
+        track_ids.emplace(track_id);
+      }
+    }
+  }
+  return track_ids;
+}
+
+// Splits the views into two halves. The normalized graph cut of the
+// covisibility graph is used if it succeeds, otherwise the views are split by
+// their id.
+void SplitViews(
+    const std::unordered_map<std::pair<ViewId, ViewId>, double>& covisibility,
+    const std::vector<ViewId>& view_ids,
+    std::vector<ViewId>* subgraph1,
+    std::vector<ViewId>* subgraph2) {
+  // The eigensolver of the normalized graph cut uses 10 Lanczos vectors and
+  // needs at least as many nodes.
+  static const int kMinNumViewsForGraphCut = 10;
+
+  const std::unordered_set<ViewId> view_id_set(view_ids.begin(),
+                                               view_ids.end());
+  std::unordered_map<std::pair<ViewId, ViewId>, double> edges;
+  std::unordered_set<ViewId> connected_view_ids;
+  for (const auto& edge : covisibility) {
+    if (ContainsKey(view_id_set, edge.first.first) &&
+        ContainsKey(view_id_set, edge.first.second)) {
+      edges.emplace(edge);
+      connected_view_ids.emplace(edge.first.first);
+      connected_view_ids.emplace(edge.first.second);
+    }
+  }
+
+  std::unordered_set<ViewId> cut1, cut2;
+  NormalizedGraphCut<ViewId>::Options cut_options;
+  NormalizedGraphCut<ViewId> normalized_graph_cut(cut_options);
+  if (connected_view_ids.size() < kMinNumViewsForGraphCut ||
+      !normalized_graph_cut.ComputeCut(edges, &cut1, &cut2, nullptr) ||
+      cut1.empty() || cut2.empty()) {
+    const int num_views_in_subgraph1 = view_ids.size() / 2;
+    subgraph1->assign(view_ids.begin(),
+                      view_ids.begin() + num_views_in_subgraph1);
+    subgraph2->assign(view_ids.begin() + num_views_in_subgraph1,
+                      view_ids.end());
+    return;
+  }
+
+  // Views that are not connected to any other view of the subgraph are added
+  // to the smaller side of the cut.
+  for (const ViewId view_id : view_ids) {
+    if (ContainsKey(cut1, view_id)) {
+      subgraph1->emplace_back(view_id);
+    } else if (ContainsKey(cut2, view_id)) {
+      subgraph2->emplace_back(view_id);
+    } else if (cut1.size() <= cut2.size()) {
+      cut1.emplace(view_id);
+      subgraph1->emplace_back(view_id);
+    } else {
+      cut2.emplace(view_id);
+      subgraph2->emplace_back(view_id);
+    }
+  }
+}
+
+// Returns the reprojection cost of the same residuals that bundle adjustment of
+// the views and tracks would optimize.
+double ComputeReprojectionCost(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize,
+    const ceres::LossFunction& loss_function) {
+  double cost = 0.0;
+  const auto add_observation_cost = [&](const View& view,
+                                        const Track& track,
+                                        const TrackId track_id) {
+    Feature reprojection;
+    view.Camera().ProjectPoint(track.Point(), &reprojection);
+    const double squared_error =
+        (*view.GetFeature(track_id) - reprojection).squaredNorm();
+    double rho[3];
+    loss_function.Evaluate(squared_error, rho);
+    cost += 0.5 * rho[0];
+  };
+
+  // Observations of estimated tracks in the views to optimize.
+  for (const ViewId view_id : views_to_optimize) {
+    const View* view = reconstruction.View(view_id);
+    if (!view->IsEstimated()) {
+      continue;
+    }
+    for (const TrackId track_id : view->TrackIds()) {
+      const Track* track = reconstruction.Track(track_id);
+      if (track->IsEstimated()) {
+        add_observation_cost(*view, *track, track_id);
+      }
+    }
+  }
+
+  // Observations of the tracks to optimize in all other estimated views.
+  for (const TrackId track_id : tracks_to_optimize) {
+    const Track* track = reconstruction.Track(track_id);
+    if (!track->IsEstimated()) {
+      continue;
+    }
+    for (const ViewId view_id : track->ViewIds()) {
+      const View* view = reconstruction.View(view_id);
+      if (view->IsEstimated() && !ContainsKey(views_to_optimize, view_id)) {
+        add_observation_cost(*view, *track, track_id);
+      }
+    }
+  }
+  return cost;
+}
+
+// Bundle adjusts the views of a partition and the tracks to optimize that they
+// observe on local copies of the parameters. All views outside of the partition
+// are held constant. Only the reconstruction is read, so several partitions may
+// be optimized at the same time.
+//
+// Each observation is part of exactly one partition: observations in the views
+// to optimize belong to the partition of the view, and observations of a track
+// in the remaining estimated views belong to the first partition that optimizes
+// the track.
+void OptimizePartition(
+    const BundleAdjustmentOptions& options,
+    const Reconstruction& reconstruction,
+    const std::vector<ViewId>& partition_view_ids,
+    const int partition_index,
+    const std::unordered_set<ViewId>& partitioned_view_ids,
+    const std::unordered_set<TrackId>& tracks_to_optimize,
+    const std::unordered_map<TrackId, ConsensusTrack>& consensus_tracks,
+    const double consensus_penalty,
+    ceres::LossFunction* loss_function,
+    PartitionSolution* solution) {
+  Timer timer;
+  const std::unordered_set<TrackId> partition_track_ids =
+      GetTracksToOptimizeInViews(
+          reconstruction, partition_view_ids, tracks_to_optimize);
+
+  // Gather the observations of the partition: all estimated tracks in the
+  // views of the partition, and the tracks owned by the partition in the
+  // estimated views that are not in any partition.
+  std::unordered_set<std::pair<ViewId, TrackId> > observations;
+  for (const ViewId view_id : partition_view_ids) {
+    for (const TrackId track_id : reconstruction.View(view_id)->TrackIds()) {
+      if (reconstruction.Track(track_id)->IsEstimated()) {
+        observations.emplace(view_id, track_id);
+      }
+    }
+  }
+  for (const TrackId track_id : partition_track_ids) {
+    const ConsensusTrack* consensus_track =
+        FindOrNull(consensus_tracks, track_id);
+    if (consensus_track != nullptr &&
+        consensus_track->partitions.front() != partition_index) {
+      continue;
+    }
+    for (const ViewId view_id : reconstruction.Track(track_id)->ViewIds()) {
+      if (reconstruction.View(view_id)->IsEstimated() &&
+          !ContainsKey(partitioned_view_ids, view_id)) {
+        observations.emplace(view_id, track_id);
+      }
+    }
+  }
+
+  // The variable parameters are copied into the solution and the constant
+  // parameters into local containers. The containers are node-based so the
+  // parameter blocks do not move while the problem is built.
+  const std::unordered_set<ViewId> partition_view_id_set(
+      partition_view_ids.begin(), partition_view_ids.end());
+  std::unordered_set<CameraIntrinsicsGroupId> partition_intrinsics_group_ids;
+  for (const ViewId view_id : partition_view_ids) {
+    partition_intrinsics_group_ids.emplace(
+        reconstruction.CameraIntrinsicsGroupIdFromViewId(view_id));
+  }
+  std::unordered_map<ViewId, CameraExtrinsics> constant_extrinsics;
+  std::unordered_map<CameraIntrinsicsGroupId, Eigen::VectorXd>
+      constant_intrinsics;
+  std::unordered_map<TrackId, Eigen::Vector4d> constant_points;
+  std::unordered_map<CameraIntrinsicsGroupId, const Camera*>
+      intrinsics_group_cameras;
+  std::unordered_map<TrackId, int> num_track_observations;
+
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+  for (const auto& observation : observations) {
+    const View* view = reconstruction.View(observation.first);
+    const Camera& camera = view->Camera();
+    const Track* track = reconstruction.Track(observation.second);
+    const CameraIntrinsicsGroupId intrinsics_group_id =
+        reconstruction.CameraIntrinsicsGroupIdFromViewId(observation.first);
+    intrinsics_group_cameras.emplace(intrinsics_group_id, &camera);
+    ++num_track_observations[observation.second];
+
+    auto& extrinsics_container =
+        ContainsKey(partition_view_id_set, observation.first)
+            ? solution->extrinsics
+            : constant_extrinsics;
+    auto& intrinsics_container =
+        ContainsKey(partition_intrinsics_group_ids, intrinsics_group_id)
+            ? solution->intrinsics
+            : constant_intrinsics;
+    auto& points_container =
+        ContainsKey(partition_track_ids, observation.second)
+            ? solution->points
+            : constant_points;
+    CameraExtrinsics& extrinsics =
+        extrinsics_container
+            .emplace(observation.first,
+                     Eigen::Map<const CameraExtrinsics>(camera.extrinsics()))
+            .first->second;
+    Eigen::VectorXd& intrinsics =
+        intrinsics_container
+            .emplace(intrinsics_group_id,
+                     Eigen::Map<const Eigen::VectorXd>(
+                         camera.intrinsics(),
+                         camera.CameraIntrinsics()->NumParameters()))
+            .first->second;
+    Eigen::Vector4d& point =
+        points_container.emplace(observation.second, track->Point())
+            .first->second;
+
+    problem.AddResidualBlock(
+        CreateReprojectionErrorCostFunction(
+            camera.GetCameraIntrinsicsModelType(),
+            *view->GetFeature(observation.second)),
+        loss_function,
+        extrinsics.data(),
+        intrinsics.data(),
+        point.data());
+  }
+
+  ceres::Solver::Options solver_options;
+  SetSolverOptions(options, &solver_options);
+  if (options.automatic_linear_solver_selection) {
+    SelectLinearSolver(options,
+                       reconstruction,
+                       partition_view_id_set,
+                       partition_track_ids,
+                       &solver_options);
+  }
+  ceres::ParameterBlockOrdering* parameter_ordering =
+      solver_options.linear_solver_ordering.get();
+
+  // Set the parameterization of the camera extrinsics.
+  for (auto& extrinsics : solution->extrinsics) {
+    double* parameters = extrinsics.second.data();
+    parameter_ordering->AddElementToGroup(parameters,
+                                          kExtrinsicsParameterGroup);
+    if (options.constant_camera_orientation &&
+        options.constant_camera_position) {
+      problem.SetParameterBlockConstant(parameters);
+    } else if (options.constant_camera_orientation) {
+      static const std::vector<int> orientation_parameters = {
+          Camera::ORIENTATION + 0,
+          Camera::ORIENTATION + 1,
+          Camera::ORIENTATION + 2};
+      problem.SetManifold(parameters,
+                          new ceres::SubsetManifold(Camera::kExtrinsicsSize,
+                                                    orientation_parameters));
+    } else if (options.constant_camera_position) {
+      static const std::vector<int> position_parameters = {
+          Camera::POSITION + 0, Camera::POSITION + 1, Camera::POSITION + 2};
+      problem.SetManifold(parameters,
+                          new ceres::SubsetManifold(Camera::kExtrinsicsSize,
+                                                    position_parameters));
+    }
+  }
+  for (auto& extrinsics : constant_extrinsics) {
+    parameter_ordering->AddElementToGroup(extrinsics.second.data(),
+                                          kExtrinsicsParameterGroup);
+    problem.SetParameterBlockConstant(extrinsics.second.data());
+  }
+
+  // Set the parameterization of the camera intrinsics.
+  for (auto& intrinsics : solution->intrinsics) {
+    double* parameters = intrinsics.second.data();
+    parameter_ordering->AddElementToGroup(parameters,
+                                          kIntrinsicsParameterGroup);
+    const Camera* camera = FindOrDie(intrinsics_group_cameras, intrinsics.first);
+    const std::vector<int> constant_intrinsics_parameters =
+        camera->CameraIntrinsics()->GetSubsetFromOptimizeIntrinsicsType(
+            options.intrinsics_to_optimize);
+    if (constant_intrinsics_parameters.size() == intrinsics.second.size()) {
+      problem.SetParameterBlockConstant(parameters);
+    } else if (!constant_intrinsics_parameters.empty()) {
+      problem.SetManifold(
+          parameters,
+          new ceres::SubsetManifold(intrinsics.second.size(),
+                                    constant_intrinsics_parameters));
+    }
+  }
+  for (auto& intrinsics : constant_intrinsics) {
+    parameter_ordering->AddElementToGroup(intrinsics.second.data(),
+                                          kIntrinsicsParameterGroup);
+    problem.SetParameterBlockConstant(intrinsics.second.data());
+  }
+
+  // Tracks that are shared with other partitions are pulled towards their
+  // consensus point. The penalty is given per observation so that the pull is
+  // balanced against the reprojection errors of the point in this partition.
+  for (auto& point : solution->points) {
+    parameter_ordering->AddElementToGroup(point.second.data(),
+                                          kTrackParameterGroup);
+    const ConsensusTrack* consensus_track =
+        FindOrNull(consensus_tracks, point.first);
+    if (consensus_track == nullptr) {
+      continue;
+    }
+    const int index =
+        std::find(consensus_track->partitions.begin(),
+                  consensus_track->partitions.end(),
+                  partition_index) -
+        consensus_track->partitions.begin();
+    const Eigen::Vector4d target_point =
+        reconstruction.Track(point.first)->Point() -
+        consensus_track->duals[index];
+    const double consensus_weight = std::sqrt(
+        consensus_penalty * FindOrDie(num_track_observations, point.first));
+    problem.AddResidualBlock(
+        PointConsensusError::Create(target_point, consensus_weight),
+        nullptr,
+        point.second.data());
+  }
+  for (auto& point : constant_points) {
+    parameter_ordering->AddElementToGroup(point.second.data(),
+                                          kTrackParameterGroup);
+    problem.SetParameterBlockConstant(point.second.data());
+  }
+
+  if (problem.NumResidualBlocks() == 0) {
+    solution->success = true;
+    return;
+  }
+
+  if (solver_options.use_inner_iterations) {
+    solver_options.inner_iteration_ordering.reset(
+        new ceres::ParameterBlockOrdering(*parameter_ordering));
+    solver_options.inner_iteration_ordering->Reverse();
+  }
+
+  const double internal_setup_time = timer.ElapsedTimeInSeconds();
+  ceres::Solver::Summary solver_summary;
+  ceres::Solve(solver_options, &problem, &solver_summary);
+  LOG_IF(INFO, options.verbose) << solver_summary.FullReport();
+
+  solution->success = solver_summary.IsSolutionUsable();
+  solution->setup_time_in_seconds =
+      internal_setup_time + solver_summary.preprocessor_time_in_seconds;
+  solution->solve_time_in_seconds = solver_summary.total_time_in_seconds;
+}
+
+}  // namespace
+
+void PartitionViewsForBundleAdjustment(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize,
+    const int max_num_views_per_partition,
+    std::vector<std::vector<ViewId> >* partitions) {
+  CHECK_GT(max_num_views_per_partition, 0);
+  CHECK_NOTNULL(partitions)->clear();
+
+  std::vector<ViewId> estimated_view_ids;
+  for (const ViewId view_id : views_to_optimize) {
+    if (reconstruction.View(view_id)->IsEstimated()) {
+      estimated_view_ids.emplace_back(view_id);
+    }
+  }
+  if (estimated_view_ids.empty()) {
+    return;
+  }
+  std::sort(estimated_view_ids.begin(), estimated_view_ids.end());
+  const std::unordered_set<ViewId> estimated_view_id_set(
+      estimated_view_ids.begin(), estimated_view_ids.end());
+
+  // The covisibility graph is weighted by the number of shared tracks.
+  std::unordered_map<std::pair<ViewId, ViewId>, double> covisibility;
+  std::vector<ViewId> track_view_ids;
+  for (const TrackId track_id : tracks_to_optimize) {
+    const Track* track = reconstruction.Track(track_id);
+    if (!track->IsEstimated()) {
+      continue;
+    }
+
+    track_view_ids.clear();
+    for (const ViewId view_id : track->ViewIds()) {
+      if (ContainsKey(estimated_view_id_set, view_id)) {
+        track_view_ids.emplace_back(view_id);
+      }
+    }
+    std::sort(track_view_ids.begin(), track_view_ids.end());
+    for (int i = 0; i < track_view_ids.size(); i++) {
+      for (int j = i + 1; j < track_view_ids.size(); j++) {
+        covisibility[std::make_pair(track_view_ids[i], track_view_ids[j])] +=
+            1.0;
+      }
+    }
+  }
+
+  // Recursively cut the views until all partitions are small enough.
+  std::vector<std::vector<ViewId> > views_to_partition;
+  views_to_partition.emplace_back(std::move(estimated_view_ids));
+  while (!views_to_partition.empty()) {
+    std::vector<ViewId> view_ids = std::move(views_to_partition.back());
+    views_to_partition.pop_back();
+    if (view_ids.size() <= max_num_views_per_partition) {
+      partitions->emplace_back(std::move(view_ids));
+      continue;
+    }
+
+    std::vector<ViewId> subgraph1, subgraph2;
+    SplitViews(covisibility, view_ids, &subgraph1, &subgraph2);
+    views_to_partition.emplace_back(std::move(subgraph1));
+    views_to_partition.emplace_back(std::move(subgraph2));
+  }
+}
+
+BundleAdjustmentSummary BundleAdjustReconstructionInPartitions(
+    const PartitionedBundleAdjustmentOptions& options,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize,
+    Reconstruction* reconstruction) {
+  CHECK_NOTNULL(reconstruction);
+  CHECK_GT(options.num_partitions_in_parallel, 0);
+  CHECK_GE(options.consensus_penalty, 0.0);
+
+  Timer timer;
+  std::vector<std::vector<ViewId> > partitions;
+  PartitionViewsForBundleAdjustment(*reconstruction,
+                                    views_to_optimize,
+                                    tracks_to_optimize,
+                                    options.max_num_views_per_partition,
+                                    &partitions);
+  if (partitions.size() <= 1) {
+    return BundleAdjustPartialReconstruction(options.bundle_adjustment_options,
+                                             views_to_optimize,
+                                             tracks_to_optimize,
+                                             reconstruction);
+  }
+
+  std::unordered_set<ViewId> partitioned_view_ids;
+  for (const std::vector<ViewId>& partition : partitions) {
+    partitioned_view_ids.insert(partition.begin(), partition.end());
+  }
+
+  // Find the tracks that are optimized in more than one partition.
+  std::unordered_map<TrackId, ConsensusTrack> consensus_tracks;
+  for (int i = 0; i < partitions.size(); i++) {
+    for (const TrackId track_id : GetTracksToOptimizeInViews(
+             *reconstruction, partitions[i], tracks_to_optimize)) {
+      consensus_tracks[track_id].partitions.emplace_back(i);
+    }
+  }
+  for (auto it = consensus_tracks.begin(); it != consensus_tracks.end();) {
+    if (it->second.partitions.size() < 2) {
+      it = consensus_tracks.erase(it);
+      continue;
+    }
+    const Eigen::Vector4d& point = reconstruction->Track(it->first)->Point();
+    it->second.estimates.resize(it->second.partitions.size(), point);
+    it->second.duals.resize(it->second.partitions.size(),
+                            Eigen::Vector4d::Zero());
+    ++it;
+  }
+  LOG(INFO) << "Bundle adjusting " << partitions.size()
+            << " partitions that share " << consensus_tracks.size()
+            << " tracks.";
+
+  const BundleAdjustmentOptions& ba_options =
+      options.bundle_adjustment_options;
+  BundleAdjustmentOptions partition_ba_options = ba_options;
+  partition_ba_options.num_threads =
+      std::max(1, ba_options.num_threads / options.num_partitions_in_parallel);
+  const std::unique_ptr<ceres::LossFunction> loss_function =
+      CreateLossFunction(ba_options.loss_function_type,
+                         ba_options.robust_loss_width);
+
+  BundleAdjustmentSummary summary;
+  summary.success = true;
+  summary.initial_cost = ComputeReprojectionCost(
+      *reconstruction, views_to_optimize, tracks_to_optimize, *loss_function);
+  summary.final_cost = summary.initial_cost;
+  summary.setup_time_in_seconds = timer.ElapsedTimeInSeconds();
+
+  for (int iteration = 0; iteration < options.max_num_iterations;
+       iteration++) {
+    std::unordered_map<CameraIntrinsicsGroupId,
+                       std::pair<Eigen::VectorXd, int> > intrinsics_sums;
+
+    // Optimize the partitions in batches. Only the problems of a single batch
+    // are held in memory at the same time. The camera poses and the tracks
+    // that are not shared are written back after each batch so that the next
+    // batch uses them as separators.
+    for (int batch_begin = 0; batch_begin < partitions.size();
+         batch_begin += options.num_partitions_in_parallel) {
+      const int batch_end =
+          std::min(static_cast<int>(partitions.size()),
+                   batch_begin + options.num_partitions_in_parallel);
+      std::vector<PartitionSolution> solutions(batch_end - batch_begin);
+      {
+        ThreadPool pool(batch_end - batch_begin);
+        for (int i = batch_begin; i < batch_end; i++) {
+          pool.Add([&, i]() {
+            OptimizePartition(partition_ba_options,
+                              *reconstruction,
+                              partitions[i],
+                              i,
+                              partitioned_view_ids,
+                              tracks_to_optimize,
+                              consensus_tracks,
+                              options.consensus_penalty,
+                              loss_function.get(),
+                              &solutions[i - batch_begin]);
+          });
+        }
+      }
+
+      for (int i = batch_begin; i < batch_end; i++) {
+        const PartitionSolution& solution = solutions[i - batch_begin];
+        summary.setup_time_in_seconds += solution.setup_time_in_seconds;
+        summary.solve_time_in_seconds += solution.solve_time_in_seconds;
+        if (!solution.success) {
+          LOG(WARNING) << "Bundle adjustment of partition " << i
+                       << " failed.";
+          summary.success = false;
+          continue;
+        }
+
+        for (const auto& extrinsics : solution.extrinsics) {
+          Eigen::Map<CameraExtrinsics>(reconstruction->MutableView(
+              extrinsics.first)->MutableCamera()->mutable_extrinsics()) =
+              extrinsics.second;
+        }
+        for (const auto& point : solution.points) {
+          ConsensusTrack* consensus_track =
+              FindOrNull(consensus_tracks, point.first);
+          if (consensus_track == nullptr) {
+            *reconstruction->MutableTrack(point.first)->MutablePoint() =
+                point.second;
+            continue;
+          }
+          const int index =
+              std::find(consensus_track->partitions.begin(),
+                        consensus_track->partitions.end(),
+                        i) -
+              consensus_track->partitions.begin();
+          consensus_track->estimates[index] = point.second;
+        }
+        for (const auto& intrinsics : solution.intrinsics) {
+          auto& intrinsics_sum = intrinsics_sums[intrinsics.first];
+          if (intrinsics_sum.second == 0) {
+            intrinsics_sum.first = intrinsics.second;
+          } else {
+            intrinsics_sum.first += intrinsics.second;
+          }
+          ++intrinsics_sum.second;
+        }
+      }
+    }
+
+    // Update the consensus points and the dual variables of the shared tracks.
+    for (auto& consensus_track : consensus_tracks) {
+      ConsensusTrack& track = consensus_track.second;
+      Eigen::Vector4d consensus_point = Eigen::Vector4d::Zero();
+      for (int i = 0; i < track.partitions.size(); i++) {
+        consensus_point += track.estimates[i] + track.duals[i];
+      }
+      consensus_point /= static_cast<double>(track.partitions.size());
+      for (int i = 0; i < track.partitions.size(); i++) {
+        track.duals[i] += track.estimates[i] - consensus_point;
+      }
+      *reconstruction->MutableTrack(consensus_track.first)->MutablePoint() =
+          consensus_point;
+    }
+
+    // Intrinsics that are shared by several partitions are averaged.
+    for (const auto& intrinsics_sum : intrinsics_sums) {
+      const ViewId view_id =
+          *reconstruction
+               ->GetViewsInCameraIntrinsicGroup(intrinsics_sum.first)
+               .begin();
+      Camera* camera = reconstruction->MutableView(view_id)->MutableCamera();
+      Eigen::Map<Eigen::VectorXd>(camera->mutable_intrinsics(),
+                                  intrinsics_sum.second.first.size()) =
+          intrinsics_sum.second.first / intrinsics_sum.second.second;
+    }
+
+    const double cost = ComputeReprojectionCost(
+        *reconstruction, views_to_optimize, tracks_to_optimize, *loss_function);
+    const double relative_cost_change =
+        std::abs(summary.final_cost - cost) /
+        std::max(summary.final_cost, std::numeric_limits<double>::epsilon());
+    LOG(INFO) << "Partitioned bundle adjustment iteration " << iteration
+              << ": cost = " << cost
+              << ", relative change = " << relative_cost_change;
+    summary.final_cost = cost;
+    if (relative_cost_change < options.function_tolerance) {
+      break;
+    }
+  }
+
+  return summary;
+}
+
+}  // namespace theia
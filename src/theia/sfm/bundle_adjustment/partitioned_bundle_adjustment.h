@@ -0,0 +1,112 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_BUNDLE_ADJUSTMENT_PARTITIONED_BUNDLE_ADJUSTMENT_H_
+#define THEIA_SFM_BUNDLE_ADJUSTMENT_PARTITIONED_BUNDLE_ADJUSTMENT_H_
+
+#include <unordered_set>
+#include <vector>
+
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/types.h"
+
+namespace theia {
+
+class Reconstruction;
+
+struct PartitionedBundleAdjustmentOptions {
+  // The options used for bundle adjustment of each partition. The number of
+  // threads is divided among the partitions that are solved in parallel.
+  BundleAdjustmentOptions bundle_adjustment_options;
+
+  // The views are recursively split with normalized graph cuts until no
+  // partition has more than this many views.
+  int max_num_views_per_partition = 500;
+
+  // The number of partitions that are optimized at the same time. Only the
+  // problems of these partitions are held in memory, so the peak memory of
+  // bundle adjustment is bounded by this many times the largest partition.
+  int num_partitions_in_parallel = 1;
+
+  // The maximum number of rounds in which all partitions are optimized once.
+  int max_num_iterations = 10;
+
+  // Iterations stop when the relative decrease of the total reprojection cost
+  // of a round is smaller than this value.
+  double function_tolerance = 1e-3;
+
+  // The weight of the consensus term that ties together the estimates of a 3D
+  // point that is optimized in several partitions. The term penalizes the
+  // squared distance to the consensus point and is multiplied by the number of
+  // observations of the point in the partition, so this value is the penalty
+  // per observation. It is given in squared pixels of reprojection error per
+  // squared unit of the reconstruction, so it depends on the scale of the
+  // reconstruction.
+  double consensus_penalty = 1.0;
+};
+
+// Bundle adjust the views and tracks of a reconstruction that is too large to
+// be bundle adjusted as a single problem. The views are split into partitions
+// of strongly connected views with normalized graph cuts on the covisibility
+// graph. Each partition is bundle adjusted on its own: the views of the
+// partition and the tracks they observe are optimized with the observations in
+// the views of the partition. Observations of the tracks in estimated views
+// that are not optimized are added to one of the partitions of the track with
+// the view held constant, so that every observation is part of exactly one
+// partition. Tracks that are observed by several partitions are coupled with
+// consensus ADMM. The partitions are optimized repeatedly until the total
+// reprojection cost converges.
+//
+// The initial and final cost of the summary are the total reprojection cost of
+// the views and tracks to optimize.
+BundleAdjustmentSummary BundleAdjustReconstructionInPartitions(
+    const PartitionedBundleAdjustmentOptions& options,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize,
+    Reconstruction* reconstruction);
+
+// Splits the views into partitions of at most max_num_views_per_partition views
+// by recursively applying normalized graph cuts to the covisibility graph of
+// the views. The edge weight between two views is the number of tracks to
+// optimize that both views observe.
+void PartitionViewsForBundleAdjustment(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize,
+    const int max_num_views_per_partition,
+    std::vector<std::vector<ViewId> >* partitions);
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_PARTITIONED_BUNDLE_ADJUSTMENT_H_
@@ -0,0 +1,185 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/view.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+namespace {
+RandomNumberGenerator rng(61);
+
+static const int kNumViewsPerCluster = 6;
+static const int kNumTracksPerCluster = 60;
+static const int kNumSharedTracks = 10;
+
+void AddTrack(const std::vector<ViewId>& view_ids,
+              const Eigen::Vector3d& point,
+              Reconstruction* reconstruction) {
+  const TrackId track_id = reconstruction->AddTrack();
+  for (const ViewId view_id : view_ids) {
+    Feature feature;
+    reconstruction->View(view_id)->Camera().ProjectPoint(point.homogeneous(),
+                                                         &feature);
+    reconstruction->AddObservation(view_id, track_id, feature);
+  }
+  Track* track = reconstruction->MutableTrack(track_id);
+  *track->MutablePoint() = point.homogeneous();
+  track->MutablePoint()->head<3>() += 0.05 * rng.RandVector3d();
+  track->SetEstimated(true);
+}
+
+// Creates a reconstruction with two clusters of views. The tracks of each
+// cluster are observed by all views of the cluster, and only a few tracks are
+// observed by the views of both clusters.
+void CreateReconstruction(Reconstruction* reconstruction) {
+  std::vector<ViewId> cluster1, cluster2;
+  for (int i = 0; i < 2 * kNumViewsPerCluster; i++) {
+    const ViewId view_id = reconstruction->AddView(std::to_string(i));
+    Camera* camera = reconstruction->MutableView(view_id)->MutableCamera();
+    camera->SetPosition(Eigen::Vector3d(i, 0, 0));
+    camera->SetOrientationFromAngleAxis(0.05 * rng.RandVector3d());
+    camera->SetImageSize(1000, 1000);
+    camera->SetFocalLength(800);
+    camera->SetPrincipalPoint(500.0, 500.0);
+    reconstruction->MutableView(view_id)->SetEstimated(true);
+    if (i < kNumViewsPerCluster) {
+      cluster1.emplace_back(view_id);
+    } else {
+      cluster2.emplace_back(view_id);
+    }
+  }
+
+  for (int i = 0; i < kNumTracksPerCluster; i++) {
+    AddTrack(cluster1,
+             Eigen::Vector3d(rng.RandDouble(-2.0, 7.0),
+                             rng.RandDouble(-2.0, 2.0),
+                             rng.RandDouble(8.0, 12.0)),
+             reconstruction);
+    AddTrack(cluster2,
+             Eigen::Vector3d(rng.RandDouble(4.0, 13.0),
+                             rng.RandDouble(-2.0, 2.0),
+                             rng.RandDouble(8.0, 12.0)),
+             reconstruction);
+  }
+  for (int i = 0; i < kNumSharedTracks; i++) {
+    AddTrack({cluster1.back(), cluster2.front()},
+             Eigen::Vector3d(rng.RandDouble(4.0, 7.0),
+                             rng.RandDouble(-2.0, 2.0),
+                             rng.RandDouble(8.0, 12.0)),
+             reconstruction);
+  }
+}
+
+void GetAllViewsAndTracks(const Reconstruction& reconstruction,
+                          std::unordered_set<ViewId>* view_ids,
+                          std::unordered_set<TrackId>* track_ids) {
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    view_ids->emplace(view_id);
+  }
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    track_ids->emplace(track_id);
+  }
+}
+
+}  // namespace
+
+TEST(PartitionedBundleAdjustment, PartitionsFollowCovisibility) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  std::unordered_set<ViewId> view_ids;
+  std::unordered_set<TrackId> track_ids;
+  GetAllViewsAndTracks(reconstruction, &view_ids, &track_ids);
+
+  std::vector<std::vector<ViewId> > partitions;
+  PartitionViewsForBundleAdjustment(
+      reconstruction, view_ids, track_ids, kNumViewsPerCluster, &partitions);
+  ASSERT_EQ(partitions.size(), 2);
+
+  // Each partition must be one of the clusters.
+  for (std::vector<ViewId> partition : partitions) {
+    ASSERT_EQ(partition.size(), kNumViewsPerCluster);
+    std::sort(partition.begin(), partition.end());
+    EXPECT_EQ(partition.back() - partition.front(), kNumViewsPerCluster - 1);
+  }
+
+  // Smaller partitions still contain every view exactly once.
+  PartitionViewsForBundleAdjustment(
+      reconstruction, view_ids, track_ids, 4, &partitions);
+  std::vector<ViewId> partitioned_view_ids;
+  for (const auto& partition : partitions) {
+    EXPECT_LE(partition.size(), 4);
+    partitioned_view_ids.insert(
+        partitioned_view_ids.end(), partition.begin(), partition.end());
+  }
+  std::vector<ViewId> all_view_ids = reconstruction.ViewIds();
+  std::sort(partitioned_view_ids.begin(), partitioned_view_ids.end());
+  std::sort(all_view_ids.begin(), all_view_ids.end());
+  EXPECT_EQ(partitioned_view_ids, all_view_ids);
+}
+
+TEST(PartitionedBundleAdjustment, ReducesReprojectionCost) {
+  Reconstruction reconstruction;
+  CreateReconstruction(&reconstruction);
+  std::unordered_set<ViewId> view_ids;
+  std::unordered_set<TrackId> track_ids;
+  GetAllViewsAndTracks(reconstruction, &view_ids, &track_ids);
+
+  PartitionedBundleAdjustmentOptions options;
+  options.bundle_adjustment_options.linear_solver_type = ceres::DENSE_SCHUR;
+  options.bundle_adjustment_options.use_inner_iterations = false;
+  options.bundle_adjustment_options.intrinsics_to_optimize =
+      OptimizeIntrinsicsType::NONE;
+  options.max_num_views_per_partition = kNumViewsPerCluster;
+  options.num_partitions_in_parallel = 2;
+
+  const BundleAdjustmentSummary summary = BundleAdjustReconstructionInPartitions(
+      options, view_ids, track_ids, &reconstruction);
+  EXPECT_TRUE(summary.success);
+  EXPECT_LT(summary.final_cost, 0.1 * summary.initial_cost);
+}
+
+}  // namespace theia
@@ -0,0 +1,399 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/bundle_adjustment/refine_track_points.h"
+
+#include <ceres/ceres.h>
+#include <ceres/jet.h>
+#include <glog/logging.h>
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera/camera_intrinsics_model_type.h"
+#include "theia/sfm/camera/division_undistortion_camera_model.h"
+#include "theia/sfm/camera/fisheye_camera_model.h"
+#include "theia/sfm/camera/fov_camera_model.h"
+#include "theia/sfm/camera/pinhole_camera_model.h"
+#include "theia/sfm/camera/pinhole_radial_tangential_camera_model.h"
+#include "theia/sfm/feature.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/view.h"
+#include "theia/util/threadpool.h"
+
+namespace theia {
+
+namespace {
+
+typedef Eigen::Matrix<double, 2, 3> Matrix23d;
+
+// Points closer than this (squared) distance to a camera center cannot be
+// projected into that camera. This matches ReprojectionError.
+static const double kVerySmallNumber = 1e-8;
+
+// The damping of the normal equations is bounded to these values. Refinement of
+// a point stops if no step can decrease its cost with the maximum damping.
+static const double kInitialDamping = 1e-4;
+static const double kMinDamping = 1e-10;
+static const double kMaxDamping = 1e10;
+
+// The camera parameters of a view that observes at least one of the points.
+struct ObservingCamera {
+  Eigen::Matrix3d rotation;
+  Eigen::Vector3d position;
+  CameraIntrinsicsModelType intrinsics_model_type;
+  const double* intrinsics;
+};
+
+// The observations of a chunk of points stored in contiguous arrays. The
+// observations of the i-th point are in the range
+// [observation_offsets[i], observation_offsets[i + 1]).
+struct PointObservations {
+  std::vector<ObservingCamera> cameras;
+  std::vector<int> observation_offsets;
+  std::vector<int> camera_indices;
+  std::vector<Feature> features;
+};
+
+// Projects a point in the camera coordinate system to pixel coordinates and
+// computes the 2x3 Jacobian of the projection with respect to the point.
+template <class CameraModel>
+void ProjectPointWithJacobian(const double* intrinsics,
+                              const Eigen::Vector3d& camera_point,
+                              Eigen::Vector2d* pixel,
+                              Matrix23d* jacobian) {
+  typedef ceres::Jet<double, 3> JetType;
+
+  JetType intrinsics_jet[CameraModel::kIntrinsicsSize];
+  for (int i = 0; i < CameraModel::kIntrinsicsSize; i++) {
+    intrinsics_jet[i] = JetType(intrinsics[i]);
+  }
+  const JetType point_jet[3] = {JetType(camera_point.x(), 0),
+                                JetType(camera_point.y(), 1),
+                                JetType(camera_point.z(), 2)};
+  JetType pixel_jet[2];
+  CameraModel::CameraToPixelCoordinates(intrinsics_jet, point_jet, pixel_jet);
+
+  for (int i = 0; i < 2; i++) {
+    (*pixel)(i) = pixel_jet[i].a;
+    jacobian->row(i) = pixel_jet[i].v.transpose();
+  }
+}
+
+void ProjectPointWithJacobian(const ObservingCamera& camera,
+                              const Eigen::Vector3d& camera_point,
+                              Eigen::Vector2d* pixel,
+                              Matrix23d* jacobian) {
+  switch (camera.intrinsics_model_type) {
+    case CameraIntrinsicsModelType::PINHOLE:
+      ProjectPointWithJacobian<PinholeCameraModel>(
+          camera.intrinsics, camera_point, pixel, jacobian);
+      break;
+    case CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL:
+      ProjectPointWithJacobian<PinholeRadialTangentialCameraModel>(
+          camera.intrinsics, camera_point, pixel, jacobian);
+      break;
+    case CameraIntrinsicsModelType::FISHEYE:
+      ProjectPointWithJacobian<FisheyeCameraModel>(
+          camera.intrinsics, camera_point, pixel, jacobian);
+      break;
+    case CameraIntrinsicsModelType::FOV:
+      ProjectPointWithJacobian<FOVCameraModel>(
+          camera.intrinsics, camera_point, pixel, jacobian);
+      break;
+    case CameraIntrinsicsModelType::DIVISION_UNDISTORTION:
+      ProjectPointWithJacobian<DivisionUndistortionCameraModel>(
+          camera.intrinsics, camera_point, pixel, jacobian);
+      break;
+    default:
+      LOG(FATAL) << "Invalid camera type. Please see camera_intrinsics_model.h "
+                    "for a list of valid camera models.";
+      break;
+  }
+}
+
+// Gathers the observations of the points of tracks [start, end) in estimated
+// views.
+void GatherObservations(const Reconstruction& reconstruction,
+                        const std::vector<TrackId>& track_ids,
+                        const int start,
+                        const int end,
+                        PointObservations* observations) {
+  std::unordered_map<ViewId, int> camera_index_of_view;
+  observations->observation_offsets.reserve(end - start + 1);
+  observations->observation_offsets.emplace_back(0);
+  for (int i = start; i < end; i++) {
+    const Track* track = reconstruction.Track(track_ids[i]);
+    for (const ViewId view_id : track->ViewIds()) {
+      const View* view = reconstruction.View(view_id);
+      if (view == nullptr || !view->IsEstimated()) {
+        continue;
+      }
+
+      const auto inserted = camera_index_of_view.emplace(
+          view_id, static_cast<int>(observations->cameras.size()));
+      if (inserted.second) {
+        const Camera& camera = view->Camera();
+        ObservingCamera observing_camera;
+        observing_camera.rotation = camera.GetOrientationAsRotationMatrix();
+        observing_camera.position = camera.GetPosition();
+        observing_camera.intrinsics_model_type =
+            camera.GetCameraIntrinsicsModelType();
+        observing_camera.intrinsics = camera.intrinsics();
+        observations->cameras.emplace_back(observing_camera);
+      }
+      observations->camera_indices.emplace_back(inserted.first->second);
+      observations->features.emplace_back(
+          *CHECK_NOTNULL(view->GetFeature(track_ids[i])));
+    }
+    observations->observation_offsets.emplace_back(
+        static_cast<int>(observations->features.size()));
+  }
+}
+
+// Evaluates the robust cost of the point as well as the reweighted normal
+// equations J^t * W * J and J^t * W * r if they are requested. Returns false if
+// the point cannot be projected into one of the cameras.
+bool EvaluatePoint(const PointObservations& observations,
+                   const ceres::LossFunction& loss_function,
+                   const int point_index,
+                   const Eigen::Vector4d& point,
+                   double* cost,
+                   Eigen::Matrix3d* jtj,
+                   Eigen::Vector3d* jtr) {
+  *cost = 0.0;
+  if (jtj != nullptr) {
+    jtj->setZero();
+    jtr->setZero();
+  }
+
+  Eigen::Vector2d pixel;
+  Matrix23d projection_jacobian;
+  for (int i = observations.observation_offsets[point_index];
+       i < observations.observation_offsets[point_index + 1];
+       i++) {
+    const ObservingCamera& camera =
+        observations.cameras[observations.camera_indices[i]];
+    const Eigen::Vector3d adjusted_point =
+        point.head<3>() - point[3] * camera.position;
+    if (adjusted_point.squaredNorm() < kVerySmallNumber) {
+      return false;
+    }
+
+    ProjectPointWithJacobian(camera,
+                             camera.rotation * adjusted_point,
+                             &pixel,
+                             &projection_jacobian);
+    const Eigen::Vector2d residual = pixel - observations.features[i];
+
+    double rho[3];
+    loss_function.Evaluate(residual.squaredNorm(), rho);
+    *cost += 0.5 * rho[0];
+    if (jtj == nullptr) {
+      continue;
+    }
+
+    // The rotation is the Jacobian of the camera point with respect to the
+    // point. The derivative of the loss is the weight of the observation.
+    const Matrix23d jacobian = projection_jacobian * camera.rotation;
+    jtj->noalias() += rho[1] * jacobian.transpose() * jacobian;
+    jtr->noalias() += rho[1] * jacobian.transpose() * residual;
+  }
+  return true;
+}
+
+// Refines the point with Levenberg-Marquardt. The initial and final costs are
+// returned.
+void RefinePoint(const PointRefinementOptions& options,
+                 const PointObservations& observations,
+                 const ceres::LossFunction& loss_function,
+                 const int point_index,
+                 Eigen::Vector4d* point,
+                 double* initial_cost,
+                 double* final_cost) {
+  double cost;
+  Eigen::Matrix3d jtj;
+  Eigen::Vector3d jtr;
+  if (!EvaluatePoint(observations,
+                     loss_function,
+                     point_index,
+                     *point,
+                     &cost,
+                     &jtj,
+                     &jtr)) {
+    *initial_cost = *final_cost = 0.0;
+    return;
+  }
+  *initial_cost = cost;
+
+  double damping = kInitialDamping;
+  double candidate_cost;
+  Eigen::Matrix3d candidate_jtj;
+  Eigen::Vector3d candidate_jtr;
+  for (int i = 0; i < options.max_num_iterations && damping < kMaxDamping;
+       i++) {
+    Eigen::Matrix3d damped_jtj = jtj;
+    damped_jtj.diagonal() *= 1.0 + damping;
+    const Eigen::Vector3d step = damped_jtj.ldlt().solve(-jtr);
+    if (!step.allFinite() ||
+        step.norm() <= options.parameter_tolerance *
+                           (point->head<3>().norm() +
+                            options.parameter_tolerance)) {
+      break;
+    }
+
+    Eigen::Vector4d candidate_point = *point;
+    candidate_point.head<3>() += step;
+    if (!EvaluatePoint(observations,
+                       loss_function,
+                       point_index,
+                       candidate_point,
+                       &candidate_cost,
+                       &candidate_jtj,
+                       &candidate_jtr) ||
+        candidate_cost >= cost) {
+      damping *= 10.0;
+      continue;
+    }
+
+    const double relative_decrease = (cost - candidate_cost) / cost;
+    *point = candidate_point;
+    cost = candidate_cost;
+    jtj = candidate_jtj;
+    jtr = candidate_jtr;
+    damping = std::max(damping / 10.0, kMinDamping);
+    if (relative_decrease <= options.function_tolerance) {
+      break;
+    }
+  }
+  *final_cost = cost;
+}
+
+// Refines the points of tracks [start, end) and writes them back to the
+// reconstruction. Each task only touches its own tracks so the tasks may run
+// concurrently.
+void RefineTrackPointsInRange(const PointRefinementOptions& options,
+                              const ceres::LossFunction& loss_function,
+                              const std::vector<TrackId>& track_ids,
+                              const int start,
+                              const int end,
+                              Reconstruction* reconstruction,
+                              PointRefinementSummary* summary) {
+  static const int kMinNumObservations = 2;
+
+  PointObservations observations;
+  GatherObservations(*reconstruction, track_ids, start, end, &observations);
+
+  for (int i = start; i < end; i++) {
+    const int point_index = i - start;
+    if (observations.observation_offsets[point_index + 1] -
+            observations.observation_offsets[point_index] <
+        kMinNumObservations) {
+      continue;
+    }
+
+    Eigen::Vector4d* point =
+        reconstruction->MutableTrack(track_ids[i])->MutablePoint();
+    double initial_cost, final_cost;
+    RefinePoint(options,
+                observations,
+                loss_function,
+                point_index,
+                point,
+                &initial_cost,
+                &final_cost);
+    ++summary->num_refined_points;
+    summary->initial_cost += initial_cost;
+    summary->final_cost += final_cost;
+  }
+}
+
+}  // namespace
+
+PointRefinementSummary RefineTrackPoints(const PointRefinementOptions& options,
+                                         const std::vector<TrackId>& track_ids,
+                                         Reconstruction* reconstruction) {
+  CHECK_NOTNULL(reconstruction);
+  CHECK_GT(options.num_points_per_task, 0);
+
+  PointRefinementSummary summary;
+  if (track_ids.empty()) {
+    return summary;
+  }
+
+  // The loss function is stateless so a single instance is shared by all
+  // threads.
+  const std::unique_ptr<ceres::LossFunction> loss_function = CreateLossFunction(
+      options.loss_function_type, options.robust_loss_width);
+
+  // Each task writes to its own summary. The summaries are combined in task
+  // order so that the result does not depend on the scheduling of the tasks.
+  const int num_tasks =
+      (static_cast<int>(track_ids.size()) + options.num_points_per_task - 1) /
+      options.num_points_per_task;
+  std::vector<PointRefinementSummary> task_summaries(num_tasks);
+  {
+    ThreadPool pool(std::max(1, std::min(options.num_threads, num_tasks)));
+    for (int i = 0; i < num_tasks; i++) {
+      const int start = i * options.num_points_per_task;
+      const int end = std::min(static_cast<int>(track_ids.size()),
+                               start + options.num_points_per_task);
+      pool.Add([&, i, start, end]() {
+        RefineTrackPointsInRange(options,
+                                 *loss_function,
+                                 track_ids,
+                                 start,
+                                 end,
+                                 reconstruction,
+                                 &task_summaries[i]);
+      });
+    }
+  }
+
+  for (const PointRefinementSummary& task_summary : task_summaries) {
+    summary.num_refined_points += task_summary.num_refined_points;
+    summary.initial_cost += task_summary.initial_cost;
+    summary.final_cost += task_summary.final_cost;
+  }
+  return summary;
+}
+
+}  // namespace theia
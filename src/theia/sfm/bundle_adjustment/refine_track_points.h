@@ -0,0 +1,90 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_BUNDLE_ADJUSTMENT_REFINE_TRACK_POINTS_H_
+#define THEIA_SFM_BUNDLE_ADJUSTMENT_REFINE_TRACK_POINTS_H_
+
+#include <vector>
+
+#include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/types.h"
+
+namespace theia {
+
+class Reconstruction;
+
+struct PointRefinementOptions {
+  // The robust loss applied to the squared reprojection error of each
+  // observation. It is applied with iteratively reweighted least squares.
+  LossFunctionType loss_function_type = LossFunctionType::TRIVIAL;
+  double robust_loss_width = 2.0;
+
+  // Maximum number of Levenberg-Marquardt iterations per point.
+  int max_num_iterations = 20;
+
+  // The refinement of a point stops once the relative decrease of its cost or
+  // the size of its update relative to the point falls below these values.
+  double function_tolerance = 1e-6;
+  double parameter_tolerance = 1e-8;
+
+  // The points are refined in chunks of num_points_per_task points that are
+  // distributed over num_threads threads.
+  int num_threads = 1;
+  int num_points_per_task = 256;
+};
+
+struct PointRefinementSummary {
+  // Number of points with at least two observations in estimated views. Only
+  // these points are refined.
+  int num_refined_points = 0;
+
+  // The total cost of the refined points before and after refinement.
+  double initial_cost = 0.0;
+  double final_cost = 0.0;
+};
+
+// Refines the 3D points of the tracks by minimizing their reprojection errors
+// in all estimated views while holding the cameras constant. This solves the
+// same problem as calling BundleAdjustTrack on each track but without building
+// a Ceres problem: the observations of each chunk of points are gathered into
+// contiguous arrays and every point is refined with Levenberg-Marquardt on its
+// closed-form 3x3 normal equations. The homogeneous coordinate of the points is
+// held constant.
+PointRefinementSummary RefineTrackPoints(const PointRefinementOptions& options,
+                                         const std::vector<TrackId>& track_ids,
+                                         Reconstruction* reconstruction);
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_BUNDLE_ADJUSTMENT_REFINE_TRACK_POINTS_H_
@@ -0,0 +1,179 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/bundle_adjustment/create_loss_function.h"
+#include "theia/sfm/bundle_adjustment/refine_track_points.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/view.h"
+#include "theia/util/random.h"
+
+namespace theia {
+
+namespace {
+
+static const int kNumViews = 5;
+static const int kNumPoints = 50;
+static const double kFocalLength = 1000.0;
+
+// Creates estimated views that observe the points without noise. The ground
+// truth points are returned.
+void CreateReconstruction(const int num_observing_views,
+                          Reconstruction* reconstruction,
+                          std::vector<TrackId>* track_ids,
+                          std::vector<Eigen::Vector4d>* points) {
+  RandomNumberGenerator rng(51);
+  for (int i = 0; i < kNumViews; i++) {
+    const ViewId view_id = reconstruction->AddView(std::to_string(i));
+    View* view = reconstruction->MutableView(view_id);
+    Camera* camera = view->MutableCamera();
+    camera->SetFocalLength(kFocalLength);
+    camera->SetPrincipalPoint(500.0, 500.0);
+    camera->SetPosition(Eigen::Vector3d(2.0 * i - kNumViews, i % 2, -10.0));
+    camera->SetOrientationFromAngleAxis(0.05 * rng.RandVector3d());
+    view->SetEstimated(true);
+  }
+
+  for (int i = 0; i < kNumPoints; i++) {
+    const TrackId track_id = reconstruction->AddTrack();
+    Eigen::Vector4d point;
+    point << 2.0 * rng.RandVector3d(), 1.0;
+    for (int j = 0; j < num_observing_views; j++) {
+      Feature feature;
+      reconstruction->View(j)->Camera().ProjectPoint(point, &feature);
+      reconstruction->AddObservation(j, track_id, feature);
+    }
+    *reconstruction->MutableTrack(track_id)->MutablePoint() = point;
+    track_ids->emplace_back(track_id);
+    points->emplace_back(point);
+  }
+}
+
+// Returns the mean distance between the points of the tracks and the ground
+// truth points.
+double MeanPointError(const Reconstruction& reconstruction,
+                      const std::vector<TrackId>& track_ids,
+                      const std::vector<Eigen::Vector4d>& points) {
+  double error = 0.0;
+  for (int i = 0; i < track_ids.size(); i++) {
+    error += (reconstruction.Track(track_ids[i])->Point() - points[i]).norm();
+  }
+  return error / track_ids.size();
+}
+
+void PerturbPoints(const double noise,
+                   const std::vector<TrackId>& track_ids,
+                   Reconstruction* reconstruction) {
+  RandomNumberGenerator rng(73);
+  for (const TrackId track_id : track_ids) {
+    reconstruction->MutableTrack(track_id)->MutablePoint()->head<3>() +=
+        noise * rng.RandVector3d();
+  }
+}
+
+}  // namespace
+
+TEST(RefineTrackPoints, NoisyPointsConvergeToGroundTruth) {
+  Reconstruction reconstruction;
+  std::vector<TrackId> track_ids;
+  std::vector<Eigen::Vector4d> points;
+  CreateReconstruction(kNumViews, &reconstruction, &track_ids, &points);
+  PerturbPoints(0.2, track_ids, &reconstruction);
+
+  // Use small tasks so that the points are split over several threads.
+  PointRefinementOptions options;
+  options.num_threads = 4;
+  options.num_points_per_task = 7;
+  options.function_tolerance = 0.0;
+  const PointRefinementSummary summary =
+      RefineTrackPoints(options, track_ids, &reconstruction);
+
+  EXPECT_EQ(summary.num_refined_points, kNumPoints);
+  EXPECT_GT(summary.initial_cost, 0.0);
+  EXPECT_LT(summary.final_cost, 1e-8);
+  EXPECT_LT(MeanPointError(reconstruction, track_ids, points), 1e-6);
+}
+
+TEST(RefineTrackPoints, RobustLossDownweightsOutliers) {
+  // Refines the points after moving their observations in the first view far
+  // away from the projections.
+  const auto refine_points_with_outliers =
+      [](const PointRefinementOptions& options) {
+        Reconstruction reconstruction;
+        std::vector<TrackId> track_ids;
+        std::vector<Eigen::Vector4d> points;
+        CreateReconstruction(kNumViews, &reconstruction, &track_ids, &points);
+        View* view = reconstruction.MutableView(0);
+        for (const TrackId track_id : track_ids) {
+          const Feature feature =
+              *view->GetFeature(track_id) + Feature(50.0, -50.0);
+          view->RemoveFeature(track_id);
+          view->AddFeature(track_id, feature);
+        }
+        PerturbPoints(0.2, track_ids, &reconstruction);
+
+        RefineTrackPoints(options, track_ids, &reconstruction);
+        return MeanPointError(reconstruction, track_ids, points);
+      };
+
+  PointRefinementOptions options;
+  const double error = refine_points_with_outliers(options);
+  options.loss_function_type = LossFunctionType::HUBER;
+  options.max_num_iterations = 100;
+  const double robust_error = refine_points_with_outliers(options);
+  EXPECT_LT(robust_error, 0.5 * error);
+}
+
+TEST(RefineTrackPoints, PointsWithOneObservationAreUnchanged) {
+  Reconstruction reconstruction;
+  std::vector<TrackId> track_ids;
+  std::vector<Eigen::Vector4d> points;
+  CreateReconstruction(1, &reconstruction, &track_ids, &points);
+  PerturbPoints(0.2, track_ids, &reconstruction);
+  const Eigen::Vector4d perturbed_point =
+      reconstruction.Track(track_ids[0])->Point();
+
+  const PointRefinementSummary summary =
+      RefineTrackPoints(PointRefinementOptions(), track_ids, &reconstruction);
+  EXPECT_EQ(summary.num_refined_points, 0);
+  EXPECT_EQ(reconstruction.Track(track_ids[0])->Point(), perturbed_point);
+}
+
+}  // namespace theia
@@ -226,6 +226,41 @@ Vector3d Camera::PixelToNormalizedCoordinates(const Vector2d& pixel) const {
   return camera_intrinsics_->ImageToCameraCoordinates(pixel);
 }
 
+void Camera::ProjectPoints(const std::vector<Vector4d>& points,
+                           std::vector<Vector2d>* pixels,
+                           std::vector<double>* depths) const {
+  const Matrix3d rotation = GetOrientationAsRotationMatrix();
+  const Vector3d position = GetPosition();
+  std::vector<Vector3d> rotated_points(points.size());
+  for (int i = 0; i < points.size(); i++) {
+    rotated_points[i] =
+        rotation * (points[i].head<3>() - points[i][3] * position);
+  }
+  camera_intrinsics_->CameraToImageCoordinates(rotated_points, pixels);
+
+  if (depths != nullptr) {
+    depths->resize(points.size());
+    for (int i = 0; i < points.size(); i++) {
+      (*depths)[i] = rotated_points[i][2] / points[i][3];
+    }
+  }
+}
+
+void Camera::PixelsToUnitDepthRays(const std::vector<Vector2d>& pixels,
+                                   std::vector<Vector3d>* rays) const {
+  PixelsToNormalizedCoordinates(pixels, rays);
+  const Matrix3d rotation = GetOrientationAsRotationMatrix();
+  for (Vector3d& ray : *rays) {
+    ray = rotation.transpose() * ray;
+  }
+}
+
+void Camera::PixelsToNormalizedCoordinates(
+    const std::vector<Vector2d>& pixels,
+    std::vector<Vector3d>* normalized_points) const {
+  camera_intrinsics_->ImageToCameraCoordinates(pixels, normalized_points);
+}
+
 void Camera::PrintCameraIntrinsics() const {
   camera_intrinsics_->PrintIntrinsics();
 }
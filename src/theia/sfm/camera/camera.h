@@ -146,6 +146,20 @@ class Camera {
   Eigen::Vector3d PixelToNormalizedCoordinates(
       const Eigen::Vector2d& pixel) const;
 
+  // Batch versions of ProjectPoint, PixelToUnitDepthRay and
+  // PixelToNormalizedCoordinates. The rotation is only computed once and the
+  // camera intrinsics model is only dispatched once for all points, which is
+  // much faster than calling the single point methods in a loop. depths may be
+  // NULL if the depths of the points are not needed.
+  void ProjectPoints(const std::vector<Eigen::Vector4d>& points,
+                     std::vector<Eigen::Vector2d>* pixels,
+                     std::vector<double>* depths) const;
+  void PixelsToUnitDepthRays(const std::vector<Eigen::Vector2d>& pixels,
+                             std::vector<Eigen::Vector3d>* rays) const;
+  void PixelsToNormalizedCoordinates(
+      const std::vector<Eigen::Vector2d>& pixels,
+      std::vector<Eigen::Vector3d>* normalized_points) const;
+
   // Print the camera intrinsics values in a human-readable format.
   void PrintCameraIntrinsics() const;
 
@@ -151,6 +151,42 @@ Eigen::Vector3d CameraIntrinsicsModel::ImageToCameraCoordinates(
   return point;
 }
 
+void CameraIntrinsicsModel::CameraToImageCoordinates(
+    const std::vector<Eigen::Vector3d>& points,
+    std::vector<Eigen::Vector2d>* pixels) const {
+  CHECK_NOTNULL(pixels)->resize(points.size());
+  const double* intrinsics = parameters();
+
+#define CAMERA_MODEL_CASE_BODY(CameraModel)                             \
+  for (int i = 0; i < points.size(); i++) {                             \
+    CameraModel::CameraToPixelCoordinates(                              \
+        intrinsics, points[i].data(), (*pixels)[i].data());             \
+  }
+
+  // Execute the switch statement.
+  CAMERA_MODEL_SWITCH_STATEMENT
+
+#undef CAMERA_MODEL_CASE_BODY
+}
+
+void CameraIntrinsicsModel::ImageToCameraCoordinates(
+    const std::vector<Eigen::Vector2d>& pixels,
+    std::vector<Eigen::Vector3d>* points) const {
+  CHECK_NOTNULL(points)->resize(pixels.size());
+  const double* intrinsics = parameters();
+
+#define CAMERA_MODEL_CASE_BODY(CameraModel)                             \
+  for (int i = 0; i < pixels.size(); i++) {                             \
+    CameraModel::PixelToCameraCoordinates(                              \
+        intrinsics, pixels[i].data(), (*points)[i].data());             \
+  }
+
+  // Execute the switch statement.
+  CAMERA_MODEL_SWITCH_STATEMENT
+
+#undef CAMERA_MODEL_CASE_BODY
+}
+
 Eigen::Vector2d CameraIntrinsicsModel::DistortPoint(
     const Eigen::Vector2d& undistorted_point) const {
   Eigen::Vector2d distorted_point;
@@ -188,6 +188,14 @@ class CameraIntrinsicsModel {
   virtual Eigen::Vector2d UndistortPoint(
       const Eigen::Vector2d& distorted_point) const;
 
+  // Batch versions of CameraToImageCoordinates and ImageToCameraCoordinates.
+  // The camera model is only dispatched once for all points instead of once per
+  // point.
+  void CameraToImageCoordinates(const std::vector<Eigen::Vector3d>& points,
+                                std::vector<Eigen::Vector2d>* pixels) const;
+  void ImageToCameraCoordinates(const std::vector<Eigen::Vector2d>& pixels,
+                                std::vector<Eigen::Vector3d>* points) const;
+
   // ----------------------- Getter and Setter methods ---------------------- //
   virtual void SetFocalLength(const double focal_length);
   virtual double FocalLength() const;
@@ -42,6 +42,7 @@
 #include "theia/sfm/camera/camera.h"
 #include "theia/sfm/camera/camera_intrinsics_model.h"
 #include "theia/sfm/camera/pinhole_camera_model.h"
+#include "theia/sfm/camera/pinhole_radial_tangential_camera_model.h"
 #include "theia/test/test_utils.h"
 #include "theia/util/random.h"
 
@@ -226,6 +227,50 @@ TEST(Camera, Reprojection) {
   }
 }
 
+TEST(Camera, BatchProjectionMatchesSinglePoints) {
+  const double kTolerance = 1e-10;
+
+  Camera camera(CameraIntrinsicsModelType::PINHOLE_RADIAL_TANGENTIAL);
+  camera.SetFocalLength(500.0);
+  camera.SetPrincipalPoint(300.0, 200.0);
+  camera.mutable_intrinsics()
+      [PinholeRadialTangentialCameraModel::RADIAL_DISTORTION_1] = -0.05;
+  camera.SetPosition(rng.RandVector3d());
+  camera.SetOrientationFromAngleAxis(0.2 * rng.RandVector3d());
+
+  std::vector<Vector2d> pixels;
+  std::vector<Vector4d> points;
+  for (int i = 0; i < 10; i++) {
+    pixels.emplace_back(Vector2d(300.0, 200.0) + 150.0 * rng.RandVector2d());
+    points.emplace_back(
+        (camera.GetPosition() +
+         rng.RandDouble(1.0, 10.0) * camera.PixelToUnitDepthRay(pixels[i]))
+            .homogeneous());
+  }
+
+  std::vector<Vector3d> rays, normalized_points;
+  camera.PixelsToUnitDepthRays(pixels, &rays);
+  camera.PixelsToNormalizedCoordinates(pixels, &normalized_points);
+  std::vector<Vector2d> projections;
+  std::vector<double> depths;
+  camera.ProjectPoints(points, &projections, &depths);
+
+  ASSERT_EQ(rays.size(), pixels.size());
+  ASSERT_EQ(projections.size(), points.size());
+  for (int i = 0; i < pixels.size(); i++) {
+    EXPECT_LT((rays[i] - camera.PixelToUnitDepthRay(pixels[i])).norm(),
+              kTolerance);
+    EXPECT_LT((normalized_points[i] -
+               camera.PixelToNormalizedCoordinates(pixels[i])).norm(),
+              kTolerance);
+
+    Vector2d projection;
+    const double depth = camera.ProjectPoint(points[i], &projection);
+    EXPECT_LT((projections[i] - projection).norm(), kTolerance);
+    EXPECT_NEAR(depths[i], depth, kTolerance);
+  }
+}
+
 TEST(Camera, SetCameraIntrinsicsModelType) {
   static const double kFocalLength = 100.0;
 
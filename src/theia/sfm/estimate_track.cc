@@ -36,11 +36,16 @@
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "theia/math/util.h"
-#include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/refine_track_points.h"
+#include "theia/sfm/camera/camera.h"
 #include "theia/sfm/estimators/estimate_triangulation.h"
 #include "theia/sfm/feature.h"
 #include "theia/sfm/reconstruction.h"
@@ -48,6 +53,7 @@
 #include "theia/sfm/track.h"
 #include "theia/sfm/triangulation/triangulation.h"
 #include "theia/sfm/types.h"
+#include "theia/sfm/view.h"
 #include "theia/util/map_util.h"
 #include "theia/util/threadpool.h"
 
@@ -55,13 +61,10 @@ namespace theia {
 
 namespace {
 
-void GetObservationsFromTrackViews(
-    const TrackId track_id,
-    const Reconstruction& reconstruction,
-    std::vector<ViewId>* view_ids,
-    std::vector<Eigen::Vector2d>* features,
-    std::vector<Eigen::Vector3d>* origins,
-    std::vector<Eigen::Vector3d>* ray_directions) {
+void GetObservationsFromTrackViews(const TrackId track_id,
+                                   const Reconstruction& reconstruction,
+                                   std::vector<ViewId>* view_ids,
+                                   std::vector<Eigen::Vector2d>* features) {
   const Track* track = reconstruction.Track(track_id);
   for (const ViewId view_id : track->ViewIds()) {
     const View* view = reconstruction.View(view_id);
@@ -74,13 +77,8 @@ void GetObservationsFromTrackViews(
     // If the feature is not in the view then we have an ill-formed
     // reconstruction.
     const Feature* feature = CHECK_NOTNULL(view->GetFeature(track_id));
-    const Eigen::Vector3d image_ray =
-        view->Camera().PixelToUnitDepthRay(*feature).normalized();
-
     features->emplace_back(*feature);
     view_ids->emplace_back(view_id);
-    origins->emplace_back(view->Camera().GetPosition());
-    ray_directions->emplace_back(image_ray);
   }
 }
 
@@ -136,6 +134,7 @@ TrackEstimator::Summary TrackEstimator::EstimateAllTracks() {
 TrackEstimator::Summary TrackEstimator::EstimateTracks(
     const std::unordered_set<TrackId>& track_ids) {
   tracks_to_estimate_.clear();
+  triangulated_tracks_.clear();
   summary_ = TrackEstimator::Summary();
   num_bad_angles_ = 0;
   num_failed_triangulations_ = 0;
@@ -158,27 +157,35 @@ TrackEstimator::Summary TrackEstimator::EstimateTracks(
     return summary_;
   }
 
-  // Estimate the tracks in parallel. Instead of 1 threadpool worker per track,
-  // we let each worker estimate a fixed number of tracks at a time (e.g. 20
-  // tracks). Since estimating the tracks is so fast, this strategy is better
-  // helps speed up multithreaded estimation by reducing the overhead of
-  // starting/stopping threads.
-  const int num_threads = std::min(
-      options_.num_threads, static_cast<int>(tracks_to_estimate_.size()));
-  const int interval_step =
-      std::min(options_.multithreaded_step_size,
-               static_cast<int>(tracks_to_estimate_.size()) / num_threads);
-
-  std::unique_ptr<ThreadPool> pool(new ThreadPool(num_threads));
-  for (int i = 0; i < tracks_to_estimate_.size(); i += interval_step) {
-    const int end_interval = std::min(
-        static_cast<int>(tracks_to_estimate_.size()), i + interval_step);
-    pool->Add(&TrackEstimator::EstimateTrackSet, this, i, end_interval);
+  // Triangulate the tracks in parallel.
+  ComputeObservationRays();
+  RunInParallel(&TrackEstimator::TriangulateTrackSet, tracks_to_estimate_);
+
+  // The rays are only needed for triangulation, so their memory is released.
+  std::vector<int>().swap(observation_offsets_);
+  std::vector<Eigen::Vector3d>().swap(observation_origins_);
+  std::vector<Eigen::Vector3d>().swap(observation_ray_directions_);
+
+  // Refine all triangulated tracks at once with the cameras held constant.
+  // Each point is refined independently so the result does not depend on the
+  // order in which the threads triangulated the tracks.
+  if (options_.bundle_adjustment && !triangulated_tracks_.empty()) {
+    PointRefinementOptions refinement_options;
+    refinement_options.loss_function_type =
+        options_.ba_options.loss_function_type;
+    refinement_options.robust_loss_width = options_.ba_options.robust_loss_width;
+    refinement_options.max_num_iterations =
+        options_.ba_options.max_num_iterations;
+    refinement_options.function_tolerance =
+        options_.ba_options.function_tolerance;
+    refinement_options.parameter_tolerance =
+        options_.ba_options.parameter_tolerance;
+    refinement_options.num_threads = options_.num_threads;
+    RefineTrackPoints(refinement_options, triangulated_tracks_, reconstruction_);
+
+    RunInParallel(&TrackEstimator::AcceptTrackSet, triangulated_tracks_);
   }
 
-  // Wait for all tracks to be estimated.
-  pool.reset(nullptr);
-
   LOG(INFO) << summary_.estimated_tracks.size() << " tracks were estimated of "
             << summary_.num_triangulation_attempts << " possible tracks. "
             << num_bad_angles_
@@ -188,62 +195,171 @@ TrackEstimator::Summary TrackEstimator::EstimateTracks(
   return summary_;
 }
 
-void TrackEstimator::EstimateTrackSet(const int start, const int end) {
+void TrackEstimator::ComputeObservationRays() {
+  // Gather the observations of the tracks in estimated views and remember which
+  // observations are in each view.
+  observation_offsets_.assign(1, 0);
+  observation_offsets_.reserve(tracks_to_estimate_.size() + 1);
+  std::vector<Eigen::Vector2d> features;
+  std::unordered_map<ViewId, std::vector<int> > observations_in_views;
+  for (const TrackId track_id : tracks_to_estimate_) {
+    for (const ViewId view_id : reconstruction_->Track(track_id)->ViewIds()) {
+      const View* view = reconstruction_->View(view_id);
+      if (view == nullptr || !view->IsEstimated()) {
+        continue;
+      }
+
+      // If the feature is not in the view then we have an ill-formed
+      // reconstruction.
+      const Feature* feature = CHECK_NOTNULL(view->GetFeature(track_id));
+      observations_in_views[view_id].emplace_back(features.size());
+      features.emplace_back(*feature);
+    }
+    observation_offsets_.emplace_back(features.size());
+  }
+
+  // Unproject the features of each view in a single batch. Each view writes
+  // only the rays of its own observations, so the views are processed in
+  // parallel.
+  observation_origins_.resize(features.size());
+  observation_ray_directions_.resize(features.size());
+  ThreadPool pool(std::max(
+      1,
+      std::min(options_.num_threads,
+               static_cast<int>(observations_in_views.size()))));
+  for (const auto& observations_in_view : observations_in_views) {
+    pool.Add([this, &features, &observations_in_view]() {
+      const Camera& camera =
+          reconstruction_->View(observations_in_view.first)->Camera();
+      const std::vector<int>& observations = observations_in_view.second;
+      std::vector<Eigen::Vector2d> view_features;
+      view_features.reserve(observations.size());
+      for (const int observation : observations) {
+        view_features.emplace_back(features[observation]);
+      }
+
+      std::vector<Eigen::Vector3d> rays;
+      camera.PixelsToUnitDepthRays(view_features, &rays);
+      const Eigen::Vector3d origin = camera.GetPosition();
+      for (int i = 0; i < observations.size(); i++) {
+        observation_origins_[observations[i]] = origin;
+        observation_ray_directions_[observations[i]] = rays[i].normalized();
+      }
+    });
+  }
+}
+
+void TrackEstimator::RunInParallel(
+    void (TrackEstimator::*track_set_function)(const std::vector<TrackId>&,
+                                               const int,
+                                               const int),
+    const std::vector<TrackId>& track_ids) {
+  // Instead of 1 threadpool worker per track, we let each worker process a
+  // fixed number of tracks at a time (e.g. 20 tracks). Since processing a track
+  // is so fast, this strategy helps speed up multithreaded estimation by
+  // reducing the overhead of starting/stopping threads.
+  const int num_threads =
+      std::min(options_.num_threads, static_cast<int>(track_ids.size()));
+  const int interval_step =
+      std::min(options_.multithreaded_step_size,
+               static_cast<int>(track_ids.size()) / num_threads);
+
+  std::unique_ptr<ThreadPool> pool(new ThreadPool(num_threads));
+  for (int i = 0; i < track_ids.size(); i += interval_step) {
+    const int end_interval =
+        std::min(static_cast<int>(track_ids.size()), i + interval_step);
+    pool->Add(track_set_function, this, std::cref(track_ids), i, end_interval);
+  }
+
+  // Wait for all tracks to be processed.
+  pool.reset(nullptr);
+}
+
+void TrackEstimator::TriangulateTrackSet(const std::vector<TrackId>& track_ids,
+                                         const int start,
+                                         const int end) {
+  // The rays of the tracks in the range are contiguous so that they can be
+  // triangulated in a single pass.
+  const int first_ray = observation_offsets_[start];
+  const int last_ray = observation_offsets_[end];
+  std::vector<int> ray_offsets;
+  ray_offsets.reserve(end - start + 1);
+  for (int i = start; i <= end; i++) {
+    ray_offsets.emplace_back(observation_offsets_[i] - first_ray);
+  }
+  const std::vector<Eigen::Vector3d> origins(
+      observation_origins_.begin() + first_ray,
+      observation_origins_.begin() + last_ray);
+  const std::vector<Eigen::Vector3d> ray_directions(
+      observation_ray_directions_.begin() + first_ray,
+      observation_ray_directions_.begin() + last_ray);
+
+  BatchTriangulationOptions triangulation_options;
+  triangulation_options.min_triangulation_angle_degrees =
+      options_.min_triangulation_angle_degrees;
+  std::vector<Eigen::Vector4d> points;
+  std::vector<TriangulationStatus> statuses;
+  TriangulateMidpointBatch(triangulation_options,
+                           ray_offsets,
+                           origins,
+                           ray_directions,
+                           &points,
+                           &statuses);
+
+  std::vector<TrackId> triangulated_tracks;
   std::unordered_set<TrackId> estimated_tracks;
   for (int i = start; i < end; i++) {
-    if (EstimateTrack(tracks_to_estimate_[i])) {
-      estimated_tracks.emplace(tracks_to_estimate_[i]);
+    CHECK(!reconstruction_->Track(track_ids[i])->IsEstimated())
+        << "Track " << track_ids[i] << " is already estimated.";
+    const TriangulationStatus status = statuses[i - start];
+    if (status == TriangulationStatus::INSUFFICIENT_ANGLE) {
+      ++num_bad_angles_;
+      continue;
+    } else if (status != TriangulationStatus::SUCCESS) {
+      ++num_failed_triangulations_;
+      continue;
+    }
+    *reconstruction_->MutableTrack(track_ids[i])->MutablePoint() =
+        points[i - start];
+
+    // Tracks are only accepted after refinement if it is enabled.
+    if (options_.bundle_adjustment) {
+      triangulated_tracks.emplace_back(track_ids[i]);
+    } else if (AcceptTrack(track_ids[i])) {
+      estimated_tracks.emplace(track_ids[i]);
     }
   }
 
   // Add the estimated tracks to the output summary.
   std::lock_guard<std::mutex> guard(summary_mutex_);
+  triangulated_tracks_.insert(triangulated_tracks_.end(),
+                              triangulated_tracks.begin(),
+                              triangulated_tracks.end());
   summary_.estimated_tracks.insert(estimated_tracks.begin(),
                                    estimated_tracks.end());
 }
 
-bool TrackEstimator::EstimateTrack(const TrackId track_id) {
-  static const int kMinNumObservationsForTriangulation = 2;
+void TrackEstimator::AcceptTrackSet(const std::vector<TrackId>& track_ids,
+                                    const int start,
+                                    const int end) {
+  std::unordered_set<TrackId> estimated_tracks;
+  for (int i = start; i < end; i++) {
+    if (AcceptTrack(track_ids[i])) {
+      estimated_tracks.emplace(track_ids[i]);
+    }
+  }
 
-  Track* track = reconstruction_->MutableTrack(track_id);
-  CHECK(!track->IsEstimated()) << "Track " << track_id
-                               << " is already estimated.";
+  // Add the estimated tracks to the output summary.
+  std::lock_guard<std::mutex> guard(summary_mutex_);
+  summary_.estimated_tracks.insert(estimated_tracks.begin(),
+                                   estimated_tracks.end());
+}
 
-  // Gather projection matrices and features.
+bool TrackEstimator::AcceptTrack(const TrackId track_id) {
   std::vector<ViewId> view_ids;
   std::vector<Eigen::Vector2d> features;
-  std::vector<Eigen::Vector3d> origins, ray_directions;
-  GetObservationsFromTrackViews(track_id,
-                                *reconstruction_,
-                                &view_ids,
-                                &features,
-                                &origins,
-                                &ray_directions);
-
-  // Check the angle between views.
-  if (view_ids.size() < kMinNumObservationsForTriangulation ||
-      !SufficientTriangulationAngle(ray_directions,
-                                    options_.min_triangulation_angle_degrees)) {
-    ++num_bad_angles_;
-    return false;
-  }
-
-  // Triangulate the track.
-  if (!TriangulateMidpoint(origins, ray_directions, track->MutablePoint())) {
-    ++num_failed_triangulations_;
-    return false;
-  }
-
-  // Bundle adjust the track.
-  if (options_.bundle_adjustment) {
-    track->SetEstimated(true);
-    const BundleAdjustmentSummary summary =
-        BundleAdjustTrack(options_.ba_options, track_id, reconstruction_);
-    track->SetEstimated(false);
-    if (!summary.success) {
-      return false;
-    }
-  }
+  GetObservationsFromTrackViews(
+      track_id, *reconstruction_, &view_ids, &features);
 
   // Ensure the reprojection errors are acceptable.
   const double sq_max_reprojection_error_pixels =
@@ -259,7 +375,7 @@ bool TrackEstimator::EstimateTrack(const TrackId track_id) {
     return false;
   }
 
-  track->SetEstimated(true);
+  reconstruction_->MutableTrack(track_id)->SetEstimated(true);
   return true;
 }
 
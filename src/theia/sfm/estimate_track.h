@@ -35,6 +35,7 @@
 #ifndef THEIA_SFM_ESTIMATE_TRACK_H_
 #define THEIA_SFM_ESTIMATE_TRACK_H_
 
+#include <Eigen/Core>
 #include <atomic>
 #include <mutex>
 #include <unordered_set>
@@ -66,8 +67,10 @@ class TrackEstimator {
     // of views has this an angle this large.
     double min_triangulation_angle_degrees = 3.0;
 
-    // Perform bundle adjustment on the track as soon as a position is
-    // estimated.
+    // Refine the points of the tracks once their positions are estimated. All
+    // triangulated tracks are refined together with RefineTrackPoints using
+    // num_threads threads. The loss function, tolerances and maximum number of
+    // iterations of ba_options are used for the refinement.
     bool bundle_adjustment = true;
     BundleAdjustmentOptions ba_options;
 
@@ -99,13 +102,47 @@ class TrackEstimator {
   Summary EstimateTracks(const std::unordered_set<TrackId>& track_ids);
 
  private:
-  void EstimateTrackSet(const int start, const int stop);
-  bool EstimateTrack(const TrackId track_id);
+  // Calls the track set function on chunks of the tracks in parallel.
+  void RunInParallel(
+      void (TrackEstimator::*track_set_function)(const std::vector<TrackId>&,
+                                                 const int,
+                                                 const int),
+      const std::vector<TrackId>& track_ids);
+
+  // Computes the rays of all observations of the tracks to estimate in
+  // estimated views. The features of each view are unprojected in a single
+  // batch.
+  void ComputeObservationRays();
+
+  // Triangulates the tracks in the range [start, end) with a single batch
+  // triangulation. Without refinement the tracks are accepted right away. The
+  // track ids must be tracks_to_estimate_ since the rays are read from
+  // observation_origins_ and observation_ray_directions_.
+  void TriangulateTrackSet(const std::vector<TrackId>& track_ids,
+                           const int start,
+                           const int end);
+
+  // Marks the tracks in the range [start, end) as estimated if their
+  // reprojection errors are acceptable.
+  void AcceptTrackSet(const std::vector<TrackId>& track_ids,
+                      const int start,
+                      const int end);
+  bool AcceptTrack(const TrackId track_id);
 
   const Options options_;
   Reconstruction* reconstruction_;
   std::vector<TrackId> tracks_to_estimate_;
 
+  // The rays of the tracks to estimate, which only exist while the tracks are
+  // triangulated. The rays of tracks_to_estimate_[i] are in the range
+  // [observation_offsets_[i], observation_offsets_[i + 1]).
+  std::vector<int> observation_offsets_;
+  std::vector<Eigen::Vector3d> observation_origins_;
+  std::vector<Eigen::Vector3d> observation_ray_directions_;
+
+  // Tracks that were triangulated and still need to be refined.
+  std::vector<TrackId> triangulated_tracks_;
+
   // A mutex lock for setting the summary
   TrackEstimator::Summary summary_;
   std::mutex summary_mutex_;
@@ -128,11 +128,15 @@ int ComputeVisibilityScoreOfInliers(
   return pyramid1.ComputeScore() + pyramid2.ComputeScore();
 }
 
+// Estimates the relative pose between calibrated views. If
+// count_homography_inliers is true then the number of homography inliers is
+// also measured from the samples of the relative pose RANSAC.
 bool EstimateTwoViewInfoCalibrated(
     const EstimateTwoViewInfoOptions& options,
     const CameraIntrinsicsPrior& intrinsics1,
     const CameraIntrinsicsPrior& intrinsics2,
     const std::vector<FeatureCorrespondence>& correspondences,
+    const bool count_homography_inliers,
     TwoViewInfo* twoview_info,
     std::vector<int>* inlier_indices) {
   // Normalize features w.r.t focal length.
@@ -164,11 +168,29 @@ bool EstimateTwoViewInfoCalibrated(
 
   RelativePose relative_pose;
   RansacSummary summary;
-  if (!EstimateRelativePose(ransac_options,
-                            options.ransac_type,
-                            normalized_correspondences,
-                            &relative_pose,
-                            &summary)) {
+  if (count_homography_inliers) {
+    // The homography inliers are counted with the pixel threshold of the
+    // separate homography RANSAC. The homography transfer error is measured in
+    // the normalized coordinates of the second image, so the threshold is
+    // scaled by the focal length of the second view.
+    const double homography_error_thresh =
+        max_sampson_error_pixels1 * max_sampson_error_pixels2 /
+        (intrinsics2.focal_length.value[0] * intrinsics2.focal_length.value[0]);
+    if (!EstimateRelativePoseAndHomographyInliers(
+            ransac_options,
+            options.ransac_type,
+            normalized_correspondences,
+            homography_error_thresh,
+            &relative_pose,
+            &twoview_info->num_homography_inliers,
+            &summary)) {
+      return false;
+    }
+  } else if (!EstimateRelativePose(ransac_options,
+                                   options.ransac_type,
+                                   normalized_correspondences,
+                                   &relative_pose,
+                                   &summary)) {
     return false;
   }
 
@@ -265,6 +287,7 @@ bool EstimateTwoViewInfo(
                                          intrinsics1,
                                          intrinsics2,
                                          correspondences,
+                                         false,
                                          twoview_info,
                                          inlier_indices);
   }
@@ -291,4 +314,26 @@ bool EstimateTwoViewInfo(
                                          inlier_indices);
 }
 
+bool EstimateTwoViewInfoAndHomographyInliers(
+    const EstimateTwoViewInfoOptions& options,
+    const CameraIntrinsicsPrior& intrinsics1,
+    const CameraIntrinsicsPrior& intrinsics2,
+    const std::vector<FeatureCorrespondence>& correspondences,
+    TwoViewInfo* twoview_info,
+    std::vector<int>* inlier_indices) {
+  CHECK_NOTNULL(twoview_info);
+  CHECK_NOTNULL(inlier_indices)->clear();
+  CHECK(intrinsics1.focal_length.is_set && intrinsics2.focal_length.is_set)
+      << "Homography inliers can only be counted jointly with the relative "
+         "pose for calibrated views.";
+
+  return EstimateTwoViewInfoCalibrated(options,
+                                       intrinsics1,
+                                       intrinsics2,
+                                       correspondences,
+                                       true,
+                                       twoview_info,
+                                       inlier_indices);
+}
+
 }  // namespace theia
@@ -95,6 +95,21 @@ bool EstimateTwoViewInfo(
     TwoViewInfo* twoview_info,
     std::vector<int>* inlier_indices);
 
+// Estimates the two view info between two calibrated views as above and also
+// sets twoview_info->num_homography_inliers. Rather than running a separate
+// homography RANSAC, a homography is fit to each minimal sample drawn for the
+// relative pose and scored in the same RANSAC iteration (see
+// EstimateRelativePoseAndHomographyInliers). The homography inliers are
+// counted with the same pixel threshold as a separate homography RANSAC would
+// use. Both views must have a known focal length.
+bool EstimateTwoViewInfoAndHomographyInliers(
+    const EstimateTwoViewInfoOptions& options,
+    const CameraIntrinsicsPrior& intrinsics1,
+    const CameraIntrinsicsPrior& intrinsics2,
+    const std::vector<FeatureCorrespondence>& correspondences,
+    TwoViewInfo* twoview_info,
+    std::vector<int>* inlier_indices);
+
 }  // namespace theia
 
 #endif  // THEIA_SFM_ESTIMATE_TWOVIEW_INFO_H_
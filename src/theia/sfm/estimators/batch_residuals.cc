@@ -0,0 +1,141 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/estimators/batch_residuals.h"
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <vector>
+
+#include "theia/matching/feature_correspondence.h"
+#include "theia/sfm/estimators/feature_correspondence_2d_3d.h"
+#include "theia/sfm/types.h"
+
+namespace theia {
+
+using Eigen::ArrayXd;
+using Eigen::Map;
+
+FeatureCorrespondenceArrays::FeatureCorrespondenceArrays(
+    const std::vector<FeatureCorrespondence>& correspondences)
+    : x1(correspondences.size()),
+      y1(correspondences.size()),
+      x2(correspondences.size()),
+      y2(correspondences.size()) {
+  for (int i = 0; i < correspondences.size(); i++) {
+    x1[i] = correspondences[i].feature1.x();
+    y1[i] = correspondences[i].feature1.y();
+    x2[i] = correspondences[i].feature2.x();
+    y2[i] = correspondences[i].feature2.y();
+  }
+}
+
+FeatureCorrespondence2D3DArrays::FeatureCorrespondence2D3DArrays(
+    const std::vector<FeatureCorrespondence2D3D>& correspondences)
+    : u(correspondences.size()),
+      v(correspondences.size()),
+      x(correspondences.size()),
+      y(correspondences.size()),
+      z(correspondences.size()) {
+  for (int i = 0; i < correspondences.size(); i++) {
+    u[i] = correspondences[i].feature.x();
+    v[i] = correspondences[i].feature.y();
+    x[i] = correspondences[i].world_point.x();
+    y[i] = correspondences[i].world_point.y();
+    z[i] = correspondences[i].world_point.z();
+  }
+}
+
+void SquaredSampsonDistances(const Eigen::Matrix3d& F,
+                             const FeatureCorrespondenceArrays& correspondences,
+                             std::vector<double>* residuals) {
+  CHECK_NOTNULL(residuals)->resize(correspondences.size());
+  const ArrayXd& x1 = correspondences.x1;
+  const ArrayXd& y1 = correspondences.y1;
+  const ArrayXd& x2 = correspondences.x2;
+  const ArrayXd& y2 = correspondences.y2;
+
+  // The epipolar line of the first feature, F * x.
+  const ArrayXd epiline_x = F(0, 0) * x1 + F(0, 1) * y1 + F(0, 2);
+  const ArrayXd epiline_y = F(1, 0) * x1 + F(1, 1) * y1 + F(1, 2);
+  const ArrayXd epiline_z = F(2, 0) * x1 + F(2, 1) * y1 + F(2, 2);
+  const ArrayXd numerator_sqrt = x2 * epiline_x + y2 * epiline_y + epiline_z;
+
+  // The first two entries of the epipolar line of the second feature, y^t * F.
+  const ArrayXd epiline2_x = x2 * F(0, 0) + y2 * F(1, 0) + F(2, 0);
+  const ArrayXd epiline2_y = x2 * F(0, 1) + y2 * F(1, 1) + F(2, 1);
+
+  Map<ArrayXd>(residuals->data(), residuals->size()) =
+      numerator_sqrt.square() /
+      (epiline2_x.square() + epiline2_y.square() + epiline_x.square() +
+       epiline_y.square());
+}
+
+void SquaredHomographyTransferErrors(
+    const Eigen::Matrix3d& H,
+    const FeatureCorrespondenceArrays& correspondences,
+    std::vector<double>* residuals) {
+  CHECK_NOTNULL(residuals)->resize(correspondences.size());
+  const ArrayXd& x1 = correspondences.x1;
+  const ArrayXd& y1 = correspondences.y1;
+
+  const ArrayXd inv_z = (H(2, 0) * x1 + H(2, 1) * y1 + H(2, 2)).inverse();
+  const ArrayXd dx =
+      correspondences.x2 - (H(0, 0) * x1 + H(0, 1) * y1 + H(0, 2)) * inv_z;
+  const ArrayXd dy =
+      correspondences.y2 - (H(1, 0) * x1 + H(1, 1) * y1 + H(1, 2)) * inv_z;
+  Map<ArrayXd>(residuals->data(), residuals->size()) = dx.square() + dy.square();
+}
+
+void SquaredReprojectionErrors(
+    const Matrix3x4d& P,
+    const FeatureCorrespondence2D3DArrays& correspondences,
+    std::vector<double>* residuals) {
+  CHECK_NOTNULL(residuals)->resize(correspondences.size());
+  const ArrayXd& x = correspondences.x;
+  const ArrayXd& y = correspondences.y;
+  const ArrayXd& z = correspondences.z;
+
+  const ArrayXd inv_depth =
+      (P(2, 0) * x + P(2, 1) * y + P(2, 2) * z + P(2, 3)).inverse();
+  const ArrayXd du =
+      correspondences.u -
+      (P(0, 0) * x + P(0, 1) * y + P(0, 2) * z + P(0, 3)) * inv_depth;
+  const ArrayXd dv =
+      correspondences.v -
+      (P(1, 0) * x + P(1, 1) * y + P(1, 2) * z + P(1, 3)) * inv_depth;
+  Map<ArrayXd>(residuals->data(), residuals->size()) = du.square() + dv.square();
+}
+
+}  // namespace theia
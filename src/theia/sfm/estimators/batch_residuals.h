@@ -0,0 +1,103 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_ESTIMATORS_BATCH_RESIDUALS_H_
+#define THEIA_SFM_ESTIMATORS_BATCH_RESIDUALS_H_
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "theia/sfm/types.h"
+
+namespace theia {
+
+struct FeatureCorrespondence;
+struct FeatureCorrespondence2D3D;
+
+// The residual functions in this file compute the error of many
+// correspondences at once for use as batch residual kernels in RANSAC
+// estimators (see Estimator::BatchResiduals). The correspondences are stored as
+// a structure-of-arrays so that each coordinate is contiguous in memory, which
+// allows Eigen to evaluate the residuals with SIMD instructions.
+
+// A structure-of-arrays layout of 2D-2D feature correspondences.
+struct FeatureCorrespondenceArrays {
+  FeatureCorrespondenceArrays() {}
+  explicit FeatureCorrespondenceArrays(
+      const std::vector<FeatureCorrespondence>& correspondences);
+
+  int size() const { return x1.size(); }
+
+  // The coordinates of the feature in the first and second images.
+  Eigen::ArrayXd x1, y1, x2, y2;
+};
+
+// A structure-of-arrays layout of 2D-3D feature correspondences.
+struct FeatureCorrespondence2D3DArrays {
+  FeatureCorrespondence2D3DArrays() {}
+  explicit FeatureCorrespondence2D3DArrays(
+      const std::vector<FeatureCorrespondence2D3D>& correspondences);
+
+  int size() const { return u.size(); }
+
+  // The 2D feature coordinates.
+  Eigen::ArrayXd u, v;
+  // The 3D world point coordinates.
+  Eigen::ArrayXd x, y, z;
+};
+
+// Computes the squared Sampson distance of each correspondence with respect to
+// the essential or fundamental matrix F. This is identical to calling
+// SquaredSampsonDistance for each correspondence.
+void SquaredSampsonDistances(const Eigen::Matrix3d& F,
+                             const FeatureCorrespondenceArrays& correspondences,
+                             std::vector<double>* residuals);
+
+// Computes the squared distance between the second feature of each
+// correspondence and the first feature transferred by the homography H.
+void SquaredHomographyTransferErrors(
+    const Eigen::Matrix3d& H,
+    const FeatureCorrespondenceArrays& correspondences,
+    std::vector<double>* residuals);
+
+// Computes the squared distance between each feature and the reprojection of
+// its world point by the projection matrix P.
+void SquaredReprojectionErrors(
+    const Matrix3x4d& P,
+    const FeatureCorrespondence2D3DArrays& correspondences,
+    std::vector<double>* residuals);
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_ESTIMATORS_BATCH_RESIDUALS_H_
@@ -0,0 +1,130 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "theia/matching/feature_correspondence.h"
+#include "theia/sfm/estimators/batch_residuals.h"
+#include "theia/sfm/estimators/feature_correspondence_2d_3d.h"
+#include "theia/sfm/pose/util.h"
+#include "theia/sfm/types.h"
+
+namespace theia {
+namespace {
+
+using Eigen::Matrix3d;
+using Eigen::Vector2d;
+using Eigen::Vector3d;
+
+static const int kNumCorrespondences = 101;
+static const double kTolerance = 1e-10;
+
+std::vector<FeatureCorrespondence> RandomCorrespondences() {
+  std::vector<FeatureCorrespondence> correspondences(kNumCorrespondences);
+  for (FeatureCorrespondence& correspondence : correspondences) {
+    correspondence.feature1 = Vector2d::Random();
+    correspondence.feature2 = Vector2d::Random();
+  }
+  return correspondences;
+}
+
+TEST(BatchResiduals, SquaredSampsonDistances) {
+  const std::vector<FeatureCorrespondence> correspondences =
+      RandomCorrespondences();
+  const Matrix3d fundamental_matrix = Matrix3d::Random();
+
+  std::vector<double> residuals;
+  SquaredSampsonDistances(fundamental_matrix,
+                          FeatureCorrespondenceArrays(correspondences),
+                          &residuals);
+  ASSERT_EQ(residuals.size(), correspondences.size());
+  for (int i = 0; i < correspondences.size(); i++) {
+    const double expected_residual =
+        SquaredSampsonDistance(fundamental_matrix,
+                               correspondences[i].feature1,
+                               correspondences[i].feature2);
+    EXPECT_NEAR(residuals[i], expected_residual, kTolerance);
+  }
+}
+
+TEST(BatchResiduals, SquaredHomographyTransferErrors) {
+  const std::vector<FeatureCorrespondence> correspondences =
+      RandomCorrespondences();
+  const Matrix3d homography = Matrix3d::Identity() + 0.1 * Matrix3d::Random();
+
+  std::vector<double> residuals;
+  SquaredHomographyTransferErrors(homography,
+                                  FeatureCorrespondenceArrays(correspondences),
+                                  &residuals);
+  ASSERT_EQ(residuals.size(), correspondences.size());
+  for (int i = 0; i < correspondences.size(); i++) {
+    const Vector3d transferred_point =
+        homography * correspondences[i].feature1.homogeneous();
+    const double expected_residual =
+        (correspondences[i].feature2 - transferred_point.hnormalized())
+            .squaredNorm();
+    EXPECT_NEAR(residuals[i], expected_residual, kTolerance);
+  }
+}
+
+TEST(BatchResiduals, SquaredReprojectionErrors) {
+  std::vector<FeatureCorrespondence2D3D> correspondences(kNumCorrespondences);
+  for (FeatureCorrespondence2D3D& correspondence : correspondences) {
+    correspondence.feature = Vector2d::Random();
+    correspondence.world_point = Vector3d::Random() + Vector3d(0, 0, 5);
+  }
+  Matrix3x4d projection_matrix;
+  projection_matrix << Matrix3d::Identity() + 0.1 * Matrix3d::Random(),
+      Vector3d::Random();
+
+  std::vector<double> residuals;
+  SquaredReprojectionErrors(projection_matrix,
+                            FeatureCorrespondence2D3DArrays(correspondences),
+                            &residuals);
+  ASSERT_EQ(residuals.size(), correspondences.size());
+  for (int i = 0; i < correspondences.size(); i++) {
+    const Vector2d reprojected_feature =
+        (projection_matrix * correspondences[i].world_point.homogeneous())
+            .eval()
+            .hnormalized();
+    const double expected_residual =
+        (correspondences[i].feature - reprojected_feature).squaredNorm();
+    EXPECT_NEAR(residuals[i], expected_residual, kTolerance);
+  }
+}
+
+}  // namespace
+}  // namespace theia
@@ -40,6 +40,7 @@
 #include <vector>
 
 #include "theia/sfm/create_and_initialize_ransac_variant.h"
+#include "theia/sfm/estimators/batch_residuals.h"
 #include "theia/sfm/estimators/feature_correspondence_2d_3d.h"
 #include "theia/sfm/pose/position_from_two_rays.h"
 #include "theia/solvers/estimator.h"
@@ -112,8 +113,27 @@ class AbsolutePoseWithKnownOrientationEstimator
     return (reprojected_feature - correspondence.feature).squaredNorm();
   }
 
+  // Copies the correspondences into a structure-of-arrays layout so that the
+  // squared reprojection errors may be computed with a vectorized batch kernel.
+  bool PrepareBatchResiduals(
+      const std::vector<FeatureCorrespondence2D3D>& correspondences) const {
+    batch_correspondences_ = FeatureCorrespondence2D3DArrays(correspondences);
+    return true;
+  }
+
+  void BatchResiduals(const Eigen::Vector3d& absolute_position,
+                      std::vector<double>* residuals) const {
+    Matrix3x4d projection_matrix;
+    projection_matrix << Eigen::Matrix3d::Identity(), -absolute_position;
+    SquaredReprojectionErrors(
+        projection_matrix, batch_correspondences_, residuals);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(AbsolutePoseWithKnownOrientationEstimator);
+
+  // The correspondences prepared for the batch residual kernel.
+  mutable FeatureCorrespondence2D3DArrays batch_correspondences_;
 };
 
 }  // namespace
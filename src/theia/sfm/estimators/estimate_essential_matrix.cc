@@ -38,6 +38,7 @@
 #include <vector>
 
 #include "theia/alignment/alignment.h"
+#include "theia/sfm/estimators/batch_residuals.h"
 #include "theia/solvers/estimator.h"
 #include "theia/matching/feature_correspondence.h"
 #include "theia/sfm/pose/five_point_relative_pose.h"
@@ -83,8 +84,24 @@ class EssentialMatrixEstimator
                                   correspondence.feature2);
   }
 
+  // Copies the correspondences into a structure-of-arrays layout so that the
+  // squared Sampson errors may be computed with a vectorized batch kernel.
+  bool PrepareBatchResiduals(
+      const std::vector<FeatureCorrespondence>& correspondences) const {
+    batch_correspondences_ = FeatureCorrespondenceArrays(correspondences);
+    return true;
+  }
+
+  void BatchResiduals(const Eigen::Matrix3d& essential_matrix,
+                      std::vector<double>* residuals) const {
+    SquaredSampsonDistances(essential_matrix, batch_correspondences_, residuals);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(EssentialMatrixEstimator);
+
+  // The correspondences prepared for the batch residual kernel.
+  mutable FeatureCorrespondenceArrays batch_correspondences_;
 };
 
 }  // namespace
@@ -38,6 +38,7 @@
 #include <vector>
 
 #include "theia/matching/feature_correspondence.h"
+#include "theia/sfm/estimators/batch_residuals.h"
 #include "theia/sfm/pose/eight_point_fundamental_matrix.h"
 #include "theia/sfm/pose/util.h"
 #include "theia/solvers/estimator.h"
@@ -84,8 +85,24 @@ class FundamentalMatrixEstimator
                                   correspondence.feature2);
   }
 
+  // Copies the correspondences into a structure-of-arrays layout so that the
+  // squared Sampson errors may be computed with a vectorized batch kernel.
+  bool PrepareBatchResiduals(
+      const std::vector<FeatureCorrespondence>& correspondences) const {
+    batch_correspondences_ = FeatureCorrespondenceArrays(correspondences);
+    return true;
+  }
+
+  void BatchResiduals(const Eigen::Matrix3d& fundamental_matrix,
+                      std::vector<double>* residuals) const {
+    SquaredSampsonDistances(fundamental_matrix, batch_correspondences_, residuals);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(FundamentalMatrixEstimator);
+
+  // The correspondences prepared for the batch residual kernel.
+  mutable FeatureCorrespondenceArrays batch_correspondences_;
 };
 
 }  // namespace
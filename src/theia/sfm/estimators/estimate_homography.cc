@@ -42,6 +42,7 @@
 
 #include "theia/matching/feature_correspondence.h"
 #include "theia/sfm/create_and_initialize_ransac_variant.h"
+#include "theia/sfm/estimators/batch_residuals.h"
 #include "theia/sfm/pose/four_point_homography.h"
 #include "theia/sfm/pose/util.h"
 #include "theia/solvers/estimator.h"
@@ -95,8 +96,24 @@ class HomographyEstimator
         .squaredNorm();
   }
 
+  // Copies the correspondences into a structure-of-arrays layout so that the
+  // squared transfer errors may be computed with a vectorized batch kernel.
+  bool PrepareBatchResiduals(
+      const std::vector<FeatureCorrespondence>& correspondences) const {
+    batch_correspondences_ = FeatureCorrespondenceArrays(correspondences);
+    return true;
+  }
+
+  void BatchResiduals(const Eigen::Matrix3d& homography,
+                      std::vector<double>* residuals) const {
+    SquaredHomographyTransferErrors(homography, batch_correspondences_, residuals);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(HomographyEstimator);
+
+  // The correspondences prepared for the batch residual kernel.
+  mutable FeatureCorrespondenceArrays batch_correspondences_;
 };
 
 }  // namespace
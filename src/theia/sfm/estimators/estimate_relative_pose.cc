@@ -36,14 +36,18 @@
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <glog/logging.h>
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <vector>
 
 #include "theia/matching/feature_correspondence.h"
 #include "theia/sfm/create_and_initialize_ransac_variant.h"
+#include "theia/sfm/estimators/batch_residuals.h"
 #include "theia/sfm/pose/essential_matrix_utils.h"
 #include "theia/sfm/pose/five_point_relative_pose.h"
+#include "theia/sfm/pose/four_point_homography.h"
 #include "theia/sfm/pose/util.h"
 #include "theia/sfm/triangulation/triangulation.h"
 #include "theia/solvers/estimator.h"
@@ -54,6 +58,7 @@ namespace theia {
 namespace {
 
 using Eigen::Matrix3d;
+using Eigen::Vector2d;
 using Eigen::Vector3d;
 
 // An estimator for computing the relative pose from 5 feature
@@ -124,6 +129,63 @@ class RelativePoseEstimator
   DISALLOW_COPY_AND_ASSIGN(RelativePoseEstimator);
 };
 
+// A relative pose estimator that additionally fits a homography to the first 4
+// correspondences of each minimal sample and scores it against all of the
+// correspondences. This allows the homography support to be measured with the
+// samples and stopping criterion of the relative pose RANSAC rather than with
+// a second, independent RANSAC.
+class RelativePoseAndHomographyEstimator : public RelativePoseEstimator {
+ public:
+  RelativePoseAndHomographyEstimator(
+      const std::vector<FeatureCorrespondence>& correspondences,
+      const double homography_error_thresh)
+      : correspondences_(correspondences),
+        homography_error_thresh_(homography_error_thresh),
+        max_num_homography_inliers_(0) {}
+
+  bool EstimateModel(const std::vector<FeatureCorrespondence>& correspondences,
+                     std::vector<RelativePose>* relative_poses) const {
+    ScoreHomography(correspondences);
+    return RelativePoseEstimator::EstimateModel(correspondences,
+                                                relative_poses);
+  }
+
+  int MaxNumHomographyInliers() const { return max_num_homography_inliers_; }
+
+ private:
+  void ScoreHomography(
+      const std::vector<FeatureCorrespondence>& correspondences) const {
+    std::vector<Vector2d> image1_points(4), image2_points(4);
+    for (int i = 0; i < 4; i++) {
+      image1_points[i] = correspondences[i].feature1;
+      image2_points[i] = correspondences[i].feature2;
+    }
+
+    Matrix3d homography;
+    if (!FourPointHomography(image1_points, image2_points, &homography)) {
+      return;
+    }
+
+    SquaredHomographyTransferErrors(
+        homography, correspondences_, &homography_residuals_);
+    int num_homography_inliers = 0;
+    for (const double residual : homography_residuals_) {
+      if (residual < homography_error_thresh_) {
+        ++num_homography_inliers;
+      }
+    }
+    max_num_homography_inliers_ =
+        std::max(max_num_homography_inliers_, num_homography_inliers);
+  }
+
+  const FeatureCorrespondenceArrays correspondences_;
+  const double homography_error_thresh_;
+
+  // The homography residuals are reused across RANSAC iterations.
+  mutable std::vector<double> homography_residuals_;
+  mutable int max_num_homography_inliers_;
+};
+
 }  // namespace
 
 bool EstimateRelativePose(
@@ -143,4 +205,27 @@ bool EstimateRelativePose(
                           ransac_summary);
 }
 
+bool EstimateRelativePoseAndHomographyInliers(
+    const RansacParameters& ransac_params,
+    const RansacType& ransac_type,
+    const std::vector<FeatureCorrespondence>& normalized_correspondences,
+    const double homography_error_thresh,
+    RelativePose* relative_pose,
+    int* num_homography_inliers,
+    RansacSummary* ransac_summary) {
+  CHECK_NOTNULL(num_homography_inliers);
+  RelativePoseAndHomographyEstimator estimator(normalized_correspondences,
+                                               homography_error_thresh);
+  std::unique_ptr<SampleConsensusEstimator<RelativePoseAndHomographyEstimator> >
+      ransac = CreateAndInitializeRansacVariant(ransac_type,
+                                                ransac_params,
+                                                estimator);
+  // Estimate the relative pose.
+  const bool success = ransac->Estimate(normalized_correspondences,
+                                        relative_pose,
+                                        ransac_summary);
+  *num_homography_inliers = estimator.MaxNumHomographyInliers();
+  return success;
+}
+
 }  // namespace theia
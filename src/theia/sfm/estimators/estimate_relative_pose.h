@@ -64,6 +64,22 @@ bool EstimateRelativePose(
     RelativePose* relative_pose,
     RansacSummary* ransac_summary);
 
+// Estimates the relative pose as above and also measures how well the
+// correspondences are explained by a homography, without running a separate
+// homography RANSAC. In each RANSAC iteration a homography is fit to four
+// correspondences of the minimal sample drawn for the relative pose and is
+// scored against all correspondences. num_homography_inliers is set to the
+// largest number of correspondences with a squared homography transfer error
+// below homography_error_thresh found by any of these homographies.
+bool EstimateRelativePoseAndHomographyInliers(
+    const RansacParameters& ransac_params,
+    const RansacType& ransac_type,
+    const std::vector<FeatureCorrespondence>& normalized_correspondences,
+    const double homography_error_thresh,
+    RelativePose* relative_pose,
+    int* num_homography_inliers,
+    RansacSummary* ransac_summary);
+
 }  // namespace theia
 
 #endif  // THEIA_SFM_ESTIMATORS_ESTIMATE_RELATIVE_POSE_H_
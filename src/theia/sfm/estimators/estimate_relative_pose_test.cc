@@ -248,4 +248,52 @@ TEST(EstimateRelativePose, OutliersWithNoise) {
   }
 }
 
+TEST(EstimateRelativePose, HomographyInliersOfPlanarScene) {
+  RansacParameters options;
+  options.rng = std::make_shared<RandomNumberGenerator>(rng);
+  options.use_mle = true;
+  options.error_thresh = kErrorThreshold;
+  options.failure_probability = 0.0001;
+
+  const Matrix3d rotation =
+      AngleAxisd(DegToRad(12.0), Vector3d::UnitY()).toRotationMatrix();
+  const Vector3d position(-0.7, 0, 0);
+  const Vector3d translation = (-rotation * position).normalized();
+
+  // All points lie on a plane so that a homography explains all of the
+  // correspondences, while the outliers do not fit the homography.
+  std::vector<FeatureCorrespondence> correspondences;
+  for (int i = -2; i <= 2; i++) {
+    for (int j = -2; j <= 2; j++) {
+      const Vector3d point(i, j, 5.0);
+      FeatureCorrespondence correspondence;
+      correspondence.feature1 = point.hnormalized();
+      correspondence.feature2 = (rotation * point + translation).hnormalized();
+      correspondences.emplace_back(correspondence);
+    }
+  }
+  const int num_planar_points = correspondences.size();
+  for (int i = 0; i < 5; i++) {
+    FeatureCorrespondence correspondence;
+    correspondence.feature1 =
+        Vector2d(rng.RandDouble(-1.0, 1.0), rng.RandDouble(-1.0, 1.0));
+    correspondence.feature2 =
+        Vector2d(rng.RandDouble(-1.0, 1.0), rng.RandDouble(-1.0, 1.0));
+    correspondences.emplace_back(correspondence);
+  }
+
+  RelativePose relative_pose;
+  int num_homography_inliers = 0;
+  RansacSummary ransac_summary;
+  EXPECT_TRUE(EstimateRelativePoseAndHomographyInliers(options,
+                                                       RansacType::RANSAC,
+                                                       correspondences,
+                                                       kErrorThreshold,
+                                                       &relative_pose,
+                                                       &num_homography_inliers,
+                                                       &ransac_summary));
+  EXPECT_GE(ransac_summary.inliers.size(), num_planar_points);
+  EXPECT_EQ(num_homography_inliers, num_planar_points);
+}
+
 }  // namespace theia
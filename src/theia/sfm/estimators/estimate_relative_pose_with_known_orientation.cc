@@ -7,6 +7,7 @@
 
 #include "theia/matching/feature_correspondence.h"
 #include "theia/sfm/create_and_initialize_ransac_variant.h"
+#include "theia/sfm/estimators/batch_residuals.h"
 #include "theia/sfm/estimators/feature_correspondence_2d_3d.h"
 #include "theia/sfm/pose/essential_matrix_utils.h"
 #include "theia/sfm/pose/util.h"
@@ -57,8 +58,26 @@ class RelativePoseWithKnownOrientationEstimator
                                   correspondence.feature2);
   }
 
+  // Copies the correspondences into a structure-of-arrays layout so that the
+  // squared Sampson errors may be computed with a vectorized batch kernel.
+  bool PrepareBatchResiduals(
+      const std::vector<FeatureCorrespondence>& correspondences) const {
+    batch_correspondences_ = FeatureCorrespondenceArrays(correspondences);
+    return true;
+  }
+
+  void BatchResiduals(const Eigen::Vector3d& relative_position,
+                      std::vector<double>* residuals) const {
+    SquaredSampsonDistances(CrossProductMatrix(-relative_position),
+                            batch_correspondences_,
+                            residuals);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(RelativePoseWithKnownOrientationEstimator);
+
+  // The correspondences prepared for the batch residual kernel.
+  mutable FeatureCorrespondenceArrays batch_correspondences_;
 };
 
 }  // namespace
@@ -42,6 +42,7 @@
 
 #include "theia/sfm/camera/projection_matrix_utils.h"
 #include "theia/sfm/create_and_initialize_ransac_variant.h"
+#include "theia/sfm/estimators/batch_residuals.h"
 #include "theia/sfm/estimators/feature_correspondence_2d_3d.h"
 #include "theia/sfm/pose/four_point_focal_length.h"
 #include "theia/sfm/types.h"
@@ -95,8 +96,24 @@ class UncalibratedAbsolutePoseEstimator
     return (reprojected_feature - correspondence.feature).squaredNorm();
   }
 
+  // Copies the correspondences into a structure-of-arrays layout so that the
+  // squared reprojection errors may be computed with a vectorized batch kernel.
+  bool PrepareBatchResiduals(
+      const std::vector<FeatureCorrespondence2D3D>& correspondences) const {
+    batch_correspondences_ = FeatureCorrespondence2D3DArrays(correspondences);
+    return true;
+  }
+
+  void BatchResiduals(const Matrix3x4d& absolute_pose,
+                      std::vector<double>* residuals) const {
+    SquaredReprojectionErrors(absolute_pose, batch_correspondences_, residuals);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(UncalibratedAbsolutePoseEstimator);
+
+  // The correspondences prepared for the batch residual kernel.
+  mutable FeatureCorrespondence2D3DArrays batch_correspondences_;
 };
 
 }  // namespace
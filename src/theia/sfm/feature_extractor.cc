@@ -36,12 +36,15 @@
 
 #include <Eigen/Core>
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "theia/image/descriptor/create_descriptor_extractor.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
 #include "theia/io/write_keypoints_and_descriptors.h"
 #include "theia/image/image.h"
 #include "theia/image/keypoint_detector/keypoint.h"
@@ -60,24 +63,37 @@ bool FeatureExtractor::Extract(
   CHECK_NOTNULL(keypoints)->resize(filenames.size());
   CHECK_NOTNULL(descriptors)->resize(filenames.size());
 
+  // Descriptors are only computed for the selected keypoints when possible.
+  KeypointSelectionOptions keypoint_selection;
+  keypoint_selection.selection_type = options_.keypoint_selection_type;
+  keypoint_selection.max_num_keypoints = options_.max_num_features;
+
+  descriptor_extractor_pool_.reset(
+      new DescriptorExtractorPool(options_.descriptor_extractor_type,
+                                  options_.feature_density,
+                                  keypoint_selection));
+
   // The thread pool will wait to finish all jobs when it goes out of scope.
   const int num_threads =
       std::min(options_.num_threads, static_cast<int>(filenames.size()));
-  ThreadPool feature_extractor_pool(num_threads);
-  for (int i = 0; i < filenames.size(); i++) {
-    if (!FileExists(filenames[i])) {
-      LOG(ERROR) << "Could not extract features for " << filenames[i]
-                 << " because the file cannot be found.";
-      continue;
+  {
+    ThreadPool feature_extractor_pool(num_threads);
+    for (int i = 0; i < filenames.size(); i++) {
+      if (!FileExists(filenames[i])) {
+        LOG(ERROR) << "Could not extract features for " << filenames[i]
+                   << " because the file cannot be found.";
+        continue;
+      }
+
+      feature_extractor_pool.Add(
+          &FeatureExtractor::ExtractFeatures,
+          this,
+          filenames[i],
+          &(*keypoints)[i],
+          &(*descriptors)[i]);
     }
-
-    feature_extractor_pool.Add(
-        &FeatureExtractor::ExtractFeatures,
-        this,
-        filenames[i],
-        &(*keypoints)[i],
-        &(*descriptors)[i]);
   }
+  descriptor_extractor_pool_.reset(nullptr);
   return true;
 }
 
@@ -91,18 +107,31 @@ bool FeatureExtractor::Extract(
   CHECK_NOTNULL(keypoints)->resize(images.size());
   CHECK_NOTNULL(descriptors)->resize(images.size());
 
+  // Descriptors are only computed for the selected keypoints when possible.
+  KeypointSelectionOptions keypoint_selection;
+  keypoint_selection.selection_type = options_.keypoint_selection_type;
+  keypoint_selection.max_num_keypoints = options_.max_num_features;
+
+  descriptor_extractor_pool_.reset(
+      new DescriptorExtractorPool(options_.descriptor_extractor_type,
+                                  options_.feature_density,
+                                  keypoint_selection));
+
   // The thread pool will wait to finish all jobs when it goes out of scope.
   const int num_threads =
           std::min(options_.num_threads, static_cast<int>(images.size()));
-  ThreadPool feature_extractor_pool(num_threads);
-  for (int i = 0; i < images.size(); i++) {
-    feature_extractor_pool.Add(
-            &FeatureExtractor::ExtractFeaturesFromImage,
-            this,
-            images[i],
-            &(*keypoints)[i],
-            &(*descriptors)[i]);
+  {
+    ThreadPool feature_extractor_pool(num_threads);
+    for (int i = 0; i < images.size(); i++) {
+      feature_extractor_pool.Add(
+              &FeatureExtractor::ExtractFeaturesFromImage,
+              this,
+              std::cref(images[i]),
+              &(*keypoints)[i],
+              &(*descriptors)[i]);
+    }
   }
+  descriptor_extractor_pool_.reset(nullptr);
   return true;
 }
 
@@ -126,8 +155,12 @@ bool FeatureExtractor::ExtractFeatures(
     const std::string& filename,
     std::vector<Keypoint>* keypoints,
     std::vector<Eigen::VectorXf>* descriptors) {
-  std::unique_ptr<FloatImage> image(new FloatImage(filename));
-  if (!ExtractFeaturesFromImage(*image, keypoints, descriptors)) {
+  // Read the image into the buffer of this thread so that the memory is reused
+  // across images.
+  FloatImage& image =
+      descriptor_extractor_pool_->GetWorkspaceForThisThread()->image;
+  image.Read(filename);
+  if (!ExtractFeaturesFromImage(image, keypoints, descriptors)) {
     LOG(ERROR) << "Could not extract descriptors in image " << filename;
     return false;
   } else {
@@ -163,16 +196,10 @@ bool FeatureExtractor::ExtractFeaturesFromImage(
     const FloatImage& image,
     std::vector<Keypoint>* keypoints,
     std::vector<Eigen::VectorXf>* descriptors) {
-  // We create these variable here instead of upon the construction of the
-  // object so that they can be thread-safe. We *should* be able to use the
-  // static thread_local keywords, but apparently Mac OS-X's version of clang
-  // does not actually support it!
-  //
-  // TODO(cmsweeney): Change this so that each thread in the threadpool receives
-  // exactly one object.
-  std::unique_ptr<DescriptorExtractor> descriptor_extractor =
-      CreateDescriptorExtractor(options_.descriptor_extractor_type,
-                                options_.feature_density);
+  // Each thread reuses its own descriptor extractor for all of its images.
+  DescriptorExtractor* descriptor_extractor =
+      descriptor_extractor_pool_->GetWorkspaceForThisThread()
+          ->descriptor_extractor.get();
 
   // Exit if the descriptor extraction fails.
   if (!descriptor_extractor->DetectAndExtractDescriptors(image,
@@ -181,9 +208,26 @@ bool FeatureExtractor::ExtractFeaturesFromImage(
     return false;
   }
 
+  // Keep the best max_num_features features rather than the first ones. This
+  // is a no-op when the descriptor extractor already selected the keypoints.
   if (keypoints->size() > options_.max_num_features) {
-    keypoints->resize(options_.max_num_features);
-    descriptors->resize(options_.max_num_features);
+    KeypointSelectionOptions keypoint_selection;
+    keypoint_selection.selection_type = options_.keypoint_selection_type;
+    keypoint_selection.max_num_keypoints = options_.max_num_features;
+    std::vector<int> selected_indices;
+    SelectKeypoints(keypoint_selection,
+                    image.Width(),
+                    image.Height(),
+                    *keypoints,
+                    &selected_indices);
+    for (int i = 0; i < selected_indices.size(); i++) {
+      if (selected_indices[i] != i) {
+        (*keypoints)[i] = (*keypoints)[selected_indices[i]];
+        (*descriptors)[i] = std::move((*descriptors)[selected_indices[i]]);
+      }
+    }
+    keypoints->resize(selected_indices.size());
+    descriptors->resize(selected_indices.size());
   }
 
   return true;
@@ -36,10 +36,13 @@
 #define THEIA_SFM_FEATURE_EXTRACTOR_H_
 
 #include <Eigen/Core>
+#include <memory>
 #include <string>
 
 #include "theia/alignment/alignment.h"
 #include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
+#include "theia/image/keypoint_detector/select_keypoints.h"
 #include "theia/util/util.h"
 #include "theia/image/image.h"
 
@@ -63,6 +66,12 @@ class FeatureExtractor {
     // The features returned will be no larger than this size.
     int max_num_features = 16384;
 
+    // How to choose which features to keep when more than max_num_features
+    // are detected in an image. GRID and ANMS spread the features over the
+    // image instead of only keeping the strongest ones.
+    KeypointSelectionType keypoint_selection_type =
+        KeypointSelectionType::STRENGTH;
+
     // If we wish to write the features to disk, they will be output in this
     // directory with the same name as the input image and a ".features"
     // appended.
@@ -102,6 +111,10 @@ class FeatureExtractor {
   const Options options_;
   bool write_features_to_disk_;
 
+  // Descriptor extractors and image buffers for each thread that extracts
+  // features. These only exist while features are being extracted.
+  std::unique_ptr<DescriptorExtractorPool> descriptor_extractor_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(FeatureExtractor);
 };
 
@@ -36,16 +36,20 @@
 
 #include <Eigen/Core>
 #include <algorithm>
+#include <functional>
 #include <glog/logging.h>
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
+#include <utility>
 #include <vector>
 
 #include "theia/image/descriptor/create_descriptor_extractor.h"
 #include "theia/image/descriptor/descriptor_extractor.h"
+#include "theia/image/descriptor/descriptor_extractor_pool.h"
 #include "theia/image/image.h"
 #include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/image/keypoint_detector/select_keypoints.h"
 #include "theia/matching/create_feature_matcher.h"
 #include "theia/matching/feature_correspondence.h"
 #include "theia/matching/feature_matcher_options.h"
@@ -64,6 +68,10 @@
 namespace theia {
 namespace {
 
+// Extracted features are written to the database in batches of this many
+// images.
+static const int kNumImagesPerFeatureWrite = 8;
+
 struct MatchedImages {
   std::unordered_set<int> ranked_matches;
   std::unordered_set<int> expanded_matches;
@@ -72,55 +80,79 @@ struct MatchedImages {
 void ExtractFeatures(const FeatureExtractorAndMatcher::Options& options,
                      const std::string& image_filepath,
                      const std::string& imagemask_filepath,
+                     DescriptorExtractorPool::Workspace* workspace,
                      std::vector<Keypoint>* keypoints,
                      std::vector<Eigen::VectorXf>* descriptors) {
   static const float kMaskThreshold = 0.5;
-  std::unique_ptr<FloatImage> image(new FloatImage(image_filepath));
-  // We create these variable here instead of upon the construction of the
-  // object so that they can be thread-safe. We *should* be able to use the
-  // static thread_local keywords, but apparently Mac OS-X's version of clang
-  // does not actually support it!
-  //
-  // TODO(cmsweeney): Change this so that each thread in the threadpool receives
-  // exactly one object.
-  std::unique_ptr<DescriptorExtractor> descriptor_extractor =
-      CreateDescriptorExtractor(options.descriptor_extractor_type,
-                                options.feature_density);
+  // The image is read into the buffer of the thread's workspace so that the
+  // memory may be reused across images.
+  FloatImage& image = workspace->image;
+  image.Read(image_filepath);
 
   // Exit if the descriptor extraction fails.
-  if (!descriptor_extractor->DetectAndExtractDescriptors(
-          *image, keypoints, descriptors)) {
+  if (!workspace->descriptor_extractor->DetectAndExtractDescriptors(
+          image, keypoints, descriptors)) {
     LOG(ERROR) << "Could not extract descriptors in image " << image_filepath;
     return;
   }
 
+  // Remove keypoints according to the associated mask (remove kp. in black
+  // part). The features are compacted in a single pass so that the remaining
+  // ones stay in order.
+  FloatImage* image_mask = nullptr;
   if (imagemask_filepath.size() > 0) {
-    std::unique_ptr<FloatImage> image_mask(new FloatImage(imagemask_filepath));
+    image_mask = &workspace->mask;
+    image_mask->Read(imagemask_filepath);
     // Check the size of the image and its associated mask.
-    CHECK(image_mask->Width() == image->Width() &&
-          image_mask->Height() == image->Height())
+    CHECK(image_mask->Width() == image.Width() &&
+          image_mask->Height() == image.Height())
         << "The image and the mask don't have the same size. \n"
-        << "- Image: " << image_filepath << "\t(" << image->Width() << " x "
-        << image->Height() << ")\n"
+        << "- Image: " << image_filepath << "\t(" << image.Width() << " x "
+        << image.Height() << ")\n"
         << "- Mask: " << imagemask_filepath << "\t(" << image_mask->Width()
         << " x " << image_mask->Height() << ")";
 
     // Convert the mask to grayscale.
     image_mask->ConvertToGrayscaleImage();
-    // Remove keypoints according to the associated mask (remove kp. in black
-    // part).
-    for (int i = keypoints->size() - 1; i > -1; i--) {
+  }
+
+  if (image_mask != nullptr) {
+    int num_kept_features = 0;
+    for (int i = 0; i < keypoints->size(); i++) {
       if (image_mask->BilinearInterpolate(
-              keypoints->at(i).x(), keypoints->at(i).y(), 0) < kMaskThreshold) {
-        keypoints->erase(keypoints->begin() + i);
-        descriptors->erase(descriptors->begin() + i);
+              (*keypoints)[i].x(), (*keypoints)[i].y(), 0) < kMaskThreshold) {
+        continue;
+      }
+      if (num_kept_features != i) {
+        (*keypoints)[num_kept_features] = (*keypoints)[i];
+        (*descriptors)[num_kept_features] = std::move((*descriptors)[i]);
       }
+      ++num_kept_features;
     }
+    keypoints->resize(num_kept_features);
+    descriptors->resize(num_kept_features);
   }
 
+  // Keep the best max_num_features features rather than the first ones. This
+  // is a no-op when the descriptor extractor already selected the keypoints.
   if (keypoints->size() > options.max_num_features) {
-    keypoints->resize(options.max_num_features);
-    descriptors->resize(options.max_num_features);
+    KeypointSelectionOptions keypoint_selection;
+    keypoint_selection.selection_type = options.keypoint_selection_type;
+    keypoint_selection.max_num_keypoints = options.max_num_features;
+    std::vector<int> selected_indices;
+    SelectKeypoints(keypoint_selection,
+                    image.Width(),
+                    image.Height(),
+                    *keypoints,
+                    &selected_indices);
+    for (int i = 0; i < selected_indices.size(); i++) {
+      if (selected_indices[i] != i) {
+        (*keypoints)[i] = (*keypoints)[selected_indices[i]];
+        (*descriptors)[i] = std::move((*descriptors)[selected_indices[i]]);
+      }
+    }
+    keypoints->resize(selected_indices.size());
+    descriptors->resize(selected_indices.size());
   }
 
   if (imagemask_filepath.size() > 0) {
@@ -210,6 +242,11 @@ void FeatureExtractorAndMatcher::SetPairsToMatch(
   matcher_->SetImagePairsToMatch(image_pairs);
 }
 
+void FeatureExtractorAndMatcher::SetImagePairMatchCallback(
+    const std::function<void(const ImagePairMatch&)>& callback) {
+  matcher_->SetImagePairMatchCallback(callback);
+}
+
 // Performs feature matching between all images provided by the image
 // filepaths. Features are extracted and matched between the images according to
 // the options passed in. Only matches that have passed geometric verification
@@ -217,6 +254,21 @@ void FeatureExtractorAndMatcher::SetPairsToMatch(
 void FeatureExtractorAndMatcher::ExtractAndMatchFeatures() {
   CHECK_NOTNULL(matcher_.get());
 
+  // Each thread extracts features with its own descriptor extractor and image
+  // buffers, which are reused for all of the images that the thread processes.
+  // When no masks are used, the extractors may select the keypoints to keep
+  // before computing descriptors. Otherwise, the keypoints are selected after
+  // the masks have been applied.
+  KeypointSelectionOptions keypoint_selection;
+  if (image_masks_.empty()) {
+    keypoint_selection.selection_type = options_.keypoint_selection_type;
+    keypoint_selection.max_num_keypoints = options_.max_num_features;
+  }
+  descriptor_extractor_pool_.reset(
+      new DescriptorExtractorPool(options_.descriptor_extractor_type,
+                                  options_.feature_density,
+                                  keypoint_selection));
+
   // For each image, process the features and add it to the matcher.
   const int num_threads =
       std::min(options_.num_threads, static_cast<int>(image_filepaths_.size()));
@@ -231,6 +283,8 @@ void FeatureExtractorAndMatcher::ExtractAndMatchFeatures() {
   }
   // This forces all tasks to complete before proceeding.
   thread_pool.reset(nullptr);
+  descriptor_extractor_pool_.reset(nullptr);
+  WriteExtractedFeatures();
 
   // After all threads complete feature extraction, perform matching.
   SelectImagePairsWithGlobalDescriptorMatching();
@@ -301,6 +355,7 @@ void FeatureExtractorAndMatcher::ProcessImage(const int i) {
     ExtractFeatures(options_,
                     image_filepath,
                     mask_filepath,
+                    descriptor_extractor_pool_->GetWorkspaceForThisThread(),
                     &features.keypoints,
                     &features.descriptors);
 
@@ -309,8 +364,17 @@ void FeatureExtractorAndMatcher::ProcessImage(const int i) {
       return;
     }
 
-    // Add the features to the DB.
-    features_and_matches_database_->PutFeatures(image_filename, features);
+    // The features are not in the DB until the batch they belong to is
+    // written, so they are used for training before they are queued.
+    if (options_.select_image_pairs_with_global_image_descriptor_matching) {
+      global_image_descriptor_extractor_->AddFeaturesForTraining(
+          features.descriptors);
+    }
+
+    // Add the features to the DB. The image is added to the matcher once the
+    // features have been written.
+    AddExtractedFeatures(image_filename, &features);
+    return;
   }
 
   // Add the descriptors to the global image descriptor extractor for training
@@ -329,6 +393,42 @@ void FeatureExtractorAndMatcher::ProcessImage(const int i) {
   return;
 }
 
+void FeatureExtractorAndMatcher::AddExtractedFeatures(
+    const std::string& image_name, KeypointsAndDescriptors* features) {
+  {
+    std::lock_guard<std::mutex> lock(extracted_features_mutex_);
+    extracted_image_names_.emplace_back(image_name);
+    extracted_features_.emplace_back(std::move(*features));
+    if (extracted_features_.size() < kNumImagesPerFeatureWrite) {
+      return;
+    }
+  }
+  WriteExtractedFeatures();
+}
+
+void FeatureExtractorAndMatcher::WriteExtractedFeatures() {
+  std::vector<std::string> image_names;
+  std::vector<KeypointsAndDescriptors> features;
+  {
+    std::lock_guard<std::mutex> lock(extracted_features_mutex_);
+    image_names.swap(extracted_image_names_);
+    features.swap(extracted_features_);
+  }
+  if (image_names.empty()) {
+    return;
+  }
+
+  // Write all features with a single batched write.
+  features_and_matches_database_->PutFeaturesOfImages(image_names, features);
+
+  // The matcher may read the features of the images when they are added, so
+  // the images are only added once their features are in the database.
+  std::lock_guard<std::mutex> lock(matcher_mutex_);
+  for (const std::string& image_name : image_names) {
+    matcher_->AddImage(image_name);
+  }
+}
+
 void FeatureExtractorAndMatcher::ExtractGlobalDesriptors(
     const std::vector<std::string>& image_names,
     std::vector<Eigen::VectorXf>* global_descriptors) {
@@ -36,18 +36,22 @@
 #define THEIA_SFM_FEATURE_EXTRACTOR_AND_MATCHER_H_
 
 #include <Eigen/Core>
+#include <functional>
 #include <mutex>  // NOLINT
 #include <string>
 #include <thread>  // NOLINT
 #include <vector>
 
 #include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/keypoint_detector/select_keypoints.h"
 #include "theia/matching/create_feature_matcher.h"
 #include "theia/matching/feature_matcher.h"
 #include "theia/matching/feature_matcher_options.h"
+#include "theia/matching/keypoints_and_descriptors.h"
 #include "theia/sfm/exif_reader.h"
 
 namespace theia {
+class DescriptorExtractorPool;
 class GlobalDescriptorExtractor;
 struct CameraIntrinsicsPrior;
 struct ImagePairMatch;
@@ -75,6 +79,12 @@ class FeatureExtractorAndMatcher {
     // The features returned will be no larger than this size.
     int max_num_features = 16384;
 
+    // How to choose which features to keep when more than max_num_features
+    // are detected in an image. GRID and ANMS spread the features over the
+    // image instead of only keeping the strongest ones.
+    KeypointSelectionType keypoint_selection_type =
+        KeypointSelectionType::STRENGTH;
+
     // Minimum number of inliers to consider the matches a good match.
     int min_num_inlier_matches = 30;
 
@@ -120,6 +130,11 @@ class FeatureExtractorAndMatcher {
   void SetPairsToMatch(
       const std::vector<std::pair<std::string, std::string> >& pairs_to_match);
 
+  // Sets a callback that receives each image pair match as soon as it has been
+  // matched and verified. See FeatureMatcher::SetImagePairMatchCallback.
+  void SetImagePairMatchCallback(
+      const std::function<void(const ImagePairMatch&)>& callback);
+
   // Performs feature matching between all images provided by the image
   // filepaths. Features are extracted and matched between the images according
   // to the options passed in. Only matches that have passed geometric
@@ -131,6 +146,16 @@ class FeatureExtractorAndMatcher {
   // features and descriptors, and adding the image to the matcher.
   void ProcessImage(const int i);
 
+  // Queues the extracted features of the image to be written to the database.
+  // The features are written in batches, and the images are added to the
+  // matcher once their features are in the database.
+  void AddExtractedFeatures(const std::string& image_name,
+                            KeypointsAndDescriptors* features);
+
+  // Writes all queued features to the database and adds the images to the
+  // matcher.
+  void WriteExtractedFeatures();
+
   // If global descriptor matching is used, select the best set of image pairs
   // to perform feature matching on. This dramatically speeds up the matching
   // pipeline over N^2 matching.
@@ -152,11 +177,20 @@ class FeatureExtractorAndMatcher {
   // times.
   ExifReader exif_reader_;
 
+  // Descriptor extractors and image buffers for each thread that extracts
+  // features. These only exist during feature extraction.
+  std::unique_ptr<DescriptorExtractorPool> descriptor_extractor_pool_;
+
   // The global image feature descriptor extractor. This is used to extract a
   // compact representation for each image and select a subset of kNN images to
   // perform explicit (and expensive) feature matching.
   std::unique_ptr<GlobalDescriptorExtractor> global_image_descriptor_extractor_;
 
+  // Extracted features that have not been written to the database yet.
+  std::vector<std::string> extracted_image_names_;
+  std::vector<KeypointsAndDescriptors> extracted_features_;
+  std::mutex extracted_features_mutex_;
+
   // Feature matcher and mutex for thread-safe access.
   std::unique_ptr<FeatureMatcher> matcher_;
   std::mutex matcher_mutex_;
@@ -37,9 +37,12 @@
 #include <ceres/rotation.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <algorithm>
+#include <functional>
 #include <memory>
-#include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "theia/math/util.h"
 #include "theia/util/hash.h"
@@ -55,22 +58,47 @@ using Eigen::Vector3d;
 
 namespace {
 
-// Helper struct to maintain the graph for the translation projection problem.
-struct MFASNode {
-  std::unordered_map<ViewId, double> incoming_nodes;
-  std::unordered_map<ViewId, double> outgoing_nodes;
-  double incoming_weight = 0;
-  double outgoing_weight = 0;
+// The view pairs of the view graph with views re-indexed to the dense range
+// [0, num_views). All per-iteration state is stored in flat arrays indexed by
+// these dense ids so that no hash map lookups are needed in the inner loops.
+struct DenseTranslationProblem {
+  // The dense view ids of each edge and the relative translation of the edge
+  // rotated into the global frame.
+  std::vector<std::pair<int, int> > edges;
+  std::vector<Vector3d> rotated_translations;
+
+  // The edges incident to each view in compressed row storage:
+  // incident_edges[incident_edges_offset[i]...incident_edges_offset[i + 1]]
+  // contains the edge indices of view i.
+  std::vector<int> incident_edges_offset;
+  std::vector<int> incident_edges;
+
+  int NumViews() const { return incident_edges_offset.size() - 1; }
 };
 
 // Rotate the translation direction based on the known orientation such that the
-// translation is in the global reference frame.
-std::unordered_map<ViewIdPair, Vector3d>
-      RotateRelativeTranslationsToGlobalFrame(
-          const std::unordered_map<ViewId, Vector3d>& orientations,
-          const std::unordered_map<ViewIdPair, TwoViewInfo>& view_pairs) {
-  std::unordered_map<ViewIdPair, Vector3d> rotated_translations;
-  rotated_translations.reserve(orientations.size());
+// translation is in the global reference frame and index the view pairs
+// densely.
+void SetupDenseTranslationProblem(
+    const std::unordered_map<ViewId, Vector3d>& orientations,
+    const std::unordered_map<ViewIdPair, TwoViewInfo>& view_pairs,
+    std::vector<ViewIdPair>* view_id_pairs,
+    DenseTranslationProblem* problem) {
+  std::unordered_map<ViewId, int> dense_view_index;
+  view_id_pairs->reserve(view_pairs.size());
+  problem->edges.reserve(view_pairs.size());
+  problem->rotated_translations.reserve(view_pairs.size());
+
+  std::vector<int> num_incident_edges;
+  const auto& GetDenseIndex = [&](const ViewId view_id) {
+    const auto& insert_result =
+        dense_view_index.emplace(view_id, dense_view_index.size());
+    if (insert_result.second) {
+      num_incident_edges.emplace_back(0);
+    }
+    ++num_incident_edges[insert_result.first->second];
+    return insert_result.first->second;
+  };
 
   for (const auto& view_pair : view_pairs) {
     const Vector3d view_to_world_rotation =
@@ -79,174 +107,226 @@ std::unordered_map<ViewIdPair, Vector3d>
     ceres::AngleAxisRotatePoint(view_to_world_rotation.data(),
                                 view_pair.second.position_2.data(),
                                 rotated_translation.data());
-    rotated_translations.emplace(view_pair.first, rotated_translation);
+    view_id_pairs->emplace_back(view_pair.first);
+    const int index1 = GetDenseIndex(view_pair.first.first);
+    const int index2 = GetDenseIndex(view_pair.first.second);
+    problem->edges.emplace_back(index1, index2);
+    problem->rotated_translations.emplace_back(rotated_translation);
+  }
+
+  // Bucket the edges by view.
+  const int num_views = num_incident_edges.size();
+  problem->incident_edges_offset.resize(num_views + 1);
+  problem->incident_edges_offset[0] = 0;
+  for (int i = 0; i < num_views; i++) {
+    problem->incident_edges_offset[i + 1] =
+        problem->incident_edges_offset[i] + num_incident_edges[i];
+  }
+  problem->incident_edges.resize(problem->incident_edges_offset[num_views]);
+  std::vector<int> next_slot(problem->incident_edges_offset.begin(),
+                             problem->incident_edges_offset.end() - 1);
+  for (int i = 0; i < problem->edges.size(); i++) {
+    problem->incident_edges[next_slot[problem->edges[i].first]++] = i;
+    problem->incident_edges[next_slot[problem->edges[i].second]++] = i;
   }
-  return rotated_translations;
 }
 
-// Find the next view to add to the order. We attempt to choose a source (i.e.,
-// a node with no incoming edges) or choose a node based on a heuristic such
-// that it has the most source-like properties.
-ViewId FindNextViewInOrder(
-    const std::unordered_map<ViewId, MFASNode>& degrees_for_view) {
-  ViewId best_choice = kInvalidViewId;
-  double best_score = 0;
-  for (const auto& view : degrees_for_view) {
-    // If the view is a source view, return it.
-    if (view.second.incoming_nodes.size() == 0) {
-      return view.first;
+// Computes an ordering of the views from the 1D projections of the edges by
+// greedily solving the minimum feedback arc set problem. Sources (i.e. views
+// with no remaining incoming edges) are always chosen first; otherwise the view
+// with the most source-like score of (outgoing + 1) / (incoming + 1) is chosen.
+// Sources are kept in their own bucket and all other views in a max-heap keyed
+// on the score. Heap entries are invalidated lazily when the score of a view
+// changes, so each step costs O(log E) instead of a scan over all views.
+class TranslationOrderingSolver {
+ public:
+  explicit TranslationOrderingSolver(const DenseTranslationProblem& problem)
+      : problem_(problem),
+        incoming_weight_(problem.NumViews()),
+        outgoing_weight_(problem.NumViews()),
+        num_incoming_edges_(problem.NumViews()),
+        version_(problem.NumViews()),
+        is_ordered_(problem.NumViews()) {}
+
+  // Computes the position of each view in the ordering. An edge points from
+  // the first to the second view if its projection is positive and the other
+  // way otherwise.
+  void Solve(const std::vector<double>& projections,
+             std::vector<int>* ordering) {
+    const int num_views = problem_.NumViews();
+    std::fill(incoming_weight_.begin(), incoming_weight_.end(), 0.0);
+    std::fill(outgoing_weight_.begin(), outgoing_weight_.end(), 0.0);
+    std::fill(num_incoming_edges_.begin(), num_incoming_edges_.end(), 0);
+    std::fill(version_.begin(), version_.end(), 0);
+    std::fill(is_ordered_.begin(), is_ordered_.end(), false);
+    sources_.clear();
+    heap_.clear();
+
+    // Compute the degrees of all vertices as the sum of weights coming in or
+    // out.
+    for (int i = 0; i < problem_.edges.size(); i++) {
+      int from, to;
+      GetEdgeDirection(i, projections, &from, &to);
+      const double weight = std::abs(projections[i]);
+      incoming_weight_[to] += weight;
+      outgoing_weight_[from] += weight;
+      ++num_incoming_edges_[to];
     }
-
-    // Otherwise, keep track of the max score seen so far.
-    const double score = (view.second.outgoing_weight + 1.0) /
-                         (view.second.incoming_weight + 1.0);
-    if (score > best_score) {
-      best_choice = view.first;
-      best_score = score;
+    for (int i = 0; i < num_views; i++) {
+      PushView(i);
     }
-  }
 
-  return best_choice;
-}
-
-// Based on the 1D translation projections, compute an ordering of the
-// translations.
-std::unordered_map<ViewId, int> OrderTranslationsFromProjections(
-    const std::unordered_map<ViewIdPair, double>&
-        translation_direction_projections) {
-  // Compute the degrees of all vertices as the sum of weights coming in or out.
-  std::unordered_map<ViewId, MFASNode> degrees_for_view;
-  for (const auto& translation_projection : translation_direction_projections) {
-    const ViewIdPair view_id_pair =
-        (translation_projection.second > 0)
-            ? translation_projection.first
-            : ViewIdPair(translation_projection.first.second,
-                         translation_projection.first.first);
-
-    // Update the MFAS entry.
-    const double weight = std::abs(translation_projection.second);
-    degrees_for_view[view_id_pair.second].incoming_weight += weight;
-    degrees_for_view[view_id_pair.first].outgoing_weight += weight;
-    degrees_for_view[view_id_pair.second].incoming_nodes.emplace(
-        view_id_pair.first, weight);
-    degrees_for_view[view_id_pair.first].outgoing_nodes.emplace(
-        view_id_pair.second, weight);
+    // Compute the ordering.
+    ordering->resize(num_views);
+    for (int i = 0; i < num_views; i++) {
+      const int next_view = PopNextView();
+      (*ordering)[next_view] = i;
+      is_ordered_[next_view] = true;
+
+      // Update the MFAS graph by removing the edges of the next view.
+      for (int j = problem_.incident_edges_offset[next_view];
+           j < problem_.incident_edges_offset[next_view + 1];
+           j++) {
+        const int edge_index = problem_.incident_edges[j];
+        int from, to;
+        GetEdgeDirection(edge_index, projections, &from, &to);
+        const int neighbor = (from == next_view) ? to : from;
+        if (is_ordered_[neighbor]) {
+          continue;
+        }
+
+        const double weight = std::abs(projections[edge_index]);
+        if (from == next_view) {
+          incoming_weight_[neighbor] -= weight;
+          --num_incoming_edges_[neighbor];
+        } else {
+          outgoing_weight_[neighbor] -= weight;
+        }
+        ++version_[neighbor];
+        PushView(neighbor);
+      }
+    }
   }
 
-  // Compute the ordering.
-  const int num_views = degrees_for_view.size();
-  std::unordered_map<ViewId, int> translation_ordering;
-  for (int i = 0; i < num_views; i++) {
-    // Find the next view to add.
-    const ViewId next_view_in_order = FindNextViewInOrder(degrees_for_view);
-    translation_ordering[next_view_in_order] = i;
-
-    // Update the MFAS graph and remove the next view from the degrees_for_view.
-    const auto& next_view_info =
-        FindOrDie(degrees_for_view, next_view_in_order);
-    for (auto& neighbor_info : next_view_info.incoming_nodes) {
-      degrees_for_view[neighbor_info.first].outgoing_weight -=
-          neighbor_info.second;
-      degrees_for_view[neighbor_info.first].outgoing_nodes.erase(
-          next_view_in_order);
+ private:
+  struct HeapEntry {
+    double score;
+    int view;
+    int version;
+    bool operator<(const HeapEntry& other) const {
+      return score < other.score;
     }
-    for (auto& neighbor_info : next_view_info.outgoing_nodes) {
-      degrees_for_view[neighbor_info.first].incoming_weight -=
-          neighbor_info.second;
-      degrees_for_view[neighbor_info.first].incoming_nodes.erase(
-          next_view_in_order);
+  };
+
+  void GetEdgeDirection(const int edge_index,
+                        const std::vector<double>& projections,
+                        int* from,
+                        int* to) const {
+    const auto& edge = problem_.edges[edge_index];
+    if (projections[edge_index] > 0) {
+      *from = edge.first;
+      *to = edge.second;
+    } else {
+      *from = edge.second;
+      *to = edge.first;
     }
-    degrees_for_view.erase(next_view_in_order);
   }
 
-  return translation_ordering;
-}
+  void PushView(const int view) {
+    if (num_incoming_edges_[view] == 0) {
+      sources_.emplace_back(view);
+      return;
+    }
+    const double score =
+        (outgoing_weight_[view] + 1.0) / (incoming_weight_[view] + 1.0);
+    heap_.emplace_back(HeapEntry{score, view, version_[view]});
+    std::push_heap(heap_.begin(), heap_.end());
+  }
 
-// Projects all the of the translation onto the given axis.
-std::unordered_map<ViewIdPair, double> ProjectTranslationsOntoAxis(
-    const Vector3d& axis,
-    const std::unordered_map<ViewIdPair, Vector3d>& relative_translations) {
-  std::unordered_map<ViewIdPair, double> projection_weights;
-  projection_weights.reserve(relative_translations.size());
+  int PopNextView() {
+    // A source may be pushed again when its outgoing weight changes, so skip
+    // views that were already ordered.
+    while (!sources_.empty()) {
+      const int view = sources_.back();
+      sources_.pop_back();
+      if (!is_ordered_[view]) {
+        return view;
+      }
+    }
 
-  for (const auto& relative_translation : relative_translations) {
-    const double projection_weight = relative_translation.second.dot(axis);
-    projection_weights.emplace(relative_translation.first, projection_weight);
+    while (!heap_.empty()) {
+      std::pop_heap(heap_.begin(), heap_.end());
+      const HeapEntry entry = heap_.back();
+      heap_.pop_back();
+      if (!is_ordered_[entry.view] && entry.version == version_[entry.view]) {
+        return entry.view;
+      }
+    }
+    LOG(FATAL) << "No views left to order.";
+    return -1;
   }
-  return projection_weights;
-}
+
+  const DenseTranslationProblem& problem_;
+  std::vector<double> incoming_weight_;
+  std::vector<double> outgoing_weight_;
+  std::vector<int> num_incoming_edges_;
+  std::vector<int> version_;
+  std::vector<bool> is_ordered_;
+  std::vector<int> sources_;
+  std::vector<HeapEntry> heap_;
+};
 
 // This chooses a random axis based on the given relative translations.
 void ComputeMeanVariance(
-    const std::unordered_map<ViewIdPair, Vector3d>& relative_translations,
+    const std::vector<Vector3d>& relative_translations,
     Vector3d* mean,
     Vector3d* variance) {
   mean->setZero();
   variance->setZero();
-  for (const auto& translation : relative_translations) {
-    *mean += translation.second;
+  for (const Vector3d& translation : relative_translations) {
+    *mean += translation;
   }
   *mean /= static_cast<double>(relative_translations.size());
 
-  for (const auto& translation : relative_translations) {
-    *variance += (translation.second - *mean).cwiseAbs2();
+  for (const Vector3d& translation : relative_translations) {
+    *variance += (translation - *mean).cwiseAbs2();
   }
   *variance /= static_cast<double>(relative_translations.size() - 1);
 }
 
-// Performs a single iterations of the translation filtering. This method is
-// thread-safe.
-void TranslationFilteringIteration(
-    const std::unordered_map<ViewIdPair, Vector3d>& relative_translations,
-    const Vector3d& direction_mean,
-    const Vector3d& direction_variance,
-    const std::shared_ptr<RandomNumberGenerator>& rng,
-    std::mutex* mutex,
-    std::unordered_map<ViewIdPair, double>* bad_edge_weight) {
-  // Create the random number generator within each thread. If the random number
-  // generator is not supplied then create a new one within each thread.
-  std::shared_ptr<RandomNumberGenerator> local_rng;
-  if (rng.get() == nullptr) {
-    local_rng = std::make_shared<RandomNumberGenerator>();
-  } else {
-    local_rng = rng;
-  }
+// Performs the translation filtering iterations for the given projection axes
+// and accumulates the bad edge weights into the thread-local
+// bad_edge_weight. This method is thread-safe.
+void TranslationFilteringIterations(
+    const DenseTranslationProblem& problem,
+    const std::vector<Vector3d>& axes,
+    const int first_axis,
+    const int last_axis,
+    std::vector<double>* bad_edge_weight) {
+  const int num_edges = problem.edges.size();
+  bad_edge_weight->assign(num_edges, 0.0);
+
+  TranslationOrderingSolver ordering_solver(problem);
+  std::vector<double> projections(num_edges);
+  std::vector<int> ordering;
+  for (int i = first_axis; i < last_axis; i++) {
+    // Project all vectors.
+    for (int j = 0; j < num_edges; j++) {
+      projections[j] = problem.rotated_translations[j].dot(axes[i]);
+    }
 
-  // Get a random vector to project all relative translations on to.
-  const Vector3d random_axis =
-      Vector3d(
-          local_rng->RandGaussian(direction_mean[0], direction_variance[0]),
-          local_rng->RandGaussian(direction_mean[1], direction_variance[1]),
-          local_rng->RandGaussian(direction_mean[2], direction_variance[2]))
-          .normalized();
-
-  // Project all vectors.
-  const std::unordered_map<ViewIdPair, double>&
-      translation_direction_projections =
-          ProjectTranslationsOntoAxis(random_axis, relative_translations);
-
-  // Compute ordering.
-  const std::unordered_map<ViewId, int>& translation_ordering =
-      OrderTranslationsFromProjections(translation_direction_projections);
-
-  // Compute bad edge weights.
-  for (auto& edge : *bad_edge_weight) {
-    const int ordering_diff =
-        FindOrDie(translation_ordering, edge.first.second) -
-        FindOrDie(translation_ordering, edge.first.first);
-    const double& projection_weight_of_edge =
-        FindOrDieNoPrint(translation_direction_projections, edge.first);
-
-    VLOG(3) << "Edge (" << edge.first.first << ", " << edge.first.second
-            << ") has ordering diff of " << ordering_diff
-            << " and a projection of " << projection_weight_of_edge << " from "
-            << FindOrDieNoPrint(relative_translations, edge.first).transpose();
-    // If the ordering is inconsistent, add the absolute value of the bad weight
-    // to the aggregate bad weight.
-    if ((ordering_diff < 0 && projection_weight_of_edge > 0) ||
-        (ordering_diff > 0 && projection_weight_of_edge < 0)) {
-      std::lock_guard<std::mutex> lock(*mutex);
-      edge.second += std::abs(projection_weight_of_edge);
+    // Compute ordering.
+    ordering_solver.Solve(projections, &ordering);
+
+    // Compute bad edge weights. If the ordering is inconsistent, add the
+    // absolute value of the bad weight to the aggregate bad weight.
+    for (int j = 0; j < num_edges; j++) {
+      const int ordering_diff =
+          ordering[problem.edges[j].second] - ordering[problem.edges[j].first];
+      if ((ordering_diff < 0 && projections[j] > 0) ||
+          (ordering_diff > 0 && projections[j] < 0)) {
+        (*bad_edge_weight)[j] += std::abs(projections[j]);
+      }
     }
   }
 }
@@ -258,47 +338,76 @@ void FilterViewPairsFromRelativeTranslation(
     const std::unordered_map<ViewId, Vector3d>& orientations,
     ViewGraph* view_graph) {
   const auto& view_pairs = view_graph->GetAllEdges();
-
-  // Weights of edges that have been accumulated throughout the iterations. A
-  // higher weight means the edge is more likely to be bad.
-  std::unordered_map<ViewIdPair, double> bad_edge_weight;
-  for (const auto& view_pair : view_pairs) {
-    bad_edge_weight[view_pair.first] = 0.0;
+  if (view_pairs.empty()) {
+    return;
   }
 
   // Compute the adjusted translations so that they are oriented in the global
   // frame.
-  const std::unordered_map<ViewIdPair, Vector3d>& rotated_translations =
-      RotateRelativeTranslationsToGlobalFrame(orientations, view_pairs);
+  std::vector<ViewIdPair> view_id_pairs;
+  DenseTranslationProblem problem;
+  SetupDenseTranslationProblem(orientations,
+                               view_pairs,
+                               &view_id_pairs,
+                               &problem);
 
   Vector3d translation_mean, translation_variance;
-  ComputeMeanVariance(rotated_translations,
+  ComputeMeanVariance(problem.rotated_translations,
                       &translation_mean,
                       &translation_variance);
 
-  std::unique_ptr<ThreadPool> pool(new ThreadPool(options.num_threads));
-  std::mutex mutex;
+  // Draw the random projection axes up front so that the random number
+  // generator is not shared between threads.
+  std::shared_ptr<RandomNumberGenerator> rng = options.rng;
+  if (rng.get() == nullptr) {
+    rng = std::make_shared<RandomNumberGenerator>();
+  }
+  std::vector<Vector3d> axes(options.num_iterations);
   for (int i = 0; i < options.num_iterations; i++) {
-    pool->Add(TranslationFilteringIteration,
-              rotated_translations,
-              translation_mean,
-              translation_variance,
-              options.rng,
-              &mutex,
-              &bad_edge_weight);
+    for (int j = 0; j < 3; j++) {
+      axes[i][j] =
+          rng->RandGaussian(translation_mean[j], translation_variance[j]);
+    }
+    axes[i].normalize();
+  }
+
+  // Split the iterations into blocks of a fixed size. Each block accumulates the
+  // weights of edges that are likely to be bad into its own buffer. A higher
+  // weight means the edge is more likely to be bad. The blocks do not depend on
+  // the number of threads so that the weights are summed in the same order,
+  // and the filtering is bitwise reproducible, for any number of threads.
+  static const int kIterationsPerBlock = 4;
+  const int num_blocks =
+      (options.num_iterations + kIterationsPerBlock - 1) / kIterationsPerBlock;
+  std::vector<std::vector<double> > bad_edge_weights(num_blocks);
+  {
+    ThreadPool pool(std::max(1, std::min(options.num_threads, num_blocks)));
+    for (int i = 0; i < num_blocks; i++) {
+      const int first_axis = i * kIterationsPerBlock;
+      const int last_axis =
+          std::min(options.num_iterations, first_axis + kIterationsPerBlock);
+      pool.Add(TranslationFilteringIterations,
+               std::cref(problem),
+               std::cref(axes),
+               first_axis,
+               last_axis,
+               &bad_edge_weights[i]);
+    }
   }
-  // Wait for tasks to finish.
-  pool.reset(nullptr);
 
   // Remove all the bad edges.
   const double max_aggregated_projection_tolerance =
       options.translation_projection_tolerance * options.num_iterations;
   int num_view_pairs_removed = 0;
-  for (const auto& view_pair : bad_edge_weight) {
-    VLOG(3) << "View pair (" << view_pair.first.first << ", "
-            << view_pair.first.second << ") projection = " << view_pair.second;
-    if (view_pair.second > max_aggregated_projection_tolerance) {
-      view_graph->RemoveEdge(view_pair.first.first, view_pair.first.second);
+  for (int i = 0; i < view_id_pairs.size(); i++) {
+    double bad_edge_weight = 0.0;
+    for (const std::vector<double>& block_weights : bad_edge_weights) {
+      bad_edge_weight += block_weights[i];
+    }
+    VLOG(3) << "View pair (" << view_id_pairs[i].first << ", "
+            << view_id_pairs[i].second << ") projection = " << bad_edge_weight;
+    if (bad_edge_weight > max_aggregated_projection_tolerance) {
+      view_graph->RemoveEdge(view_id_pairs[i].first, view_id_pairs[i].second);
       ++num_view_pairs_removed;
     }
   }
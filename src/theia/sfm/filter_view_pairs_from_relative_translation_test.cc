@@ -215,4 +215,31 @@ TEST(FilterViewPairsFromRelativeTranslation, ManyBadRotations) {
   TestFilterViewPairsFromRelativeTranslation(30, 100, 30);
 }
 
+TEST(FilterViewPairsFromRelativeTranslation, NumThreadsInvariant) {
+  std::unordered_map<ViewId, Vector3d> orientations;
+  std::unordered_map<ViewId, Vector3d> positions;
+  CreateViewsWithRandomPoses(30, &orientations, &positions);
+  ViewGraph view_graph;
+  CreateValidViewPairs(100, orientations, positions, &view_graph);
+  CreateInvalidViewPairs(30, orientations, positions, &view_graph);
+  ViewGraph multithreaded_view_graph = view_graph;
+
+  FilterViewPairsFromRelativeTranslationOptions options;
+  options.rng = std::make_shared<RandomNumberGenerator>(243);
+  FilterViewPairsFromRelativeTranslation(options, orientations, &view_graph);
+
+  // The projection axes only depend on the random number generator, so the
+  // result should not depend on the number of threads.
+  options.rng = std::make_shared<RandomNumberGenerator>(243);
+  options.num_threads = 4;
+  FilterViewPairsFromRelativeTranslation(options,
+                                         orientations,
+                                         &multithreaded_view_graph);
+  EXPECT_EQ(view_graph.NumEdges(), multithreaded_view_graph.NumEdges());
+  for (const auto& edge : view_graph.GetAllEdges()) {
+    EXPECT_TRUE(multithreaded_view_graph.HasEdge(edge.first.first,
+                                                 edge.first.second));
+  }
+}
+
 }  // namespace theia
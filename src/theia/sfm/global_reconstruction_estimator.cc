@@ -39,6 +39,7 @@
 #include <sstream>  // NOLINT
 
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h"
 #include "theia/sfm/estimate_track.h"
 #include "theia/sfm/extract_maximally_parallel_rigid_subgraph.h"
 #include "theia/sfm/filter_view_graph_cycles_by_rotation.h"
@@ -104,6 +105,42 @@ void SetUnderconstrainedAsUnestimated(Reconstruction* reconstruction) {
   }
 }
 
+// Bundle adjusts the views and tracks. Reconstructions with more views than
+// the maximum partition size are bundle adjusted in partitions so that the
+// memory is bounded by the size of the largest partition.
+BundleAdjustmentSummary BundleAdjustViewsAndTracks(
+    const ReconstructionEstimatorOptions& options,
+    const BundleAdjustmentOptions& bundle_adjustment_options,
+    const std::unordered_set<ViewId>& views_to_optimize,
+    const std::unordered_set<TrackId>& tracks_to_optimize,
+    Reconstruction* reconstruction) {
+  if (options.max_num_views_per_bundle_adjustment_partition <= 0 ||
+      views_to_optimize.size() <=
+          options.max_num_views_per_bundle_adjustment_partition) {
+    return BundleAdjustPartialReconstruction(bundle_adjustment_options,
+                                             views_to_optimize,
+                                             tracks_to_optimize,
+                                             reconstruction);
+  }
+
+  PartitionedBundleAdjustmentOptions partitioned_options;
+  partitioned_options.bundle_adjustment_options = bundle_adjustment_options;
+  partitioned_options.max_num_views_per_partition =
+      options.max_num_views_per_bundle_adjustment_partition;
+  partitioned_options.num_partitions_in_parallel =
+      options.num_bundle_adjustment_partitions_in_parallel;
+  partitioned_options.max_num_iterations =
+      options.max_num_partitioned_bundle_adjustment_iterations;
+  partitioned_options.function_tolerance =
+      options.partitioned_bundle_adjustment_function_tolerance;
+  partitioned_options.consensus_penalty =
+      options.bundle_adjustment_partition_consensus_penalty;
+  return BundleAdjustReconstructionInPartitions(partitioned_options,
+                                                views_to_optimize,
+                                                tracks_to_optimize,
+                                                reconstruction);
+}
+
 }  // namespace
 
 GlobalReconstructionEstimator::GlobalReconstructionEstimator(
@@ -444,7 +481,6 @@ void GlobalReconstructionEstimator::EstimateStructure() {
       options_.min_triangulation_angle_degrees;
   triangulation_options.bundle_adjustment = options_.bundle_adjust_tracks;
   triangulation_options.ba_options = SetBundleAdjustmentOptions(options_, 0);
-  triangulation_options.ba_options.num_threads = 1;
   triangulation_options.ba_options.verbose = false;
   triangulation_options.num_threads = options_.num_threads;
   TrackEstimator track_estimator(triangulation_options, reconstruction_);
@@ -467,6 +503,7 @@ bool GlobalReconstructionEstimator::BundleAdjustment() {
           options_.track_subset_selection_long_track_length_threshold,
           options_.track_selection_image_grid_cell_size_pixels,
           options_.min_num_optimized_tracks_per_view,
+          options_.num_threads,
           &tracks_to_optimize)) {
     // Set all tracks that were not chosen for BA to be unestimated so that they
     // do not affect the bundle adjustment optimization.
@@ -484,10 +521,11 @@ bool GlobalReconstructionEstimator::BundleAdjustment() {
   GetEstimatedViewsFromReconstruction(*reconstruction_,
                                       &views_to_optimize);
   const auto& bundle_adjustment_summary =
-      BundleAdjustPartialReconstruction(bundle_adjustment_options_,
-                                        views_to_optimize,
-                                        tracks_to_optimize,
-                                        reconstruction_);
+      BundleAdjustViewsAndTracks(options_,
+                                 bundle_adjustment_options_,
+                                 views_to_optimize,
+                                 tracks_to_optimize,
+                                 reconstruction_);
   return bundle_adjustment_summary.success;
 }
 
@@ -509,6 +547,7 @@ bool GlobalReconstructionEstimator::BundleAdjustCameraPositionsAndPoints() {
           options_.track_subset_selection_long_track_length_threshold,
           options_.track_selection_image_grid_cell_size_pixels,
           options_.min_num_optimized_tracks_per_view,
+          options_.num_threads,
           &tracks_to_optimize)) {
     GetEstimatedTracksFromReconstruction(*reconstruction_, &tracks_to_optimize);
   }
@@ -519,10 +558,11 @@ bool GlobalReconstructionEstimator::BundleAdjustCameraPositionsAndPoints() {
   GetEstimatedViewsFromReconstruction(*reconstruction_,
                                       &views_to_optimize);
   const auto& bundle_adjustment_summary =
-      BundleAdjustPartialReconstruction(bundle_adjustment_options_,
-                                        views_to_optimize,
-                                        tracks_to_optimize,
-                                        reconstruction_);
+      BundleAdjustViewsAndTracks(options_,
+                                 bundle_adjustment_options_,
+                                 views_to_optimize,
+                                 tracks_to_optimize,
+                                 reconstruction_);
   return bundle_adjustment_summary.success;
 }
 
@@ -119,7 +119,6 @@ HybridReconstructionEstimator::HybridReconstructionEstimator(
       options_.min_triangulation_angle_degrees;
   triangulation_options_.bundle_adjustment = options_.bundle_adjust_tracks;
   triangulation_options_.ba_options = SetBundleAdjustmentOptions(options_, 0);
-  triangulation_options_.ba_options.num_threads = 1;
   triangulation_options_.ba_options.verbose = false;
   triangulation_options_.num_threads = options_.num_threads;
 
@@ -729,6 +728,7 @@ bool HybridReconstructionEstimator::FullBundleAdjustment() {
           options_.track_subset_selection_long_track_length_threshold,
           options_.track_selection_image_grid_cell_size_pixels,
           options_.min_num_optimized_tracks_per_view,
+          options_.num_threads,
           &tracks_to_optimize)) {
     SetTracksInViewsToUnestimated(reconstructed_views_,
                                   tracks_to_optimize,
@@ -801,6 +801,7 @@ bool HybridReconstructionEstimator::PartialBundleAdjustment() {
           options_.track_subset_selection_long_track_length_threshold,
           options_.track_selection_image_grid_cell_size_pixels,
           options_.min_num_optimized_tracks_per_view,
+          options_.num_threads,
           &tracks_to_optimize)) {
     SetTracksInViewsToUnestimated(views_to_optimize,
                                   tracks_to_optimize,
@@ -114,7 +114,6 @@ IncrementalReconstructionEstimator::IncrementalReconstructionEstimator(
       options_.min_triangulation_angle_degrees;
   triangulation_options_.bundle_adjustment = options_.bundle_adjust_tracks;
   triangulation_options_.ba_options = SetBundleAdjustmentOptions(options_, 0);
-  triangulation_options_.ba_options.num_threads = 1;
   triangulation_options_.ba_options.verbose = false;
   triangulation_options_.num_threads = options_.num_threads;
 
@@ -161,6 +160,12 @@ ReconstructionEstimatorSummary IncrementalReconstructionEstimator::Estimate(
     ViewGraph* view_graph, Reconstruction* reconstruction) {
   reconstruction_ = reconstruction;
   view_graph_ = view_graph;
+  if (options_.reuse_bundle_adjustment_problem) {
+    partial_bundle_adjustment_session_.reset(
+        new BundleAdjustmentSession(reconstruction_));
+    full_bundle_adjustment_session_.reset(
+        new BundleAdjustmentSession(reconstruction_));
+  }
 
   // Initialize the unlocalized_views_ variable.
   const auto& view_ids = view_graph_->ViewIds();
@@ -494,13 +499,18 @@ bool IncrementalReconstructionEstimator::FullBundleAdjustment() {
   // reduces the number of parameters in bundle adjustment, and does a decent
   // job of filtering tracks with outliers that may slow down the nonlinear
   // optimization.
+  std::unordered_set<ViewId> views_to_optimize;
+  GetEstimatedViewsFromReconstruction(*reconstruction_, &views_to_optimize);
   std::unordered_set<TrackId> tracks_to_optimize;
   if (options_.subsample_tracks_for_bundle_adjustment &&
       SelectGoodTracksForBundleAdjustment(
           *reconstruction_,
+          views_to_optimize,
           options_.track_subset_selection_long_track_length_threshold,
           options_.track_selection_image_grid_cell_size_pixels,
           options_.min_num_optimized_tracks_per_view,
+          options_.num_threads,
+          &track_statistics_cache_,
           &tracks_to_optimize)) {
     SetTracksInViewsToUnestimated(
         reconstructed_views_, tracks_to_optimize, reconstruction_);
@@ -510,13 +520,10 @@ bool IncrementalReconstructionEstimator::FullBundleAdjustment() {
   LOG(INFO) << "Selected " << tracks_to_optimize.size()
             << " tracks to optimize.";
 
-  std::unordered_set<ViewId> views_to_optimize;
-  GetEstimatedViewsFromReconstruction(*reconstruction_, &views_to_optimize);
   const auto& ba_summary =
-      BundleAdjustPartialReconstruction(bundle_adjustment_options_,
-                                        views_to_optimize,
-                                        tracks_to_optimize,
-                                        reconstruction_);
+      BundleAdjustViewsAndTracks(views_to_optimize,
+                                 tracks_to_optimize,
+                                 full_bundle_adjustment_session_.get());
   num_optimized_views_ = reconstructed_views_.size();
 
   const auto& track_ids = reconstruction_->TrackIds();
@@ -566,6 +573,8 @@ bool IncrementalReconstructionEstimator::PartialBundleAdjustment() {
           options_.track_subset_selection_long_track_length_threshold,
           options_.track_selection_image_grid_cell_size_pixels,
           options_.min_num_optimized_tracks_per_view,
+          options_.num_threads,
+          &track_statistics_cache_,
           &tracks_to_optimize)) {
     SetTracksInViewsToUnestimated(
         views_to_optimize, tracks_to_optimize, reconstruction_);
@@ -584,16 +593,31 @@ bool IncrementalReconstructionEstimator::PartialBundleAdjustment() {
             << " tracks to optimize.";
 
   // Perform partial BA.
-  ba_summary = BundleAdjustPartialReconstruction(bundle_adjustment_options_,
-                                                 views_to_optimize,
-                                                 tracks_to_optimize,
-                                                 reconstruction_);
+  ba_summary =
+      BundleAdjustViewsAndTracks(views_to_optimize,
+                                 tracks_to_optimize,
+                                 partial_bundle_adjustment_session_.get());
 
   RemoveOutlierTracks(tracks_to_optimize,
                       options_.max_reprojection_error_in_pixels);
   return ba_summary.success;
 }
 
+BundleAdjustmentSummary IncrementalReconstructionEstimator::
+    BundleAdjustViewsAndTracks(
+        const std::unordered_set<ViewId>& views_to_optimize,
+        const std::unordered_set<TrackId>& tracks_to_optimize,
+        BundleAdjustmentSession* bundle_adjustment_session) {
+  if (bundle_adjustment_session != nullptr) {
+    return bundle_adjustment_session->Optimize(
+        bundle_adjustment_options_, views_to_optimize, tracks_to_optimize);
+  }
+  return BundleAdjustPartialReconstruction(bundle_adjustment_options_,
+                                           views_to_optimize,
+                                           tracks_to_optimize,
+                                           reconstruction_);
+}
+
 void IncrementalReconstructionEstimator::RemoveOutlierTracks(
     const std::unordered_set<TrackId>& tracks_to_check,
     const double max_reprojection_error_in_pixels) {
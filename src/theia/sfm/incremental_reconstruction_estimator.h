@@ -35,14 +35,17 @@
 #ifndef THEIA_SFM_INCREMENTAL_RECONSTRUCTION_ESTIMATOR_H_
 #define THEIA_SFM_INCREMENTAL_RECONSTRUCTION_ESTIMATOR_H_
 
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/bundle_adjustment/bundle_adjustment_session.h"
 #include "theia/sfm/estimate_track.h"
 #include "theia/sfm/localize_view_to_reconstruction.h"
 #include "theia/sfm/reconstruction_estimator.h"
 #include "theia/sfm/reconstruction_estimator_options.h"
+#include "theia/sfm/select_good_tracks_for_bundle_adjustment.h"
 #include "theia/sfm/types.h"
 #include "theia/solvers/sample_consensus_estimator.h"
 #include "theia/util/util.h"
@@ -125,6 +128,13 @@ class IncrementalReconstructionEstimator : public ReconstructionEstimator {
   // Performs full bundle adjustment on the model.
   bool FullBundleAdjustment();
 
+  // Bundle adjusts the views and tracks, reusing the bundle adjustment problem
+  // of the previous calls with the same session if the session is not null.
+  BundleAdjustmentSummary BundleAdjustViewsAndTracks(
+      const std::unordered_set<ViewId>& views_to_optimize,
+      const std::unordered_set<TrackId>& tracks_to_optimize,
+      BundleAdjustmentSession* bundle_adjustment_session);
+
   // Chooses the next cameras to be localized according to which camera observes
   // the highest number of 3D points in the scene. This view is then localized
   // to using the calibrated or uncalibrated absolute pose algorithm.
@@ -162,6 +172,17 @@ class IncrementalReconstructionEstimator : public ReconstructionEstimator {
   // Indicates the number of views that have been optimized with full BA.
   int num_optimized_views_;
 
+  // The bundle adjustment problems that are reused between the partial BA calls
+  // and between the full BA calls if options_.reuse_bundle_adjustment_problem
+  // is true. Partial and full BA optimize very different sets of views, so they
+  // use separate problems.
+  std::unique_ptr<BundleAdjustmentSession> partial_bundle_adjustment_session_;
+  std::unique_ptr<BundleAdjustmentSession> full_bundle_adjustment_session_;
+
+  // The statistics of the tracks used to select the tracks for BA. Only the
+  // statistics of tracks that changed since the previous BA are recomputed.
+  TrackStatisticsCache track_statistics_cache_;
+
   DISALLOW_COPY_AND_ASSIGN(IncrementalReconstructionEstimator);
 };
 
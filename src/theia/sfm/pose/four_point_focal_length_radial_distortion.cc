@@ -140,11 +140,10 @@ bool FourPointsPoseFocalLengthRadialDistortion(
   N.fill(0.0);
   N.leftCols<3>() = Q.rightCols<3>();
 
-  // this random rotation is supposed to make the solver more stable
-  static RandomNumberGenerator random_number_gen(42);
-  Vector3d rot_vec(random_number_gen.RandDouble(-0.5, 0.5),
-                   random_number_gen.RandDouble(-0.5, 0.5),
-                   random_number_gen.RandDouble(-0.5, 0.5));
+  // this random rotation is supposed to make the solver more stable. A local
+  // generator is used so that the solver is thread-safe and deterministic.
+  RandomNumberGenerator random_number_gen(42);
+  const Vector3d rot_vec = random_number_gen.RandVector3d(-0.5, 0.5);
   Eigen::AngleAxisd random_rot(rot_vec.norm(), rot_vec);
   N.leftCols<3>() *= random_rot.toRotationMatrix();
   Matrix<double, 8, 1> x0 =
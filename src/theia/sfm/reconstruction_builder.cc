@@ -37,12 +37,15 @@
 #include <glog/logging.h>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "theia/image/keypoint_detector/keypoint.h"
 #include "theia/matching/features_and_matches_database.h"
 #include "theia/matching/image_pair_match.h"
 #include "theia/matching/rocksdb_features_and_matches_database.h"
 #include "theia/sfm/camera_intrinsics_prior.h"
+#include "theia/sfm/feature.h"
 #include "theia/sfm/feature_extractor_and_matcher.h"
 #include "theia/sfm/reconstruction.h"
 #include "theia/sfm/reconstruction_estimator.h"
@@ -50,12 +53,19 @@
 #include "theia/sfm/types.h"
 #include "theia/sfm/view.h"
 #include "theia/sfm/view_graph/view_graph.h"
+#include "theia/util/bounded_queue.h"
 #include "theia/util/filesystem.h"
+#include "theia/util/map_util.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 
 namespace {
 
+// Maximum number of verified matches that are queued for the view graph and
+// track builder while matching.
+static const int kMatchQueueCapacity = 1024;
+
 // Add the view to the reconstruction. If the camera intrinsics group id is set
 // to an invalid group id then simply add the view to the reconstruction without
 // shared camera intrinsics.
@@ -154,7 +164,8 @@ ReconstructionBuilder::ReconstructionBuilder(
     std::unique_ptr<ViewGraph> view_graph)
     : options_(options),
       reconstruction_(std::move(reconstruction)),
-      view_graph_(std::move(view_graph)) {
+      view_graph_(std::move(view_graph)),
+      features_and_matches_database_(nullptr) {
   CHECK_GT(options.num_threads, 0);
   options_.reconstruction_estimator_options.rng = options.rng;
 }
@@ -180,9 +191,11 @@ ReconstructionBuilder::ReconstructionBuilder(
   feam_options.num_threads = options_.num_threads;
   feam_options.descriptor_extractor_type = options_.descriptor_type;
   feam_options.feature_density = options_.feature_density;
+  feam_options.keypoint_selection_type = options_.keypoint_selection_type;
   feam_options.min_num_inlier_matches = options_.min_num_inlier_matches;
   feam_options.matching_strategy = options_.matching_strategy;
   feam_options.feature_matcher_options = options_.matching_options;
+  feam_options.feature_matcher_options.rng = options_.rng;
   feam_options.feature_matcher_options.geometric_verification_options
       .min_num_inlier_matches = options_.min_num_inlier_matches;
   feam_options.feature_matcher_options.geometric_verification_options
@@ -269,9 +282,32 @@ bool ReconstructionBuilder::ExtractAndMatchFeatures() {
   // TODO: Remove all references to matches variable and replace with db
   // functions.
 
+  // The matches are added to the view graph and the track builder by a
+  // dedicated thread as they are verified, so that both are complete as soon
+  // as matching finishes. Only the feature indices of the matches are queued
+  // since the tracks are built from the indices.
+  BoundedQueue<ImagePairMatch> match_queue(kMatchQueueCapacity);
+  std::unique_ptr<ThreadPool> match_consumer(new ThreadPool(1));
+  match_consumer->Add(
+      &ReconstructionBuilder::AddStreamedTwoViewMatches, this, &match_queue);
+  feature_extractor_and_matcher_->SetImagePairMatchCallback(
+      [&match_queue](const ImagePairMatch& match) {
+        ImagePairMatch streamed_match;
+        streamed_match.image1 = match.image1;
+        streamed_match.image2 = match.image2;
+        streamed_match.twoview_info = match.twoview_info;
+        streamed_match.feature_indices = match.feature_indices;
+        if (streamed_match.feature_indices.empty()) {
+          streamed_match.correspondences = match.correspondences;
+        }
+        match_queue.Push(std::move(streamed_match));
+      });
+
   // Extract features and obtain the feature matches.
   feature_extractor_and_matcher_->ExtractAndMatchFeatures();
   feature_extractor_and_matcher_.release();
+  match_queue.Close();
+  match_consumer.reset(nullptr);
 
   // Log how many view pairs were geometrically verified.
   const int num_total_view_pairs =
@@ -301,19 +337,56 @@ bool ReconstructionBuilder::ExtractAndMatchFeatures() {
   //
   ///////////////////////////////////
 
-  // Add the matches to the view graph and reconstruction.
+  // Add the matches that were not streamed (e.g., the matches of a previous
+  // run when resuming matching) to the view graph and reconstruction.
   const auto& match_keys =
       features_and_matches_database_->ImageNamesOfMatches();
+  int num_stored_matches = 0;
   for (const auto& match_key : match_keys) {
+    const ViewId view_id1 = reconstruction_->ViewIdFromName(match_key.first);
+    const ViewId view_id2 = reconstruction_->ViewIdFromName(match_key.second);
+    if (view_graph_->HasEdge(view_id1, view_id2)) {
+      continue;
+    }
+
     const ImagePairMatch& match =
         features_and_matches_database_->GetImagePairMatch(match_key.first,
                                                           match_key.second);
     AddTwoViewMatch(match_key.first, match_key.second, match);
+    ++num_stored_matches;
   }
+  VLOG(1) << num_stored_matches
+          << " image pair matches were added from the database.";
 
   return true;
 }
 
+void ReconstructionBuilder::AddStreamedTwoViewMatches(
+    BoundedQueue<ImagePairMatch>* match_queue) {
+  // The feature extractor only matches the calibrated images when
+  // only_calibrated_views is set, so the matches are added without checking
+  // the calibration of the views. The intrinsics priors of the views are not
+  // set until matching has finished.
+  int num_streamed_matches = 0;
+  ImagePairMatch match;
+  while (match_queue->Pop(&match)) {
+    const ViewId view_id1 = reconstruction_->ViewIdFromName(match.image1);
+    const ViewId view_id2 = reconstruction_->ViewIdFromName(match.image2);
+    CHECK_NE(view_id1, kInvalidViewId)
+        << "Tried to add a view with the name " << match.image1
+        << " to the view graph but does not exist in the reconstruction.";
+    CHECK_NE(view_id2, kInvalidViewId)
+        << "Tried to add a view with the name " << match.image2
+        << " to the view graph but does not exist in the reconstruction.";
+
+    AddMatchToViewGraph(view_id1, view_id2, match);
+    AddTracksForMatch(view_id1, view_id2, match);
+    ++num_streamed_matches;
+  }
+  VLOG(1) << num_streamed_matches
+          << " image pair matches were added while matching.";
+}
+
 bool ReconstructionBuilder::AddTwoViewMatch(const std::string& image1,
                                             const std::string& image2,
                                             const ImagePairMatch& matches) {
@@ -354,9 +427,7 @@ bool ReconstructionBuilder::BuildReconstruction(
                                           "reconstruction.";
 
   // Build tracks if they were not explicitly specified.
-  if (reconstruction_->NumTracks() == 0) {
-    track_builder_->BuildTracks(reconstruction_.get());
-  }
+  BuildTracks();
 
   // Remove uncalibrated views from the reconstruction and view graph.
   if (options_.only_calibrated_views) {
@@ -414,6 +485,23 @@ bool ReconstructionBuilder::BuildReconstruction(
   return true;
 }
 
+void ReconstructionBuilder::BuildTracks() {
+  if (reconstruction_->NumTracks() > 0) {
+    return;
+  }
+
+  SetFeaturePositionsForIndexedMatches();
+  track_builder_->BuildTracks(reconstruction_.get());
+}
+
+const Reconstruction& ReconstructionBuilder::GetReconstruction() const {
+  return *reconstruction_;
+}
+
+const ViewGraph& ReconstructionBuilder::GetViewGraph() const {
+  return *view_graph_;
+}
+
 void ReconstructionBuilder::AddMatchToViewGraph(
     const ViewId view_id1,
     const ViewId view_id2,
@@ -432,10 +520,99 @@ void ReconstructionBuilder::AddMatchToViewGraph(
 void ReconstructionBuilder::AddTracksForMatch(const ViewId view_id1,
                                               const ViewId view_id2,
                                               const ImagePairMatch& matches) {
+  // Matches are added by feature index whenever the indices are known so that
+  // the features of streamed and stored matches are identified the same way.
+  // The keypoint positions are loaded from the database once all matches have
+  // been added, right before the tracks are built.
+  if (!matches.feature_indices.empty()) {
+    for (const auto& match : matches.feature_indices) {
+      track_builder_->AddIndexedFeatureCorrespondence(
+          view_id1, match.feature1_ind, view_id2, match.feature2_ind);
+    }
+    return;
+  }
+
+  // Matches without feature indices (e.g. matches that were stored before the
+  // indices were serialized) are resolved to feature indices with the keypoints
+  // of the views. Otherwise a feature that is also matched by index in another
+  // image pair would be added to the track builder as two different features.
+  const std::unordered_map<Feature, uint32_t>* keypoint_indices1 =
+      KeypointIndicesOfView(view_id1);
+  const std::unordered_map<Feature, uint32_t>* keypoint_indices2 =
+      KeypointIndicesOfView(view_id2);
+  int num_unresolved_matches = 0;
   for (const auto& match : matches.correspondences) {
+    const uint32_t* feature_index1 =
+        keypoint_indices1 == nullptr
+            ? nullptr
+            : FindOrNull(*keypoint_indices1, match.feature1);
+    const uint32_t* feature_index2 =
+        keypoint_indices2 == nullptr
+            ? nullptr
+            : FindOrNull(*keypoint_indices2, match.feature2);
+    if (feature_index1 != nullptr && feature_index2 != nullptr) {
+      track_builder_->AddIndexedFeatureCorrespondence(
+          view_id1, *feature_index1, view_id2, *feature_index2);
+      continue;
+    }
+
+    // Features that are not at a keypoint position cannot be matched by index
+    // in any image pair, so they are identified by their position.
     track_builder_->AddFeatureCorrespondence(
         view_id1, match.feature1, view_id2, match.feature2);
+    ++num_unresolved_matches;
+  }
+  if (num_unresolved_matches > 0 && keypoint_indices1 != nullptr &&
+      keypoint_indices2 != nullptr) {
+    LOG(WARNING) << num_unresolved_matches << " matches between "
+                 << reconstruction_->View(view_id1)->Name() << " and "
+                 << reconstruction_->View(view_id2)->Name()
+                 << " do not correspond to keypoints in the database.";
+  }
+}
+
+const std::unordered_map<Feature, uint32_t>*
+ReconstructionBuilder::KeypointIndicesOfView(const ViewId view_id) {
+  const auto& cached_keypoint_indices = keypoint_indices_.find(view_id);
+  if (cached_keypoint_indices != keypoint_indices_.end()) {
+    return &cached_keypoint_indices->second;
   }
+
+  const std::string& image_name = reconstruction_->View(view_id)->Name();
+  if (features_and_matches_database_ == nullptr ||
+      !features_and_matches_database_->ContainsFeatures(image_name)) {
+    return nullptr;
+  }
+
+  // If several keypoints share a position, the first one is used.
+  const std::vector<Keypoint> keypoints =
+      features_and_matches_database_->GetKeypoints(image_name);
+  std::unordered_map<Feature, uint32_t>& keypoint_indices =
+      keypoint_indices_[view_id];
+  keypoint_indices.reserve(keypoints.size());
+  for (uint32_t i = 0; i < keypoints.size(); i++) {
+    keypoint_indices.emplace(Feature(keypoints[i].x(), keypoints[i].y()), i);
+  }
+  return &keypoint_indices;
+}
+
+void ReconstructionBuilder::SetFeaturePositionsForIndexedMatches() {
+  for (const ViewId view_id : track_builder_->ViewsWithIndexedFeatures()) {
+    CHECK_NOTNULL(features_and_matches_database_);
+    const std::string& image_name = reconstruction_->View(view_id)->Name();
+    const std::vector<Keypoint> keypoints =
+        features_and_matches_database_->GetKeypoints(image_name);
+    std::vector<Feature> feature_positions;
+    feature_positions.reserve(keypoints.size());
+    for (const Keypoint& keypoint : keypoints) {
+      feature_positions.emplace_back(keypoint.x(), keypoint.y());
+    }
+    track_builder_->SetFeaturePositions(view_id, feature_positions);
+  }
+
+  // All matches have been added, so the keypoint indices are not needed
+  // anymore.
+  keypoint_indices_.clear();
 }
 
 }  // namespace theia
@@ -36,17 +36,23 @@
 #define THEIA_SFM_RECONSTRUCTION_BUILDER_H_
 
 #include <memory>
+#include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "theia/image/descriptor/create_descriptor_extractor.h"
+#include "theia/image/keypoint_detector/select_keypoints.h"
 #include "theia/matching/create_feature_matcher.h"
 #include "theia/matching/feature_matcher_options.h"
+#include "theia/sfm/feature.h"
 #include "theia/sfm/reconstruction_estimator_options.h"
 #include "theia/sfm/types.h"
 #include "theia/util/util.h"
 
 namespace theia {
+template <typename T>
+class BoundedQueue;
 class FeatureExtractorAndMatcher;
 class FeaturesAndMatchesDatabase;
 class RandomNumberGenerator;
@@ -97,6 +103,12 @@ struct ReconstructionBuilderOptions {
   // extracted.
   FeatureDensity feature_density = FeatureDensity::NORMAL;
 
+  // How to choose which features to keep when an image has more features than
+  // the maximum number of features. See
+  // //theia/image/keypoint_detector/select_keypoints.h
+  KeypointSelectionType keypoint_selection_type =
+      KeypointSelectionType::STRENGTH;
+
   // Keypoints and descriptors are stored to disk as they are added to the
   // FeatureMatcher. Features will be stored in this directory, which must be a
   // valid writeable directory.
@@ -183,6 +195,17 @@ class ReconstructionBuilder {
   // successfully estimated.
   bool BuildReconstruction(std::vector<Reconstruction*>* reconstructions);
 
+  // Builds the tracks from the two view matches that have been added. This is
+  // called by BuildReconstruction if the reconstruction does not contain any
+  // tracks yet, so it only needs to be called to inspect the tracks before the
+  // reconstruction is estimated.
+  void BuildTracks();
+
+  // The views and tracks, and the view graph that the reconstruction is
+  // estimated from.
+  const Reconstruction& GetReconstruction() const;
+  const ViewGraph& GetViewGraph() const;
+
  private:
   // Adds the given matches as edges in the view graph.
   void AddMatchToViewGraph(const ViewId view_id1,
@@ -195,6 +218,20 @@ class ReconstructionBuilder {
                          const ViewId view_id2,
                          const ImagePairMatch& image_matches);
 
+  // Adds the matches popped from the queue to the view graph and the track
+  // builder until the queue is closed and empty.
+  void AddStreamedTwoViewMatches(BoundedQueue<ImagePairMatch>* match_queue);
+
+  // Returns the map from the keypoint positions of the view to the keypoint
+  // indices, which is loaded from the database on first use. Returns nullptr if
+  // the database does not contain the keypoints of the view.
+  const std::unordered_map<Feature, uint32_t>* KeypointIndicesOfView(
+      const ViewId view_id);
+
+  // Loads the keypoint positions of all views whose tracks were added from
+  // feature indices rather than feature positions.
+  void SetFeaturePositionsForIndexedMatches();
+
   // Removes all uncalibrated views from the reconstruction and view graph.
   void RemoveUncalibratedViews();
 
@@ -211,6 +248,11 @@ class ReconstructionBuilder {
   // A DB for storing features and matches.
   FeaturesAndMatchesDatabase* features_and_matches_database_;
 
+  // The keypoint indices of the views with matches that only have feature
+  // positions. They are released once the tracks are built.
+  std::unordered_map<ViewId, std::unordered_map<Feature, uint32_t> >
+      keypoint_indices_;
+
   // Module for performing feature extraction and matching.
   std::unique_ptr<FeatureExtractorAndMatcher> feature_extractor_and_matcher_;
 
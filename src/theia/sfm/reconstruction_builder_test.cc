@@ -0,0 +1,293 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "theia/image/keypoint_detector/keypoint.h"
+#include "theia/matching/feature_correspondence.h"
+#include "theia/matching/image_pair_match.h"
+#include "theia/matching/in_memory_features_and_matches_database.h"
+#include "theia/matching/keypoints_and_descriptors.h"
+#include "theia/sfm/camera_intrinsics_prior.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/reconstruction_builder.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/twoview_info.h"
+#include "theia/sfm/view.h"
+#include "theia/sfm/view_graph/view_graph.h"
+
+namespace theia {
+
+namespace {
+
+// The observations of a track as (view name, feature) pairs.
+typedef std::vector<std::pair<std::string, std::pair<double, double> > >
+    TrackObservations;
+
+// Returns the observations of all tracks so that tracks can be compared
+// independently of their track ids.
+std::set<TrackObservations> GetTrackObservations(
+    const Reconstruction& reconstruction) {
+  std::set<TrackObservations> tracks;
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Track* track = reconstruction.Track(track_id);
+    TrackObservations observations;
+    for (const ViewId view_id : track->ViewIds()) {
+      const View* view = reconstruction.View(view_id);
+      const Feature* feature = view->GetFeature(track_id);
+      observations.emplace_back(view->Name(),
+                                std::make_pair((*feature)[0], (*feature)[1]));
+    }
+    std::sort(observations.begin(), observations.end());
+    tracks.insert(observations);
+  }
+  return tracks;
+}
+
+// Returns the number of verified matches of each edge in the view graph by the
+// names of the views.
+std::map<std::pair<std::string, std::string>, int> GetViewGraphEdges(
+    const Reconstruction& reconstruction, const ViewGraph& view_graph) {
+  std::map<std::pair<std::string, std::string>, int> edges;
+  for (const auto& edge : view_graph.GetAllEdges()) {
+    const std::string& view_name1 =
+        reconstruction.View(edge.first.first)->Name();
+    const std::string& view_name2 =
+        reconstruction.View(edge.first.second)->Name();
+    edges[std::minmax(view_name1, view_name2)] =
+        edge.second.num_verified_matches;
+  }
+  return edges;
+}
+
+void AddKeypoints(const std::string& image_name,
+                  const std::vector<Keypoint>& keypoints,
+                  FeaturesAndMatchesDatabase* database) {
+  KeypointsAndDescriptors features;
+  features.image_name = image_name;
+  features.keypoints = keypoints;
+  features.descriptors.resize(keypoints.size(), Eigen::VectorXf::Zero(128));
+  database->PutFeatures(image_name, features);
+}
+
+}  // namespace
+
+// Matches that were stored with only the feature positions (e.g. by an older
+// version of the database) must be merged with the matches that are stored
+// with feature indices into the same tracks.
+TEST(ReconstructionBuilder, MatchesWithAndWithoutFeatureIndices) {
+  const std::vector<std::string> image_names = {
+    "img1.png", "img2.png", "img3.png"
+  };
+  const std::vector<std::vector<Keypoint> > keypoints = {
+    { Keypoint(10, 11, Keypoint::OTHER), Keypoint(12, 13, Keypoint::OTHER),
+      Keypoint(14, 15, Keypoint::OTHER) },
+    { Keypoint(20, 21, Keypoint::OTHER), Keypoint(22, 23, Keypoint::OTHER),
+      Keypoint(24, 25, Keypoint::OTHER) },
+    { Keypoint(30, 31, Keypoint::OTHER), Keypoint(32, 33, Keypoint::OTHER),
+      Keypoint(34, 35, Keypoint::OTHER) }
+  };
+
+  InMemoryFeaturesAndMatchesDatabase database;
+  for (int i = 0; i < image_names.size(); i++) {
+    AddKeypoints(image_names[i], keypoints[i], &database);
+  }
+
+  ReconstructionBuilderOptions options;
+  options.select_image_pairs_with_global_image_descriptor_matching = false;
+  ReconstructionBuilder reconstruction_builder(options, &database);
+  for (const std::string& image_name : image_names) {
+    EXPECT_TRUE(reconstruction_builder.AddImage(image_name));
+  }
+
+  // The matches between the first two images have feature indices.
+  ImagePairMatch indexed_match;
+  indexed_match.image1 = image_names[0];
+  indexed_match.image2 = image_names[1];
+  indexed_match.feature_indices = { FeatureIndexPair(0, 1),
+                                    FeatureIndexPair(2, 2) };
+  for (const FeatureIndexPair& match : indexed_match.feature_indices) {
+    indexed_match.correspondences.emplace_back(
+        Feature(keypoints[0][match.feature1_ind].x(),
+                keypoints[0][match.feature1_ind].y()),
+        Feature(keypoints[1][match.feature2_ind].x(),
+                keypoints[1][match.feature2_ind].y()));
+  }
+
+  // The matches between the last two images only have feature positions.
+  ImagePairMatch position_match;
+  position_match.image1 = image_names[1];
+  position_match.image2 = image_names[2];
+  position_match.correspondences.emplace_back(Feature(22, 23),
+                                              Feature(30, 31));
+  position_match.correspondences.emplace_back(Feature(24, 25),
+                                              Feature(34, 35));
+
+  EXPECT_TRUE(reconstruction_builder.AddTwoViewMatch(
+      indexed_match.image1, indexed_match.image2, indexed_match));
+  EXPECT_TRUE(reconstruction_builder.AddTwoViewMatch(
+      position_match.image1, position_match.image2, position_match));
+  reconstruction_builder.BuildTracks();
+
+  const std::set<TrackObservations> expected_tracks = {
+    { { "img1.png", { 10, 11 } },
+      { "img2.png", { 22, 23 } },
+      { "img3.png", { 30, 31 } } },
+    { { "img1.png", { 14, 15 } },
+      { "img2.png", { 24, 25 } },
+      { "img3.png", { 34, 35 } } }
+  };
+  EXPECT_EQ(GetTrackObservations(reconstruction_builder.GetReconstruction()),
+            expected_tracks);
+}
+
+// Matching that is resumed from a database with the matches of a previous run
+// only streams the new matches to the view graph and track builder, and the
+// stored matches are added afterwards. The view graph and tracks must be the
+// same as when all matches are added at once.
+TEST(ReconstructionBuilder, ResumeMatchingFromDatabase) {
+  static const int kNumImages = 4;
+  static const int kNumPoints = 100;
+  static const double kFocalLength = 1000.0;
+  static const int kImageSize = 1000;
+
+  // Images of a synthetic scene with a unique descriptor for each 3D point so
+  // that the features are matched perfectly. The images must exist on disk,
+  // but their features are read from the database.
+  std::vector<std::string> image_filepaths(kNumImages);
+  for (int i = 0; i < kNumImages; i++) {
+    image_filepaths[i] = THEIA_DATA_DIR + std::string("/image/img") +
+                         std::to_string(i + 1) + ".png";
+  }
+
+  CameraIntrinsicsPrior intrinsics;
+  intrinsics.image_width = kImageSize;
+  intrinsics.image_height = kImageSize;
+  intrinsics.focal_length.is_set = true;
+  intrinsics.focal_length.value[0] = kFocalLength;
+  intrinsics.principal_point.is_set = true;
+  intrinsics.principal_point.value[0] = kImageSize / 2.0;
+  intrinsics.principal_point.value[1] = kImageSize / 2.0;
+
+  std::vector<Eigen::Vector3d> points(kNumPoints);
+  std::vector<Eigen::VectorXf> descriptors(kNumPoints);
+  for (int i = 0; i < kNumPoints; i++) {
+    points[i] = Eigen::Vector3d::Random() + Eigen::Vector3d(0, 0, 5.0);
+    descriptors[i] = Eigen::VectorXf::Random(128).normalized();
+  }
+
+  InMemoryFeaturesAndMatchesDatabase database;
+  for (int i = 0; i < kNumImages; i++) {
+    const Eigen::Vector3d position(0.5 * i, 0.1 * i, 0.0);
+    KeypointsAndDescriptors features;
+    features.image_name = "img" + std::to_string(i + 1) + ".png";
+    for (int j = 0; j < kNumPoints; j++) {
+      const Eigen::Vector3d point = points[j] - position;
+      features.keypoints.emplace_back(
+          kFocalLength * point.x() / point.z() + kImageSize / 2.0,
+          kFocalLength * point.y() / point.z() + kImageSize / 2.0,
+          Keypoint::OTHER);
+      features.descriptors.emplace_back(descriptors[j]);
+    }
+    database.PutFeatures(features.image_name, features);
+  }
+
+  ReconstructionBuilderOptions options;
+  options.num_threads = 2;
+  options.num_gmm_clusters_for_fisher_vector = 4;
+
+  // A previous run that matched all images but the last one.
+  {
+    ReconstructionBuilder reconstruction_builder(options, &database);
+    for (int i = 0; i < kNumImages - 1; i++) {
+      EXPECT_TRUE(reconstruction_builder.AddImageWithCameraIntrinsicsPrior(
+          image_filepaths[i], intrinsics));
+    }
+    EXPECT_TRUE(reconstruction_builder.ExtractAndMatchFeatures());
+  }
+  const int num_stored_matches = database.NumMatches();
+  EXPECT_GT(num_stored_matches, 0);
+
+  // Resume matching with all images. Only the image pairs with the last image
+  // are matched and streamed.
+  ReconstructionBuilder resumed_reconstruction_builder(options, &database);
+  for (int i = 0; i < kNumImages; i++) {
+    EXPECT_TRUE(
+        resumed_reconstruction_builder.AddImageWithCameraIntrinsicsPrior(
+            image_filepaths[i], intrinsics));
+  }
+  EXPECT_TRUE(resumed_reconstruction_builder.ExtractAndMatchFeatures());
+  EXPECT_GT(database.NumMatches(), num_stored_matches);
+  resumed_reconstruction_builder.BuildTracks();
+
+  // Add all matches of the database at once.
+  ReconstructionBuilder reconstruction_builder(options, &database);
+  for (int i = 0; i < kNumImages; i++) {
+    EXPECT_TRUE(reconstruction_builder.AddImageWithCameraIntrinsicsPrior(
+        image_filepaths[i], intrinsics));
+  }
+  for (const auto& match_key : database.ImageNamesOfMatches()) {
+    EXPECT_TRUE(reconstruction_builder.AddTwoViewMatch(
+        match_key.first,
+        match_key.second,
+        database.GetImagePairMatch(match_key.first, match_key.second)));
+  }
+  reconstruction_builder.BuildTracks();
+
+  const Reconstruction& resumed_reconstruction =
+      resumed_reconstruction_builder.GetReconstruction();
+  const Reconstruction& reconstruction =
+      reconstruction_builder.GetReconstruction();
+  EXPECT_EQ(resumed_reconstruction_builder.GetViewGraph().NumEdges(),
+            database.NumMatches());
+  EXPECT_EQ(
+      GetViewGraphEdges(resumed_reconstruction,
+                        resumed_reconstruction_builder.GetViewGraph()),
+      GetViewGraphEdges(reconstruction, reconstruction_builder.GetViewGraph()));
+
+  EXPECT_GT(resumed_reconstruction.NumTracks(), 0);
+  EXPECT_EQ(GetTrackObservations(resumed_reconstruction),
+            GetTrackObservations(reconstruction));
+}
+
+}  // namespace theia
@@ -199,6 +199,13 @@ struct ReconstructionEstimatorOptions {
   // controls how many views should be part of the partial BA.
   int partial_bundle_adjustment_num_views = 20;
 
+  // If true, the bundle adjustment problems of incremental SfM are kept alive
+  // between calls, one for partial and one for full bundle adjustment. Only the
+  // residuals of views and tracks that enter or leave the optimization are
+  // added or removed between calls, instead of rebuilding the entire problem
+  // for every call.
+  bool reuse_bundle_adjustment_problem = false;
+
   // --------------------- Hybrid SfM Options --------------------- //
 
   // The relative position of the initial pair used for the incremental portion
@@ -245,10 +252,30 @@ struct ReconstructionEstimatorOptions {
   // constant loss when the error values are greater than this.
   double bundle_adjustment_robust_loss_width = 10.0;
 
-  // Use SPARSE_SCHUR for problems smaller than this size and ITERATIVE_SCHUR
-  // for problems larger than this size.
+  // The linear solver of bundle adjustment is selected automatically from the
+  // size and sparsity of each problem. ITERATIVE_SCHUR is used for problems
+  // with at least this many optimized views.
   int min_cameras_for_iterative_solver = 1000;
 
+  // Global SfM bundle adjustment of reconstructions with more views than this
+  // is split into partitions of at most this many views. The partitions are
+  // bundle adjusted separately and coupled through the tracks they share so
+  // that the memory of bundle adjustment is bounded by the largest partition.
+  // See //theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h for
+  // details. A value of 0 disables partitioned bundle adjustment.
+  int max_num_views_per_bundle_adjustment_partition = 0;
+
+  // Options of partitioned bundle adjustment: the number of partitions that
+  // are optimized (and held in memory) at the same time, the maximum number of
+  // rounds in which all partitions are optimized, the relative decrease of the
+  // reprojection cost of a round at which the rounds stop, and the per
+  // observation weight of the consensus term of tracks that are shared between
+  // partitions. See //theia/sfm/bundle_adjustment/partitioned_bundle_adjustment.h
+  int num_bundle_adjustment_partitions_in_parallel = 1;
+  int max_num_partitioned_bundle_adjustment_iterations = 10;
+  double partitioned_bundle_adjustment_function_tolerance = 1e-3;
+  double bundle_adjustment_partition_consensus_penalty = 1.0;
+
   // If accurate calibration is known ahead of time then it is recommended to
   // set the camera intrinsics constant during bundle adjustment. Othewise, you
   // can choose which intrinsics to optimize. See
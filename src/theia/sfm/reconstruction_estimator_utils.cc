@@ -109,7 +109,7 @@ double ComputeResolutionScaledThreshold(const double threshold_pixels,
 // Sets the bundle adjustment options from the reconstruction estimator options.
 BundleAdjustmentOptions SetBundleAdjustmentOptions(
     const ReconstructionEstimatorOptions& options, const int num_views) {
-  static const int kMinViewsForSparseSchur = 150;
+  static const int kMaxViewsForDenseSchur = 150;
 
   BundleAdjustmentOptions ba_options;
   ba_options.num_threads = options.num_threads;
@@ -118,15 +118,16 @@ BundleAdjustmentOptions SetBundleAdjustmentOptions(
   ba_options.use_inner_iterations = true;
   ba_options.intrinsics_to_optimize = options.intrinsics_to_optimize;
 
+  // The linear solver and preconditioner are chosen for each problem from the
+  // views that are actually optimized and the sparsity of the problem.
+  ba_options.automatic_linear_solver_selection = true;
+  ba_options.max_num_views_for_dense_schur = kMaxViewsForDenseSchur;
+  ba_options.min_num_views_for_iterative_schur =
+      options.min_cameras_for_iterative_solver;
   if (num_views >= options.min_cameras_for_iterative_solver) {
-    ba_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
     // NOTE: this is an arbitrary scaling that was found to work well. It may
     // need to change depending on the application.
     ba_options.max_num_iterations *= 1.5;
-  } else if (num_views >= kMinViewsForSparseSchur) {
-    ba_options.linear_solver_type = ceres::SPARSE_SCHUR;
-  } else {
-    ba_options.linear_solver_type = ceres::DENSE_SCHUR;
   }
   ba_options.verbose = VLOG_IS_ON(1);
   return ba_options;
@@ -0,0 +1,539 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/sfm/reconstruction_localizer.h"
+
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/vector.hpp>
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <fstream>  // NOLINT
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "theia/io/eigen_serializable.h"
+#include "theia/matching/distance.h"
+#include "theia/matching/features_and_matches_database.h"
+#include "theia/matching/keypoints_and_descriptors.h"
+#include "theia/sfm/estimators/estimate_calibrated_absolute_pose.h"
+#include "theia/sfm/estimators/estimate_uncalibrated_absolute_pose.h"
+#include "theia/sfm/estimators/feature_correspondence_2d_3d.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/reconstruction_estimator_utils.h"
+#include "theia/util/random.h"
+#include "theia/util/threadpool.h"
+
+namespace theia {
+
+namespace {
+
+// Increment this whenever the on-disk layout of the index changes.
+const int kIndexFileVersion = 1;
+
+// Returns the index of the descriptor with the smallest sum of squared
+// distances to all other descriptors.
+int MedoidDescriptor(const std::vector<Eigen::VectorXf>& descriptors) {
+  L2 distance;
+  int medoid = 0;
+  float min_total_distance = std::numeric_limits<float>::max();
+  for (int i = 0; i < descriptors.size(); i++) {
+    float total_distance = 0;
+    for (int j = 0; j < descriptors.size(); j++) {
+      total_distance += distance(descriptors[i], descriptors[j]);
+    }
+    if (total_distance < min_total_distance) {
+      min_total_distance = total_distance;
+      medoid = i;
+    }
+  }
+  return medoid;
+}
+
+}  // namespace
+
+ReconstructionLocalizer::ReconstructionLocalizer(
+    const ReconstructionLocalizerOptions& options)
+    : options_(options) {
+  CHECK_GT(options_.branching_factor, 1);
+  CHECK_GT(options_.num_levels, 0);
+  CHECK_GT(options_.max_num_matches, 0);
+  CHECK_GT(options_.num_threads, 0);
+}
+
+bool ReconstructionLocalizer::BuildIndex(
+    const Reconstruction& reconstruction,
+    const std::unordered_map<TrackId, std::vector<Eigen::VectorXf> >&
+        track_descriptors) {
+  track_ids_.clear();
+  points_.clear();
+  descriptors_.clear();
+  nodes_.clear();
+  node_centers_.clear();
+  inverted_lists_.clear();
+
+  // Sort the track ids so that the index does not depend on the hash order.
+  std::vector<TrackId> track_ids;
+  track_ids.reserve(track_descriptors.size());
+  for (const auto& track_descriptor : track_descriptors) {
+    track_ids.emplace_back(track_descriptor.first);
+  }
+  std::sort(track_ids.begin(), track_ids.end());
+
+  // Choose a representative descriptor for each estimated track.
+  for (const TrackId track_id : track_ids) {
+    const Track* track = reconstruction.Track(track_id);
+    const std::vector<Eigen::VectorXf>& descriptors =
+        track_descriptors.at(track_id);
+    if (track == nullptr || !track->IsEstimated() || descriptors.empty()) {
+      continue;
+    }
+    track_ids_.emplace_back(track_id);
+    points_.emplace_back(track->Point().hnormalized());
+    descriptors_.emplace_back(descriptors[MedoidDescriptor(descriptors)]);
+  }
+
+  if (track_ids_.empty()) {
+    LOG(ERROR) << "Could not build the localization index because no "
+                  "estimated tracks have descriptors.";
+    return false;
+  }
+
+  // Build the vocabulary tree over the representative descriptors.
+  std::vector<int> point_indices(track_ids_.size());
+  for (int i = 0; i < point_indices.size(); i++) {
+    point_indices[i] = i;
+  }
+  RandomNumberGenerator rng(options_.random_seed);
+  nodes_.emplace_back();
+  node_centers_.emplace_back();
+  BuildTree(0, 0, point_indices, &rng);
+
+  VLOG(2) << "Indexed " << track_ids_.size() << " 3D points in "
+          << inverted_lists_.size() << " visual words.";
+  return true;
+}
+
+void ReconstructionLocalizer::BuildTree(const int node_index,
+                                        const int level,
+                                        const std::vector<int>& point_indices,
+                                        RandomNumberGenerator* rng) {
+  const int num_clusters = options_.branching_factor;
+
+  // Make this node a leaf once the tree is deep enough or there are too few
+  // points left to split.
+  if (level == options_.num_levels || point_indices.size() <= num_clusters) {
+    nodes_[node_index].visual_word = inverted_lists_.size();
+    inverted_lists_.emplace_back(point_indices);
+    return;
+  }
+
+  // Initialize the cluster centers with distinct random points.
+  std::vector<int> shuffled_indices = point_indices;
+  std::vector<Eigen::VectorXf> centers(num_clusters);
+  for (int i = 0; i < num_clusters; i++) {
+    const int j = rng->RandInt(i, shuffled_indices.size() - 1);
+    std::swap(shuffled_indices[i], shuffled_indices[j]);
+    centers[i] = descriptors_[shuffled_indices[i]];
+  }
+
+  // Run Lloyd's algorithm. Empty clusters keep their previous center.
+  L2 distance;
+  std::vector<int> assignments(point_indices.size(), -1);
+  for (int iteration = 0; iteration < options_.max_num_kmeans_iterations;
+       iteration++) {
+    bool assignments_changed = false;
+    for (int i = 0; i < point_indices.size(); i++) {
+      const Eigen::VectorXf& descriptor = descriptors_[point_indices[i]];
+      int nearest_cluster = 0;
+      float min_distance = std::numeric_limits<float>::max();
+      for (int j = 0; j < num_clusters; j++) {
+        const float dist = distance(descriptor, centers[j]);
+        if (dist < min_distance) {
+          min_distance = dist;
+          nearest_cluster = j;
+        }
+      }
+      if (assignments[i] != nearest_cluster) {
+        assignments[i] = nearest_cluster;
+        assignments_changed = true;
+      }
+    }
+    if (!assignments_changed) {
+      break;
+    }
+
+    std::vector<int> cluster_sizes(num_clusters, 0);
+    std::vector<Eigen::VectorXf> sums(
+        num_clusters, Eigen::VectorXf::Zero(centers[0].size()));
+    for (int i = 0; i < point_indices.size(); i++) {
+      sums[assignments[i]] += descriptors_[point_indices[i]];
+      ++cluster_sizes[assignments[i]];
+    }
+    for (int j = 0; j < num_clusters; j++) {
+      if (cluster_sizes[j] > 0) {
+        centers[j] = sums[j] / cluster_sizes[j];
+      }
+    }
+  }
+
+  // Partition the points by cluster and drop the empty clusters.
+  std::vector<std::vector<int> > clusters(num_clusters);
+  for (int i = 0; i < point_indices.size(); i++) {
+    clusters[assignments[i]].emplace_back(point_indices[i]);
+  }
+  std::vector<int> nonempty_clusters;
+  for (int j = 0; j < num_clusters; j++) {
+    if (!clusters[j].empty()) {
+      nonempty_clusters.emplace_back(j);
+    }
+  }
+
+  // Identical descriptors cannot be split any further.
+  if (nonempty_clusters.size() == 1) {
+    nodes_[node_index].visual_word = inverted_lists_.size();
+    inverted_lists_.emplace_back(point_indices);
+    return;
+  }
+
+  // Children are stored contiguously so that a node only needs the range.
+  const int first_child = nodes_.size();
+  nodes_[node_index].first_child = first_child;
+  nodes_[node_index].num_children = nonempty_clusters.size();
+  for (const int cluster : nonempty_clusters) {
+    nodes_.emplace_back();
+    node_centers_.emplace_back(centers[cluster]);
+  }
+  for (int i = 0; i < nonempty_clusters.size(); i++) {
+    BuildTree(first_child + i, level + 1, clusters[nonempty_clusters[i]], rng);
+  }
+}
+
+int ReconstructionLocalizer::Quantize(
+    const Eigen::VectorXf& descriptor) const {
+  L2 distance;
+  int node_index = 0;
+  while (nodes_[node_index].num_children > 0) {
+    const Node& node = nodes_[node_index];
+    int nearest_child = node.first_child;
+    float min_distance = std::numeric_limits<float>::max();
+    for (int i = node.first_child; i < node.first_child + node.num_children;
+         i++) {
+      const float dist = distance(descriptor, node_centers_[i]);
+      if (dist < min_distance) {
+        min_distance = dist;
+        nearest_child = i;
+      }
+    }
+    node_index = nearest_child;
+  }
+  return nodes_[node_index].visual_word;
+}
+
+void ReconstructionLocalizer::MatchDescriptors(
+    const std::vector<Eigen::VectorXf>& descriptors,
+    std::vector<std::pair<int, int> >* matches) const {
+  CHECK_NOTNULL(matches)->clear();
+  if (inverted_lists_.empty()) {
+    return;
+  }
+
+  // Assign each descriptor to a visual word and order the descriptors by the
+  // size of their visual word so that the cheapest searches are done first.
+  std::vector<std::pair<int, int> > search_order;
+  std::vector<int> visual_words(descriptors.size());
+  search_order.reserve(descriptors.size());
+  for (int i = 0; i < descriptors.size(); i++) {
+    visual_words[i] = Quantize(descriptors[i]);
+    search_order.emplace_back(inverted_lists_[visual_words[i]].size(), i);
+  }
+  std::sort(search_order.begin(), search_order.end());
+
+  L2 distance;
+  const float sq_lowes_ratio = options_.lowes_ratio * options_.lowes_ratio;
+  std::vector<bool> point_is_matched(points_.size(), false);
+  for (const auto& search : search_order) {
+    const int feature_index = search.second;
+    const Eigen::VectorXf& descriptor = descriptors[feature_index];
+
+    int best_point = -1;
+    float best_distance = std::numeric_limits<float>::max();
+    float second_best_distance = std::numeric_limits<float>::max();
+    for (const int point_index : inverted_lists_[visual_words[feature_index]]) {
+      const float dist = distance(descriptor, descriptors_[point_index]);
+      if (dist < best_distance) {
+        second_best_distance = best_distance;
+        best_distance = dist;
+        best_point = point_index;
+      } else if (dist < second_best_distance) {
+        second_best_distance = dist;
+      }
+    }
+
+    // Each 3D point may only be matched once. If there is no second nearest
+    // neighbor in the visual word the ratio test trivially passes.
+    if (best_point == -1 || point_is_matched[best_point] ||
+        best_distance >= sq_lowes_ratio * second_best_distance) {
+      continue;
+    }
+    point_is_matched[best_point] = true;
+    matches->emplace_back(feature_index, best_point);
+    if (matches->size() == options_.max_num_matches) {
+      break;
+    }
+  }
+}
+
+bool ReconstructionLocalizer::Localize(const LocalizationQuery& query,
+                                       LocalizationResult* result) const {
+  // The generator of the options may not be drawn from by several threads at
+  // once, so RANSAC draws from a stream derived from the query features. This
+  // also makes the pose of a query independent of earlier calls.
+  const uint64_t stream_id = StreamIdFromString(std::string(
+      reinterpret_cast<const char*>(query.features.data()),
+      sizeof(Feature) * query.features.size()));
+  const std::shared_ptr<RandomNumberGenerator> rng =
+      std::make_shared<RandomNumberGenerator>(
+          options_.ransac_params.rng != nullptr
+              ? options_.ransac_params.rng->Stream(stream_id)
+              : RandomNumberGenerator(options_.random_seed, stream_id));
+  return LocalizeWithRng(query, rng, result);
+}
+
+bool ReconstructionLocalizer::LocalizeWithRng(
+    const LocalizationQuery& query,
+    const std::shared_ptr<RandomNumberGenerator>& rng,
+    LocalizationResult* result) const {
+  CHECK_NOTNULL(result);
+  CHECK_EQ(query.features.size(), query.descriptors.size());
+  result->success = false;
+  result->num_putative_matches = 0;
+  result->inlier_matches.clear();
+
+  Camera& camera = result->camera;
+  camera.SetFromCameraIntrinsicsPriors(query.intrinsics_prior);
+  const bool known_intrinsics = query.intrinsics_prior.focal_length.is_set;
+
+  std::vector<std::pair<int, int> > matches;
+  MatchDescriptors(query.descriptors, &matches);
+  result->num_putative_matches = matches.size();
+  if (matches.size() < options_.min_num_inliers) {
+    VLOG(2) << "Not enough 2D-3D matches (" << matches.size()
+            << ") to localize the query.";
+    return false;
+  }
+
+  // Normalize the features by the intrinsics if they are known, otherwise
+  // only remove the principal point so that the focal length can be
+  // recovered.
+  std::vector<FeatureCorrespondence2D3D> correspondences(matches.size());
+  for (int i = 0; i < matches.size(); i++) {
+    const Feature& feature = query.features[matches[i].first];
+    if (known_intrinsics) {
+      correspondences[i].feature =
+          camera.PixelToNormalizedCoordinates(feature).hnormalized();
+    } else {
+      correspondences[i].feature =
+          feature -
+          Eigen::Vector2d(camera.PrincipalPointX(), camera.PrincipalPointY());
+    }
+    correspondences[i].world_point = points_[matches[i].second];
+  }
+
+  RansacParameters ransac_parameters = options_.ransac_params;
+  ransac_parameters.rng = rng;
+  const double threshold_pixels = ComputeResolutionScaledThreshold(
+      options_.reprojection_error_threshold_pixels,
+      camera.ImageWidth(),
+      camera.ImageHeight());
+  ransac_parameters.error_thresh = threshold_pixels * threshold_pixels;
+
+  RansacSummary summary;
+  if (known_intrinsics) {
+    ransac_parameters.error_thresh /=
+        camera.FocalLength() * camera.FocalLength();
+    CalibratedAbsolutePose pose;
+    if (!EstimateCalibratedAbsolutePose(ransac_parameters,
+                                        RansacType::RANSAC,
+                                        correspondences,
+                                        &pose,
+                                        &summary)) {
+      return false;
+    }
+    camera.SetOrientationFromRotationMatrix(pose.rotation);
+    camera.SetPosition(pose.position);
+  } else {
+    UncalibratedAbsolutePose pose;
+    if (!EstimateUncalibratedAbsolutePose(ransac_parameters,
+                                          RansacType::RANSAC,
+                                          correspondences,
+                                          &pose,
+                                          &summary)) {
+      return false;
+    }
+    camera.SetOrientationFromRotationMatrix(pose.rotation);
+    camera.SetPosition(pose.position);
+    camera.SetFocalLength(pose.focal_length);
+  }
+
+  result->inlier_matches.reserve(summary.inliers.size());
+  for (const int inlier : summary.inliers) {
+    result->inlier_matches.emplace_back(matches[inlier].first,
+                                        track_ids_[matches[inlier].second]);
+  }
+  result->success = summary.inliers.size() >= options_.min_num_inliers;
+  return result->success;
+}
+
+void ReconstructionLocalizer::LocalizeQueries(
+    const std::vector<LocalizationQuery>& queries,
+    std::vector<LocalizationResult>* results) const {
+  CHECK_NOTNULL(results)->resize(queries.size());
+
+  // Each query draws from its own random stream so that the poses do not
+  // depend on which thread localizes the query.
+  const RandomNumberGenerator rng =
+      options_.ransac_params.rng != nullptr
+          ? *options_.ransac_params.rng
+          : RandomNumberGenerator(options_.random_seed);
+
+  // The index is read-only so the queries may be localized independently.
+  ThreadPool pool(std::max(
+      1, std::min(options_.num_threads, static_cast<int>(queries.size()))));
+  for (int i = 0; i < queries.size(); i++) {
+    pool.Add([this, &queries, &rng, results, i]() {
+      LocalizeWithRng(queries[i],
+                      std::make_shared<RandomNumberGenerator>(rng.Stream(i)),
+                      &(*results)[i]);
+    });
+  }
+}
+
+bool ReconstructionLocalizer::WriteIndex(const std::string& filename) const {
+  std::ofstream output_writer(filename, std::ios::out | std::ios::binary);
+  if (!output_writer.is_open()) {
+    LOG(ERROR) << "Could not open the file: " << filename << " for writing.";
+    return false;
+  }
+
+  // Make sure that Cereal is able to finish executing before returning.
+  {
+    cereal::PortableBinaryOutputArchive output_archive(output_writer);
+    output_archive(kIndexFileVersion,
+                   track_ids_,
+                   points_,
+                   descriptors_,
+                   nodes_,
+                   node_centers_,
+                   inverted_lists_);
+  }
+  return true;
+}
+
+bool ReconstructionLocalizer::ReadIndex(const std::string& filename) {
+  std::ifstream input_reader(filename, std::ios::in | std::ios::binary);
+  if (!input_reader.is_open()) {
+    LOG(ERROR) << "Could not open the file: " << filename << " for reading.";
+    return false;
+  }
+
+  // Make sure that Cereal is able to finish executing before returning.
+  {
+    cereal::PortableBinaryInputArchive input_archive(input_reader);
+    int version;
+    input_archive(version);
+    if (version != kIndexFileVersion) {
+      LOG(ERROR) << "The localization index " << filename << " has version "
+                 << version << " but version " << kIndexFileVersion
+                 << " is required.";
+      return false;
+    }
+    input_archive(track_ids_,
+                  points_,
+                  descriptors_,
+                  nodes_,
+                  node_centers_,
+                  inverted_lists_);
+  }
+  return true;
+}
+
+bool GetTrackDescriptorsFromDatabase(
+    const Reconstruction& reconstruction,
+    FeaturesAndMatchesDatabase* features_database,
+    std::unordered_map<TrackId, std::vector<Eigen::VectorXf> >*
+        track_descriptors) {
+  CHECK_NOTNULL(features_database);
+  CHECK_NOTNULL(track_descriptors)->clear();
+
+  for (const ViewId view_id : reconstruction.ViewIds()) {
+    const View* view = reconstruction.View(view_id);
+    if (!features_database->ContainsFeatures(view->Name())) {
+      LOG(ERROR) << "The features of view " << view->Name()
+                 << " are not in the database.";
+      return false;
+    }
+    const KeypointsAndDescriptors features =
+        features_database->GetFeatures(view->Name());
+
+    // Observations were created from the keypoints so their positions match
+    // exactly.
+    std::map<std::pair<double, double>, int> keypoint_indices;
+    for (int i = 0; i < features.keypoints.size(); i++) {
+      keypoint_indices.emplace(
+          std::make_pair(features.keypoints[i].x(), features.keypoints[i].y()),
+          i);
+    }
+
+    for (const TrackId track_id : view->TrackIds()) {
+      const Feature& feature = *view->GetFeature(track_id);
+      const auto keypoint_index =
+          keypoint_indices.find(std::make_pair(feature.x(), feature.y()));
+      if (keypoint_index == keypoint_indices.end()) {
+        continue;
+      }
+      (*track_descriptors)[track_id].emplace_back(
+          features.descriptors[keypoint_index->second]);
+    }
+  }
+  return true;
+}
+
+}  // namespace theia
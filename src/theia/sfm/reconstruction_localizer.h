@@ -0,0 +1,227 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#ifndef THEIA_SFM_RECONSTRUCTION_LOCALIZER_H_
+#define THEIA_SFM_RECONSTRUCTION_LOCALIZER_H_
+
+#include <Eigen/Core>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "theia/alignment/alignment.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/camera_intrinsics_prior.h"
+#include "theia/sfm/feature.h"
+#include "theia/sfm/types.h"
+#include "theia/solvers/sample_consensus_estimator.h"
+
+namespace theia {
+
+class FeaturesAndMatchesDatabase;
+class RandomNumberGenerator;
+class Reconstruction;
+
+struct ReconstructionLocalizerOptions {
+  // The vocabulary tree used to quantize descriptors is built with
+  // hierarchical k-means. Each node is split into branching_factor children
+  // until num_levels levels have been created, giving at most
+  // branching_factor^num_levels leaves (i.e. visual words).
+  int branching_factor = 10;
+  int num_levels = 3;
+  int max_num_kmeans_iterations = 10;
+
+  // Seed for the k-means initialization so that the index is reproducible.
+  unsigned random_seed = 181;
+
+  // A query feature is matched to the nearest 3D point in its visual word only
+  // if it passes the Lowe's ratio test against the second nearest point.
+  float lowes_ratio = 0.8;
+
+  // Query features are matched in order of increasing visual word size (the
+  // cheapest and most distinctive first) and matching stops once this many
+  // 2D-3D matches have been found.
+  int max_num_matches = 200;
+
+  // The reprojection error threshold that determines whether a 2D-3D
+  // correspondence is an inlier. As in LocalizeViewToReconstruction, this is
+  // relative to an image that is 1024 pixels wide.
+  double reprojection_error_threshold_pixels = 4.0;
+
+  // The RANSAC parameters used for pose estimation. The error threshold is
+  // overridden by reprojection_error_threshold_pixels. The generator rng is
+  // never drawn from; each query draws from its own stream of it instead.
+  RansacParameters ransac_params;
+
+  // The minimum number of RANSAC inliers for a query to be localized.
+  int min_num_inliers = 15;
+
+  // The number of threads used by LocalizeQueries.
+  int num_threads = 1;
+};
+
+// A query image to localize. The intrinsics prior must contain the image size.
+// If the focal length is set then the calibrated pose is estimated with P3P,
+// otherwise the focal length is recovered as well with P4Pf.
+struct LocalizationQuery {
+  CameraIntrinsicsPrior intrinsics_prior;
+  std::vector<Feature> features;
+  std::vector<Eigen::VectorXf> descriptors;
+};
+
+struct LocalizationResult {
+  bool success = false;
+
+  // The localized camera. Only the intrinsics are valid if localization fails.
+  Camera camera;
+
+  // The number of 2D-3D matches found by descriptor matching.
+  int num_putative_matches = 0;
+
+  // The RANSAC inliers as (query feature index, track id) pairs.
+  std::vector<std::pair<int, TrackId> > inlier_matches;
+};
+
+// Localizes a stream of query images against a fixed reconstruction with
+// direct 2D-3D matching. Each estimated track is represented by a single
+// descriptor (the medoid of the descriptors of its observations) and the
+// representative descriptors are indexed with a vocabulary tree whose leaves
+// hold inverted lists of 3D points. A query descriptor is quantized to a leaf
+// and linearly matched against the points in that leaf, with the smallest
+// leaves searched first so that matching can terminate early. The pose is then
+// estimated with RANSAC.
+//
+// Once built, the index is read-only and may be queried from multiple threads.
+// It may be written to disk and reloaded without the reconstruction.
+class ReconstructionLocalizer {
+ public:
+  explicit ReconstructionLocalizer(
+      const ReconstructionLocalizerOptions& options);
+  ~ReconstructionLocalizer() {}
+
+  // Builds the index from the estimated tracks of the reconstruction.
+  // track_descriptors holds the descriptors of the observations of each track;
+  // tracks that are not estimated or have no descriptors are not indexed.
+  // Returns false if no tracks could be indexed.
+  bool BuildIndex(
+      const Reconstruction& reconstruction,
+      const std::unordered_map<TrackId, std::vector<Eigen::VectorXf> >&
+          track_descriptors);
+
+  // Localizes a single query. Returns true if the pose was estimated with at
+  // least min_num_inliers inliers. RANSAC draws from the stream of
+  // ransac_params.rng (or of random_seed if no generator is given) that is
+  // given by a hash of the query features, so the generator of the options is
+  // never drawn from and this method may be called from several threads.
+  bool Localize(const LocalizationQuery& query,
+                LocalizationResult* result) const;
+
+  // Localizes all queries in parallel with options.num_threads threads. The
+  // RANSAC of query i draws from stream i of ransac_params.rng (or of
+  // random_seed if no generator is given), so the results do not depend on the
+  // number of threads.
+  void LocalizeQueries(const std::vector<LocalizationQuery>& queries,
+                       std::vector<LocalizationResult>* results) const;
+
+  // Finds the 2D-3D matches for the query descriptors as (query feature index,
+  // index into the indexed points) pairs.
+  void MatchDescriptors(const std::vector<Eigen::VectorXf>& descriptors,
+                        std::vector<std::pair<int, int> >* matches) const;
+
+  // Writes the index to or reads it from a binary file. Reading an index
+  // replaces the current one but keeps the matching and pose options.
+  bool WriteIndex(const std::string& filename) const;
+  bool ReadIndex(const std::string& filename);
+
+  int NumIndexedPoints() const { return track_ids_.size(); }
+  int NumVisualWords() const { return inverted_lists_.size(); }
+
+ private:
+  // A node of the vocabulary tree. Interior nodes store the range of their
+  // children in nodes_ while leaves store the index of their inverted list.
+  struct Node {
+    int first_child = -1;
+    int num_children = 0;
+    int visual_word = -1;
+
+    template <class Archive>
+    void serialize(Archive& ar) {  // NOLINT
+      ar(first_child, num_children, visual_word);
+    }
+  };
+
+  // Recursively clusters the descriptors of the given points under node_index.
+  void BuildTree(const int node_index,
+                 const int level,
+                 const std::vector<int>& point_indices,
+                 RandomNumberGenerator* rng);
+
+  // Localizes the query with the given random number generator for RANSAC.
+  bool LocalizeWithRng(const LocalizationQuery& query,
+                       const std::shared_ptr<RandomNumberGenerator>& rng,
+                       LocalizationResult* result) const;
+
+  // Descends the tree to find the visual word of the descriptor.
+  int Quantize(const Eigen::VectorXf& descriptor) const;
+
+  const ReconstructionLocalizerOptions options_;
+
+  // The indexed 3D points and their representative descriptors.
+  std::vector<TrackId> track_ids_;
+  std::vector<Eigen::Vector3d> points_;
+  std::vector<Eigen::VectorXf> descriptors_;
+
+  // The vocabulary tree. node_centers_[i] is the cluster center of nodes_[i];
+  // the root (node 0) has no meaningful center.
+  std::vector<Node> nodes_;
+  std::vector<Eigen::VectorXf> node_centers_;
+  std::vector<std::vector<int> > inverted_lists_;
+};
+
+// Collects the descriptors of every track observation from the features
+// database, which must contain the features of each view in the
+// reconstruction (keyed by view name). Observations are associated to
+// keypoints by their exact image position. Returns false if the features of a
+// view are missing.
+bool GetTrackDescriptorsFromDatabase(
+    const Reconstruction& reconstruction,
+    FeaturesAndMatchesDatabase* features_database,
+    std::unordered_map<TrackId, std::vector<Eigen::VectorXf> >*
+        track_descriptors);
+
+}  // namespace theia
+
+#endif  // THEIA_SFM_RECONSTRUCTION_LOCALIZER_H_
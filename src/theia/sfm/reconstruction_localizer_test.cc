@@ -0,0 +1,303 @@
+// Copyright (C) 2016 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/reconstruction_localizer.h"
+#include "theia/util/random.h"
+#include "theia/util/threadpool.h"
+
+namespace theia {
+namespace {
+
+static const int kDescriptorDimension = 32;
+static const int kNumPoints = 500;
+static const int kImageWidth = 1000;
+static const int kImageHeight = 800;
+static const double kFocalLength = 800;
+
+RandomNumberGenerator rng(57);
+
+Eigen::VectorXf RandomUnitDescriptor() {
+  Eigen::VectorXf descriptor(kDescriptorDimension);
+  rng.SetRandom(&descriptor);
+  return descriptor.normalized();
+}
+
+Eigen::VectorXf PerturbDescriptor(const Eigen::VectorXf& descriptor) {
+  Eigen::VectorXf noise(kDescriptorDimension);
+  rng.SetRandom(&noise);
+  return (descriptor + 0.02 * noise).normalized();
+}
+
+// Builds a reconstruction with random 3D points in front of the origin and a
+// few noisy observation descriptors for each point.
+void BuildScene(
+    Reconstruction* reconstruction,
+    std::unordered_map<TrackId, std::vector<Eigen::VectorXf> >*
+        track_descriptors) {
+  for (int i = 0; i < kNumPoints; i++) {
+    const TrackId track_id = reconstruction->AddTrack();
+    Track* track = reconstruction->MutableTrack(track_id);
+    *track->MutablePoint() =
+        Eigen::Vector3d(rng.RandDouble(-2.0, 2.0),
+                        rng.RandDouble(-2.0, 2.0),
+                        rng.RandDouble(4.0, 8.0)).homogeneous();
+    track->SetEstimated(true);
+
+    const Eigen::VectorXf descriptor = RandomUnitDescriptor();
+    for (int j = 0; j < 3; j++) {
+      (*track_descriptors)[track_id].emplace_back(
+          PerturbDescriptor(descriptor));
+    }
+  }
+}
+
+// Creates a query that observes every point of the reconstruction from the
+// given camera along with some unmatchable clutter features.
+LocalizationQuery CreateQuery(
+    const Reconstruction& reconstruction,
+    const std::unordered_map<TrackId, std::vector<Eigen::VectorXf> >&
+        track_descriptors,
+    const Camera& camera,
+    const bool known_focal_length) {
+  LocalizationQuery query;
+  query.intrinsics_prior.image_width = kImageWidth;
+  query.intrinsics_prior.image_height = kImageHeight;
+  if (known_focal_length) {
+    query.intrinsics_prior.focal_length.is_set = true;
+    query.intrinsics_prior.focal_length.value[0] = kFocalLength;
+  }
+
+  // The features of the points are in the order of the track ids so that
+  // query feature i observes track i.
+  std::vector<TrackId> track_ids = reconstruction.TrackIds();
+  std::sort(track_ids.begin(), track_ids.end());
+  for (const TrackId track_id : track_ids) {
+    Feature feature;
+    camera.ProjectPoint(reconstruction.Track(track_id)->Point(), &feature);
+    query.features.emplace_back(feature);
+    query.descriptors.emplace_back(
+        PerturbDescriptor(track_descriptors.at(track_id)[0]));
+  }
+  for (int i = 0; i < 100; i++) {
+    query.features.emplace_back(rng.RandDouble(0, kImageWidth),
+                                rng.RandDouble(0, kImageHeight));
+    query.descriptors.emplace_back(RandomUnitDescriptor());
+  }
+  return query;
+}
+
+Camera QueryCamera() {
+  Camera camera;
+  camera.SetImageSize(kImageWidth, kImageHeight);
+  camera.SetFocalLength(kFocalLength);
+  camera.SetPrincipalPoint(kImageWidth / 2.0, kImageHeight / 2.0);
+  camera.SetOrientationFromAngleAxis(Eigen::Vector3d(0.05, -0.1, 0.02));
+  camera.SetPosition(Eigen::Vector3d(0.3, -0.2, 0.5));
+  return camera;
+}
+
+ReconstructionLocalizerOptions LocalizerOptions() {
+  ReconstructionLocalizerOptions options;
+  options.branching_factor = 4;
+  options.num_levels = 3;
+  options.reprojection_error_threshold_pixels = 2.0;
+  options.ransac_params.rng = std::make_shared<RandomNumberGenerator>(59);
+  return options;
+}
+
+void TestLocalization(const bool known_focal_length) {
+  Reconstruction reconstruction;
+  std::unordered_map<TrackId, std::vector<Eigen::VectorXf> > track_descriptors;
+  BuildScene(&reconstruction, &track_descriptors);
+
+  ReconstructionLocalizer localizer(LocalizerOptions());
+  ASSERT_TRUE(localizer.BuildIndex(reconstruction, track_descriptors));
+  EXPECT_EQ(localizer.NumIndexedPoints(), kNumPoints);
+  EXPECT_GT(localizer.NumVisualWords(), 1);
+
+  const Camera camera = QueryCamera();
+  const LocalizationQuery query = CreateQuery(
+      reconstruction, track_descriptors, camera, known_focal_length);
+
+  LocalizationResult result;
+  EXPECT_TRUE(localizer.Localize(query, &result));
+  EXPECT_GE(result.inlier_matches.size(), 50);
+  for (const auto& inlier_match : result.inlier_matches) {
+    // Every query feature before the clutter observes the track with the same
+    // index.
+    EXPECT_EQ(inlier_match.first, inlier_match.second);
+  }
+  EXPECT_LT((result.camera.GetPosition() - camera.GetPosition()).norm(), 1e-4);
+  EXPECT_LT((result.camera.GetOrientationAsAngleAxis() -
+             camera.GetOrientationAsAngleAxis()).norm(),
+            1e-4);
+  EXPECT_NEAR(result.camera.FocalLength(), kFocalLength, 1e-2);
+}
+
+TEST(ReconstructionLocalizer, LocalizeCalibratedQuery) {
+  TestLocalization(true);
+}
+
+TEST(ReconstructionLocalizer, LocalizeUncalibratedQuery) {
+  TestLocalization(false);
+}
+
+TEST(ReconstructionLocalizer, PrioritizedSearchStopsAtMaxNumMatches) {
+  Reconstruction reconstruction;
+  std::unordered_map<TrackId, std::vector<Eigen::VectorXf> > track_descriptors;
+  BuildScene(&reconstruction, &track_descriptors);
+
+  ReconstructionLocalizerOptions options = LocalizerOptions();
+  options.max_num_matches = 40;
+  ReconstructionLocalizer localizer(options);
+  ASSERT_TRUE(localizer.BuildIndex(reconstruction, track_descriptors));
+
+  const LocalizationQuery query = CreateQuery(
+      reconstruction, track_descriptors, QueryCamera(), true);
+  std::vector<std::pair<int, int> > matches;
+  localizer.MatchDescriptors(query.descriptors, &matches);
+  EXPECT_EQ(matches.size(), options.max_num_matches);
+}
+
+TEST(ReconstructionLocalizer, WriteAndReadIndex) {
+  static const std::string kIndexFile =
+      THEIA_DATA_DIR + std::string("/reconstruction_localizer_index.bin");
+
+  Reconstruction reconstruction;
+  std::unordered_map<TrackId, std::vector<Eigen::VectorXf> > track_descriptors;
+  BuildScene(&reconstruction, &track_descriptors);
+
+  ReconstructionLocalizer localizer(LocalizerOptions());
+  ASSERT_TRUE(localizer.BuildIndex(reconstruction, track_descriptors));
+  ASSERT_TRUE(localizer.WriteIndex(kIndexFile));
+
+  ReconstructionLocalizer read_localizer(LocalizerOptions());
+  ASSERT_TRUE(read_localizer.ReadIndex(kIndexFile));
+  std::remove(kIndexFile.c_str());
+  EXPECT_EQ(read_localizer.NumIndexedPoints(), localizer.NumIndexedPoints());
+  EXPECT_EQ(read_localizer.NumVisualWords(), localizer.NumVisualWords());
+
+  // The loaded index must produce identical matches.
+  const LocalizationQuery query = CreateQuery(
+      reconstruction, track_descriptors, QueryCamera(), true);
+  std::vector<std::pair<int, int> > matches, read_matches;
+  localizer.MatchDescriptors(query.descriptors, &matches);
+  read_localizer.MatchDescriptors(query.descriptors, &read_matches);
+  EXPECT_EQ(matches, read_matches);
+}
+
+TEST(ReconstructionLocalizer, LocalizeQueriesInParallel) {
+  Reconstruction reconstruction;
+  std::unordered_map<TrackId, std::vector<Eigen::VectorXf> > track_descriptors;
+  BuildScene(&reconstruction, &track_descriptors);
+
+  ReconstructionLocalizerOptions options = LocalizerOptions();
+  options.num_threads = 4;
+  ReconstructionLocalizer localizer(options);
+  ASSERT_TRUE(localizer.BuildIndex(reconstruction, track_descriptors));
+
+  std::vector<LocalizationQuery> queries;
+  std::vector<Camera> cameras;
+  for (int i = 0; i < 8; i++) {
+    Camera camera = QueryCamera();
+    camera.SetPosition(0.1 * rng.RandVector3d());
+    cameras.emplace_back(camera);
+    queries.emplace_back(
+        CreateQuery(reconstruction, track_descriptors, camera, true));
+  }
+
+  std::vector<LocalizationResult> results;
+  localizer.LocalizeQueries(queries, &results);
+  ASSERT_EQ(results.size(), queries.size());
+  for (int i = 0; i < results.size(); i++) {
+    EXPECT_TRUE(results[i].success);
+    EXPECT_LT(
+        (results[i].camera.GetPosition() - cameras[i].GetPosition()).norm(),
+        1e-4);
+  }
+}
+
+TEST(ReconstructionLocalizer, LocalizeFromSeveralThreads) {
+  Reconstruction reconstruction;
+  std::unordered_map<TrackId, std::vector<Eigen::VectorXf> > track_descriptors;
+  BuildScene(&reconstruction, &track_descriptors);
+
+  const ReconstructionLocalizerOptions options = LocalizerOptions();
+  RandomNumberGenerator options_rng = *options.ransac_params.rng;
+  ReconstructionLocalizer localizer(options);
+  ASSERT_TRUE(localizer.BuildIndex(reconstruction, track_descriptors));
+
+  std::vector<LocalizationQuery> queries;
+  for (int i = 0; i < 8; i++) {
+    Camera camera = QueryCamera();
+    camera.SetPosition(0.1 * rng.RandVector3d());
+    queries.emplace_back(
+        CreateQuery(reconstruction, track_descriptors, camera, true));
+  }
+
+  std::vector<LocalizationResult> results(queries.size());
+  {
+    ThreadPool pool(4);
+    for (int i = 0; i < queries.size(); i++) {
+      pool.Add([&localizer, &queries, &results, i]() {
+        localizer.Localize(queries[i], &results[i]);
+      });
+    }
+  }
+
+  // The generator of the options is not drawn from, and a query gives the same
+  // result no matter when or on which thread it is localized.
+  EXPECT_EQ(options.ransac_params.rng->RandBits(), options_rng.RandBits());
+  for (int i = 0; i < queries.size(); i++) {
+    LocalizationResult result;
+    EXPECT_TRUE(localizer.Localize(queries[i], &result));
+    EXPECT_TRUE(results[i].success);
+    EXPECT_EQ(results[i].inlier_matches, result.inlier_matches);
+    EXPECT_EQ(results[i].camera.GetPosition(), result.camera.GetPosition());
+  }
+}
+
+}  // namespace
+}  // namespace theia
@@ -34,8 +34,12 @@
 
 #include "theia/sfm/select_good_tracks_for_bundle_adjustment.h"
 
+#include <glog/logging.h>
 #include <algorithm>
-#include <unordered_map>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -47,22 +51,54 @@
 #include "theia/sfm/types.h"
 #include "theia/sfm/view.h"
 #include "theia/util/hash.h"
-#include "theia/util/map_util.h"
+#include "theia/util/threadpool.h"
 
 namespace theia {
 namespace {
 // Track statistics are the track length and mean reprojection error.
-typedef std::pair<int, double> TrackStatistics;
+typedef TrackStatisticsCache::TrackStatistics TrackStatistics;
 typedef std::pair<TrackId, TrackStatistics> GridCellElement;
-typedef std::unordered_map<Eigen::Vector2i, std::vector<GridCellElement> >
-    ImageGrid;
+
+// The (column, row) index of a cell of the image grid.
+typedef std::pair<int, int> GridCell;
+
+// An observation of an estimated track in a view along with the image grid cell
+// that the feature falls into.
+struct TrackObservation {
+  TrackId track_id;
+  GridCell grid_cell;
+};
 
 // Sorts the grid cell elements by the track statistics, which will sort first
-// by the (truncated) track length, then by the mean reprojection error.
-bool CompareGridCellElements(
-    const std::pair<TrackId, TrackStatistics>& element1,
-    const std::pair<TrackId, TrackStatistics>& element2) {
-  return element1.second < element2.second;
+// by the (truncated) track length, then by the mean reprojection error. Ties
+// are broken by the TrackId so that the selection does not depend on the order
+// in which the tracks are visited.
+bool CompareGridCellElements(const GridCellElement& element1,
+                             const GridCellElement& element2) {
+  if (element1.second != element2.second) {
+    return element1.second < element2.second;
+  }
+  return element1.first < element2.first;
+}
+
+// Splits the range [0, num_items) into one block per thread and runs
+// process_block(start, end) on each block in a thread pool.
+void ProcessBlocksInParallel(
+    const int num_threads,
+    const int num_items,
+    const std::function<void(const int, const int)>& process_block) {
+  const int num_blocks = std::max(1, std::min(num_threads, num_items));
+  if (num_blocks == 1) {
+    process_block(0, num_items);
+    return;
+  }
+
+  ThreadPool pool(num_blocks);
+  for (int i = 0; i < num_blocks; i++) {
+    const int start = i * num_items / num_blocks;
+    const int end = (i + 1) * num_items / num_blocks;
+    pool.Add(process_block, start, end);
+  }
 }
 
 // Return the squared reprojection error of the track in the view.
@@ -107,58 +143,54 @@ TrackStatistics ComputeStatisticsForTrack(
   return TrackStatistics(truncated_track_length, mean_sq_reprojection_error);
 }
 
-// Compute the mean reprojection error and the truncated track length of each
-// track. We truncate the track length based on the observation that while
-// larger track lengths provide better constraints for bundle adjustment, larger
-// tracks are also more likely to contain outliers in our experience. Truncating
-// the track lengths enforces that the long tracks with the lowest reprojection
-// error are chosen.
-void ComputeTrackStatistics(
-    const Reconstruction& reconstruction,
-    const std::unordered_set<ViewId>& view_ids,
-    const int long_track_length_threshold,
-    std::unordered_map<TrackId, TrackStatistics>* track_statistics) {
-  // Iterate over all views and compute the track statistics for each track we
-  // encounter.
-  for (const ViewId view_id : view_ids) {
-    const View* view = reconstruction.View(view_id);
-    const auto& tracks_in_view = view->TrackIds();
-    // Compute statistics for each track in this view that we have not already
-    // computed statistics for.
-    for (const TrackId track_id : tracks_in_view) {
-      const Track* track = reconstruction.Track(track_id);
-      // Skip this track if the statistics were already computed, or if the
-      // track has not been estimated.
-      if (ContainsKey(*track_statistics, track_id) || track == nullptr ||
-          !track->IsEstimated()) {
-        continue;
-      }
+// Returns a fingerprint of all camera parameters of the view. A fingerprint is
+// never 0.
+uint64_t ComputeViewFingerprint(const View& view) {
+  const Camera& camera = view.Camera();
+  size_t seed = static_cast<size_t>(camera.GetCameraIntrinsicsModelType());
+  for (int i = 0; i < Camera::kExtrinsicsSize; i++) {
+    std::HashCombine(camera.extrinsics()[i], &seed);
+  }
+  const int num_intrinsics = camera.CameraIntrinsics()->NumParameters();
+  for (int i = 0; i < num_intrinsics; i++) {
+    std::HashCombine(camera.intrinsics()[i], &seed);
+  }
+  return seed == 0 ? 1 : seed;
+}
 
-      // Compute the track statistics and add it to the output map.
-      const TrackStatistics& statistics_for_this_track =
-          ComputeStatisticsForTrack(reconstruction,
-                                    track_id,
-                                    long_track_length_threshold);
-      track_statistics->emplace(track_id, statistics_for_this_track);
+// Returns a fingerprint of the point of the track and of the cameras of the
+// estimated views observing it. The views are combined independently of the
+// order in which they are visited. A fingerprint is never 0.
+uint64_t ComputeTrackFingerprint(
+    const Track& track, const std::vector<uint64_t>& view_fingerprints) {
+  size_t seed = std::hash<Eigen::Vector4d>()(track.Point());
+  size_t views_seed = 0;
+  for (const ViewId view_id : track.ViewIds()) {
+    if (view_id >= view_fingerprints.size() ||
+        view_fingerprints[view_id] == 0) {
+      continue;
     }
+    size_t view_seed = view_fingerprints[view_id];
+    std::HashCombine(view_id, &view_seed);
+    views_seed += view_seed;
   }
+  std::HashCombine(views_seed, &seed);
+  return seed == 0 ? 1 : seed;
 }
 
-// Select tracks from the image to ensure good spatial coverage of the image. To
-// do this, we first bin the tracks into grid cells in an image grid. Then
-// within each cell we find the best ranked track and add it to the list of
-// tracks to optimize.
-void SelectBestTracksFromEachImageGridCell(
+// Gathers the estimated tracks observed in the view and hashes each feature
+// into a grid cell of an image grid where each cell is the provided width.
+// Features outside of the image (e.g. with negative coordinates) fall into
+// their own grid cells outside of the image.
+void GetTrackObservationsInView(
     const Reconstruction& reconstruction,
     const View& view,
     const int grid_cell_size,
-    const std::unordered_map<TrackId, TrackStatistics>& track_statistics,
-    std::unordered_set<TrackId>* tracks_to_optimize) {
-  static const double inv_grid_cell_size =  1.0 / grid_cell_size;
+    std::vector<TrackObservation>* observations) {
+  const double inv_grid_cell_size = 1.0 / grid_cell_size;
 
-  // Hash each feature into a grid cell.
-  ImageGrid image_grid;
   const auto& track_ids = view.TrackIds();
+  observations->reserve(track_ids.size());
   for (const TrackId track_id : track_ids) {
     const Track* track = reconstruction.Track(track_id);
     if (track == nullptr || !track->IsEstimated()) {
@@ -166,53 +198,69 @@ void SelectBestTracksFromEachImageGridCell(
     }
 
     const Feature& feature = *view.GetFeature(track_id);
-    const TrackStatistics& current_track_statistics =
-        FindOrDieNoPrint(track_statistics, track_id);
-    const Eigen::Vector2i grid_cell =
-        (feature * inv_grid_cell_size).cast<int>();
+    const GridCell grid_cell(
+        static_cast<int>(std::floor(feature.x() * inv_grid_cell_size)),
+        static_cast<int>(std::floor(feature.y() * inv_grid_cell_size)));
+    observations->emplace_back(TrackObservation{track_id, grid_cell});
+  }
+}
 
-    image_grid[grid_cell].emplace_back(track_id, current_track_statistics);
+// Select tracks from the image to ensure good spatial coverage of the image. To
+// do this, we sort the tracks by their grid cell in the image grid and then by
+// rank. The first track of each grid cell is then the best ranked track of the
+// cell and is added to the list of tracks to optimize.
+void SelectBestTracksFromEachImageGridCell(
+    const std::vector<TrackObservation>& observations,
+    const TrackStatisticsCache& track_statistics,
+    std::vector<std::pair<GridCell, GridCellElement> >* grid_cell_elements,
+    std::vector<TrackId>* tracks_to_optimize) {
+  grid_cell_elements->clear();
+  for (const TrackObservation& observation : observations) {
+    grid_cell_elements->emplace_back(
+        observation.grid_cell,
+        GridCellElement(observation.track_id,
+                        track_statistics.Statistics(observation.track_id)));
   }
 
+  // Order the features in each cell by track length first, then mean
+  // reprojection error.
+  std::sort(grid_cell_elements->begin(),
+            grid_cell_elements->end(),
+            [](const std::pair<GridCell, GridCellElement>& element1,
+               const std::pair<GridCell, GridCellElement>& element2) {
+              if (element1.first != element2.first) {
+                return element1.first < element2.first;
+              }
+              return CompareGridCellElements(element1.second,
+                                             element2.second);
+            });
+
   // Select the best feature from each grid cell and add it to the tracks to
   // optimize.
-  for (auto& grid_cell : image_grid) {
-    // Order the features in each cell by track length first, then mean
-    // reprojection error.
-    const GridCellElement& grid_cell_element =
-        *std::min_element(grid_cell.second.begin(),
-                          grid_cell.second.end(),
-                          CompareGridCellElements);
-
-    // Insert the track id in to the tracks to optimize.
-    tracks_to_optimize->emplace(grid_cell_element.first);
+  for (int i = 0; i < grid_cell_elements->size(); i++) {
+    if (i == 0 ||
+        (*grid_cell_elements)[i].first != (*grid_cell_elements)[i - 1].first) {
+      tracks_to_optimize->emplace_back((*grid_cell_elements)[i].second.first);
+    }
   }
 }
 
 // Selects the top ranked tracks that have not already been chosen until the
 // view observes the minimum number of optimized tracks.
 void SelectTopRankedTracksInView(
-    const Reconstruction& reconstruction,
-    const std::unordered_map<TrackId, TrackStatistics>& track_statistics,
-    const View& view,
+    const TrackStatisticsCache& track_statistics,
+    const std::vector<TrackObservation>& observations,
     const int min_num_optimized_tracks_per_view,
-    std::unordered_set<TrackId>* tracks_to_optimize) {
+    std::vector<GridCellElement>* ranked_candidate_tracks,
+    std::vector<bool>* tracks_to_optimize) {
   int num_optimized_tracks = 0;
-  int num_estimated_tracks = 0;
-
-  const auto& tracks_in_view = view.TrackIds();
-  std::vector<GridCellElement> ranked_candidate_tracks;
-  for (const TrackId track_id : tracks_in_view) {
-    const Track* track = reconstruction.Track(track_id);
-    if (track == nullptr || !track->IsEstimated()) {
-      continue;
-    }
-    // We only reach this point if the track is estimated.
-    ++num_estimated_tracks;
+  const int num_estimated_tracks = observations.size();
 
+  ranked_candidate_tracks->clear();
+  for (const TrackObservation& observation : observations) {
     // If the track is already slated for optimization, increase the count of
     // optimized features.
-    if (ContainsKey(*tracks_to_optimize, track_id)) {
+    if ((*tracks_to_optimize)[observation.track_id]) {
       ++num_optimized_tracks;
       // If the number of optimized_tracks is greater than the minimum then we
       // can return early since we know that no more features need to added for
@@ -223,8 +271,9 @@ void SelectTopRankedTracksInView(
     } else {
       // If the track is not already set to be optimized then add it to the list
       // of candidate tracks.
-      ranked_candidate_tracks.emplace_back(
-          track_id, FindOrDieNoPrint(track_statistics, track_id));
+      ranked_candidate_tracks->emplace_back(
+          observation.track_id,
+          track_statistics.Statistics(observation.track_id));
     }
   }
 
@@ -238,18 +287,77 @@ void SelectTopRankedTracksInView(
         std::min(min_num_optimized_tracks_per_view - num_optimized_tracks,
                  num_estimated_tracks - num_optimized_tracks);
     std::partial_sort(
-        ranked_candidate_tracks.begin(),
-        ranked_candidate_tracks.begin() + num_optimized_tracks_needed,
-        ranked_candidate_tracks.end());
+        ranked_candidate_tracks->begin(),
+        ranked_candidate_tracks->begin() + num_optimized_tracks_needed,
+        ranked_candidate_tracks->end(),
+        CompareGridCellElements);
     // Add the candidate tracks to the list of tracks to be optimized.
     for (int i = 0; i < num_optimized_tracks_needed; i++) {
-      tracks_to_optimize->emplace(ranked_candidate_tracks[i].first);
+      (*tracks_to_optimize)[(*ranked_candidate_tracks)[i].first] = true;
     }
   }
 }
 
 }  // namespace
 
+void TrackStatisticsCache::Update(const Reconstruction& reconstruction,
+                                  const std::vector<TrackId>& track_ids,
+                                  const int long_track_length_threshold,
+                                  const int num_threads) {
+  // The truncated track lengths depend on the threshold.
+  if (long_track_length_threshold != long_track_length_threshold_) {
+    std::fill(track_fingerprints_.begin(), track_fingerprints_.end(), 0);
+    long_track_length_threshold_ = long_track_length_threshold;
+  }
+
+  // Fingerprint the cameras of all estimated views. The fingerprint of views
+  // that are not estimated is 0.
+  const auto& view_ids = reconstruction.ViewIds();
+  ViewId max_view_id = 0;
+  for (const ViewId view_id : view_ids) {
+    max_view_id = std::max(max_view_id, view_id);
+  }
+  view_fingerprints_.assign(view_ids.empty() ? 0 : max_view_id + 1, 0);
+  for (const ViewId view_id : view_ids) {
+    const View* view = reconstruction.View(view_id);
+    if (view->IsEstimated()) {
+      view_fingerprints_[view_id] = ComputeViewFingerprint(*view);
+    }
+  }
+
+  TrackId max_track_id = 0;
+  for (const TrackId track_id : track_ids) {
+    max_track_id = std::max(max_track_id, track_id);
+  }
+  if (!track_ids.empty() && max_track_id >= statistics_.size()) {
+    statistics_.resize(max_track_id + 1);
+    track_fingerprints_.resize(max_track_id + 1, 0);
+  }
+
+  // Each track writes to its own slot so the tracks may be processed in
+  // parallel.
+  std::atomic<int> num_recomputed_tracks(0);
+  ProcessBlocksInParallel(
+      num_threads, track_ids.size(), [&](const int start, const int end) {
+        int num_recomputed_tracks_in_block = 0;
+        for (int i = start; i < end; i++) {
+          const TrackId track_id = track_ids[i];
+          const uint64_t fingerprint = ComputeTrackFingerprint(
+              *reconstruction.Track(track_id), view_fingerprints_);
+          if (track_fingerprints_[track_id] == fingerprint) {
+            continue;
+          }
+
+          statistics_[track_id] = ComputeStatisticsForTrack(
+              reconstruction, track_id, long_track_length_threshold);
+          track_fingerprints_[track_id] = fingerprint;
+          ++num_recomputed_tracks_in_block;
+        }
+        num_recomputed_tracks += num_recomputed_tracks_in_block;
+      });
+  num_recomputed_tracks_ = num_recomputed_tracks;
+}
+
 // The efficiency of large scale bundle adjustment can be dramatically increased
 // by choosing only a subset of 3d points to optimize, as the 3d points tend to
 // have increasing scene redundancy. If the points are chosen in a way that
@@ -266,6 +374,7 @@ bool SelectGoodTracksForBundleAdjustment(
     const int long_track_length_threshold,
     const int image_grid_cell_size_pixels,
     const int min_num_optimized_tracks_per_view,
+    const int num_threads,
     std::unordered_set<TrackId>* tracks_to_optimize) {
   std::unordered_set<ViewId> view_ids;
   GetEstimatedViewsFromReconstruction(reconstruction, &view_ids);
@@ -274,6 +383,25 @@ bool SelectGoodTracksForBundleAdjustment(
                                              long_track_length_threshold,
                                              image_grid_cell_size_pixels,
                                              min_num_optimized_tracks_per_view,
+                                             num_threads,
+                                             tracks_to_optimize);
+}
+
+bool SelectGoodTracksForBundleAdjustment(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& view_ids,
+    const int long_track_length_threshold,
+    const int image_grid_cell_size_pixels,
+    const int min_num_optimized_tracks_per_view,
+    const int num_threads,
+    std::unordered_set<TrackId>* tracks_to_optimize) {
+  return SelectGoodTracksForBundleAdjustment(reconstruction,
+                                             view_ids,
+                                             long_track_length_threshold,
+                                             image_grid_cell_size_pixels,
+                                             min_num_optimized_tracks_per_view,
+                                             num_threads,
+                                             nullptr,
                                              tracks_to_optimize);
 }
 
@@ -283,42 +411,132 @@ bool SelectGoodTracksForBundleAdjustment(
     const int long_track_length_threshold,
     const int image_grid_cell_size_pixels,
     const int min_num_optimized_tracks_per_view,
+    const int num_threads,
+    TrackStatisticsCache* track_statistics_cache,
     std::unordered_set<TrackId>* tracks_to_optimize) {
-  // Compute the track mean reprojection errors.
-  std::unordered_map<TrackId, TrackStatistics> track_statistics;
-  ComputeTrackStatistics(reconstruction,
-                         view_ids,
-                         long_track_length_threshold,
-                         &track_statistics);
+  std::vector<bool> selected_tracks;
+  if (!SelectGoodTracksForBundleAdjustment(reconstruction,
+                                           view_ids,
+                                           long_track_length_threshold,
+                                           image_grid_cell_size_pixels,
+                                           min_num_optimized_tracks_per_view,
+                                           num_threads,
+                                           track_statistics_cache,
+                                           &selected_tracks)) {
+    return false;
+  }
+
+  for (TrackId track_id = 0; track_id < selected_tracks.size(); track_id++) {
+    if (selected_tracks[track_id]) {
+      tracks_to_optimize->emplace(track_id);
+    }
+  }
+  return true;
+}
+
+bool SelectGoodTracksForBundleAdjustment(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& view_ids,
+    const int long_track_length_threshold,
+    const int image_grid_cell_size_pixels,
+    const int min_num_optimized_tracks_per_view,
+    const int num_threads,
+    TrackStatisticsCache* track_statistics_cache,
+    std::vector<bool>* tracks_to_optimize) {
+  CHECK_NOTNULL(tracks_to_optimize);
+  CHECK_GT(image_grid_cell_size_pixels, 0);
+
+  // Gather the estimated tracks of each view along with their grid cells. Only
+  // const methods of the reconstruction are used so the views may be processed
+  // in parallel. The views are sorted so that the selection does not depend on
+  // the order of the set.
+  std::vector<ViewId> views(view_ids.begin(), view_ids.end());
+  std::sort(views.begin(), views.end());
+  std::vector<std::vector<TrackObservation> > observations(views.size());
+  ProcessBlocksInParallel(
+      num_threads, views.size(), [&](const int start, const int end) {
+        for (int i = start; i < end; i++) {
+          GetTrackObservationsInView(reconstruction,
+                                     *reconstruction.View(views[i]),
+                                     image_grid_cell_size_pixels,
+                                     &observations[i]);
+        }
+      });
+
+  // Find the unique tracks observed in all views.
+  size_t num_track_ids = 0;
+  for (const auto& observations_in_view : observations) {
+    for (const TrackObservation& observation : observations_in_view) {
+      num_track_ids = std::max(num_track_ids,
+                               static_cast<size_t>(observation.track_id) + 1);
+    }
+  }
+  std::vector<bool> is_observed(num_track_ids, false);
+  std::vector<TrackId> observed_tracks;
+  for (const auto& observations_in_view : observations) {
+    for (const TrackObservation& observation : observations_in_view) {
+      if (!is_observed[observation.track_id]) {
+        is_observed[observation.track_id] = true;
+        observed_tracks.emplace_back(observation.track_id);
+      }
+    }
+  }
+
+  // Compute the mean reprojection error and the truncated track length of each
+  // track. We truncate the track length based on the observation that while
+  // larger track lengths provide better constraints for bundle adjustment,
+  // larger tracks are also more likely to contain outliers in our experience.
+  // Truncating the track lengths enforces that the long tracks with the lowest
+  // reprojection error are chosen.
+  TrackStatisticsCache local_track_statistics;
+  TrackStatisticsCache* track_statistics = track_statistics_cache != nullptr
+                                               ? track_statistics_cache
+                                               : &local_track_statistics;
+  track_statistics->Update(reconstruction,
+                           observed_tracks,
+                           long_track_length_threshold,
+                           num_threads);
+  VLOG(2) << "Recomputed the statistics of "
+          << track_statistics->NumRecomputedTracks() << " out of "
+          << observed_tracks.size() << " tracks.";
 
   // For each image, divide the image into a grid and choose the highest quality
   // tracks from each grid cell. This encourages good spatial coverage of tracks
-  // within each image.
-  for (const ViewId view_id : view_ids) {
-    const View* view = reconstruction.View(view_id);
+  // within each image. The grid of each view is independent of the others, so
+  // the views are processed in parallel.
+  std::vector<std::vector<TrackId> > best_tracks_in_view(views.size());
+  ProcessBlocksInParallel(
+      num_threads, views.size(), [&](const int start, const int end) {
+        std::vector<std::pair<GridCell, GridCellElement> > grid_cell_elements;
+        for (int i = start; i < end; i++) {
+          SelectBestTracksFromEachImageGridCell(observations[i],
+                                                *track_statistics,
+                                                &grid_cell_elements,
+                                                &best_tracks_in_view[i]);
+        }
+      });
 
-    // Select the best tracks from each grid cell in the image and add them to
-    // the container of tracks to be optimized.
-    SelectBestTracksFromEachImageGridCell(reconstruction,
-                                          *view,
-                                          image_grid_cell_size_pixels,
-                                          track_statistics,
-                                          tracks_to_optimize);
+  tracks_to_optimize->assign(num_track_ids, false);
+  for (const auto& best_tracks : best_tracks_in_view) {
+    for (const TrackId track_id : best_tracks) {
+      (*tracks_to_optimize)[track_id] = true;
+    }
   }
 
   // To this point, we have only added features that have as full spatial
   // coverage as possible within each image but we have not ensured that each
   // image is constrainted by at least K features. So, we cycle through all
   // views again and add the top M tracks that have not already been added.
-  for (const ViewId view_id : view_ids) {
-    const View* view = reconstruction.View(view_id);
-
+  // This depends on the tracks chosen for previous views so it is done
+  // serially.
+  std::vector<GridCellElement> ranked_candidate_tracks;
+  for (int i = 0; i < views.size(); i++) {
     // If this view is not constrained by enough optimized tracks, add the top
     // ranked features until there are enough tracks constraining the view.
-    SelectTopRankedTracksInView(reconstruction,
-                                track_statistics,
-                                *view,
+    SelectTopRankedTracksInView(*track_statistics,
+                                observations[i],
                                 min_num_optimized_tracks_per_view,
+                                &ranked_candidate_tracks,
                                 tracks_to_optimize);
   }
 
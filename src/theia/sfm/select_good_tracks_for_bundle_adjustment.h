@@ -35,13 +35,69 @@
 #ifndef THEIA_SFM_SELECT_GOOD_TRACKS_FOR_BUNDLE_ADJUSTMENT_H_
 #define THEIA_SFM_SELECT_GOOD_TRACKS_FOR_BUNDLE_ADJUSTMENT_H_
 
+#include <cstdint>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "theia/sfm/types.h"
+#include "theia/util/util.h"
 
 namespace theia {
 class Reconstruction;
 
+// Keeps the statistics of tracks (the truncated track length and the mean
+// squared reprojection error) between calls to
+// SelectGoodTracksForBundleAdjustment. The statistics of a track only depend on
+// its 3D point and on the cameras of the estimated views that observe it, so
+// the cached statistics of a track are reused as long as none of these have
+// changed. This avoids recomputing the reprojection errors of the parts of the
+// reconstruction that were not modified since the previous selection, e.g.
+// between the bundle adjustments of incremental SfM.
+//
+// Changes are detected by comparing fingerprints of the point and of the
+// cameras with the ones of the previous call, so the cache never needs to be
+// invalidated explicitly. The feature positions of the views are assumed to not
+// change while the cache is in use.
+class TrackStatisticsCache {
+ public:
+  typedef std::pair<int, double> TrackStatistics;
+
+  TrackStatisticsCache() {}
+
+  // Makes sure that the statistics of the tracks are up to date. The statistics
+  // of a track are only recomputed if it was not cached before or if its point
+  // or the cameras observing it have changed. The tracks must be estimated.
+  void Update(const Reconstruction& reconstruction,
+              const std::vector<TrackId>& track_ids,
+              const int long_track_length_threshold,
+              const int num_threads);
+
+  // Returns the statistics of a track that was passed to the last Update.
+  const TrackStatistics& Statistics(const TrackId track_id) const {
+    return statistics_[track_id];
+  }
+
+  // The number of tracks whose statistics were recomputed by the last Update.
+  int NumRecomputedTracks() const { return num_recomputed_tracks_; }
+
+ private:
+  int long_track_length_threshold_ = 0;
+  int num_recomputed_tracks_ = 0;
+
+  // The statistics of each track and the fingerprint of its point and cameras
+  // at the time the statistics were computed, indexed by TrackId. A fingerprint
+  // of 0 marks a track without statistics.
+  std::vector<TrackStatistics> statistics_;
+  std::vector<uint64_t> track_fingerprints_;
+
+  // The fingerprints of the cameras of the estimated views, indexed by ViewId.
+  // These are recomputed by each Update.
+  std::vector<uint64_t> view_fingerprints_;
+
+  DISALLOW_COPY_AND_ASSIGN(TrackStatisticsCache);
+};
+
 // The efficiency of large scale bundle adjustment can be dramatically increased
 // by choosing only a subset of 3d points to optimize, as the 3d points tend to
 // have increasing scene redundancy. If the points are chosen in a way that
@@ -58,18 +114,20 @@ class Reconstruction;
 // Tracks in each image are first hashed into spatial bins with an image grid
 // where each image grid cell is the provided width. Within each grid cell, the
 // tracks are ordered based on their track length, then by mean reprojection
-// error. The track length is truncated to be no longer than
+// error, then by TrackId. The track length is truncated to be no longer than
 // long_track_length_threshold so that among long tracks, the ones with low
 // reprojection error are chosen for bundle adjustment.
 //
 // We recommend the grid cell size is set to 100 pixels, the long track length
 // threshold is set to 10, and the min num optimized tracks per view is set to
-// 100.
+// 100. The track statistics and the image grids of the views are computed with
+// num_threads threads.
 bool SelectGoodTracksForBundleAdjustment(
     const Reconstruction& reconstruction,
     const int long_track_length_threshold,
     const int image_grid_cell_size_pixels,
     const int min_num_optimized_tracks_per_view,
+    const int num_threads,
     std::unordered_set<TrackId>* tracks_to_optimize);
 
 // Same as above, but only selecting tracks from the set of views provided.
@@ -79,8 +137,36 @@ bool SelectGoodTracksForBundleAdjustment(
     const int long_track_length_threshold,
     const int image_grid_cell_size_pixels,
     const int min_num_optimized_tracks_per_view,
+    const int num_threads,
     std::unordered_set<TrackId>* tracks_to_optimize);
 
+// Same as above, but the track statistics are taken from the cache when
+// possible and the cache is updated with the statistics that were recomputed.
+bool SelectGoodTracksForBundleAdjustment(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& view_ids,
+    const int long_track_length_threshold,
+    const int image_grid_cell_size_pixels,
+    const int min_num_optimized_tracks_per_view,
+    const int num_threads,
+    TrackStatisticsCache* track_statistics_cache,
+    std::unordered_set<TrackId>* tracks_to_optimize);
+
+// Same as above, but the selected tracks are returned as a dense bitset indexed
+// by TrackId, i.e. (*tracks_to_optimize)[track_id] is true if the track was
+// selected. The bitset is sized to hold the largest TrackId observed in the
+// views. The track statistics cache may be NULL, in which case the statistics
+// of all tracks are computed.
+bool SelectGoodTracksForBundleAdjustment(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& view_ids,
+    const int long_track_length_threshold,
+    const int image_grid_cell_size_pixels,
+    const int min_num_optimized_tracks_per_view,
+    const int num_threads,
+    TrackStatisticsCache* track_statistics_cache,
+    std::vector<bool>* tracks_to_optimize);
+
 }  // namespace theia
 
 #endif  // THEIA_SFM_SELECT_GOOD_TRACKS_FOR_BUNDLE_ADJUSTMENT_H_
@@ -0,0 +1,291 @@
+// Copyright (C) 2017 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <Eigen/Core>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "theia/sfm/camera/camera.h"
+#include "theia/sfm/reconstruction.h"
+#include "theia/sfm/select_good_tracks_for_bundle_adjustment.h"
+#include "theia/sfm/track.h"
+#include "theia/sfm/types.h"
+#include "theia/sfm/view.h"
+
+namespace theia {
+
+namespace {
+
+static const int kLongTrackLengthThreshold = 10;
+static const int kNumThreads = 1;
+
+// Adds views that all have the same camera with a focal length of 1 and a
+// principal point at the origin, so that the point (x, y, 1) projects to the
+// pixel (x, y) in every view.
+void AddViews(const int num_views, Reconstruction* reconstruction) {
+  for (int i = 0; i < num_views; i++) {
+    const ViewId view_id = reconstruction->AddView(std::to_string(i));
+    View* view = reconstruction->MutableView(view_id);
+    view->MutableCamera()->SetFocalLength(1.0);
+    view->MutableCamera()->SetPrincipalPoint(0.0, 0.0);
+    view->SetEstimated(true);
+  }
+}
+
+// Adds an estimated track that is observed by all views at the pixel
+// (x + reprojection_error, y) and whose point projects to (x, y).
+TrackId AddTrackAtPixel(const double x,
+                        const double y,
+                        const double reprojection_error,
+                        Reconstruction* reconstruction) {
+  std::vector<std::pair<ViewId, Feature> > observations;
+  for (const ViewId view_id : reconstruction->ViewIds()) {
+    observations.emplace_back(view_id, Feature(x + reprojection_error, y));
+  }
+  const TrackId track_id = reconstruction->AddTrack(observations);
+  Track* track = reconstruction->MutableTrack(track_id);
+  *track->MutablePoint() = Eigen::Vector4d(x, y, 1.0, 1.0);
+  track->SetEstimated(true);
+  return track_id;
+}
+
+std::unordered_set<TrackId> SelectTracks(
+    const Reconstruction& reconstruction,
+    const int image_grid_cell_size_pixels,
+    const int min_num_optimized_tracks_per_view) {
+  std::unordered_set<TrackId> tracks_to_optimize;
+  EXPECT_TRUE(SelectGoodTracksForBundleAdjustment(
+      reconstruction,
+      kLongTrackLengthThreshold,
+      image_grid_cell_size_pixels,
+      min_num_optimized_tracks_per_view,
+      kNumThreads,
+      &tracks_to_optimize));
+  return tracks_to_optimize;
+}
+
+// Selects the tracks of the views, using the track statistics cache if it is
+// not NULL.
+std::unordered_set<TrackId> SelectTracksInViews(
+    const Reconstruction& reconstruction,
+    const std::unordered_set<ViewId>& view_ids,
+    TrackStatisticsCache* track_statistics_cache) {
+  static const int kGridCellSizePixels = 100;
+  static const int kMinNumOptimizedTracksPerView = 3;
+  std::unordered_set<TrackId> tracks_to_optimize;
+  EXPECT_TRUE(SelectGoodTracksForBundleAdjustment(
+      reconstruction,
+      view_ids,
+      kLongTrackLengthThreshold,
+      kGridCellSizePixels,
+      kMinNumOptimizedTracksPerView,
+      kNumThreads,
+      track_statistics_cache,
+      &tracks_to_optimize));
+  return tracks_to_optimize;
+}
+
+}  // namespace
+
+TEST(SelectGoodTracksForBundleAdjustment, BestTrackOfEachGridCell) {
+  Reconstruction reconstruction;
+  AddViews(2, &reconstruction);
+  // Two tracks in the cell (0, 0), of which the second has the lower error.
+  AddTrackAtPixel(10, 10, 1.0, &reconstruction);
+  const TrackId track1 = AddTrackAtPixel(50, 50, 0.5, &reconstruction);
+  // A single track in the cell (1, 0).
+  const TrackId track2 = AddTrackAtPixel(150, 50, 2.0, &reconstruction);
+  // Tracks in the cell (2, 3) with the same statistics. The one with the
+  // smallest TrackId is selected.
+  const TrackId track3 = AddTrackAtPixel(250, 350, 0.5, &reconstruction);
+  AddTrackAtPixel(260, 360, 0.5, &reconstruction);
+  AddTrackAtPixel(270, 370, 0.5, &reconstruction);
+
+  const std::unordered_set<TrackId> expected_tracks = {track1, track2, track3};
+  EXPECT_EQ(SelectTracks(reconstruction, 100, 0), expected_tracks);
+
+  // The selection is the same with multiple threads.
+  std::unordered_set<TrackId> tracks_to_optimize;
+  EXPECT_TRUE(SelectGoodTracksForBundleAdjustment(reconstruction,
+                                                  kLongTrackLengthThreshold,
+                                                  100,
+                                                  0,
+                                                  4,
+                                                  &tracks_to_optimize));
+  EXPECT_EQ(tracks_to_optimize, expected_tracks);
+}
+
+TEST(SelectGoodTracksForBundleAdjustment, FeaturesOutsideOfTheImage) {
+  Reconstruction reconstruction;
+  AddViews(2, &reconstruction);
+  // Features with negative coordinates are in separate cells from the features
+  // of the first row and column of cells.
+  const TrackId track1 = AddTrackAtPixel(-30, 50, 0.5, &reconstruction);
+  const TrackId track2 = AddTrackAtPixel(30, 50, 1.0, &reconstruction);
+  const TrackId track3 = AddTrackAtPixel(30, -50, 1.0, &reconstruction);
+  // Features far outside of the image are not mistaken for features of another
+  // row.
+  const TrackId track4 = AddTrackAtPixel((1 << 20) + 30, 50, 0.5, &reconstruction);
+  const TrackId track5 = AddTrackAtPixel(30, 150, 1.0, &reconstruction);
+
+  const std::unordered_set<TrackId> expected_tracks = {
+      track1, track2, track3, track4, track5};
+  EXPECT_EQ(SelectTracks(reconstruction, 1, 0), expected_tracks);
+  EXPECT_EQ(SelectTracks(reconstruction, 100, 0), expected_tracks);
+}
+
+TEST(SelectGoodTracksForBundleAdjustment, ChangeGridCellSize) {
+  Reconstruction reconstruction;
+  AddViews(2, &reconstruction);
+  const TrackId track1 = AddTrackAtPixel(50, 50, 0.5, &reconstruction);
+  const TrackId track2 = AddTrackAtPixel(150, 50, 1.0, &reconstruction);
+  const TrackId track3 = AddTrackAtPixel(150, 150, 0.25, &reconstruction);
+  const TrackId track4 = AddTrackAtPixel(50, 150, 2.0, &reconstruction);
+
+  const std::unordered_set<TrackId> small_cell_tracks = {
+      track1, track2, track3, track4};
+  const std::unordered_set<TrackId> large_cell_tracks = {track3};
+  EXPECT_EQ(SelectTracks(reconstruction, 100, 0), small_cell_tracks);
+  EXPECT_EQ(SelectTracks(reconstruction, 200, 0), large_cell_tracks);
+  EXPECT_EQ(SelectTracks(reconstruction, 100, 0), small_cell_tracks);
+}
+
+TEST(SelectGoodTracksForBundleAdjustment, MinNumOptimizedTracksPerView) {
+  Reconstruction reconstruction;
+  AddViews(2, &reconstruction);
+  // All tracks are in the same cell, so the grid only selects the best track
+  // and the remaining tracks are the next best ranked tracks. Ties are broken
+  // by the TrackId.
+  const TrackId track1 = AddTrackAtPixel(10, 10, 0.25, &reconstruction);
+  AddTrackAtPixel(20, 20, 2.0, &reconstruction);
+  const TrackId track2 = AddTrackAtPixel(30, 30, 1.0, &reconstruction);
+  const TrackId track3 = AddTrackAtPixel(40, 40, 1.0, &reconstruction);
+  AddTrackAtPixel(50, 50, 1.0, &reconstruction);
+  const TrackId track4 = AddTrackAtPixel(60, 60, 0.5, &reconstruction);
+
+  const std::unordered_set<TrackId> expected_tracks = {
+      track1, track2, track3, track4};
+  EXPECT_EQ(SelectTracks(reconstruction, 100, 4), expected_tracks);
+
+  // If the views need more tracks than they observe, all tracks are selected.
+  EXPECT_EQ(SelectTracks(reconstruction, 100, 10).size(),
+            reconstruction.NumTracks());
+}
+
+TEST(SelectGoodTracksForBundleAdjustment, OnlySelectedViews) {
+  Reconstruction reconstruction;
+  AddViews(3, &reconstruction);
+  const ViewId view_id0 = reconstruction.ViewIdFromName("0");
+  const ViewId view_id1 = reconstruction.ViewIdFromName("1");
+  const ViewId view_id2 = reconstruction.ViewIdFromName("2");
+  const std::vector<std::pair<ViewId, Feature> > observations1 = {
+      {view_id0, Feature(10, 10)}, {view_id1, Feature(10, 10)}};
+  const std::vector<std::pair<ViewId, Feature> > observations2 = {
+      {view_id1, Feature(20, 20)}, {view_id2, Feature(20, 20)}};
+  const TrackId track1 = reconstruction.AddTrack(observations1);
+  const TrackId track2 = reconstruction.AddTrack(observations2);
+  for (const TrackId track_id : {track1, track2}) {
+    Track* track = reconstruction.MutableTrack(track_id);
+    track->SetEstimated(true);
+    *track->MutablePoint() = Eigen::Vector4d(10, 10, 1, 1);
+  }
+
+  const std::unordered_set<TrackId> expected_tracks = {track1};
+  EXPECT_EQ(SelectTracksInViews(reconstruction, {view_id0}, nullptr),
+            expected_tracks);
+}
+
+TEST(SelectGoodTracksForBundleAdjustment, TrackStatisticsCache) {
+  Reconstruction reconstruction;
+  AddViews(3, &reconstruction);
+  std::vector<TrackId> track_ids;
+  for (int i = 0; i < 20; i++) {
+    track_ids.emplace_back(AddTrackAtPixel(
+        20 * i, 10 * (i % 3), 0.1 * (i % 7), &reconstruction));
+  }
+  const std::vector<ViewId> all_view_ids = reconstruction.ViewIds();
+  const std::unordered_set<ViewId> view_ids(all_view_ids.begin(),
+                                            all_view_ids.end());
+
+  // The first selection computes the statistics of all tracks and the second
+  // one reuses them.
+  TrackStatisticsCache cache;
+  EXPECT_EQ(SelectTracksInViews(reconstruction, view_ids, &cache),
+            SelectTracksInViews(reconstruction, view_ids, nullptr));
+  EXPECT_EQ(cache.NumRecomputedTracks(), track_ids.size());
+  EXPECT_EQ(SelectTracksInViews(reconstruction, view_ids, &cache),
+            SelectTracksInViews(reconstruction, view_ids, nullptr));
+  EXPECT_EQ(cache.NumRecomputedTracks(), 0);
+
+  // Moving a point only recomputes the statistics of its track.
+  *reconstruction.MutableTrack(track_ids[7])->MutablePoint() =
+      Eigen::Vector4d(145, 5, 1, 1);
+  EXPECT_EQ(SelectTracksInViews(reconstruction, view_ids, &cache),
+            SelectTracksInViews(reconstruction, view_ids, nullptr));
+  EXPECT_EQ(cache.NumRecomputedTracks(), 1);
+
+  // Changing a camera recomputes the statistics of all tracks it observes.
+  reconstruction.MutableView(reconstruction.ViewIdFromName("1"))
+      ->MutableCamera()
+      ->SetFocalLength(1.1);
+  EXPECT_EQ(SelectTracksInViews(reconstruction, view_ids, &cache),
+            SelectTracksInViews(reconstruction, view_ids, nullptr));
+  EXPECT_EQ(cache.NumRecomputedTracks(), track_ids.size());
+
+  // As does a view that is no longer estimated.
+  const ViewId view_id0 = reconstruction.ViewIdFromName("0");
+  reconstruction.MutableView(view_id0)->SetEstimated(false);
+  const std::unordered_set<ViewId> estimated_view_ids = {
+      reconstruction.ViewIdFromName("1"), reconstruction.ViewIdFromName("2")};
+  EXPECT_EQ(SelectTracksInViews(reconstruction, estimated_view_ids, &cache),
+            SelectTracksInViews(reconstruction, estimated_view_ids, nullptr));
+  EXPECT_EQ(cache.NumRecomputedTracks(), track_ids.size());
+
+  // A different track length threshold invalidates all statistics.
+  std::unordered_set<TrackId> tracks_to_optimize;
+  EXPECT_TRUE(SelectGoodTracksForBundleAdjustment(reconstruction,
+                                                  estimated_view_ids,
+                                                  1,
+                                                  100,
+                                                  3,
+                                                  kNumThreads,
+                                                  &cache,
+                                                  &tracks_to_optimize));
+  EXPECT_EQ(cache.NumRecomputedTracks(), track_ids.size());
+}
+
+}  // namespace theia
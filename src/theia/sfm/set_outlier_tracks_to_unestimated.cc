@@ -36,7 +36,9 @@
 
 #include <Eigen/Core>
 #include <glog/logging.h>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "theia/sfm/camera/camera.h"
 #include "theia/sfm/reconstruction.h"
@@ -66,59 +68,82 @@ int SetOutlierTracksToUnestimated(const std::unordered_set<TrackId>& track_ids,
   const double max_sq_reprojection_error =
       max_inlier_reprojection_error * max_inlier_reprojection_error;
 
-  int num_estimated_tracks = 0;
-  int num_bad_reprojections = 0;
-  int num_insufficient_viewing_angles = 0;
-
+  // Gather the estimated tracks and the estimated views that observe them so
+  // that the points can be projected into each view with a single batch.
+  std::vector<TrackId> estimated_tracks;
+  std::unordered_map<ViewId, std::vector<int> > tracks_in_view;
   for (const TrackId track_id : track_ids) {
-    Track* track = reconstruction->MutableTrack(track_id);
+    const Track* track = reconstruction->Track(track_id);
     if (!track->IsEstimated()) {
       continue;
     }
-    ++num_estimated_tracks;
 
-    std::vector<Eigen::Vector3d> ray_directions;
-    const auto& view_ids = track->ViewIds();
-    int num_projections = 0;
-    double mean_sq_reprojection_error = 0;
-    for (const ViewId view_id : view_ids) {
+    for (const ViewId view_id : track->ViewIds()) {
       const View* view = CHECK_NOTNULL(reconstruction->View(view_id));
-      if (!view->IsEstimated()) {
-        continue;
+      if (view->IsEstimated()) {
+        tracks_in_view[view_id].emplace_back(estimated_tracks.size());
       }
+    }
+    estimated_tracks.emplace_back(track_id);
+  }
+
+  // Reproject the observations of the tracks.
+  std::vector<double> sq_reprojection_errors(estimated_tracks.size(), 0.0);
+  std::vector<int> num_projections(estimated_tracks.size(), 0);
+  std::vector<bool> behind_camera(estimated_tracks.size(), false);
+  std::vector<std::vector<Eigen::Vector3d> > ray_directions(
+      estimated_tracks.size());
+  std::vector<Eigen::Vector4d> points;
+  std::vector<Eigen::Vector2d> projections;
+  std::vector<double> depths;
+  for (const auto& view_and_tracks : tracks_in_view) {
+    const View* view = reconstruction->View(view_and_tracks.first);
+    const Camera& camera = view->Camera();
+    const std::vector<int>& track_indices = view_and_tracks.second;
+
+    points.clear();
+    for (const int track_index : track_indices) {
+      points.emplace_back(
+          reconstruction->Track(estimated_tracks[track_index])->Point());
+    }
+    camera.ProjectPoints(points, &projections, &depths);
+
+    const Eigen::Vector3d position = camera.GetPosition();
+    for (int i = 0; i < track_indices.size(); i++) {
+      const int track_index = track_indices[i];
+      ray_directions[track_index].emplace_back(
+          (points[i].hnormalized() - position).normalized());
 
-      const Camera& camera = view->Camera();
-      const Eigen::Vector3d ray_direction =
-          track->Point().hnormalized() - camera.GetPosition();
-      ray_directions.push_back(ray_direction.normalized());
-
-      // Check the reprojection error.
-      const Feature* feature = view->GetFeature(track_id);
-      // Reproject the observations.
-      Eigen::Vector2d projection;
-      const double depth = camera.ProjectPoint(track->Point(), &projection);
-      // Remove the feature if the reprojection is behind the camera.
-      if (depth < 0) {
-        ++num_bad_reprojections;
-        track->SetEstimated(false);
-        break;
+      // The track is removed if the reprojection is behind the camera.
+      if (depths[i] < 0) {
+        behind_camera[track_index] = true;
+        continue;
       }
-      mean_sq_reprojection_error += (projection - *feature).squaredNorm();
-      ++num_projections;
+      const Feature* feature =
+          view->GetFeature(estimated_tracks[track_index]);
+      sq_reprojection_errors[track_index] +=
+          (projections[i] - *feature).squaredNorm();
+      ++num_projections[track_index];
     }
+  }
 
-    mean_sq_reprojection_error /= static_cast<double>(num_projections);
-    if (track->IsEstimated() &&
+  int num_bad_reprojections = 0;
+  int num_insufficient_viewing_angles = 0;
+  for (int i = 0; i < estimated_tracks.size(); i++) {
+    Track* track = reconstruction->MutableTrack(estimated_tracks[i]);
+    const double mean_sq_reprojection_error =
+        sq_reprojection_errors[i] / static_cast<double>(num_projections[i]);
+    if (behind_camera[i] ||
         mean_sq_reprojection_error > max_sq_reprojection_error) {
       ++num_bad_reprojections;
       track->SetEstimated(false);
+      continue;
     }
 
     // The track will remain estimated if the reprojection errors were all
     // good. We then test that the track is properly constrained by having at
     // least two cameras view it with a sufficient viewing angle.
-    if (track->IsEstimated() &&
-        !SufficientTriangulationAngle(ray_directions,
+    if (!SufficientTriangulationAngle(ray_directions[i],
                                       min_triangulation_angle_degrees)) {
       ++num_insufficient_viewing_angles;
       track->SetEstimated(false);
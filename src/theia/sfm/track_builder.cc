@@ -49,6 +49,20 @@
 #include "theia/util/map_util.h"
 
 namespace theia {
+namespace {
+
+// Features that are added by index use the view id and feature index as their
+// id. The top bit distinguishes them from the ids of features that are added
+// by position, which are assigned sequentially.
+static const uint64_t kIndexedFeatureIdFlag = 1ULL << 63;
+
+inline uint64_t IndexedFeatureId(const ViewId view_id,
+                                 const uint32_t feature_index) {
+  return kIndexedFeatureIdFlag | (static_cast<uint64_t>(view_id) << 32) |
+         feature_index;
+}
+
+}  // namespace
 
 TrackBuilder::TrackBuilder(const int min_track_length,
                            const int max_track_length)
@@ -76,6 +90,33 @@ void TrackBuilder::AddFeatureCorrespondence(const ViewId view_id1,
   connected_components_->AddEdge(feature1_id, feature2_id);
 }
 
+void TrackBuilder::AddIndexedFeatureCorrespondence(
+    const ViewId view_id1,
+    const uint32_t feature_index1,
+    const ViewId view_id2,
+    const uint32_t feature_index2) {
+  CHECK_NE(view_id1, view_id2)
+      << "Cannot add 2 features from the same image as a correspondence for "
+         "track generation.";
+  CHECK_EQ((view_id1 | view_id2) & (1U << 31), 0)
+      << "The view ids are too large for indexed features.";
+
+  views_with_indexed_features_.insert(view_id1);
+  views_with_indexed_features_.insert(view_id2);
+  connected_components_->AddEdge(IndexedFeatureId(view_id1, feature_index1),
+                                 IndexedFeatureId(view_id2, feature_index2));
+}
+
+void TrackBuilder::SetFeaturePositions(
+    const ViewId view_id, const std::vector<Feature>& feature_positions) {
+  feature_positions_[view_id] = feature_positions;
+}
+
+const std::unordered_set<ViewId>& TrackBuilder::ViewsWithIndexedFeatures()
+    const {
+  return views_with_indexed_features_;
+}
+
 void TrackBuilder::BuildTracks(Reconstruction* reconstruction) {
   CHECK_NOTNULL(reconstruction);
 
@@ -106,7 +147,19 @@ void TrackBuilder::BuildTracks(Reconstruction* reconstruction) {
     // Add all features in the connected component to the track.
     std::unordered_set<ViewId> view_ids;
     for (const auto& feature_id : component.second) {
-      const auto& feature_to_add = *FindOrDie(id_to_feature, feature_id);
+      std::pair<ViewId, Feature> feature_to_add;
+      if (feature_id & kIndexedFeatureIdFlag) {
+        feature_to_add.first = (feature_id & ~kIndexedFeatureIdFlag) >> 32;
+        const uint32_t feature_index = feature_id & 0xFFFFFFFF;
+        const std::vector<Feature>& feature_positions =
+            FindOrDie(feature_positions_, feature_to_add.first);
+        CHECK_LT(feature_index, feature_positions.size())
+            << "The feature index is out of range for view "
+            << feature_to_add.first;
+        feature_to_add.second = feature_positions[feature_index];
+      } else {
+        feature_to_add = *FindOrDie(id_to_feature, feature_id);
+      }
 
       // Do not add the feature if the track already contains a feature from the
       // same image.
@@ -40,7 +40,9 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "theia/sfm/feature.h"
 #include "theia/sfm/types.h"
@@ -65,6 +67,25 @@ class TrackBuilder {
   void AddFeatureCorrespondence(const ViewId view_id1, const Feature& feature1,
                                 const ViewId view_id2, const Feature& feature2);
 
+  // Adds a correspondence between the features with the given indices in the
+  // two views. Features that are added by index are identified by their index
+  // rather than by hashing their positions, and the positions are looked up in
+  // the feature positions of each view when the tracks are built. A feature
+  // should not be added both by index and by position.
+  void AddIndexedFeatureCorrespondence(const ViewId view_id1,
+                                       const uint32_t feature_index1,
+                                       const ViewId view_id2,
+                                       const uint32_t feature_index2);
+
+  // Sets the positions of the features of the view that were added by index.
+  // This must be called for every view in ViewsWithIndexedFeatures() before
+  // the tracks are built.
+  void SetFeaturePositions(const ViewId view_id,
+                           const std::vector<Feature>& feature_positions);
+
+  // The views that have features which were added by index.
+  const std::unordered_set<ViewId>& ViewsWithIndexedFeatures() const;
+
   // Generates all tracks and adds them to the reconstruction.
   void BuildTracks(Reconstruction* reconstruction);
 
@@ -72,6 +93,8 @@ class TrackBuilder {
   uint64_t FindOrInsert(const std::pair<ViewId, Feature>& image_feature);
 
   std::unordered_map<std::pair<ViewId, Feature>, uint64_t> features_;
+  std::unordered_map<ViewId, std::vector<Feature> > feature_positions_;
+  std::unordered_set<ViewId> views_with_indexed_features_;
   std::unique_ptr<ConnectedComponents<uint64_t> > connected_components_;
   uint64_t num_features_;
   const int min_track_length_;
@@ -198,4 +198,51 @@ TEST(TrackBuilder, MinTrackLength) {
   EXPECT_EQ(reconstruction.NumTracks(), 1);
 }
 
+// Features that are added by index take their positions from the feature
+// positions of each view.
+TEST(TrackBuilder, IndexedFeatures) {
+  static const int kMaxTrackLength = 10;
+
+  TrackBuilder track_builder(kMinTrackLength, kMaxTrackLength);
+  track_builder.AddIndexedFeatureCorrespondence(0, 0, 1, 1);
+  track_builder.AddIndexedFeatureCorrespondence(1, 1, 2, 0);
+  track_builder.AddIndexedFeatureCorrespondence(0, 1, 1, 0);
+  EXPECT_EQ(track_builder.ViewsWithIndexedFeatures().size(), 3);
+
+  const std::vector<Feature> feature_positions = { Feature(1, 2),
+                                                   Feature(3, 4) };
+  for (const ViewId view_id : track_builder.ViewsWithIndexedFeatures()) {
+    track_builder.SetFeaturePositions(view_id, feature_positions);
+  }
+
+  Reconstruction reconstruction;
+  reconstruction.AddView("0");
+  reconstruction.AddView("1");
+  reconstruction.AddView("2");
+  track_builder.BuildTracks(&reconstruction);
+  VerifyTracks(reconstruction);
+  EXPECT_EQ(reconstruction.NumTracks(), 2);
+
+  // One track contains the first feature of view 0, the second feature of view
+  // 1 and the first feature of view 2. The other contains the second feature of
+  // view 0 and the first feature of view 1.
+  for (const TrackId track_id : reconstruction.TrackIds()) {
+    const Track* track = reconstruction.Track(track_id);
+    if (track->NumViews() == 3) {
+      EXPECT_EQ(*reconstruction.View(0)->GetFeature(track_id),
+                feature_positions[0]);
+      EXPECT_EQ(*reconstruction.View(1)->GetFeature(track_id),
+                feature_positions[1]);
+      EXPECT_EQ(*reconstruction.View(2)->GetFeature(track_id),
+                feature_positions[0]);
+    } else {
+      EXPECT_EQ(track->NumViews(), 2);
+      EXPECT_EQ(*reconstruction.View(0)->GetFeature(track_id),
+                feature_positions[1]);
+      EXPECT_EQ(*reconstruction.View(1)->GetFeature(track_id),
+                feature_positions[0]);
+    }
+  }
+}
+
 }  // namespace theia
@@ -103,6 +103,63 @@ void FindOptimalImagePoints(const Matrix3d& ematrix,
           .hnormalized();
 }
 
+
+// Returns the vector that is orthogonal to the three rows. This is the
+// nullspace of a 3x4 matrix of rank 3 and is computed with the cofactor
+// expansion of the 4x4 determinant.
+Vector4d OrthogonalVector(const Vector4d& row1,
+                          const Vector4d& row2,
+                          const Vector4d& row3) {
+  Matrix<double, 3, 4> rows;
+  rows << row1.transpose(), row2.transpose(), row3.transpose();
+  Matrix3d minor;
+  Vector4d orthogonal_vector;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0, k = 0; j < 4; j++) {
+      if (j != i) {
+        minor.col(k++) = rows.col(j);
+      }
+    }
+    orthogonal_vector[i] = (i % 2 == 0 ? 1.0 : -1.0) * minor.determinant();
+  }
+  return orthogonal_vector;
+}
+
+// Returns true if the homogeneous point has a positive depth in the camera with
+// the projection matrix. See HZZ 6.2.3 p 162.
+bool PositiveDepth(const Matrix3x4d& pose,
+                   const double pose_determinant_sign,
+                   const Vector4d& point) {
+  return pose_determinant_sign * pose.row(2).dot(point) * point[3] > 0.0;
+}
+
+// Returns the direction from the camera center to the homogeneous point. Both
+// directions of a point have the same sign, so this can be used to compute the
+// angle between two observations even for points close to infinity.
+Vector3d DirectionToPoint(const Vector3d& camera_center, const Vector4d& point) {
+  return point.head<3>() - point[3] * camera_center;
+}
+
+// Returns the center of the camera with the projection matrix.
+Vector3d CameraCenter(const Matrix3x4d& pose) {
+  return -pose.leftCols<3>().inverse() * pose.col(3);
+}
+
+// Returns true if any two of the unit directions have an angle larger than the
+// angle of the cosine.
+bool SufficientAngle(const Vector3d* directions,
+                     const int num_directions,
+                     const double cos_of_min_angle) {
+  for (int i = 0; i < num_directions; i++) {
+    for (int j = i + 1; j < num_directions; j++) {
+      if (directions[i].dot(directions[j]) < cos_of_min_angle) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 // Triangulates 2 posed views
@@ -249,4 +306,130 @@ bool SufficientTriangulationAngle(
   return false;
 }
 
+int TriangulateBatch(const BatchTriangulationOptions& options,
+                     const Matrix3x4d& pose1,
+                     const Matrix3x4d& pose2,
+                     const std::vector<Vector2d>& points1,
+                     const std::vector<Vector2d>& points2,
+                     std::vector<Vector4d>* triangulated_points,
+                     std::vector<TriangulationStatus>* statuses) {
+  CHECK_EQ(points1.size(), points2.size());
+  CHECK_NOTNULL(triangulated_points)->resize(points1.size());
+  CHECK_NOTNULL(statuses)->resize(points1.size());
+
+  // Everything that only depends on the poses is computed once.
+  Matrix3d ematrix;
+  EssentialMatrixFromTwoProjectionMatrices(pose1, pose2, &ematrix);
+  const Vector3d center1 = CameraCenter(pose1);
+  const Vector3d center2 = CameraCenter(pose2);
+  const double sign1 = pose1.leftCols<3>().determinant() > 0.0 ? 1.0 : -1.0;
+  const double sign2 = pose2.leftCols<3>().determinant() > 0.0 ? 1.0 : -1.0;
+  const double cos_of_min_angle =
+      cos(DegToRad(options.min_triangulation_angle_degrees));
+
+  int num_triangulated_points = 0;
+  for (int i = 0; i < points1.size(); i++) {
+    Vector2d corrected_point1, corrected_point2;
+    FindOptimalImagePoints(
+        ematrix, points1[i], points2[i], &corrected_point1, &corrected_point2);
+
+    // The corrected points satisfy the epipolar constraint up to the accuracy
+    // of the correction, so the DLT system has rank 3 and its nullspace is
+    // orthogonal to any three independent rows. Both choices of the third row
+    // are computed and the better conditioned one is kept.
+    const Vector4d row1 =
+        corrected_point1[0] * pose1.row(2) - pose1.row(0);
+    const Vector4d row2 =
+        corrected_point1[1] * pose1.row(2) - pose1.row(1);
+    const Vector4d row3 =
+        corrected_point2[0] * pose2.row(2) - pose2.row(0);
+    const Vector4d row4 =
+        corrected_point2[1] * pose2.row(2) - pose2.row(1);
+    const Vector4d point_a = OrthogonalVector(row1, row2, row3);
+    const Vector4d point_b = OrthogonalVector(row1, row2, row4);
+    Vector4d& point = (*triangulated_points)[i];
+    point = point_a.squaredNorm() > point_b.squaredNorm() ? point_a : point_b;
+    if (!(point.squaredNorm() > 0.0) || !point.allFinite()) {
+      (*statuses)[i] = TriangulationStatus::FAILED;
+      continue;
+    }
+    point.normalize();
+
+    const Vector3d directions[2] = {
+        DirectionToPoint(center1, point).normalized(),
+        DirectionToPoint(center2, point).normalized()};
+    if (!SufficientAngle(directions, 2, cos_of_min_angle)) {
+      (*statuses)[i] = TriangulationStatus::INSUFFICIENT_ANGLE;
+    } else if (options.check_cheirality &&
+               (!PositiveDepth(pose1, sign1, point) ||
+                !PositiveDepth(pose2, sign2, point))) {
+      (*statuses)[i] = TriangulationStatus::BEHIND_CAMERA;
+    } else {
+      (*statuses)[i] = TriangulationStatus::SUCCESS;
+      ++num_triangulated_points;
+    }
+  }
+  return num_triangulated_points;
+}
+
+int TriangulateMidpointBatch(const BatchTriangulationOptions& options,
+                             const std::vector<int>& ray_offsets,
+                             const std::vector<Vector3d>& ray_origins,
+                             const std::vector<Vector3d>& ray_directions,
+                             std::vector<Vector4d>* triangulated_points,
+                             std::vector<TriangulationStatus>* statuses) {
+  CHECK(!ray_offsets.empty());
+  CHECK_EQ(ray_origins.size(), ray_directions.size());
+  CHECK_EQ(ray_offsets.back(), ray_origins.size());
+  const int num_points = ray_offsets.size() - 1;
+  CHECK_NOTNULL(triangulated_points)->resize(num_points);
+  CHECK_NOTNULL(statuses)->resize(num_points);
+
+  const double cos_of_min_angle =
+      cos(DegToRad(options.min_triangulation_angle_degrees));
+
+  int num_triangulated_points = 0;
+  for (int i = 0; i < num_points; i++) {
+    const int begin = ray_offsets[i];
+    const int num_rays = ray_offsets[i + 1] - begin;
+    if (!SufficientAngle(
+            ray_directions.data() + begin, num_rays, cos_of_min_angle)) {
+      (*statuses)[i] = TriangulationStatus::INSUFFICIENT_ANGLE;
+      continue;
+    }
+
+    // The point closest to all rays solves the 3x3 system
+    // sum(I - d * d^t) * x = sum((I - d * d^t) * o).
+    Matrix3d A = Matrix3d::Zero();
+    Vector3d b = Vector3d::Zero();
+    for (int j = begin; j < begin + num_rays; j++) {
+      const Matrix3d A_term = Matrix3d::Identity() -
+                              ray_directions[j] * ray_directions[j].transpose();
+      A += A_term;
+      b += A_term * ray_origins[j];
+    }
+    const Eigen::LLT<Matrix3d> linear_solver(A);
+    if (linear_solver.info() != Eigen::Success) {
+      (*statuses)[i] = TriangulationStatus::FAILED;
+      continue;
+    }
+    const Vector3d point = linear_solver.solve(b);
+    (*triangulated_points)[i] = point.homogeneous();
+
+    (*statuses)[i] = TriangulationStatus::SUCCESS;
+    if (options.check_cheirality) {
+      for (int j = begin; j < begin + num_rays; j++) {
+        if ((point - ray_origins[j]).dot(ray_directions[j]) <= 0.0) {
+          (*statuses)[i] = TriangulationStatus::BEHIND_CAMERA;
+          break;
+        }
+      }
+    }
+    if ((*statuses)[i] == TriangulationStatus::SUCCESS) {
+      ++num_triangulated_points;
+    }
+  }
+  return num_triangulated_points;
+}
+
 }  // namespace theia
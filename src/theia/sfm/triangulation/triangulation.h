@@ -103,6 +103,56 @@ bool SufficientTriangulationAngle(
     const std::vector<Eigen::Vector3d>& ray_directions,
     const double min_triangulation_angle_degrees);
 
+// The batch triangulation functions below triangulate many points in a single
+// pass over contiguous arrays of observations. They use fixed-size arithmetic
+// only and fold the triangulation angle and cheirality checks into the same
+// pass. The result of each point is reported with one of these values.
+enum class TriangulationStatus {
+  SUCCESS = 0,
+  // No two observations of the point have a sufficient triangulation angle.
+  // Points with less than two observations always have this status.
+  INSUFFICIENT_ANGLE = 1,
+  // The linear system of the triangulation is degenerate.
+  FAILED = 2,
+  // The point lies behind at least one of the cameras.
+  BEHIND_CAMERA = 3
+};
+
+struct BatchTriangulationOptions {
+  // Points are only triangulated if the angle between at least one pair of
+  // observations is larger than this.
+  double min_triangulation_angle_degrees = 0.0;
+
+  // If true, points must be in front of all cameras that observe them.
+  bool check_cheirality = true;
+};
+
+// Triangulates the correspondences points1[i] <-> points2[i] of two posed views
+// with the optimal method of Lindstrom (see Triangulate). The essential matrix
+// and camera centers are only computed once for all points, and the nullspace
+// of the DLT system is computed in closed form. Returns the number of points
+// that were triangulated successfully.
+int TriangulateBatch(const BatchTriangulationOptions& options,
+                     const Matrix3x4d& pose1,
+                     const Matrix3x4d& pose2,
+                     const std::vector<Eigen::Vector2d>& points1,
+                     const std::vector<Eigen::Vector2d>& points2,
+                     std::vector<Eigen::Vector4d>* triangulated_points,
+                     std::vector<TriangulationStatus>* statuses);
+
+// Triangulates many points with the midpoint method (see TriangulateMidpoint).
+// The rays of point i are the entries [ray_offsets[i], ray_offsets[i + 1]) of
+// ray_origins and ray_directions, so ray_offsets holds one more entry than
+// there are points. The ray directions must be unit vectors. Returns the number
+// of points that were triangulated successfully.
+int TriangulateMidpointBatch(
+    const BatchTriangulationOptions& options,
+    const std::vector<int>& ray_offsets,
+    const std::vector<Eigen::Vector3d>& ray_origins,
+    const std::vector<Eigen::Vector3d>& ray_directions,
+    std::vector<Eigen::Vector4d>* triangulated_points,
+    std::vector<TriangulationStatus>* statuses);
+
 }  // namespace theia
 
 #endif  // THEIA_SFM_TRIANGULATION_TRIANGULATION_H_
@@ -496,5 +496,162 @@ TEST(SufficientTriangulationAngle, TwoInsufficient) {
   EXPECT_FALSE(SufficientTriangulationAngle(rays, kMinSufficientAngle));
 }
 
+// Creates two cameras looking at the origin from different sides, the points
+// and their noiseless projections.
+void CreateTwoViewBatch(const int num_points,
+                        Matrix3x4d* pose1,
+                        Matrix3x4d* pose2,
+                        std::vector<Vector3d>* points,
+                        std::vector<Vector2d>* image_points1,
+                        std::vector<Vector2d>* image_points2) {
+  const Matrix3d rotation =
+      Eigen::AngleAxisd(DegToRad(15.0), Vector3d::UnitY()).toRotationMatrix();
+  *pose1 << Matrix3d::Identity(), Vector3d(0.0, 0.0, 5.0);
+  *pose2 << rotation, Vector3d(-1.0, 0.1, 5.0);
+  for (int i = 0; i < num_points; i++) {
+    points->emplace_back(rng.RandVector3d());
+    image_points1->emplace_back(
+        (*pose1 * points->back().homogeneous()).eval().hnormalized());
+    image_points2->emplace_back(
+        (*pose2 * points->back().homogeneous()).eval().hnormalized());
+  }
+}
+
+TEST(TriangulationBatch, MatchesTriangulate) {
+  static const int kNumPoints = 20;
+  // The corrected image points only satisfy the epipolar constraint
+  // approximately, so the closed form nullspace differs slightly from the SVD
+  // used by Triangulate.
+  static const double kTolerance = 1e-6;
+
+  Matrix3x4d pose1, pose2;
+  std::vector<Vector3d> points;
+  std::vector<Vector2d> image_points1, image_points2;
+  CreateTwoViewBatch(
+      kNumPoints, &pose1, &pose2, &points, &image_points1, &image_points2);
+  for (int i = 0; i < kNumPoints; i++) {
+    AddNoiseToProjection(1.0 / 512.0, &rng, &image_points1[i]);
+    AddNoiseToProjection(1.0 / 512.0, &rng, &image_points2[i]);
+  }
+
+  BatchTriangulationOptions options;
+  std::vector<Vector4d> triangulated_points;
+  std::vector<TriangulationStatus> statuses;
+  EXPECT_EQ(TriangulateBatch(options,
+                             pose1,
+                             pose2,
+                             image_points1,
+                             image_points2,
+                             &triangulated_points,
+                             &statuses),
+            kNumPoints);
+  for (int i = 0; i < kNumPoints; i++) {
+    EXPECT_EQ(statuses[i], TriangulationStatus::SUCCESS);
+    Vector4d expected_point;
+    EXPECT_TRUE(Triangulate(
+        pose1, pose2, image_points1[i], image_points2[i], &expected_point));
+    EXPECT_LT((triangulated_points[i].hnormalized() -
+               expected_point.hnormalized()).norm(),
+              kTolerance);
+  }
+}
+
+TEST(TriangulationBatch, ChecksAngleAndCheirality) {
+  Matrix3x4d pose1, pose2;
+  std::vector<Vector3d> points;
+  std::vector<Vector2d> image_points1, image_points2;
+  CreateTwoViewBatch(1, &pose1, &pose2, &points, &image_points1, &image_points2);
+
+  // The projections of a point behind both cameras are the projections of the
+  // point mirrored through the camera centers.
+  const Vector3d point_behind(0.0, 0.0, -10.0);
+  image_points1.emplace_back(
+      (pose1 * point_behind.homogeneous()).eval().hnormalized());
+  image_points2.emplace_back(
+      (pose2 * point_behind.homogeneous()).eval().hnormalized());
+
+  BatchTriangulationOptions options;
+  std::vector<Vector4d> triangulated_points;
+  std::vector<TriangulationStatus> statuses;
+  EXPECT_EQ(TriangulateBatch(options,
+                             pose1,
+                             pose2,
+                             image_points1,
+                             image_points2,
+                             &triangulated_points,
+                             &statuses),
+            1);
+  EXPECT_EQ(statuses[0], TriangulationStatus::SUCCESS);
+  EXPECT_EQ(statuses[1], TriangulationStatus::BEHIND_CAMERA);
+
+  // The angle between the cameras is at most 30 degrees at the points.
+  options.min_triangulation_angle_degrees = 45.0;
+  EXPECT_EQ(TriangulateBatch(options,
+                             pose1,
+                             pose2,
+                             image_points1,
+                             image_points2,
+                             &triangulated_points,
+                             &statuses),
+            0);
+  EXPECT_EQ(statuses[0], TriangulationStatus::INSUFFICIENT_ANGLE);
+}
+
+TEST(TriangulationMidpointBatch, MatchesTriangulateMidpoint) {
+  static const int kNumPoints = 20;
+  static const double kTolerance = 1e-10;
+
+  // Each point is observed by a different number of rays. The last point only
+  // has one ray.
+  std::vector<int> ray_offsets = {0};
+  std::vector<Vector3d> origins, directions;
+  for (int i = 0; i < kNumPoints; i++) {
+    const Vector3d point = rng.RandVector3d();
+    const int num_rays = i + 1 < kNumPoints ? 2 + i % 3 : 1;
+    for (int j = 0; j < num_rays; j++) {
+      origins.emplace_back(5.0 * rng.RandVector3d() + Vector3d(0, 0, -10.0));
+      directions.emplace_back(
+          (point - origins.back() + 0.01 * rng.RandVector3d()).normalized());
+    }
+    ray_offsets.emplace_back(origins.size());
+  }
+
+  BatchTriangulationOptions options;
+  std::vector<Vector4d> triangulated_points;
+  std::vector<TriangulationStatus> statuses;
+  EXPECT_EQ(TriangulateMidpointBatch(options,
+                                     ray_offsets,
+                                     origins,
+                                     directions,
+                                     &triangulated_points,
+                                     &statuses),
+            kNumPoints - 1);
+  for (int i = 0; i + 1 < kNumPoints; i++) {
+    EXPECT_EQ(statuses[i], TriangulationStatus::SUCCESS);
+    const std::vector<Vector3d> point_origins(
+        origins.begin() + ray_offsets[i], origins.begin() + ray_offsets[i + 1]);
+    const std::vector<Vector3d> point_directions(
+        directions.begin() + ray_offsets[i],
+        directions.begin() + ray_offsets[i + 1]);
+    Vector4d expected_point;
+    EXPECT_TRUE(
+        TriangulateMidpoint(point_origins, point_directions, &expected_point));
+    EXPECT_LT((triangulated_points[i] - expected_point).norm(), kTolerance);
+  }
+  EXPECT_EQ(statuses.back(), TriangulationStatus::INSUFFICIENT_ANGLE);
+
+  // Flip the rays of the first point so that it lies behind the origins.
+  for (int j = ray_offsets[0]; j < ray_offsets[1]; j++) {
+    directions[j] *= -1.0;
+  }
+  TriangulateMidpointBatch(options,
+                           ray_offsets,
+                           origins,
+                           directions,
+                           &triangulated_points,
+                           &statuses);
+  EXPECT_EQ(statuses[0], TriangulationStatus::BEHIND_CAMERA);
+}
+
 }  // namespace
 }  // namespace theia
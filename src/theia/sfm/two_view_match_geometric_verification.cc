@@ -41,6 +41,7 @@
 #include "theia/matching/guided_epipolar_matcher.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjust_two_views.h"
 #include "theia/sfm/bundle_adjustment/bundle_adjustment.h"
+#include "theia/sfm/camera/projection_matrix_utils.h"
 #include "theia/sfm/camera_intrinsics_prior.h"
 #include "theia/sfm/estimate_twoview_info.h"
 #include "theia/sfm/estimators/estimate_homography.h"
@@ -120,17 +121,28 @@ bool TwoViewMatchGeometricVerification::VerifyMatches(
   std::vector<FeatureCorrespondence> correspondences;
   CreateCorrespondencesFromIndexedMatches(&correspondences);
 
-  // Estimate a homography (before the matches_ container is modified).
-  twoview_info->num_homography_inliers = CountHomographyInliers();
-
-  // Estimate 2-view geometry from feature matches.
+  // Estimate 2-view geometry from feature matches. If possible, the homography
+  // inliers are counted from the same RANSAC hypotheses.
+  const bool share_homography_hypotheses =
+      options_.share_homography_hypotheses &&
+      intrinsics1_.focal_length.is_set && intrinsics2_.focal_length.is_set;
   std::vector<int> inlier_indices;
-  if (!EstimateTwoViewInfo(options_.estimate_twoview_info_options,
-                           intrinsics1_,
-                           intrinsics2_,
-                           correspondences,
-                           twoview_info,
-                           &inlier_indices)) {
+  if (share_homography_hypotheses) {
+    if (!EstimateTwoViewInfoAndHomographyInliers(
+            options_.estimate_twoview_info_options,
+            intrinsics1_,
+            intrinsics2_,
+            correspondences,
+            twoview_info,
+            &inlier_indices)) {
+      return false;
+    }
+  } else if (!EstimateTwoViewInfo(options_.estimate_twoview_info_options,
+                                  intrinsics1_,
+                                  intrinsics2_,
+                                  correspondences,
+                                  twoview_info,
+                                  &inlier_indices)) {
     return false;
   }
   VLOG(2) << inlier_indices.size()
@@ -141,6 +153,13 @@ bool TwoViewMatchGeometricVerification::VerifyMatches(
     return false;
   }
 
+  // Estimate a homography (before the matches_ container is modified). This is
+  // only done for pairs that pass the initial verification since the number of
+  // homography inliers does not affect whether the pair is accepted.
+  if (!share_homography_hypotheses) {
+    twoview_info->num_homography_inliers = CountHomographyInliers();
+  }
+
   // Update the current set of matches.
   std::vector<IndexedFeatureMatch> new_matches;
   new_matches.reserve(inlier_indices.size());
@@ -156,6 +175,7 @@ bool TwoViewMatchGeometricVerification::VerifyMatches(
   // Perform guided matching if desired.
   if (options_.guided_matching) {
     GuidedEpipolarMatcher::Options guided_matching_options;
+    guided_matching_options.rng = options_.estimate_twoview_info_options.rng;
     guided_matching_options.guided_matching_max_distance_pixels =
         options_.guided_matching_max_distance_pixels;
     guided_matching_options.lowes_ratio = options_.guided_matching_lowes_ratio;
@@ -167,9 +187,14 @@ bool TwoViewMatchGeometricVerification::VerifyMatches(
     }
   }
 
+  // Bundle adjustment can only remove matches, so it cannot change the outcome
+  // if there are already too few matches to accept the pair.
+  if (matches_.size() <= options_.min_num_inlier_matches) {
+    return false;
+  }
+
   // Perform BA if desired.
-  if (options_.bundle_adjustment &&
-      matches_.size() > options_.min_num_inlier_matches) {
+  if (options_.bundle_adjustment) {
     if (!BundleAdjustRelativePose(twoview_info)) {
       return false;
     }
@@ -189,34 +214,62 @@ void TwoViewMatchGeometricVerification::TriangulatePoints(
       options_.triangulation_max_reprojection_error *
       options_.triangulation_max_reprojection_error;
 
-  // Triangulate all points, throwing out the ones with bad initial reprojection
-  // errors.
-  const std::vector<Eigen::Vector3d> origins = {camera1_.GetPosition(),
-                                                camera2_.GetPosition()};
+  // Gather the features of all matches so that they can be triangulated in a
+  // single pass. The calibration of each camera is removed in a single batch
+  // and the normalized points are triangulated with the calibrated poses.
+  std::vector<Feature> features1(matches_.size()), features2(matches_.size());
+  for (int i = 0; i < matches_.size(); i++) {
+    const Keypoint& keypoint1 = features1_.keypoints[matches_[i].feature1_ind];
+    const Keypoint& keypoint2 = features2_.keypoints[matches_[i].feature2_ind];
+    features1[i] = Feature(keypoint1.x(), keypoint1.y());
+    features2[i] = Feature(keypoint2.x(), keypoint2.y());
+  }
+  std::vector<Eigen::Vector3d> normalized_rays1, normalized_rays2;
+  camera1_.PixelsToNormalizedCoordinates(features1, &normalized_rays1);
+  camera2_.PixelsToNormalizedCoordinates(features2, &normalized_rays2);
+  std::vector<Eigen::Vector2d> normalized_points1(matches_.size()),
+      normalized_points2(matches_.size());
+  for (int i = 0; i < matches_.size(); i++) {
+    normalized_points1[i] = normalized_rays1[i].hnormalized();
+    normalized_points2[i] = normalized_rays2[i].hnormalized();
+  }
+
+  Matrix3x4d pose1, pose2;
+  ComposeProjectionMatrix(Eigen::Matrix3d::Identity(),
+                          camera1_.GetOrientationAsAngleAxis(),
+                          camera1_.GetPosition(),
+                          &pose1);
+  ComposeProjectionMatrix(Eigen::Matrix3d::Identity(),
+                          camera2_.GetOrientationAsAngleAxis(),
+                          camera2_.GetPosition(),
+                          &pose2);
+
+  // Triangulate all points, making sure that there is enough baseline between
+  // the cameras so that the triangulation is well-constrained.
+  BatchTriangulationOptions triangulation_options;
+  triangulation_options.min_triangulation_angle_degrees =
+      options_.min_triangulation_angle_degrees;
+  std::vector<Eigen::Vector4d> points;
+  std::vector<TriangulationStatus> statuses;
+  TriangulateBatch(triangulation_options,
+                   pose1,
+                   pose2,
+                   normalized_points1,
+                   normalized_points2,
+                   &points,
+                   &statuses);
+
+  // Throw out the points with bad initial reprojection errors.
   std::vector<IndexedFeatureMatch> triangulated_matches;
   triangulated_matches.reserve(matches_.size());
   int num_bad_triangulation_angles = 0;
   int num_failed_triangulations = 0;
   int num_bad_reprojection_errors = 0;
   for (int i = 0; i < matches_.size(); i++) {
-    const Keypoint& keypoint1 = features1_.keypoints[matches_[i].feature1_ind];
-    const Keypoint& keypoint2 = features2_.keypoints[matches_[i].feature2_ind];
-    const Feature feature1(keypoint1.x(), keypoint1.y());
-    const Feature feature2(keypoint2.x(), keypoint2.y());
-
-    // Make sure that there is enough baseline between the point so that the
-    // triangulation is well-constrained.
-    std::vector<Eigen::Vector3d> ray_directions(2);
-    ray_directions[0] = camera1_.PixelToUnitDepthRay(feature1).normalized();
-    ray_directions[1] = camera2_.PixelToUnitDepthRay(feature2).normalized();
-    if (!SufficientTriangulationAngle(
-            ray_directions, options_.min_triangulation_angle_degrees)) {
+    if (statuses[i] == TriangulationStatus::INSUFFICIENT_ANGLE) {
       ++num_bad_triangulation_angles;
       continue;
-    }
-
-    Eigen::Vector4d point3d;
-    if (!TriangulateMidpoint(origins, ray_directions, &point3d)) {
+    } else if (statuses[i] != TriangulationStatus::SUCCESS) {
       ++num_failed_triangulations;
       continue;
     }
@@ -225,19 +278,19 @@ void TwoViewMatchGeometricVerification::TriangulatePoints(
     // small enough reprojection error.
     if (!AcceptableReprojectionError(
             camera1_,
-            feature1,
-            point3d,
+            features1[i],
+            points[i],
             triangulation_sq_max_reprojection_error_pixels) ||
         !AcceptableReprojectionError(
             camera2_,
-            feature2,
-            point3d,
+            features2[i],
+            points[i],
             triangulation_sq_max_reprojection_error_pixels)) {
       ++num_bad_reprojection_errors;
       continue;
     }
 
-    triangulated_points->emplace_back(point3d);
+    triangulated_points->emplace_back(points[i]);
     triangulated_matches.emplace_back(matches_[i]);
   }
   VLOG(2) << "Num acceptable triangulations = " << triangulated_matches.size()
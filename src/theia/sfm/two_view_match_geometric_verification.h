@@ -58,6 +58,16 @@ class TwoViewMatchGeometricVerification {
     // Minimum number of inlier matches in order to return true.
     int min_num_inlier_matches = 30;
 
+    // The number of homography inliers is normally computed with a separate
+    // homography RANSAC. If this is set to true and both views are calibrated,
+    // a homography is instead fit to each minimal sample of the relative pose
+    // RANSAC and scored in the same iteration with the same threshold, so that
+    // only one consensus search is performed for the image pair. Since the
+    // homographies are only fit to the relative pose samples, the number of
+    // homography inliers may be lower than with the separate RANSAC.
+    // Uncalibrated pairs always use the separate homography RANSAC.
+    bool share_homography_hypotheses = false;
+
     // Perform guided matching to find more matches after initial geometry
     // estimation. Guided matching uses the current estimate for two-view
     // geometry to perform a constrained search along epipolar lines
@@ -106,6 +116,12 @@ class TwoViewMatchGeometricVerification {
   bool VerifyMatches(std::vector<FeatureCorrespondence>* verified_matches,
                      TwoViewInfo* twoview_info);
 
+  // The feature indices of the verified matches, in the same order as the
+  // verified correspondences. Only valid after VerifyMatches returns true.
+  const std::vector<IndexedFeatureMatch>& VerifiedMatchIndices() const {
+    return matches_;
+  }
+
  private:
   // A helper method that creates a vector of FeatureCorrespondence from the
   // matches_ vector of match indices.
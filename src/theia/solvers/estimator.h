@@ -36,9 +36,6 @@
 #define THEIA_SOLVERS_ESTIMATOR_H_
 
 #include <glog/logging.h>
-#ifdef THEIA_USE_OPENMP
-#include <omp.h>
-#endif
 #include <vector>
 
 namespace theia {
@@ -91,17 +88,36 @@ template <typename DatumType, typename ModelType> class Estimator {
   // that calls Error() on each data point, but this function can be useful if
   // the errors of multiple points may be estimated simultanesously (e.g.,
   // matrix multiplication to compute the reprojection error of many points at
-  // once).
+  // once). No threads are spawned here since estimation is typically already
+  // run in parallel across image pairs or tracks.
   virtual std::vector<double> Residuals(const std::vector<Datum>& data,
                                         const Model& model) const {
     std::vector<double> residuals(data.size());
-#pragma omp parallel for
     for (int i = 0; i < data.size(); i++) {
       residuals[i] = Error(data[i], model);
     }
     return residuals;
   }
 
+  // Estimators may optionally provide a batch residual kernel. Before any
+  // models are scored, the data is passed to PrepareBatchResiduals so that it
+  // may be converted to a structure-of-arrays layout, which allows the
+  // residuals of all data points to be computed with vectorized arithmetic.
+  // Returns true if batch residuals are supported, in which case
+  // BatchResiduals may be called in place of Residuals for the prepared data.
+  // Estimators implementing this hold the prepared data, so an estimator must
+  // not be shared between concurrent sample consensus estimations.
+  virtual bool PrepareBatchResiduals(const std::vector<Datum>& data) const {
+    return false;
+  }
+
+  // Computes the residuals of all data passed to PrepareBatchResiduals, which
+  // must match the output of Residuals for the same data.
+  virtual void BatchResiduals(const Model& model,
+                              std::vector<double>* residuals) const {
+    LOG(FATAL) << "This estimator does not implement batch residuals.";
+  }
+
   // Returns the set inliers of the data set based on the error threshold
   // provided.
   std::vector<int> GetInliers(const std::vector<Datum>& data,
@@ -163,6 +163,13 @@ class SampleConsensusEstimator {
   //   particular type of sampling consensus.
   bool Initialize(Sampler* sampler);
 
+  // Computes the residuals of the data for the model. The batch residual
+  // kernel of the estimator is used if it was successfully prepared.
+  void ComputeResiduals(const std::vector<Datum>& data,
+                        const Model& model,
+                        const bool use_batch_residuals,
+                        std::vector<double>* residuals) const;
+
   // Computes the maximum number of iterations required to ensure the inlier
   // ratio is the best with a probability corresponding to log_failure_prob.
   int ComputeMaxIterations(const double min_sample_size,
@@ -242,6 +249,19 @@ int SampleConsensusEstimator<ModelEstimator>::ComputeMaxIterations(
                            static_cast<double>(ransac_params_.max_iterations)));
 }
 
+template <class ModelEstimator>
+void SampleConsensusEstimator<ModelEstimator>::ComputeResiduals(
+    const std::vector<Datum>& data,
+    const Model& model,
+    const bool use_batch_residuals,
+    std::vector<double>* residuals) const {
+  if (use_batch_residuals) {
+    estimator_.BatchResiduals(model, residuals);
+  } else {
+    *residuals = estimator_.Residuals(data, model);
+  }
+}
+
 template <class ModelEstimator>
 bool SampleConsensusEstimator<ModelEstimator>::Estimate(
     const std::vector<Datum>& data, Model* best_model, RansacSummary* summary) {
@@ -260,6 +280,10 @@ bool SampleConsensusEstimator<ModelEstimator>::Estimate(
 
   summary->num_input_data_points = data.size();
 
+  // Prepare the batch residual kernel of the estimator if one is available.
+  const bool use_batch_residuals = estimator_.PrepareBatchResiduals(data);
+  std::vector<double> residuals;
+
   const double log_failure_prob = log(ransac_params_.failure_probability);
   double best_cost = std::numeric_limits<double>::max();
   int max_iterations = ransac_params_.max_iterations;
@@ -296,8 +320,7 @@ bool SampleConsensusEstimator<ModelEstimator>::Estimate(
 
     // Calculate residuals from estimated model.
     for (const Model& temp_model : temp_models) {
-      const std::vector<double> residuals =
-          estimator_.Residuals(data, temp_model);
+      ComputeResiduals(data, temp_model, use_batch_residuals, &residuals);
 
       // Determine cost of the generated model.
       std::vector<int> inlier_indices;
@@ -330,9 +353,8 @@ bool SampleConsensusEstimator<ModelEstimator>::Estimate(
   }
 
   // Compute the final inliers for the best model.
-  const std::vector<double> best_residuals =
-      estimator_.Residuals(data, *best_model);
-  quality_measurement_->ComputeCost(best_residuals, &summary->inliers);
+  ComputeResiduals(data, *best_model, use_batch_residuals, &residuals);
+  quality_measurement_->ComputeCost(residuals, &summary->inliers);
 
   const double inlier_ratio =
       static_cast<double>(summary->inliers.size()) / data.size();
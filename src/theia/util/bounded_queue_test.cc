@@ -0,0 +1,119 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "theia/util/bounded_queue.h"
+
+namespace theia {
+
+TEST(BoundedQueue, FirstInFirstOut) {
+  BoundedQueue<int> queue(3);
+  EXPECT_TRUE(queue.Push(1));
+  EXPECT_TRUE(queue.Push(2));
+  EXPECT_TRUE(queue.Push(3));
+  EXPECT_EQ(queue.Size(), 3);
+
+  int value;
+  for (int i = 1; i <= 3; i++) {
+    EXPECT_TRUE(queue.Pop(&value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_EQ(queue.Size(), 0);
+}
+
+TEST(BoundedQueue, PopDrainsQueueAfterClose) {
+  BoundedQueue<int> queue(2);
+  EXPECT_TRUE(queue.Push(1));
+  queue.Close();
+  EXPECT_FALSE(queue.Push(2));
+
+  int value;
+  EXPECT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(value, 1);
+  EXPECT_FALSE(queue.Pop(&value));
+}
+
+TEST(BoundedQueue, ProducersAndConsumers) {
+  static const int kNumProducers = 4;
+  static const int kNumConsumers = 3;
+  static const int kValuesPerProducer = 1000;
+  BoundedQueue<int> queue(5);
+
+  std::vector<std::thread> producers;
+  for (int i = 0; i < kNumProducers; i++) {
+    producers.emplace_back([&queue, i]() {
+      for (int j = 0; j < kValuesPerProducer; j++) {
+        queue.Push(i * kValuesPerProducer + j);
+      }
+    });
+  }
+
+  // Each consumer counts the values that it has popped.
+  std::vector<std::vector<int> > counts(
+      kNumConsumers, std::vector<int>(kNumProducers * kValuesPerProducer, 0));
+  std::vector<std::thread> consumers;
+  for (int i = 0; i < kNumConsumers; i++) {
+    consumers.emplace_back([&queue, &counts, i]() {
+      int value;
+      while (queue.Pop(&value)) {
+        EXPECT_LE(queue.Size(), queue.Capacity());
+        ++counts[i][value];
+      }
+    });
+  }
+
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  queue.Close();
+  for (std::thread& consumer : consumers) {
+    consumer.join();
+  }
+
+  // Every value must have been popped exactly once.
+  for (int i = 0; i < kNumProducers * kValuesPerProducer; i++) {
+    int count = 0;
+    for (int j = 0; j < kNumConsumers; j++) {
+      count += counts[j][i];
+    }
+    EXPECT_EQ(count, 1);
+  }
+}
+
+}  // namespace theia
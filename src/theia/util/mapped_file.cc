@@ -0,0 +1,129 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include "theia/util/mapped_file.h"
+
+#include <glog/logging.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <fstream>  // NOLINT
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace theia {
+
+namespace {
+
+// Returned as the data of empty files so that data() is never null.
+const char kEmptyFile[] = "";
+
+}  // namespace
+
+MappedFile::MappedFile() : data_(kEmptyFile), size_(0), is_mapped_(false) {}
+
+MappedFile::~MappedFile() { Close(); }
+
+void MappedFile::Close() {
+#ifndef _WIN32
+  if (is_mapped_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+  std::vector<char>().swap(buffer_);
+  data_ = kEmptyFile;
+  size_ = 0;
+  is_mapped_ = false;
+}
+
+bool MappedFile::Open(const std::string& filename) {
+  Close();
+
+#ifdef _WIN32
+  std::ifstream input_reader(filename, std::ios::in | std::ios::binary);
+  if (!input_reader.is_open()) {
+    LOG(ERROR) << "Could not open the file: " << filename << " for reading.";
+    return false;
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(input_reader),
+                 std::istreambuf_iterator<char>());
+  if (!buffer_.empty()) {
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+  }
+  return true;
+#else
+  const int file_descriptor = open(filename.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    LOG(ERROR) << "Could not open the file: " << filename << " for reading.";
+    return false;
+  }
+  struct stat file_status;
+  if (fstat(file_descriptor, &file_status) != 0) {
+    LOG(ERROR) << "Could not determine the size of " << filename;
+    close(file_descriptor);
+    return false;
+  }
+
+  // mmap does not accept empty mappings.
+  if (file_status.st_size == 0) {
+    close(file_descriptor);
+    return true;
+  }
+
+  void* data = mmap(nullptr,
+                    file_status.st_size,
+                    PROT_READ,
+                    MAP_SHARED,
+                    file_descriptor,
+                    0);
+  close(file_descriptor);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Could not map the file: " << filename << " into memory.";
+    return false;
+  }
+  data_ = static_cast<const char*>(data);
+  size_ = file_status.st_size;
+  is_mapped_ = true;
+  return true;
+#endif
+}
+
+}  // namespace theia
@@ -35,64 +35,169 @@
 #include "theia/util/random.h"
 
 #include <glog/logging.h>
+#include <stdint.h>
+#include <atomic>
 #include <chrono>  // NOLINT
-#include <random>
+#include <cmath>
+#include <string>
 
 #include "theia/util/util.h"
 
 namespace theia {
 namespace {
 
-#ifdef THEIA_HAS_THREAD_LOCAL_KEYWORD
-thread_local std::mt19937 util_generator;
-#else
-static std::mt19937 util_generator;
-#endif  // THEIA_HAS_THREAD_LOCAL_KEYWORD
+// Philox4x32 multipliers and Weyl sequence constants for the key schedule.
+const uint32_t kPhiloxM0 = 0xD2511F53;
+const uint32_t kPhiloxM1 = 0xCD9E8D57;
+const uint32_t kPhiloxW0 = 0x9E3779B9;
+const uint32_t kPhiloxW1 = 0xBB67AE85;
+const int kNumPhiloxRounds = 10;
+
+// Marks the counters used to derive the keys of streams so that they never
+// coincide with the counters used to draw numbers.
+const uint32_t kStreamCounterTag = 0x5354524D;
+
+// Distinguishes the time-seeded generators created at the same time.
+std::atomic<uint64_t> num_time_seeded_generators(0);
+
+inline void MultiplyHighLow(const uint32_t a,
+                            const uint32_t b,
+                            uint32_t* high,
+                            uint32_t* low) {
+  const uint64_t product = static_cast<uint64_t>(a) * b;
+  *high = static_cast<uint32_t>(product >> 32);
+  *low = static_cast<uint32_t>(product);
+}
+
+// Applies the Philox4x32-10 bijection to the counter.
+std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> counter,
+                                   std::array<uint32_t, 2> key) {
+  for (int i = 0; i < kNumPhiloxRounds; i++) {
+    if (i > 0) {
+      key[0] += kPhiloxW0;
+      key[1] += kPhiloxW1;
+    }
+    uint32_t high0, low0, high1, low1;
+    MultiplyHighLow(kPhiloxM0, counter[0], &high0, &low0);
+    MultiplyHighLow(kPhiloxM1, counter[2], &high1, &low1);
+    counter = {{high1 ^ counter[1] ^ key[0],
+                low1,
+                high0 ^ counter[3] ^ key[1],
+                low0}};
+  }
+  return counter;
+}
 
 }  // namespace
 
-RandomNumberGenerator::RandomNumberGenerator() {
-  const unsigned seed =
-      std::chrono::system_clock::now().time_since_epoch().count();
-  util_generator.seed(seed);
+RandomNumberGenerator::RandomNumberGenerator()
+    : RandomNumberGenerator(static_cast<unsigned>(
+          std::chrono::system_clock::now().time_since_epoch().count())) {
+  *this = Stream(num_time_seeded_generators++);
 }
 
 RandomNumberGenerator::RandomNumberGenerator(const unsigned seed) {
-  util_generator.seed(seed);
+  Seed(seed);
 }
 
+RandomNumberGenerator::RandomNumberGenerator(const unsigned seed,
+                                             const uint64_t stream_id)
+    : RandomNumberGenerator(RandomNumberGenerator(seed).Stream(stream_id)) {}
+
+RandomNumberGenerator::RandomNumberGenerator(const Key& key)
+    : key_(key), counter_({{0, 0, 0, 0}}), block_index_(4) {}
+
 void RandomNumberGenerator::Seed(const unsigned seed) {
-  util_generator.seed(seed);
+  key_ = {{seed, 0}};
+  counter_ = {{0, 0, 0, 0}};
+  block_index_ = 4;
+}
+
+RandomNumberGenerator RandomNumberGenerator::Stream(
+    const uint64_t stream_id) const {
+  const Counter stream_counter = {{static_cast<uint32_t>(stream_id),
+                                   static_cast<uint32_t>(stream_id >> 32),
+                                   kStreamCounterTag,
+                                   kStreamCounterTag}};
+  const Counter stream_block = Philox4x32(stream_counter, key_);
+  return RandomNumberGenerator(Key({{stream_block[0], stream_block[1]}}));
+}
+
+void RandomNumberGenerator::GenerateBlock() {
+  block_ = Philox4x32(counter_, key_);
+  block_index_ = 0;
+  // Increment the 64 bit draw counter.
+  if (++counter_[0] == 0) {
+    ++counter_[1];
+  }
+}
+
+uint32_t RandomNumberGenerator::RandBits() {
+  if (block_index_ == 4) {
+    GenerateBlock();
+  }
+  return block_[block_index_++];
+}
+
+uint64_t RandomNumberGenerator::RandBits64() {
+  const uint64_t high = RandBits();
+  return (high << 32) | RandBits();
 }
 
 // Get a random double between lower and upper (inclusive).
 double RandomNumberGenerator::RandDouble(const double lower,
                                          const double upper) {
-  std::uniform_real_distribution<double> distribution(lower, upper);
-  return distribution(util_generator);
+  // Use the 53 most significant bits for a uniform number in [0, 1).
+  const double uniform = (RandBits64() >> 11) * (1.0 / 9007199254740992.0);
+  return lower + (upper - lower) * uniform;
 }
 
 float RandomNumberGenerator::RandFloat(const float lower, const float upper) {
-  std::uniform_real_distribution<float> distribution(lower, upper);
-  return distribution(util_generator);
+  // Use the 24 most significant bits for a uniform number in [0, 1).
+  const float uniform = (RandBits() >> 8) * (1.0f / 16777216.0f);
+  return lower + (upper - lower) * uniform;
 }
 
 // Get a random int between lower and upper (inclusive).
 int RandomNumberGenerator::RandInt(const int lower, const int upper) {
-  std::uniform_int_distribution<int> distribution(lower, upper);
-  return distribution(util_generator);
+  DCHECK_LE(lower, upper);
+  const uint64_t range =
+      static_cast<uint64_t>(static_cast<int64_t>(upper) - lower) + 1;
+  if (range > 0xFFFFFFFFull) {
+    return static_cast<int>(static_cast<int64_t>(lower) + RandBits());
+  }
+
+  // Lemire's multiply-and-shift method with rejection of the biased values.
+  const uint32_t range32 = static_cast<uint32_t>(range);
+  uint64_t product = static_cast<uint64_t>(RandBits()) * range32;
+  if (static_cast<uint32_t>(product) < range32) {
+    const uint32_t threshold = (0u - range32) % range32;
+    while (static_cast<uint32_t>(product) < threshold) {
+      product = static_cast<uint64_t>(RandBits()) * range32;
+    }
+  }
+  return static_cast<int>(static_cast<int64_t>(lower) + (product >> 32));
 }
 
 // Gaussian Distribution with the corresponding mean and std dev.
 double RandomNumberGenerator::RandGaussian(const double mean,
                                            const double std_dev) {
-  std::normal_distribution<double> distribution(mean, std_dev);
-  return distribution(util_generator);
+  // Box-Muller transform. The first uniform number is in (0, 1] so that the
+  // logarithm is finite.
+  const double uniform1 = 1.0 - RandDouble(0.0, 1.0);
+  const double uniform2 = RandDouble(0.0, 1.0);
+  return mean + std_dev * std::sqrt(-2.0 * std::log(uniform1)) *
+                    std::cos(2.0 * M_PI * uniform2);
 }
-
+// The coordinates are drawn in order so that the vectors do not depend on the
+// evaluation order of constructor arguments.
 Eigen::Vector2d RandomNumberGenerator::RandVector2d(const double min,
                                                     const double max) {
-  return Eigen::Vector2d(RandDouble(min, max), RandDouble(min, max));
+  Eigen::Vector2d vector;
+  for (int i = 0; i < 2; i++) {
+    vector[i] = RandDouble(min, max);
+  }
+  return vector;
 }
 
 Eigen::Vector2d RandomNumberGenerator::RandVector2d() {
@@ -101,9 +206,11 @@ Eigen::Vector2d RandomNumberGenerator::RandVector2d() {
 
 Eigen::Vector3d RandomNumberGenerator::RandVector3d(const double min,
                                                     const double max) {
-  return Eigen::Vector3d(RandDouble(min, max),
-                         RandDouble(min, max),
-                         RandDouble(min, max));
+  Eigen::Vector3d vector;
+  for (int i = 0; i < 3; i++) {
+    vector[i] = RandDouble(min, max);
+  }
+  return vector;
 }
 
 Eigen::Vector3d RandomNumberGenerator::RandVector3d() {
@@ -112,14 +219,24 @@ Eigen::Vector3d RandomNumberGenerator::RandVector3d() {
 
 Eigen::Vector4d RandomNumberGenerator::RandVector4d(const double min,
                                                     const double max) {
-  return Eigen::Vector4d(RandDouble(min, max),
-                         RandDouble(min, max),
-                         RandDouble(min, max),
-                         RandDouble(min, max));
+  Eigen::Vector4d vector;
+  for (int i = 0; i < 4; i++) {
+    vector[i] = RandDouble(min, max);
+  }
+  return vector;
 }
 
 Eigen::Vector4d RandomNumberGenerator::RandVector4d() {
   return RandVector4d(-1.0, 1.0);
 }
 
+uint64_t StreamIdFromString(const std::string& name) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const char c : name) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
 }  // namespace theia
@@ -36,13 +36,23 @@
 #define THEIA_UTIL_RANDOM_H_
 
 #include <Eigen/Core>
+#include <stdint.h>
+#include <array>
 #include <random>
+#include <string>
 
 namespace theia {
 
-// A wrapper around the c++11 random generator utilities. This allows for a
-// thread-safe random number generator that may be easily instantiated and
-// passed around as an object.
+// A counter-based random number generator in the style of Philox4x32-10 (from
+// "Parallel Random Numbers: As Easy as 1, 2, 3" by Salmon et al., SC 2011).
+// Each random block is a keyed bijection of a counter, so every instance owns
+// a tiny state (a key and a counter) and independent streams are derived by
+// changing the key rather than by advancing a shared engine.
+//
+// An instance must not be used by several threads at once. Parallel code should
+// instead give each task its own generator with Stream(task_id): the numbers a
+// task draws then only depend on the seed and the task id, so the results are
+// identical for any number of threads or scheduling order.
 class RandomNumberGenerator {
  public:
   // Creates the random number generator using the current time as the seed.
@@ -51,9 +61,22 @@ class RandomNumberGenerator {
   // Creates the random number generator using the given seed.
   explicit RandomNumberGenerator(const unsigned seed);
 
+  // Creates the generator of stream stream_id for the given seed. This is
+  // equivalent to RandomNumberGenerator(seed).Stream(stream_id).
+  RandomNumberGenerator(const unsigned seed, const uint64_t stream_id);
+
   // Seeds the random number generator with the given value.
   void Seed(const unsigned seed);
 
+  // Returns an independent generator for the given stream (e.g., a task index
+  // or a hash of the task's inputs). The stream only depends on the seed of
+  // this generator and stream_id, not on how many numbers have been drawn, so
+  // this method is thread-safe and streams may be nested.
+  RandomNumberGenerator Stream(const uint64_t stream_id) const;
+
+  // Returns 32 uniformly distributed random bits.
+  uint32_t RandBits();
+
   // Get a random double between lower and upper (inclusive).
   double RandDouble(const double lower, const double upper);
 
@@ -95,8 +118,30 @@ class RandomNumberGenerator {
     }
   }
 
+ private:
+  typedef std::array<uint32_t, 2> Key;
+  typedef std::array<uint32_t, 4> Counter;
+
+  explicit RandomNumberGenerator(const Key& key);
+
+  // Returns a 64 bit random number.
+  uint64_t RandBits64();
+
+  // Computes the next block of random bits from the counter.
+  void GenerateBlock();
+
+  Key key_;
+  Counter counter_;
+  Counter block_;
+  int block_index_;
 };
 
+// Returns a stream id for a task that is identified by a name (e.g., an image
+// name) rather than an index, so that the stream does not depend on the order
+// in which the tasks are created. The FNV-1a hash is used since, unlike
+// std::hash, it is the same on all platforms.
+uint64_t StreamIdFromString(const std::string& name);
+
 }  // namespace theia
 
 #endif  // THEIA_UTIL_RANDOM_H_
@@ -0,0 +1,162 @@
+// Copyright (C) 2014 The Regents of the University of California (Regents).
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of The Regents or University of California nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Chris Sweeney (cmsweeney@cs.ucsb.edu)
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "theia/util/random.h"
+#include "theia/util/threadpool.h"
+
+namespace theia {
+
+// The first block of a generator seeded with 0 uses the all-zero key and
+// counter, for which the output of Philox4x32-10 is given by the known answer
+// tests of the Random123 library.
+TEST(RandomNumberGenerator, PhiloxKnownAnswer) {
+  RandomNumberGenerator rng(0);
+  EXPECT_EQ(rng.RandBits(), 0x6627e8d5u);
+  EXPECT_EQ(rng.RandBits(), 0xe169c58du);
+  EXPECT_EQ(rng.RandBits(), 0xbc57ac4cu);
+  EXPECT_EQ(rng.RandBits(), 0x9b00dbd8u);
+}
+
+TEST(RandomNumberGenerator, SeedRestartsTheSequence) {
+  RandomNumberGenerator rng1(13), rng2(14);
+  std::vector<uint32_t> sequence(10);
+  for (int i = 0; i < sequence.size(); i++) {
+    sequence[i] = rng1.RandBits();
+  }
+  rng2.Seed(13);
+  for (int i = 0; i < sequence.size(); i++) {
+    EXPECT_EQ(rng2.RandBits(), sequence[i]);
+  }
+}
+
+TEST(RandomNumberGenerator, StreamsDoNotDependOnTheState) {
+  RandomNumberGenerator rng(7);
+  RandomNumberGenerator stream1 = rng.Stream(3);
+  for (int i = 0; i < 17; i++) {
+    rng.RandBits();
+  }
+  RandomNumberGenerator stream2 = rng.Stream(3);
+  RandomNumberGenerator stream3(7, 3);
+  RandomNumberGenerator other_stream = rng.Stream(4);
+
+  int num_equal_to_other_stream = 0;
+  for (int i = 0; i < 100; i++) {
+    const uint32_t bits = stream1.RandBits();
+    EXPECT_EQ(stream2.RandBits(), bits);
+    EXPECT_EQ(stream3.RandBits(), bits);
+    if (other_stream.RandBits() == bits) {
+      ++num_equal_to_other_stream;
+    }
+  }
+  EXPECT_LT(num_equal_to_other_stream, 2);
+}
+
+// Draws from per-task streams with different numbers of threads and checks that
+// the results are identical.
+TEST(RandomNumberGenerator, StreamsAreReproducibleAcrossThreads) {
+  static const int kNumTasks = 64;
+  const RandomNumberGenerator rng(42);
+  std::vector<std::vector<double> > results;
+  for (const int num_threads : {1, 3, 8}) {
+    std::vector<double> task_results(kNumTasks);
+    {
+      ThreadPool pool(num_threads);
+      for (int i = 0; i < kNumTasks; i++) {
+        pool.Add([&rng, &task_results, i]() {
+          RandomNumberGenerator task_rng = rng.Stream(i);
+          double sum = 0.0;
+          for (int j = 0; j < 1000; j++) {
+            sum += task_rng.RandGaussian(0.0, 1.0);
+          }
+          task_results[i] = sum;
+        });
+      }
+    }
+    results.emplace_back(task_results);
+  }
+  EXPECT_EQ(results[0], results[1]);
+  EXPECT_EQ(results[0], results[2]);
+}
+
+TEST(RandomNumberGenerator, Ranges) {
+  RandomNumberGenerator rng(59);
+  std::vector<int> counts(5, 0);
+  for (int i = 0; i < 10000; i++) {
+    const int value = rng.RandInt(-2, 2);
+    ASSERT_GE(value, -2);
+    ASSERT_LE(value, 2);
+    ++counts[value + 2];
+
+    const double real = rng.RandDouble(-3.0, 5.0);
+    EXPECT_GE(real, -3.0);
+    EXPECT_LE(real, 5.0);
+    const float real_float = rng.RandFloat(1.0f, 2.0f);
+    EXPECT_GE(real_float, 1.0f);
+    EXPECT_LE(real_float, 2.0f);
+  }
+  for (const int count : counts) {
+    EXPECT_NEAR(count, 2000, 200);
+  }
+  EXPECT_EQ(rng.RandInt(4, 4), 4);
+}
+
+TEST(RandomNumberGenerator, Gaussian) {
+  RandomNumberGenerator rng(61);
+  static const int kNumSamples = 100000;
+  double sum = 0.0, sum_of_squares = 0.0;
+  for (int i = 0; i < kNumSamples; i++) {
+    const double value = rng.RandGaussian(2.0, 3.0);
+    sum += value;
+    sum_of_squares += value * value;
+  }
+  const double mean = sum / kNumSamples;
+  const double variance = sum_of_squares / kNumSamples - mean * mean;
+  EXPECT_NEAR(mean, 2.0, 0.05);
+  EXPECT_NEAR(std::sqrt(variance), 3.0, 0.05);
+}
+
+TEST(StreamIdFromString, IsStable) {
+  // FNV-1a of the empty string and of "a".
+  EXPECT_EQ(StreamIdFromString(""), 0xcbf29ce484222325ull);
+  EXPECT_EQ(StreamIdFromString("a"), 0xaf63dc4c8601ec8cull);
+  EXPECT_NE(StreamIdFromString("image1.jpg"), StreamIdFromString("image2.jpg"));
+}
+
+}  // namespace theia